@@ -0,0 +1,1112 @@
+/* * * * * * * * *
+ * Utility program that benchmarks the hash table implementations directly,
+ * without going through the command interpreter
+ *
+ * usage:
+ *   make bench
+ *   ./bench mode [arguments...]
+ *       run ./bench with no arguments for a list of modes
+ *
+ * created for COMP20007 Design of Algorithms - Assignment 2, 2017
+ * by Luke Hedt
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include "inthash.h"
+#include "hashtbl.h"
+#include "hashtbl_typed.h"
+#include "perfcount.h"
+
+/*************************************************************************/
+
+/* Wall-clock time in seconds, for measuring throughput. */
+static double now() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/* Small, fast per-thread random number generator (xorshift64*). */
+static int64 next_random(int64 *state) {
+	*state ^= *state >> 12;
+	*state ^= *state << 25;
+	*state ^= *state >> 27;
+	return *state * 2685821657736338717ULL;
+}
+
+/*************************************************************************/
+
+/* Mode 'scaling': mixed insert/lookup workload on the thread-safe extendible
+ * hash table, with 1..N threads sharing one table. */
+
+typedef struct scaling_job {
+	XtndblCHashTable *table;
+	int nops;		/* how many operations this thread performs */
+	int insertpct;	/* percentage of those operations that are inserts */
+	int64 seed;		/* seed for this thread's keys */
+	int keyrange;	/* keys are drawn from [0, keyrange) */
+} ScalingJob;
+
+static void *scaling_worker(void *arg) {
+	ScalingJob *job = arg;
+	int64 state = job->seed;
+	int i;
+	for (i = 0; i < job->nops; i++) {
+		int64 r = next_random(&state);
+		int64 key = (r >> 8) % job->keyrange;
+		if ((int)(r % 100) < job->insertpct) {
+			xtndblc_hash_table_insert(job->table, key);
+		} else {
+			xtndblc_hash_table_lookup(job->table, key);
+		}
+	}
+	return NULL;
+}
+
+static void bench_scaling(int maxthreads, int nops, int bucketsize,
+		int insertpct) {
+	printf("xtndblc scaling: %d ops, bucket size %d, %d%% inserts\n",
+		nops, bucketsize, insertpct);
+	printf("threads   seconds    Mops/s   speedup\n");
+
+	double base = 0;
+	int nthreads;
+	for (nthreads = 1; nthreads <= maxthreads; nthreads++) {
+		XtndblCHashTable *table = new_xtndblc_hash_table(bucketsize);
+		pthread_t *threads = malloc(sizeof *threads * nthreads);
+		ScalingJob *jobs = malloc(sizeof *jobs * nthreads);
+
+		double start = now();
+		int t;
+		for (t = 0; t < nthreads; t++) {
+			jobs[t].table = table;
+			jobs[t].nops = nops / nthreads;
+			jobs[t].insertpct = insertpct;
+			jobs[t].seed = 88172645463325252ULL + t;
+			jobs[t].keyrange = nops;
+			pthread_create(&threads[t], NULL, scaling_worker, &jobs[t]);
+		}
+		long done = 0;
+		for (t = 0; t < nthreads; t++) {
+			pthread_join(threads[t], NULL);
+			done += jobs[t].nops;
+		}
+		double elapsed = now() - start;
+
+		// (nops may not divide evenly between the threads)
+		double mops = done / elapsed / 1e6;
+		if (nthreads == 1) {
+			base = mops;
+		}
+		printf("%7d %9.3f %9.2f %8.2fx\n", nthreads, elapsed, mops,
+			mops / base);
+
+		free(jobs);
+		free(threads);
+		free_xtndblc_hash_table(table);
+	}
+}
+
+/*************************************************************************/
+
+/* Mode 'sharded': the same mixed insert/lookup workload as 'scaling', on a
+ * sharded table of each of the single-threaded types, with 1, 2, 4, ...
+ * threads sharing it. */
+
+typedef struct sharded_job {
+	HashTable *table;
+	int nops;		/* how many operations this thread performs */
+	int insertpct;	/* percentage of those operations that are inserts */
+	int64 seed;		/* seed for this thread's keys */
+	int keyrange;	/* keys are drawn from [0, keyrange) */
+} ShardedJob;
+
+static void *sharded_worker(void *arg) {
+	ShardedJob *job = arg;
+	int64 state = job->seed;
+	int i;
+	for (i = 0; i < job->nops; i++) {
+		int64 r = next_random(&state);
+		int64 key = (r >> 8) % job->keyrange;
+		if ((int)(r % 100) < job->insertpct) {
+			hash_table_insert(job->table, key);
+		} else {
+			hash_table_lookup(job->table, key);
+		}
+	}
+	return NULL;
+}
+
+static void bench_sharded(int maxthreads, int nops, int nshards,
+		int insertpct) {
+	// each type, with a size that suits it (linear tables only grow once
+	// they are full, so each shard gets room for every key it could hold)
+	struct { TableType type; int size; } backends[] = {
+		{ LINEAR, 2 * (nops / nshards + 1) }, { CUCKOO, 1024 },
+		{ XTNDBLN, 16 }, { XUCKOO, 4 }, { LINHASH, 16 }, { XTNDBLZ, 16 },
+		{ STRLINEAR, 1024 },
+	};
+	int nbackends = sizeof backends / sizeof *backends;
+
+	printf("sharded scaling: %d ops, %d shards, %d%% inserts\n", nops,
+		nshards, insertpct);
+	printf("type      threads   seconds    Mops/s   speedup\n");
+
+	int b;
+	for (b = 0; b < nbackends; b++) {
+		double base = 0;
+		int nthreads;
+		for (nthreads = 1; nthreads <= maxthreads; nthreads *= 2) {
+			HashTable *table = new_sharded_hash_table(backends[b].type,
+				backends[b].size, nshards);
+			pthread_t *threads = malloc(sizeof *threads * nthreads);
+			ShardedJob *jobs = malloc(sizeof *jobs * nthreads);
+
+			double start = now();
+			int t;
+			for (t = 0; t < nthreads; t++) {
+				jobs[t].table = table;
+				jobs[t].nops = nops / nthreads;
+				jobs[t].insertpct = insertpct;
+				jobs[t].seed = 88172645463325252ULL + t;
+				jobs[t].keyrange = nops;
+				pthread_create(&threads[t], NULL, sharded_worker, &jobs[t]);
+			}
+			long done = 0;
+			for (t = 0; t < nthreads; t++) {
+				pthread_join(threads[t], NULL);
+				done += jobs[t].nops;
+			}
+			double elapsed = now() - start;
+
+			double mops = done / elapsed / 1e6;
+			if (nthreads == 1) {
+				base = mops;
+			}
+			printf("%-9s %7d %9.3f %9.2f %8.2fx\n",
+				nthreads == 1 ? typetostr(backends[b].type) : "",
+				nthreads, elapsed, mops, mops / base);
+
+			free(jobs);
+			free(threads);
+			free_hash_table(table);
+		}
+	}
+}
+
+/*************************************************************************/
+
+/* Mode 'lockfree': the same mixed insert/lookup workload again, on the
+ * lock-free linear probing table, next to the lock-based tables it could
+ * replace, with 1, 2, 4, ... threads sharing each one. */
+
+static void bench_lockfree(int maxthreads, int nops, int insertpct) {
+	int nshards = 64;
+	printf("lock-free scaling: %d ops, %d%% inserts\n", nops, insertpct);
+	printf("table          threads   seconds    Mops/s   speedup\n");
+
+	int b;
+	for (b = 0; b < 3; b++) {
+		double base = 0;
+		int nthreads;
+		for (nthreads = 1; nthreads <= maxthreads; nthreads *= 2) {
+			HashTable *table;
+			char *name;
+			if (b == 0) {
+				table = new_hash_table(LINEARC, 16);
+				name = "linearc";
+			} else if (b == 1) {
+				table = new_hash_table(XTNDBLC, 16);
+				name = "xtndblc";
+			} else {
+				table = new_sharded_hash_table(LINEAR,
+					2 * (nops / nshards + 1), nshards);
+				name = "sharded linear";
+			}
+			pthread_t *threads = malloc(sizeof *threads * nthreads);
+			ShardedJob *jobs = malloc(sizeof *jobs * nthreads);
+
+			double start = now();
+			int t;
+			for (t = 0; t < nthreads; t++) {
+				jobs[t].table = table;
+				jobs[t].nops = nops / nthreads;
+				jobs[t].insertpct = insertpct;
+				jobs[t].seed = 88172645463325252ULL + t;
+				jobs[t].keyrange = nops;
+				pthread_create(&threads[t], NULL, sharded_worker, &jobs[t]);
+			}
+			long done = 0;
+			for (t = 0; t < nthreads; t++) {
+				pthread_join(threads[t], NULL);
+				done += jobs[t].nops;
+			}
+			double elapsed = now() - start;
+
+			double mops = done / elapsed / 1e6;
+			if (nthreads == 1) {
+				base = mops;
+			}
+			printf("%-14s %7d %9.3f %9.2f %8.2fx\n", nthreads == 1 ? name : "",
+				nthreads, elapsed, mops, mops / base);
+
+			free(jobs);
+			free(threads);
+			free_hash_table(table);
+		}
+	}
+}
+
+/*************************************************************************/
+
+/* Mode 'stress': correctness check of the thread-safe tables (the lock-free
+ * linear table, and xtndblc, whose directory is read without a lock). Each
+ * round, every thread inserts the same keys (in its own order) into one table
+ * that starts as small as it can, so it grows many times while they do; each
+ * key
+ * must be inserted exactly once, be found straight after every insert of it,
+ * and be found at the end, while keys never inserted must not be. Exits with
+ * status 1 on any failure. */
+
+typedef struct stress_job {
+	HashTable *table;
+	int64 *keys;
+	int nkeys;
+	int thread;		/* which thread this is, to choose its order */
+	int nthreads;
+	int ninserted;	/* how many of this thread's inserts returned true */
+	int nmissing;	/* how many keys it couldn't find after inserting them */
+} StressJob;
+
+static void *stress_worker(void *arg) {
+	StressJob *job = arg;
+	int offset = (int)((long long)job->nkeys * job->thread / job->nthreads);
+	int j;
+	for (j = 0; j < job->nkeys; j++) {
+		// start at a different key in each thread, every other one backwards
+		int i = (j + offset) % job->nkeys;
+		if (job->thread % 2) {
+			i = job->nkeys - 1 - i;
+		}
+		if (hash_table_insert(job->table, job->keys[i])) {
+			job->ninserted++;
+		}
+		if (!hash_table_lookup(job->table, job->keys[i])) {
+			job->nmissing++;
+		}
+	}
+	return NULL;
+}
+
+static void bench_stress(int nthreads, int nkeys, int rounds) {
+	// distinct keys spread over all 64 bits, including the two the table
+	// reserves for its slots; the second half are never inserted
+	int64 *keys = malloc(sizeof *keys * nkeys * 2);
+	int i;
+	for (i = 0; i < nkeys * 2; i++) {
+		keys[i] = (int64)(i + 2) * 0x9E3779B97F4A7C15ULL;
+	}
+	keys[0] = UINT64_MAX;
+	keys[1] = UINT64_MAX - 1;
+
+	printf("thread-safe stress: %d threads, %d keys, %d rounds\n", nthreads,
+		nkeys, rounds);
+	pthread_t *threads = malloc(sizeof *threads * nthreads);
+	StressJob *jobs = malloc(sizeof *jobs * nthreads);
+	int failures = 0;
+
+	// each type, starting small (one slot, or one bucket of four keys), and
+	// taking turns round by round
+	struct { TableType type; int size; } types[] = {
+		{ LINEARC, 1 }, { XTNDBLC, 4 },
+	};
+	int r, ntypes = sizeof types / sizeof *types;
+	for (r = 0; r < rounds * ntypes; r++) {
+		TableType type = types[r % ntypes].type;
+		HashTable *table = new_hash_table(type, types[r % ntypes].size);
+		int t;
+		for (t = 0; t < nthreads; t++) {
+			jobs[t].table = table;
+			jobs[t].keys = keys;
+			jobs[t].nkeys = nkeys;
+			jobs[t].thread = t;
+			jobs[t].nthreads = nthreads;
+			jobs[t].ninserted = 0;
+			jobs[t].nmissing = 0;
+			pthread_create(&threads[t], NULL, stress_worker, &jobs[t]);
+		}
+		int ninserted = 0, nmissing = 0;
+		for (t = 0; t < nthreads; t++) {
+			pthread_join(threads[t], NULL);
+			ninserted += jobs[t].ninserted;
+			nmissing += jobs[t].nmissing;
+		}
+
+		int nlost = 0, nextra = 0;
+		for (i = 0; i < nkeys; i++) {
+			nlost += !hash_table_lookup(table, keys[i]);
+			nextra += hash_table_lookup(table, keys[nkeys + i]);
+		}
+
+		if (ninserted != nkeys || nmissing || nlost || nextra) {
+			printf("%s round %d FAILED: %d inserts succeeded (expected %d), "
+				"%d lookups missed during inserts, %d keys lost, "
+				"%d absent keys found\n", typetostr(type), r / ntypes,
+				ninserted, nkeys, nmissing, nlost, nextra);
+			failures++;
+		}
+		free_hash_table(table);
+	}
+
+	printf("%d of %d rounds passed\n", rounds * ntypes - failures,
+		rounds * ntypes);
+	free(jobs);
+	free(threads);
+	free(keys);
+	if (failures) {
+		exit(1);
+	}
+}
+
+/*************************************************************************/
+
+/* Mode 'lookup': build a table of any type from random keys, then time
+ * lookups (half hits, half misses) and report memory per key. */
+
+/* Resident memory of this process right now, in bytes. (The peak from
+ * getrusage() would hide small tables behind the memory used while the
+ * program was being loaded.) */
+static long resident_bytes() {
+	long pages = 0, resident = 0;
+	FILE *statm = fopen("/proc/self/statm", "r");
+	if (statm) {
+		if (fscanf(statm, "%ld %ld", &pages, &resident) != 2) {
+			resident = 0;
+		}
+		fclose(statm);
+	}
+	return resident * sysconf(_SC_PAGESIZE);
+}
+
+static void bench_lookup(TableType type, int size, int nkeys, int nlookups) {
+	long base = resident_bytes();
+	int64 *keys = malloc(sizeof *keys * nkeys);
+	int64 state = 88172645463325252ULL;
+	int i;
+	for (i = 0; i < nkeys; i++) {
+		keys[i] = next_random(&state);
+	}
+	long keybytes = resident_bytes() - base;
+
+	HashTable *table = new_hash_table(type, size);
+	double start = now();
+	for (i = 0; i < nkeys; i++) {
+		hash_table_insert(table, keys[i]);
+	}
+	double build = now() - start;
+	long tablebytes = resident_bytes() - base - keybytes;
+
+	int found = 0;
+	start = now();
+	for (i = 0; i < nlookups; i++) {
+		int64 key = (i & 1) ? keys[(i * 7919L) % nkeys] : next_random(&state);
+		found += hash_table_lookup(table, key);
+	}
+	double look = now() - start;
+
+	printf("keys: %d, lookups: %d (%d found)\n", nkeys, nlookups, found);
+	printf("build: %.3f s (%.1f ns/insert)\n", build, build * 1e9 / nkeys);
+	printf("lookup: %.3f s (%.1f ns/lookup)\n", look, look * 1e9 / nlookups);
+	printf("resident memory: %.1f bytes/key\n", (double)tablebytes / nkeys);
+
+	free_hash_table(table);
+	free(keys);
+}
+
+/*************************************************************************/
+
+/* Mode 'batch': build a table of any type from random keys, then compare
+ * one-at-a-time lookups with batched lookups of the same keys. */
+
+static void bench_batch(TableType type, int size, int nkeys, int nlookups,
+		int batchsize) {
+	long base = resident_bytes();
+	int64 *keys = malloc(sizeof *keys * nkeys);
+	int64 state = 88172645463325252ULL;
+	int i;
+	for (i = 0; i < nkeys; i++) {
+		keys[i] = next_random(&state);
+	}
+
+	HashTable *table = new_hash_table(type, size);
+	for (i = 0; i < nkeys; i++) {
+		hash_table_insert(table, keys[i]);
+	}
+	long tablebytes = resident_bytes() - base;
+
+	// the same queries for both runs: half hits, half misses
+	int64 *queries = malloc(sizeof *queries * nlookups);
+	bool *found = malloc(sizeof *found * batchsize);
+	for (i = 0; i < nlookups; i++) {
+		queries[i] = (i & 1) ? keys[(i * 7919L) % nkeys] : next_random(&state);
+	}
+
+	int nfound = 0;
+	double start = now();
+	for (i = 0; i < nlookups; i++) {
+		nfound += hash_table_lookup(table, queries[i]);
+	}
+	double single = now() - start;
+
+	int nbatchfound = 0;
+	start = now();
+	for (i = 0; i < nlookups; i += batchsize) {
+		int n = nlookups - i < batchsize ? nlookups - i : batchsize;
+		nbatchfound += hash_table_lookup_batch(table, queries + i, n, found);
+	}
+	double batch = now() - start;
+
+	printf("keys: %d, table: %.1f MB, lookups: %d (%d found, %d batched)\n",
+		nkeys, tablebytes / 1048576.0, nlookups, nfound, nbatchfound);
+	printf("one at a time: %.3f s (%.1f ns/lookup)\n", single,
+		single * 1e9 / nlookups);
+	printf("batches of %d: %.3f s (%.1f ns/lookup, %.2fx)\n", batchsize, batch,
+		batch * 1e9 / nlookups, single / batch);
+
+	free_hash_table(table);
+	free(found);
+	free(queries);
+	free(keys);
+}
+
+/*************************************************************************/
+
+/* Mode 'memory': insert keys drawn from the same range as cmdgen's (without
+ * keeping a copy of them), then report memory and the table's stats. */
+
+static void bench_memory(TableType type, int size, int nkeys) {
+	long base = resident_bytes();
+	int64 state = 88172645463325252ULL;
+	int64 max = 100LL * nkeys + 1;
+
+	HashTable *table = new_hash_table(type, size);
+	double start = now();
+	int i;
+	for (i = 0; i < nkeys; i++) {
+		hash_table_insert(table, next_random(&state) % max);
+	}
+	double build = now() - start;
+	long tablebytes = resident_bytes() - base;
+
+	printf("keys: %d from [0, %lld)\n", nkeys, (long long)max);
+	printf("build: %.3f s (%.1f ns/insert)\n", build, build * 1e9 / nkeys);
+	printf("resident memory: %.1f bytes/key\n", (double)tablebytes / nkeys);
+	hash_table_stats(table);
+
+	free_hash_table(table);
+}
+
+/*************************************************************************/
+
+/* Mode 'sizes': batched lookups of keys that are (and aren't) in an n-key
+ * extendible hash table, for each of the bucket sizes that xtndbln has a
+ * specialised bucket search for. The default table fits in cache, so that
+ * the time goes on searching buckets rather than on cache misses. */
+
+/* Time batched lookups of all 'n' 'queries' in 'table', in ns/lookup. */
+static double time_batches(HashTable *table, int64 *queries, int n,
+		bool *found, int batchsize) {
+	double start = now();
+	int i;
+	for (i = 0; i < n; i += batchsize) {
+		hash_table_lookup_batch(table, queries + i,
+			n - i < batchsize ? n - i : batchsize, found);
+	}
+	return (now() - start) * 1e9 / n;
+}
+
+static void bench_sizes(int nkeys, int nlookups) {
+	int sizes[] = {4, 8, 16, 32};
+	int batchsize = 1024;
+	int64 *keys = malloc(sizeof *keys * nkeys);
+	int64 *hits = malloc(sizeof *hits * nlookups);
+	int64 *misses = malloc(sizeof *misses * nlookups);
+	bool *found = malloc(sizeof *found * batchsize);
+	int64 state = 88172645463325252ULL;
+	int i;
+	for (i = 0; i < nkeys; i++) {
+		keys[i] = next_random(&state);
+	}
+	for (i = 0; i < nlookups; i++) {
+		hits[i] = keys[(i * 7919L) % nkeys];
+		misses[i] = next_random(&state);
+	}
+
+	printf("xtndbln: %d keys, %d lookups in batches of %d\n", nkeys, nlookups,
+		batchsize);
+	printf("bucketsize   hits ns/lookup   misses ns/lookup\n");
+	int s;
+	for (s = 0; s < (int)(sizeof sizes / sizeof *sizes); s++) {
+		HashTable *table = new_hash_table(XTNDBLN, sizes[s]);
+		for (i = 0; i < nkeys; i++) {
+			hash_table_insert(table, keys[i]);
+		}
+		double hit = time_batches(table, hits, nlookups, found, batchsize);
+		double miss = time_batches(table, misses, nlookups, found, batchsize);
+		printf("%10d %17.1f %18.1f\n", sizes[s], hit, miss);
+		free_hash_table(table);
+	}
+
+	free(found);
+	free(misses);
+	free(hits);
+	free(keys);
+}
+
+/*************************************************************************/
+
+/* Mode 'map': keys with a value each, kept either as a set of keys plus a
+ * second table mapping them to their values (two hashes and two cache misses
+ * per lookup), or as one hash map holding both. */
+
+static void bench_map(TableType type, int size, int nkeys, int nlookups) {
+	int64 *keys = malloc(sizeof *keys * nkeys);
+	int64 *queries = malloc(sizeof *queries * nlookups);
+	int64 state = 88172645463325252ULL;
+	int i;
+	for (i = 0; i < nkeys; i++) {
+		keys[i] = next_random(&state);
+	}
+	for (i = 0; i < nlookups; i++) {
+		queries[i] = (i & 1) ? keys[(i * 7919L) % nkeys] : next_random(&state);
+	}
+
+	// the set and its separate table of values
+	long base = resident_bytes();
+	HashTable *set = new_hash_table(type, size);
+	HashTable *values = new_hash_map(type, size);
+	if (values == NULL) {
+		fprintf(stderr, "this type of table can't store values\n");
+		exit(1);
+	}
+	for (i = 0; i < nkeys; i++) {
+		hash_table_insert(set, keys[i]);
+		hash_table_put(values, keys[i], i);
+	}
+	long twobytes = resident_bytes() - base;
+
+	// the map holding both
+	base = resident_bytes();
+	HashTable *map = new_hash_map(type, size);
+	for (i = 0; i < nkeys; i++) {
+		hash_table_put(map, keys[i], i);
+	}
+	long mapbytes = resident_bytes() - base;
+
+	int64 value, sum = 0;
+	double start = now();
+	for (i = 0; i < nlookups; i++) {
+		if (hash_table_lookup(set, queries[i])) {
+			hash_table_get(values, queries[i], &value);
+			sum += value;
+		}
+	}
+	double two = now() - start;
+
+	start = now();
+	for (i = 0; i < nlookups; i++) {
+		if (hash_table_get(map, queries[i], &value)) {
+			sum -= value;
+		}
+	}
+	double one = now() - start;
+
+	// and for comparison, just the keys
+	start = now();
+	for (i = 0; i < nlookups; i++) {
+		sum += hash_table_lookup(set, queries[i]);
+	}
+	double keysonly = now() - start;
+
+	printf("keys: %d, lookups: %d (half found, checksum %lld)\n", nkeys,
+		nlookups, (long long)sum);
+	printf("set + value table: %7.1f ns/lookup, %5.1f bytes/key\n",
+		two * 1e9 / nlookups, (double)twobytes / nkeys);
+	printf("hash map:          %7.1f ns/lookup, %5.1f bytes/key\n",
+		one * 1e9 / nlookups, (double)mapbytes / nkeys);
+	printf("(set alone:        %7.1f ns/lookup)\n", keysonly * 1e9 / nlookups);
+
+	free_hash_table(map);
+	free_hash_table(values);
+	free_hash_table(set);
+	free(queries);
+	free(keys);
+}
+
+/*************************************************************************/
+
+/* Mode 'strings': URL-like string keys, kept in a string key table, or
+ * pre-hashed to int64 keys (risking collisions) in an n-key extendible table
+ * as before. */
+
+#define MAX_URL_LEN 64
+
+static void bench_strings(int nkeys, int nlookups) {
+	char (*urls)[MAX_URL_LEN] = malloc(sizeof *urls * nkeys);
+	int *lengths = malloc(sizeof *lengths * nkeys);
+	int *queries = malloc(sizeof *queries * nlookups);
+	int64 state = 88172645463325252ULL;
+	int i;
+	for (i = 0; i < nkeys; i++) {
+		lengths[i] = snprintf(urls[i], MAX_URL_LEN,
+			"https://example.com/users/%llu/items/%llu",
+			next_random(&state) % 1000000, next_random(&state) % 100000);
+	}
+	// the keys in the first half of 'urls' are inserted, and half of the
+	// lookups are for those, half for keys in the other half
+	for (i = 0; i < nlookups; i++) {
+		queries[i] = next_random(&state) % nkeys;
+	}
+
+	long base = resident_bytes();
+	HashTable *strings = new_hash_table(STRLINEAR, 16);
+	for (i = 0; i < nkeys / 2; i++) {
+		hash_table_insert_string(strings, urls[i], lengths[i]);
+	}
+	long stringbytes = resident_bytes() - base;
+
+	base = resident_bytes();
+	HashTable *hashed = new_hash_table(XTNDBLN, 16);
+	for (i = 0; i < nkeys / 2; i++) {
+		hash_table_insert(hashed, hstr(urls[i], lengths[i]));
+	}
+	long hashedbytes = resident_bytes() - base;
+
+	int found = 0;
+	double start = now();
+	for (i = 0; i < nlookups; i++) {
+		int q = queries[i];
+		found += hash_table_lookup_string(strings, urls[q], lengths[q]);
+	}
+	double stringtime = now() - start;
+
+	start = now();
+	for (i = 0; i < nlookups; i++) {
+		int q = queries[i];
+		found += hash_table_lookup(hashed, hstr(urls[q], lengths[q]));
+	}
+	double hashedtime = now() - start;
+
+	printf("keys: %d, lookups: %d (%d found by each)\n", nkeys / 2,
+		nlookups, found / 2);
+	printf("strlinear, string keys:   %7.1f ns/lookup, %5.1f bytes/key\n",
+		stringtime * 1e9 / nlookups, (double)stringbytes / (nkeys / 2));
+	printf("xtndbln, pre-hashed keys: %7.1f ns/lookup, %5.1f bytes/key\n",
+		hashedtime * 1e9 / nlookups, (double)hashedbytes / (nkeys / 2));
+	hash_table_stats(strings);
+
+	free_hash_table(hashed);
+	free_hash_table(strings);
+	free(queries);
+	free(lengths);
+	free(urls);
+}
+
+/*************************************************************************/
+
+/* Mode 'build': make a table from an array of keys (a quarter of them
+ * repeats) by inserting them one at a time, by bulk building it, and by bulk
+ * building it with several threads, then check all three hold the same keys. */
+
+/* Counts how many of the 'n' 'queries' are in 'table'. */
+static int count_found(HashTable *table, int64 *queries, int n) {
+	bool *found = malloc(sizeof *found * n);
+	int nfound = hash_table_lookup_batch(table, queries, n, found);
+	free(found);
+	return nfound;
+}
+
+static void bench_build(TableType type, int size, int nkeys, int nthreads) {
+	int64 *keys = malloc(sizeof *keys * nkeys);
+	int64 *queries = malloc(sizeof *queries * nkeys);
+	int64 state = 88172645463325252ULL;
+	int i;
+	for (i = 0; i < nkeys; i++) {
+		keys[i] = (i % 4 == 3) ? keys[(i * 7919L) % i] : next_random(&state);
+	}
+	for (i = 0; i < nkeys; i++) {
+		queries[i] = (i & 1) ? keys[(i * 7919L) % nkeys] : next_random(&state);
+	}
+
+	printf("keys: %d (some repeated), %d thread(s)\n", nkeys, nthreads);
+	printf("build             seconds  ns/key   found\n");
+
+	double start = now();
+	HashTable *table = new_hash_table(type, size);
+	for (i = 0; i < nkeys; i++) {
+		hash_table_insert(table, keys[i]);
+	}
+	double took = now() - start;
+	printf("insert loop     %9.3f %7.1f  %7d\n", took,
+		took * 1e9 / nkeys, count_found(table, queries, nkeys));
+	free_hash_table(table);
+
+	start = now();
+	table = hash_table_bulk_build(type, size, keys, nkeys);
+	took = now() - start;
+	printf("bulk build      %9.3f %7.1f  %7d\n", took,
+		took * 1e9 / nkeys, count_found(table, queries, nkeys));
+	free_hash_table(table);
+
+	start = now();
+	table = hash_table_bulk_build_parallel(type, size, keys, nkeys, nthreads);
+	took = now() - start;
+	printf("parallel build  %9.3f %7.1f  %7d\n", took,
+		took * 1e9 / nkeys, count_found(table, queries, nkeys));
+	free_hash_table(table);
+
+	free(queries);
+	free(keys);
+}
+
+/*************************************************************************/
+
+/* Mode 'counters': for every type of table, count hardware events (from perf
+ * events, where the kernel allows them) per insert while building an n-key
+ * table, and per lookup (half hits, half misses) in batches. Keys are drawn
+ * from the same range as cmdgen's. Unless types are named, xtndbl1 is left
+ * out (with one key per bucket, its directory can't hold this many keys) and
+ * so is xtndbld (which can only be opened from files on disk). */
+
+/* Print one row of the 'counters' table: 'values' counted over 'nops' ops
+ * taking 'seconds', with '-' for the events that couldn't be counted. */
+static void print_counters_row(const char *type, const char *op,
+		PerfCounters *counters, uint64_t *values, int nops, double seconds) {
+	printf("%-10s %-7s %7.1f", type, op, seconds * 1e9 / nops);
+	if (perf_counters_available(counters, PERF_INSTRUCTIONS)
+			&& perf_counters_available(counters, PERF_CYCLES)
+			&& values[PERF_CYCLES] > 0) {
+		printf(" %6.2f", (double)values[PERF_INSTRUCTIONS]
+			/ values[PERF_CYCLES]);
+	} else {
+		printf(" %6s", "-");
+	}
+	int event;
+	for (event = 0; event < NUM_PERF_EVENTS; event++) {
+		if (perf_counters_available(counters, event)) {
+			printf(" %9.2f", (double)values[event] / nops);
+		} else {
+			printf(" %9s", "-");
+		}
+	}
+	printf("\n");
+}
+
+static void bench_counters(int size, int nkeys, int nlookups,
+		TableType *types, int ntypes) {
+	int batchsize = 1024;
+	int64 *keys = malloc(sizeof *keys * nkeys);
+	int64 *queries = malloc(sizeof *queries * nlookups);
+	bool *found = malloc(sizeof *found * batchsize);
+	int64 state = 88172645463325252ULL;
+	int64 max = 100LL * nkeys + 1;
+	int i;
+	for (i = 0; i < nkeys; i++) {
+		keys[i] = next_random(&state) % max;
+	}
+	for (i = 0; i < nlookups; i++) {
+		queries[i] = (i & 1) ? keys[(i * 7919L) % nkeys]
+			: next_random(&state) % max;
+	}
+
+	PerfCounters *counters = new_perf_counters();
+	printf("hardware events per op: %d keys, %d lookups in batches of %d, "
+		"size %d\n", nkeys, nlookups, batchsize, size);
+	if (perf_counters_error(counters)) {
+		printf("(%s)\n", perf_counters_error(counters));
+	}
+	printf("%-10s %-7s %7s %6s", "type", "op", "ns", "IPC");
+	int event;
+	for (event = 0; event < NUM_PERF_EVENTS; event++) {
+		printf(" %9s", perf_event_name(event));
+	}
+	printf("\n");
+
+	uint64_t values[NUM_PERF_EVENTS];
+	int t;
+	for (t = 0; t < ntypes; t++) {
+		TableType type = types[t];
+		HashTable *table = new_hash_table(type, size);
+
+		double start = now();
+		perf_counters_start(counters);
+		for (i = 0; i < nkeys; i++) {
+			hash_table_insert(table, keys[i]);
+		}
+		perf_counters_stop(counters, values);
+		print_counters_row(typetostr(type), "insert", counters, values, nkeys,
+			now() - start);
+
+		start = now();
+		perf_counters_start(counters);
+		for (i = 0; i < nlookups; i += batchsize) {
+			hash_table_lookup_batch(table, queries + i,
+				nlookups - i < batchsize ? nlookups - i : batchsize, found);
+		}
+		perf_counters_stop(counters, values);
+		print_counters_row("", "lookup", counters, values, nlookups,
+			now() - start);
+
+		free_hash_table(table);
+	}
+
+	free_perf_counters(counters);
+	free(found);
+	free(queries);
+	free(keys);
+}
+
+/*************************************************************************/
+
+/* Mode 'dispatch': the cost of calling a table through the unified interface
+ * (a vtable call behind a wrapper), compared with calling the same function
+ * directly or having it inlined, for a table that does no work at all and
+ * then for a real one. */
+
+/* A 'null' table type, holding one key, registered like any other type. */
+typedef struct null_table {
+	int64 key;
+} NullTable;
+
+static void *null_create(int size) {
+	NullTable *table = malloc(sizeof *table);
+	table->key = size;
+	return table;
+}
+static bool null_insert(void *table, int64 key) {
+	((NullTable *)table)->key = key;
+	return true;
+}
+static bool null_lookup(void *table, int64 key) {
+	return ((NullTable *)table)->key == key;
+}
+static void null_nothing(void *table) {
+	(void)table;
+}
+
+static const TableOps null_ops = {
+	.name = "null", .create = null_create, .free = free,
+	.insert = null_insert, .lookup = null_lookup,
+	.print = null_nothing, .stats = null_nothing
+};
+
+/* The same lookup, but never inlined, standing in for a direct call into
+ * another module. */
+static __attribute__((noinline)) bool null_lookup_call(NullTable *table,
+		int64 key) {
+	return table->key == key;
+}
+
+static void bench_dispatch(int nkeys, int nlookups) {
+	int64 *queries = malloc(sizeof *queries * nlookups);
+	int64 state = 88172645463325252ULL;
+	int i;
+	for (i = 0; i < nlookups; i++) {
+		queries[i] = next_random(&state) % 4;
+	}
+
+	printf("dispatch: %d lookups\n", nlookups);
+	printf("table    call          ns/op\n");
+
+	TableType null = register_hash_table_type(&null_ops);
+	HashTable *table = new_hash_table(null, 1);
+	NullTable *impl = hash_table_impl(table);
+	int found = 0;
+
+	double start = now();
+	for (i = 0; i < nlookups; i++) {
+		found += hash_table_lookup(table, queries[i]);
+	}
+	printf("null     vtable    %9.2f\n", (now() - start) * 1e9 / nlookups);
+
+	start = now();
+	for (i = 0; i < nlookups; i++) {
+		found += null_lookup_call(impl, queries[i]);
+	}
+	printf("null     direct    %9.2f\n", (now() - start) * 1e9 / nlookups);
+
+	start = now();
+	for (i = 0; i < nlookups; i++) {
+		found += null_lookup(impl, queries[i]);
+	}
+	printf("null     inline    %9.2f\n", (now() - start) * 1e9 / nlookups);
+	free_hash_table(table);
+
+	// then a real table, with half of the lookups hitting
+	table = new_hash_table(XTNDBLN, 16);
+	state = 88172645463325252ULL;
+	for (i = 0; i < nkeys; i++) {
+		hash_table_insert(table, next_random(&state) % (2 * nkeys));
+	}
+	for (i = 0; i < nlookups; i++) {
+		queries[i] = next_random(&state) % (2 * nkeys);
+	}
+
+	start = now();
+	for (i = 0; i < nlookups; i++) {
+		found += hash_table_lookup(table, queries[i]);
+	}
+	printf("xtndbln  vtable    %9.2f\n", (now() - start) * 1e9 / nlookups);
+
+	XtndblNHashTable *xtndbln = xtndbln_of(table);
+	start = now();
+	for (i = 0; i < nlookups; i++) {
+		found += xtndbln_hash_table_lookup(xtndbln, queries[i]);
+	}
+	printf("xtndbln  direct    %9.2f\n", (now() - start) * 1e9 / nlookups);
+	printf("(%d found)\n", found);
+
+	free_hash_table(table);
+	free(queries);
+}
+
+/*************************************************************************/
+
+void printusageexit(char *exe) {
+	fprintf(stderr, "usage: %s mode [arguments...]\n", exe);
+	fprintf(stderr, " %s scaling [maxthreads [nops [bucketsize [insertpct]]]]\n",
+		exe);
+	fprintf(stderr, "     mixed insert/lookup throughput of the thread-safe\n");
+	fprintf(stderr, "     extendible hash table, with 1..maxthreads threads\n");
+	fprintf(stderr, " %s sharded [maxthreads [nops [nshards [insertpct]]]]\n",
+		exe);
+	fprintf(stderr, "     the same, on a sharded table of each of the\n");
+	fprintf(stderr, "     single-threaded types, with 1, 2, 4... threads\n");
+	fprintf(stderr, " %s lockfree [maxthreads [nops [insertpct]]]\n", exe);
+	fprintf(stderr, "     the same, on the lock-free linear table, xtndblc\n");
+	fprintf(stderr, "     and a sharded linear table, with 1, 2, 4... threads\n");
+	fprintf(stderr, " %s stress [nthreads [nkeys [rounds]]]\n", exe);
+	fprintf(stderr, "     many threads insert the same keys into a growing\n");
+	fprintf(stderr, "     linearc or xtndblc table at once; check none are\n");
+	fprintf(stderr, "     lost\n");
+	fprintf(stderr, " %s lookup type size nkeys [nlookups]\n", exe);
+	fprintf(stderr, "     build a table of 'type' (as for a2 -t) from nkeys\n");
+	fprintf(stderr, "     random keys, then time lookups and report memory\n");
+	fprintf(stderr, " %s batch type size nkeys [nlookups [batchsize]]\n", exe);
+	fprintf(stderr, "     as for lookup, but compare one-at-a-time lookups\n");
+	fprintf(stderr, "     with batched lookups of the same keys\n");
+	fprintf(stderr, " %s memory type size nkeys\n", exe);
+	fprintf(stderr, "     insert nkeys keys in the range cmdgen uses, then\n");
+	fprintf(stderr, "     report memory and the table's stats\n");
+	fprintf(stderr, " %s sizes [nkeys [nlookups]]\n", exe);
+	fprintf(stderr, "     batched lookup speed of the n-key extendible hash\n");
+	fprintf(stderr, "     table for bucket sizes 4, 8, 16 and 32\n");
+	fprintf(stderr, " %s map type size nkeys [nlookups]\n", exe);
+	fprintf(stderr, "     look up values kept in a second table beside a\n");
+	fprintf(stderr, "     set, or with their keys in one hash map\n");
+	fprintf(stderr, " %s strings [nkeys [nlookups]]\n", exe);
+	fprintf(stderr, "     look up URL-like keys in a string key table, and\n");
+	fprintf(stderr, "     pre-hashed to int64 keys in an n-key table\n");
+	fprintf(stderr, " %s build type size nkeys [nthreads]\n", exe);
+	fprintf(stderr, "     make a table from an array of keys by inserting\n");
+	fprintf(stderr, "     them, and by bulk building it (with nthreads)\n");
+	fprintf(stderr, " %s counters [size [nkeys [nlookups [type...]]]]\n",
+		exe);
+	fprintf(stderr, "     cache, TLB and branch misses and instructions per\n");
+	fprintf(stderr, "     insert and lookup, for each type of table\n");
+	fprintf(stderr, " %s dispatch [nkeys [nlookups]]\n", exe);
+	fprintf(stderr, "     cost per lookup of calling a table through the\n");
+	fprintf(stderr, "     unified interface, directly, and inlined\n");
+	exit(1);
+}
+
+/* The type of table named 'str', or print usage and exit if there is no such
+ * type which can be created in memory. */
+static TableType typearg(char *exe, char *str) {
+	TableType type = strtotype(str);
+	if (type == NOTYPE || type == XTNDBLD) {
+		printusageexit(exe);
+	}
+	return type;
+}
+
+/* Integer argument 'i' of argv, or 'fallback' if it was not given. */
+static int intarg(int argc, char **argv, int i, int fallback) {
+	return i < argc ? atoi(argv[i]) : fallback;
+}
+
+int main(int argc, char **argv) {
+	if (argc < 2) {
+		printusageexit(argv[0]);
+	}
+
+	if (strcmp(argv[1], "scaling") == 0) {
+		bench_scaling(intarg(argc, argv, 2, 8), intarg(argc, argv, 3, 4000000),
+			intarg(argc, argv, 4, 16), intarg(argc, argv, 5, 50));
+	} else if (strcmp(argv[1], "sharded") == 0) {
+		bench_sharded(intarg(argc, argv, 2, 8), intarg(argc, argv, 3, 4000000),
+			intarg(argc, argv, 4, 64), intarg(argc, argv, 5, 50));
+	} else if (strcmp(argv[1], "lockfree") == 0) {
+		bench_lockfree(intarg(argc, argv, 2, 8), intarg(argc, argv, 3, 4000000),
+			intarg(argc, argv, 4, 50));
+	} else if (strcmp(argv[1], "stress") == 0) {
+		bench_stress(intarg(argc, argv, 2, 8), intarg(argc, argv, 3, 100000),
+			intarg(argc, argv, 4, 20));
+	} else if (strcmp(argv[1], "lookup") == 0 && argc >= 5) {
+		TableType type = typearg(argv[0], argv[2]);
+		int nkeys = atoi(argv[4]);
+		bench_lookup(type, atoi(argv[3]), nkeys, intarg(argc, argv, 5, nkeys));
+	} else if (strcmp(argv[1], "batch") == 0 && argc >= 5) {
+		TableType type = typearg(argv[0], argv[2]);
+		int nkeys = atoi(argv[4]);
+		bench_batch(type, atoi(argv[3]), nkeys, intarg(argc, argv, 5, nkeys),
+			intarg(argc, argv, 6, 1024));
+	} else if (strcmp(argv[1], "memory") == 0 && argc >= 5) {
+		TableType type = typearg(argv[0], argv[2]);
+		bench_memory(type, atoi(argv[3]), atoi(argv[4]));
+	} else if (strcmp(argv[1], "sizes") == 0) {
+		bench_sizes(intarg(argc, argv, 2, 20000),
+			intarg(argc, argv, 3, 4000000));
+	} else if (strcmp(argv[1], "map") == 0 && argc >= 5) {
+		TableType type = typearg(argv[0], argv[2]);
+		int nkeys = atoi(argv[4]);
+		bench_map(type, atoi(argv[3]), nkeys, intarg(argc, argv, 5, nkeys));
+	} else if (strcmp(argv[1], "strings") == 0) {
+		bench_strings(intarg(argc, argv, 2, 1000000),
+			intarg(argc, argv, 3, 1000000));
+	} else if (strcmp(argv[1], "build") == 0 && argc >= 5) {
+		TableType type = typearg(argv[0], argv[2]);
+		bench_build(type, atoi(argv[3]), atoi(argv[4]),
+			intarg(argc, argv, 5, 4));
+	} else if (strcmp(argv[1], "counters") == 0) {
+		// the types named after the numbers, or all the usual ones
+		TableType types[argc + LINEARC + 1];
+		int i, ntypes = 0;
+		for (i = 5; i < argc; i++) {
+			types[ntypes++] = typearg(argv[0], argv[i]);
+		}
+		TableType type;
+		for (type = 0; argc <= 5 && type <= LINEARC; type++) {
+			if (type != XTNDBL1 && type != XTNDBLD && type != SHARDED) {
+				types[ntypes++] = type;
+			}
+		}
+		bench_counters(intarg(argc, argv, 2, 4), intarg(argc, argv, 3, 1000000),
+			intarg(argc, argv, 4, 1000000), types, ntypes);
+	} else if (strcmp(argv[1], "dispatch") == 0) {
+		bench_dispatch(intarg(argc, argv, 2, 100000),
+			intarg(argc, argv, 3, 10000000));
+	} else {
+		printusageexit(argv[0]);
+	}
+
+	return 0;
+}
@@ -4,10 +4,13 @@
  * 
  * usage:
  *   make cmdgen
- *   ./cmdgen ninserts nlookups > commandfilename
+ *   ./cmdgen [-b] ninserts nlookups > commandfilename
  *       ninserts: number of insert commands to generate
  *       nlookups: number of lookup commands to generate
  *       commandfilename: name of file to store commands in
+ *       -b: write a binary command log instead of text
+ *   ./cmdgen -c < textfilename > logfilename
+ *       convert text commands to a binary command log
  *
  * created for COMP20007 Design of Algorithms - Assignment 2, 2017
  * by Shreyash Patodia and Matt Farrugia
@@ -15,20 +18,29 @@
  * modifications by ...
  */
 
+#define _POSIX_C_SOURCE 200809L
+
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
 #include <time.h>
 
 #include "inthash.h"
+#include "commands.h"
 
 /*************************************************************************/
 
 void printusageexit(char *exe) {
 	/* Print usage information: */
-	fprintf(stderr, "usage: %s ninserts nlookups > commandfilename\n", exe);
+	fprintf(stderr, "usage: %s [-b] ninserts nlookups > commandfilename\n",
+		exe);
 	fprintf(stderr, " ninserts: number of insert commands to generate\n");
 	fprintf(stderr, " nlookups: number of lookup commands to generate\n");
 	fprintf(stderr, " commandfilename: name of file to store commands in\n");
+	fprintf(stderr, " -b: write a binary command log instead of text\n");
+	fprintf(stderr, "   or: %s -c < textfilename > logfilename\n", exe);
+	fprintf(stderr, " convert text commands to a binary command log\n");
 
 	/* and exit, as promised :) */
 	exit(1);
@@ -36,10 +48,68 @@ void printusageexit(char *exe) {
 
 /*************************************************************************/
 
+/* Write one command with a key (or without, if 'op' takes none), as a line of
+ * text or as a command log record. */
+void emit(bool binary, char op, int64 key) {
+	if (binary) {
+		write_command(stdout, op, key, NULL, -1);
+	} else if (op == INSERT || op == LOOKUP) {
+		printf("%c %llu\n", op, key);
+	} else {
+		printf("%c\n", op);
+	}
+}
+
+/* Convert the text commands on stdin into a command log on stdout. Lines the
+ * interpreter would only complain about (inserts and lookups without a key,
+ * or commands that aren't ASCII characters) are left out. */
+void convert() {
+	write_command_log_header(stdout);
+
+	char *line = NULL;
+	size_t capacity = 0;
+	ssize_t linelen;
+	long long nconverted = 0, nskipped = 0;
+	while ((linelen = getline(&line, &capacity, stdin)) >= 0) {
+		if (linelen > 0 && line[linelen - 1] == '\n') {
+			linelen--;
+		}
+		char op;
+		int64 key;
+		char string[MAX_LINE_LEN];
+		int length;
+		int argc = parse_command(line, linelen, &op, &key, string, &length);
+		if (argc < 1) {
+			continue;
+		}
+		if (((op == INSERT || op == LOOKUP) && argc < 2) || (op & 0x80)) {
+			nskipped++;
+			continue;
+		}
+		write_command(stdout, op, key, string, length);
+		nconverted++;
+	}
+	free(line);
+
+	fprintf(stderr, "converted %lld commands (%lld skipped)\n", nconverted,
+		nskipped);
+}
+
+/*************************************************************************/
+
 int main(int argc, char **argv) {
 	int i;
 
 	/* Get command line arguments. */
+	if (argc == 2 && strcmp(argv[1], "-c") == 0) {
+		convert();
+		return 0;
+	}
+	bool binary = argc > 1 && strcmp(argv[1], "-b") == 0;
+	if (binary) {
+		argc--;
+		argv++;
+	}
 	if (argc < 3) {
 		printusageexit(argv[0]);
 	}
@@ -57,8 +127,11 @@ int main(int argc, char **argv) {
 	}
 
 	/* Print insertion commands for these numbers. */
+	if (binary) {
+		write_command_log_header(stdout);
+	}
 	for (i = 0; i < ninserts; i++) {
-		printf("i %llu\n", inserts[i]);
+		emit(binary, INSERT, inserts[i]);
 	}
 
 
@@ -75,14 +148,14 @@ int main(int argc, char **argv) {
 			/* Generate a new random key */
 			lookup = rand() % max;
 		}
-		printf("l %llu\n", lookup);
+		emit(binary, LOOKUP, lookup);
 	}
 
 	/* Finish with commands to print the table, print statistics, and quit. */
 
-	printf("p\n");
-	printf("s\n");
-	printf("q\n"); 
+	emit(binary, PRINT, 0);
+	emit(binary, STATS, 0);
+	emit(binary, QUIT, 0);
 
 	return 0;
 }
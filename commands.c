@@ -0,0 +1,187 @@
+/* * * * * * * * *
+ * Module for reading and writing the hash table interpreter's commands, as
+ * lines of text, or in a compact binary command log
+ *
+ * created for COMP20007 Design of Algorithms - Assignment 2, 2017
+ * by Luke Hedt
+ */
+
+#include <string.h>
+#include <assert.h>
+
+#include "commands.h"
+
+// the bit of a command byte that marks a string key
+#define STRING_KEY 0x80
+
+// does this command carry a key?
+#define HAS_KEY(operation) ((operation) == INSERT || (operation) == LOOKUP)
+
+
+/* * * *
+ * helper functions
+ */
+
+// decode the varint at the start of the 'size' bytes of 'data' into *value
+// returns its size in bytes, or 0 if it was cut short (or too long)
+static size_t read_varint(const unsigned char *data, size_t size,
+		int64 *value) {
+	int64 result = 0;
+	size_t n = 0;
+	int shift;
+	for (shift = 0; shift < 64; shift += 7) {
+		if (n == size) {
+			return 0;
+		}
+		unsigned char byte = data[n++];
+		result |= (int64)(byte & 0x7f) << shift;
+		if (!(byte & 0x80)) {
+			*value = result;
+			return n;
+		}
+	}
+	return 0;
+}
+
+// write 'value' to 'file' as a varint
+static void write_varint(FILE *file, int64 value) {
+	while (value >= 0x80) {
+		putc((value & 0x7f) | 0x80, file);
+		value >>= 7;
+	}
+	putc(value, file);
+}
+
+
+/* * * *
+ * all functions
+ */
+
+// parses a line of 'linelen' characters (not including its newline) into an
+// operation character and possibly a long long uinteger argument
+// returns the number of tokens successfully read
+int parse_command(const char *line, int linelen, char *operation, int64 *key,
+		char *string, int *length) {
+	const char *end = line + linelen;
+	*length = -1;
+	if (linelen == 0) {
+		return 0;
+	}
+
+	// the operation is the first character, then the argument comes after
+	// any whitespace
+	*operation = line[0];
+	const char *c = line + 1;
+	while (c < end && (*c == ' ' || *c == '\t' || *c == '\r' || *c == '\v'
+			|| *c == '\f')) {
+		c++;
+	}
+	if (c == end) {
+		return 1;
+	}
+
+	// parse an integer argument by hand, like scanf's "%llu": note that
+	// since it is unsigned, a command like 'i -1' will overflow, resulting
+	// in *key = 18446744073709551615 (2^64-1). this is a feature.
+	bool negative = false;
+	const char *digits = c;
+	if (*digits == '+' || *digits == '-') {
+		negative = *digits == '-';
+		digits++;
+	}
+	if (digits < end && *digits >= '0' && *digits <= '9') {
+		int64 value = 0;
+		bool overflow = false;
+		for (; digits < end && *digits >= '0' && *digits <= '9'; digits++) {
+			int digit = *digits - '0';
+			if (value > (UINT64_MAX - digit) / 10) {
+				overflow = true; // too big: like scanf, saturate
+			}
+			value = value * 10 + digit;
+		}
+		*key = overflow ? UINT64_MAX : negative ? -value : value;
+		return 2;
+	}
+
+	// if there was no integer, look for a quoted string instead
+	if (*c == '"') {
+		int n = 0;
+		for (c++; c < end && *c != '"' && n < MAX_LINE_LEN; c++) {
+			if (*c == '\\' && c + 1 < end && (c[1] == '"' || c[1] == '\\')) {
+				c++;
+			}
+			string[n++] = *c;
+		}
+		if (c < end && *c == '"') {
+			// the string was closed properly, so it's a valid key
+			*length = n;
+			return 2;
+		}
+	}
+
+	return 1;
+}
+
+
+// does the 'size' bytes of 'data' start like a command log?
+bool is_command_log(const char *data, size_t size) {
+	return size >= COMMAND_LOG_MAGIC_LEN
+		&& memcmp(data, COMMAND_LOG_MAGIC, COMMAND_LOG_MAGIC_LEN) == 0;
+}
+
+
+// decode the command log record at the start of 'data'
+// returns the size of the record in bytes, or 0 if it was cut short
+size_t read_command(const char *data, size_t size, char *operation,
+		int64 *key, const char **string, int *length) {
+	const unsigned char *bytes = (const unsigned char *)data;
+	if (size == 0) {
+		return 0;
+	}
+	unsigned char op = bytes[0];
+	*operation = op & ~STRING_KEY;
+	*length = -1;
+	if (!HAS_KEY(*operation)) {
+		return 1;
+	}
+
+	size_t n = read_varint(bytes + 1, size - 1, key);
+	if (n == 0) {
+		return 0;
+	}
+	if (!(op & STRING_KEY)) {
+		return 1 + n;
+	}
+
+	// a string key: the varint was its length, and its bytes follow
+	int64 keylength = *key;
+	if (keylength > size - 1 - n || keylength > MAX_LINE_LEN) {
+		return 0;
+	}
+	*string = data + 1 + n;
+	*length = keylength;
+	return 1 + n + keylength;
+}
+
+
+// write the bytes every command log starts with to 'file'
+void write_command_log_header(FILE *file) {
+	fwrite(COMMAND_LOG_MAGIC, 1, COMMAND_LOG_MAGIC_LEN, file);
+}
+
+
+// write a record for 'operation' to 'file'
+void write_command(FILE *file, char operation, int64 key, const char *string,
+		int length) {
+	assert(!(operation & STRING_KEY) && "error: command is not ASCII!");
+	if (!HAS_KEY(operation)) {
+		putc(operation, file);
+	} else if (length >= 0) {
+		putc(operation | STRING_KEY, file);
+		write_varint(file, length);
+		fwrite(string, 1, length, file);
+	} else {
+		putc(operation, file);
+		write_varint(file, key);
+	}
+}
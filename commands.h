@@ -0,0 +1,72 @@
+/* * * * * * * * *
+ * Module for reading and writing the hash table interpreter's commands, as
+ * lines of text, or in a compact binary command log
+ *
+ * a command log is the 8 bytes COMMAND_LOG_MAGIC, then one record for each
+ * command: its command character as a single byte, followed (for inserts
+ * and lookups only) by its key as a varint: 7 bits at a time, least
+ * significant first, with the top bit of every byte but the last set. a
+ * string key is marked by setting the top bit of the command byte, and is
+ * stored as its length (as a varint) followed by its bytes
+ *
+ * created for COMP20007 Design of Algorithms - Assignment 2, 2017
+ * by Luke Hedt
+ */
+
+#ifndef COMMANDS_H
+#define COMMANDS_H
+
+#include <stdio.h>
+#include <stdbool.h>
+#include "inthash.h"
+
+// interpreter commands
+#define INSERT 'i'
+#define LOOKUP 'l'
+#define PRINT  'p'
+#define STATS  's'
+#define STATS_JSON 'j'
+#define METRICS 'm'
+#define TRACE  't'
+#define HELP   'h'
+#define QUIT   'q'
+#define MAX_LINE_LEN 4096	// long enough for string keys like URLs
+
+// the first bytes of every command log, to tell it apart from text
+#define COMMAND_LOG_MAGIC "a2cmdlog"
+#define COMMAND_LOG_MAGIC_LEN 8
+
+// parses a line of 'linelen' characters (not including its newline) into an
+// operation character and possibly a long long uinteger argument. store
+// results in *operation and *key, resp.
+// the argument may instead be a string key in double quotes (in which \"
+// stands for a quote and \\ for a backslash), which is stored in 'string'
+// (of size MAX_LINE_LEN) with its length in *length; otherwise *length is -1
+//
+// returns the number of tokens successfully read (e.g. 0 for none,
+// 1 for operation only, 2 for both operation and integer or string)
+int parse_command(const char *line, int linelen, char *operation, int64 *key,
+	char *string, int *length);
+
+// does the 'size' bytes of 'data' start like a command log?
+bool is_command_log(const char *data, size_t size);
+
+// decode the command log record at the start of the 'size' bytes of 'data'
+// into *operation and *key, as for parse_command. a string key is not
+// copied: *string points to it inside 'data', and *length is its length
+// (or -1 if the key was a number)
+//
+// returns the size of the record in bytes, or 0 if it was cut short
+size_t read_command(const char *data, size_t size, char *operation,
+	int64 *key, const char **string, int *length);
+
+// write the bytes every command log starts with to 'file'
+void write_command_log_header(FILE *file);
+
+// write a record for 'operation' to 'file', with 'key' (or the 'length'
+// byte string key 'string', if 'length' is not -1) if it is an insert or
+// lookup. 'operation' must be an ASCII character
+void write_command(FILE *file, char operation, int64 key, const char *string,
+	int length);
+
+#endif
@@ -4,11 +4,23 @@
  *
  * created for COMP20007 Design of Algorithms - Assignment 2, 2017
  * by Matt Farrugia <matt.farrugia@unimelb.edu.au>
+ *
+ * Each type of table is described by a TableOps vtable in a registry indexed
+ * by TableType, so adding a type means adding its vtable here (or registering
+ * it at runtime with register_hash_table_type()), rather than a case to every
+ * function below.
+ *
+ * A sharded table is one more type of table, whose functions pass each key
+ * on to one of several tables of another type, each behind its own lock.
  */
 
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
 #include <assert.h>
+#include <pthread.h>
 
 #include "hashtbl.h"
 
@@ -17,6 +29,319 @@
 #include "tables/cuckoo.h"	// create for part 1
 #include "tables/xtndbln.h" // create for part 2
 #include "tables/xuckoo.h"	// create for part 3
+#include "tables/xtndbld.h"	// disk-resident extendible hashing
+#include "tables/xtndblc.h"	// thread-safe extendible hashing
+#include "tables/linhash.h"	// linear hashing (Litwin)
+#include "tables/xtndblz.h"	// compressed extendible hashing
+#include "tables/strlinear.h"	// byte-string keys
+#include "tables/linearc.h"	// lock-free linear probing
+
+// how many more types of table can be registered at runtime
+#define MAX_REGISTERED_TYPES 16
+
+
+/*
+ * Vtables for the built-in table types
+ */
+
+// define the vtable functions for table type 'name', whose functions are
+// named like '<name>_hash_table_insert'
+// (the wrappers only convert between void * and the table's own type, and
+// compile to a single jump)
+#define DEFINE_TABLE_FUNCTIONS(name) \
+static void name##_free(void *table) { \
+	free_##name##_hash_table(table); \
+} \
+static bool name##_insert(void *table, int64 key) { \
+	return name##_hash_table_insert(table, key); \
+} \
+static bool name##_lookup(void *table, int64 key) { \
+	return name##_hash_table_lookup(table, key); \
+} \
+static void name##_print(void *table) { \
+	name##_hash_table_print(table); \
+} \
+static void name##_stats(void *table) { \
+	name##_hash_table_stats(table); \
+} \
+static void name##_get_stats(void *table, TableStats *stats) { \
+	name##_hash_table_get_stats(table, stats); \
+}
+
+// and the create function, for table types which can be made in memory, given
+// an expression 'create' making a new table of that type from the int 'size'
+#define DEFINE_CREATE_FUNCTION(name, create) \
+static void *name##_create(int size) { \
+	(void)size; \
+	return create; \
+}
+
+// and the batch lookup function, for table types which have one
+#define DEFINE_BATCH_FUNCTION(name) \
+static int name##_lookup_batch(void *table, int64 *keys, int n, \
+		bool *found) { \
+	return name##_hash_table_lookup_batch(table, keys, n, found); \
+}
+
+// and the hash map functions, for table types which can store values
+#define DEFINE_MAP_FUNCTIONS(name, create) \
+static void *name##_create_map(int size) { \
+	(void)size; \
+	return create; \
+} \
+static bool name##_put(void *table, int64 key, int64 value) { \
+	return name##_hash_table_put(table, key, value); \
+} \
+static bool name##_get(void *table, int64 key, int64 *value) { \
+	return name##_hash_table_get(table, key, value); \
+} \
+static bool name##_update(void *table, int64 key, int64 value) { \
+	return name##_hash_table_update(table, key, value); \
+}
+
+// and the string key functions, for table types whose keys are byte strings
+#define DEFINE_STRING_FUNCTIONS(name) \
+static bool name##_insert_string(void *table, const char *key, int length) { \
+	return name##_hash_table_insert_string(table, key, length); \
+} \
+static bool name##_lookup_string(void *table, const char *key, int length) { \
+	return name##_hash_table_lookup_string(table, key, length); \
+}
+
+// and the bulk build function, for table types which have one, given an
+// expression 'build' making a table from 'size', 'keys', 'n' and 'nthreads'
+#define DEFINE_BUILD_FUNCTION(name, build) \
+static void *name##_build(int size, int64 *keys, int n, int nthreads) { \
+	(void)nthreads; \
+	return build; \
+}
+
+DEFINE_TABLE_FUNCTIONS(linear)
+DEFINE_TABLE_FUNCTIONS(xtndbl1)
+DEFINE_TABLE_FUNCTIONS(cuckoo)
+DEFINE_TABLE_FUNCTIONS(xtndbln)
+DEFINE_TABLE_FUNCTIONS(xuckoo)
+DEFINE_TABLE_FUNCTIONS(xtndbld)
+DEFINE_TABLE_FUNCTIONS(xtndblc)
+DEFINE_TABLE_FUNCTIONS(linhash)
+DEFINE_TABLE_FUNCTIONS(xtndblz)
+DEFINE_TABLE_FUNCTIONS(strlinear)
+DEFINE_TABLE_FUNCTIONS(linearc)
+
+// (a disk-resident table has no create function: it is always opened from a
+// path, so that a 'new' table never picks up one left behind on disk)
+DEFINE_CREATE_FUNCTION(linear, new_linear_hash_table(size))
+DEFINE_CREATE_FUNCTION(xtndbl1, new_xtndbl1_hash_table())
+DEFINE_CREATE_FUNCTION(cuckoo, new_cuckoo_hash_table(size))
+DEFINE_CREATE_FUNCTION(xtndbln, new_xtndbln_hash_table(size))
+DEFINE_CREATE_FUNCTION(xuckoo, new_xuckoo_hash_table(size))
+DEFINE_CREATE_FUNCTION(xtndblc, new_xtndblc_hash_table(size))
+DEFINE_CREATE_FUNCTION(linhash, new_linhash_hash_table(size))
+DEFINE_CREATE_FUNCTION(xtndblz, new_xtndblz_hash_table(size))
+DEFINE_CREATE_FUNCTION(strlinear, new_strlinear_hash_table(size))
+DEFINE_CREATE_FUNCTION(linearc, new_linearc_hash_table(size))
+
+DEFINE_BATCH_FUNCTION(xtndbl1)
+DEFINE_BATCH_FUNCTION(xtndbln)
+DEFINE_BATCH_FUNCTION(xuckoo)
+
+DEFINE_MAP_FUNCTIONS(linear, new_linear_hash_map(size))
+DEFINE_MAP_FUNCTIONS(xtndbl1, new_xtndbl1_hash_map())
+DEFINE_MAP_FUNCTIONS(cuckoo, new_cuckoo_hash_map(size))
+DEFINE_MAP_FUNCTIONS(xtndbln, new_xtndbln_hash_map(size))
+DEFINE_MAP_FUNCTIONS(xuckoo, new_xuckoo_hash_map(size))
+
+DEFINE_STRING_FUNCTIONS(strlinear)
+
+DEFINE_BUILD_FUNCTION(linear, build_linear_hash_table(size, keys, n))
+DEFINE_BUILD_FUNCTION(xtndbln,
+	build_xtndbln_hash_table(size, keys, n, nthreads))
+
+// a disk-resident table can also be opened from a path
+static void *xtndbld_open(char *path) {
+	return open_xtndbld_hash_table(path);
+}
+
+
+/*
+ * Sharded tables
+ */
+
+// a shard is one table behind its own lock, with its own statistics, aligned
+// to a cache line so that threads using neighbouring shards don't slow each
+// other down. the lock is a mutex rather than a reader/writer lock because
+// most types of table update their statistics during lookups too
+typedef struct shard {
+	pthread_mutex_t lock;	// held for every operation on this shard
+	HashTable *table;		// the shard's own table
+	int ninserts;			// how many insertions were made in this shard
+	int nlookups;			// how many lookups were made in it
+	int nwaits;				// how many of those waited for the lock
+} __attribute__((aligned(64))) Shard;
+
+// a sharded table shares keys between its shards by their hash values
+typedef struct sharded_table {
+	Shard *shards;		// array of shards
+	int nshards;		// how many shards there are
+	TableType type;		// the type of every shard's table
+	char name[32];		// "sharded:" and the name of that type, for stats
+} ShardedTable;
+
+// the shard for 'key': chosen by the high bits of its hash value, because
+// most types of table use the low bits to choose where it goes in the shard
+static Shard *shard_of(ShardedTable *table, int64 key) {
+	return &table->shards[((int64)h1(key) * table->nshards) >> 31];
+}
+
+// lock 'shard', counting whether another thread had it locked already
+static void lock_shard(Shard *shard) {
+	if (pthread_mutex_trylock(&shard->lock) != 0) {
+		pthread_mutex_lock(&shard->lock);
+		shard->nwaits++;
+	}
+}
+
+static void sharded_free(void *table) {
+	ShardedTable *sharded = table;
+	int i;
+	for (i = 0; i < sharded->nshards; i++) {
+		free_hash_table(sharded->shards[i].table);
+		pthread_mutex_destroy(&sharded->shards[i].lock);
+	}
+	free(sharded->shards);
+	free(sharded);
+}
+
+static bool sharded_insert(void *table, int64 key) {
+	Shard *shard = shard_of(table, key);
+	lock_shard(shard);
+	bool inserted = hash_table_insert(shard->table, key);
+	shard->ninserts++;
+	pthread_mutex_unlock(&shard->lock);
+	return inserted;
+}
+
+static bool sharded_lookup(void *table, int64 key) {
+	Shard *shard = shard_of(table, key);
+	lock_shard(shard);
+	bool found = hash_table_lookup(shard->table, key);
+	shard->nlookups++;
+	pthread_mutex_unlock(&shard->lock);
+	return found;
+}
+
+static void sharded_print(void *table) {
+	ShardedTable *sharded = table;
+	int i;
+	for (i = 0; i < sharded->nshards; i++) {
+		Shard *shard = &sharded->shards[i];
+		lock_shard(shard);
+		printf("--- shard %d of %d:\n", i, sharded->nshards);
+		hash_table_print(shard->table);
+		pthread_mutex_unlock(&shard->lock);
+	}
+}
+
+static void sharded_stats(void *table) {
+	ShardedTable *sharded = table;
+	int i;
+	for (i = 0; i < sharded->nshards; i++) {
+		Shard *shard = &sharded->shards[i];
+		lock_shard(shard);
+		printf("--- shard %d of %d: %d inserts, %d lookups, "
+			"%d waited for the lock\n", i, sharded->nshards, shard->ninserts,
+			shard->nlookups, shard->nwaits);
+		hash_table_stats(shard->table);
+		pthread_mutex_unlock(&shard->lock);
+	}
+}
+
+static void sharded_get_stats(void *table, TableStats *stats) {
+	ShardedTable *sharded = table;
+	int i;
+	for (i = 0; i < sharded->nshards; i++) {
+		Shard *shard = &sharded->shards[i];
+		TableStats shardstats;
+		lock_shard(shard);
+		hash_table_get_stats(shard->table, &shardstats);
+		pthread_mutex_unlock(&shard->lock);
+		table_stats_add(stats, &shardstats);
+	}
+	stats->type = sharded->name;
+}
+
+// a vtable for table type 'name', called 'name' (or 'alias') by strtotype(),
+// with create function 'create', batch lookup function 'batch' and open
+// function 'open' (each or NULL), and hash map functions 'map' (MAP_OPS(name)
+// or NO_MAP_OPS), and string key functions 'strings' (STRING_OPS(name) or
+// NO_STRING_OPS), and bulk build function 'build' (or NULL)
+#define TABLE_OPS(name, alias, create, batch, open, map, strings, build) { \
+	#name, alias, create, open, name##_free, name##_insert, name##_lookup, \
+	batch, name##_print, name##_stats, name##_get_stats, map, strings, \
+	build }
+#define MAP_OPS(name) name##_create_map, name##_put, name##_get, name##_update
+#define NO_MAP_OPS NULL, NULL, NULL, NULL
+#define STRING_OPS(name) name##_insert_string, name##_lookup_string
+#define NO_STRING_OPS NULL, NULL
+
+static const TableOps builtin_ops[] = {
+	[LINEAR]  = TABLE_OPS(linear, NULL, linear_create, NULL, NULL,
+					MAP_OPS(linear), NO_STRING_OPS, linear_build),
+	[XTNDBL1] = TABLE_OPS(xtndbl1, NULL, xtndbl1_create, xtndbl1_lookup_batch,
+					NULL, MAP_OPS(xtndbl1), NO_STRING_OPS, NULL),
+	[CUCKOO]  = TABLE_OPS(cuckoo, "1", cuckoo_create, NULL, NULL,
+					MAP_OPS(cuckoo), NO_STRING_OPS, NULL),
+	[XTNDBLN] = TABLE_OPS(xtndbln, "2", xtndbln_create, xtndbln_lookup_batch,
+					NULL, MAP_OPS(xtndbln), NO_STRING_OPS, xtndbln_build),
+	[XUCKOO]  = TABLE_OPS(xuckoo, "3", xuckoo_create, xuckoo_lookup_batch,
+					NULL, MAP_OPS(xuckoo), NO_STRING_OPS, NULL),
+	[XTNDBLD] = TABLE_OPS(xtndbld, NULL, NULL, NULL, xtndbld_open,
+					NO_MAP_OPS, NO_STRING_OPS, NULL),
+	[XTNDBLC] = TABLE_OPS(xtndblc, NULL, xtndblc_create, NULL, NULL,
+					NO_MAP_OPS, NO_STRING_OPS, NULL),
+	[LINHASH] = TABLE_OPS(linhash, NULL, linhash_create, NULL, NULL,
+					NO_MAP_OPS, NO_STRING_OPS, NULL),
+	[XTNDBLZ] = TABLE_OPS(xtndblz, NULL, xtndblz_create, NULL, NULL,
+					NO_MAP_OPS, NO_STRING_OPS, NULL),
+	[STRLINEAR] = TABLE_OPS(strlinear, NULL, strlinear_create, NULL, NULL,
+					NO_MAP_OPS, STRING_OPS(strlinear), NULL),
+	[LINEARC] = TABLE_OPS(linearc, NULL, linearc_create, NULL, NULL,
+					NO_MAP_OPS, NO_STRING_OPS, NULL),
+
+	// with no create function, since its shards need a type of their own
+	[SHARDED] = { .name = "sharded", .free = sharded_free,
+					.insert = sharded_insert, .lookup = sharded_lookup,
+					.print = sharded_print, .stats = sharded_stats,
+					.get_stats = sharded_get_stats },
+};
+
+// the number of built-in table types
+#define NBUILTINTYPES (int)(sizeof builtin_ops / sizeof *builtin_ops)
+
+// the vtables of any other table types, registered at runtime, which get the
+// TableTypes following the built-in ones
+static const TableOps *registered[MAX_REGISTERED_TYPES];
+static int nregistered = 0;
+
+// register another type of table with vtable 'ops' (which must outlive every
+// table of that type), and return its TableType
+TableType register_hash_table_type(const TableOps *ops) {
+	assert(ops && ops->name);
+	assert(nregistered < MAX_REGISTERED_TYPES && "error: too many types!");
+	registered[nregistered++] = ops;
+	return NBUILTINTYPES + nregistered - 1;
+}
+
+// the vtable for table type 'type', or NULL if there is no such type
+static const TableOps *ops_of(TableType type) {
+	if (type >= 0 && type < NBUILTINTYPES) {
+		return &builtin_ops[type];
+	}
+	if (type >= NBUILTINTYPES && type < NBUILTINTYPES + nregistered) {
+		return registered[type - NBUILTINTYPES];
+	}
+	return NULL;
+}
 
 // converts from a string representation to a TableType constant:
 // "linear"			->	LINEAR
@@ -24,66 +349,172 @@
 // "1" or "cuckoo"	->	CUCKOO
 // "2" or "xtndbln"	->	XTNDBLN
 // "3" or "xuckoo"	->	XUCKOO
+// "xtndbld"		->	XTNDBLD
+// "xtndblc"		->	XTNDBLC
+// "linhash"		->	LINHASH
+// "xtndblz"		->	XTNDBLZ
+// "strlinear"		->	STRLINEAR
+// "linearc"		->	LINEARC
+// or the name (or alias) of any other registered type
+// (but not "sharded": a sharded table is made with new_sharded_hash_table())
 TableType strtotype(char *str) {
-	if (strcmp("linear",  str) == 0) {
-		return LINEAR;
-	}
-	if (strcmp("xtndbl1", str) == 0) {
-		return XTNDBL1;
-	}
-	if (strcmp("1", str) == 0 || strcmp("cuckoo",  str) == 0) {
-		return CUCKOO;
-	}
-	if (strcmp("2", str) == 0 || strcmp("xtndbln", str) == 0) {
-		return XTNDBLN;
-	}
-	if (strcmp("3", str) == 0 || strcmp("xuckoo",  str) == 0) {
-		return XUCKOO;
+	const TableOps *ops;
+	int type;
+	for (type = 0; (ops = ops_of(type)) != NULL; type++) {
+		if (ops->create == NULL && ops->open == NULL) {
+			continue;
+		}
+		if (strcmp(ops->name, str) == 0
+				|| (ops->alias && strcmp(ops->alias, str) == 0)) {
+			return type;
+		}
 	}
 	return NOTYPE;
 }
 
+// converts from a TableType constant to its name (the reverse of strtotype()),
+// or NULL if there is no such type
+const char *typetostr(TableType type) {
+	const TableOps *ops = ops_of(type);
+	return ops ? ops->name : NULL;
+}
+
 // a HashTable is a wrapper for an actual table structure of some type,
-// and it also remembers is own type
+// and it also remembers is own type and where to find its functions
 struct table {
-	TableType type;	// what type of hash table is this?
-	void *table;	// the hash table itself
+	TableType type;			// what type of hash table is this?
+	const TableOps *ops;	// the functions for that type of table
+	void *table;			// the hash table itself
 };
 
-// initialise a hash table of type 'type' with initial size 'size',
-// and return its pointer
-HashTable *new_hash_table(TableType type, int size) {
-	
+// create the wrapper for a table of type 'type', or return NULL if there is
+// no such type
+static HashTable *new_wrapper(TableType type) {
+	const TableOps *ops = ops_of(type);
+	if (ops == NULL) {
+		return NULL;
+	}
+
 	// allocate space for the table wrapper
 	HashTable *table = malloc(sizeof *table);
 	assert(table);
 
 	// store the table type, so we know which functions to call later
 	table->type = type;
+	table->ops = ops;
+	return table;
+}
+
+// initialise a hash table of type 'type' with initial size 'size',
+// and return its pointer (NULL if there is no such type)
+HashTable *new_hash_table(TableType type, int size) {
+	HashTable *table = new_wrapper(type);
+	if (table && !table->ops->create) {
+		free(table);
+		return NULL;
+	}
+	if (table) {
+		// create and store the table itself
+		table->table = table->ops->create(size);
+	}
+	return table;
+}
+
+// initialise a sharded hash table: 'nshards' tables of type 'type' (each
+// created with initial size 'size'), each behind its own lock, and return its
+// pointer
+HashTable *new_sharded_hash_table(TableType type, int size, int nshards) {
+	assert(nshards > 0);
+	assert(type != XTNDBLD && "error: disk-resident tables can't be sharded!");
+
+	ShardedTable *sharded = malloc(sizeof *sharded);
+	assert(sharded);
+	int err = posix_memalign((void **)&sharded->shards, sizeof (Shard),
+		sizeof (Shard) * nshards);
+	assert(err == 0);
+	sharded->nshards = nshards;
+	sharded->type = type;
+	snprintf(sharded->name, sizeof sharded->name, "sharded:%s",
+		typetostr(type));
+
+	int i;
+	for (i = 0; i < nshards; i++) {
+		Shard *shard = &sharded->shards[i];
+		shard->table = new_hash_table(type, size);
+		assert(shard->table && "error: can't shard this type of table!");
+		pthread_mutex_init(&shard->lock, NULL);
+		shard->ninserts = 0;
+		shard->nlookups = 0;
+		shard->nwaits = 0;
+	}
+
+	HashTable *table = new_wrapper(SHARDED);
+	table->table = sharded;
+	return table;
+}
+
+// initialise a hash map (a table storing a value with each key) of type 'type'
+// with initial size 'size', and return its pointer (NULL if 'type' is not a
+// table type which can store values)
+HashTable *new_hash_map(TableType type, int size) {
+	HashTable *table = new_wrapper(type);
+	if (table && !table->ops->create_map) {
+		free(table);
+		return NULL;
+	}
+	if (table) {
+		table->table = table->ops->create_map(size);
+	}
+	return table;
+}
+
+// build a hash table of type 'type' (with 'size' as for new_hash_table())
+// holding the 'n' keys in 'keys' (ignoring repeats), and return its pointer
+HashTable *hash_table_bulk_build(TableType type, int size, int64 *keys,
+		int n) {
+	return hash_table_bulk_build_parallel(type, size, keys, n, 1);
+}
 
-	// create and store the table itself
-	switch (type) {
-		case LINEAR:
-			table->table = new_linear_hash_table(size);
-			break;
-		case XTNDBL1:
-			table->table = new_xtndbl1_hash_table();
-			break;
-		case CUCKOO:
-			table->table = new_cuckoo_hash_table(size);
-			break;
-		case XTNDBLN:
-			table->table = new_xtndbln_hash_table(size);
-			break;
-		case XUCKOO:
-			table->table = new_xuckoo_hash_table();
-			break;
-		default:
-			// no such table type? error. release memory and return NULL
-			free(table);
-			return NULL;
+// the same, but sharing the work between 'nthreads' threads (for types whose
+// build function can use them)
+HashTable *hash_table_bulk_build_parallel(TableType type, int size,
+		int64 *keys, int n, int nthreads) {
+	HashTable *table = new_wrapper(type);
+	if (table == NULL) {
+		return NULL;
 	}
 
+	// use this type's bulk build function, if it has one
+	if (table->ops->build) {
+		table->table = table->ops->build(size, keys, n, nthreads);
+		return table;
+	}
+
+	// otherwise, insert the keys one at a time
+	if (!table->ops->create) {
+		free(table);
+		return NULL;
+	}
+	table->table = table->ops->create(size);
+	int i;
+	for (i = 0; i < n; i++) {
+		table->ops->insert(table->table, keys[i]);
+	}
+	return table;
+}
+
+// open (or create) a disk-resident hash table of type 'type' stored in files
+// starting with 'path', and return its pointer (NULL if 'type' is not a
+// disk-resident table type)
+HashTable *open_hash_table(TableType type, char *path) {
+	HashTable *table = new_wrapper(type);
+	if (table && !table->ops->open) {
+		free(table);
+		return NULL;
+	}
+	if (table) {
+		table->table = table->ops->open(path);
+	}
 	return table;
 }
 
@@ -92,27 +523,9 @@ void free_hash_table(HashTable *table) {
 	assert(table != NULL);
 
 	// free the actual table, using the relevant free function for its type
-	switch (table->type) {
-		case LINEAR:
-			free_linear_hash_table(table->table);
-			break;
-		case XTNDBL1:
-			free_xtndbl1_hash_table(table->table);
-			break;
-		case CUCKOO:
-			free_cuckoo_hash_table(table->table);
-			break;
-		case XTNDBLN:
-			free_xtndbln_hash_table(table->table);
-			break;
-		case XUCKOO:
-			free_xuckoo_hash_table(table->table);
-			break;
-		default:
-			break;
-	}
-
-	// free the wrapper struct itself
+	table->ops->free(table->table);
+
+	// free the wrapper
 	free(table);
 }
 
@@ -120,94 +533,117 @@ void free_hash_table(HashTable *table) {
 // returns true if insertion succeeds, false if it was already in there
 bool hash_table_insert(HashTable *table, int64 key) {
 	assert(table != NULL);
-
-	// forward the call onto the relevant insert function
-	switch (table->type) {
-		case LINEAR:
-			return linear_hash_table_insert(table->table, key);
-		case XTNDBL1:
-			return xtndbl1_hash_table_insert(table->table, key);
-		case CUCKOO:
-			return cuckoo_hash_table_insert(table->table, key);
-		case XTNDBLN:
-			return xtndbln_hash_table_insert(table->table, key);
-		case XUCKOO:
-			return xuckoo_hash_table_insert(table->table, key);
-		default:
-			return false;
-	}
+	return table->ops->insert(table->table, key);
 }
 
 // lookup whether 'key' is inside 'table'
 // returns true if found, false if not
 bool hash_table_lookup(HashTable *table, int64 key) {
 	assert(table != NULL);
+	return table->ops->lookup(table->table, key);
+}
 
-	// forward the call onto the relevant lookup function
-	switch (table->type) {
-		case LINEAR:
-			return linear_hash_table_lookup(table->table, key);
-		case XTNDBL1:
-			return xtndbl1_hash_table_lookup(table->table, key);
-		case CUCKOO:
-			return cuckoo_hash_table_lookup(table->table, key);
-		case XTNDBLN:
-			return xtndbln_hash_table_lookup(table->table, key);
-		case XUCKOO:
-			return xuckoo_hash_table_lookup(table->table, key);
-		default:
-			return false;
+// lookup whether each of the 'n' keys in 'keys' is inside 'table', storing
+// the answers in 'found', and return how many were found
+int hash_table_lookup_batch(HashTable *table, int64 *keys, int n,
+		bool *found) {
+	assert(table != NULL);
+
+	// use this type's batch lookup function, if it has one
+	if (table->ops->lookup_batch) {
+		return table->ops->lookup_batch(table->table, keys, n, found);
+	}
+
+	// otherwise, look the keys up one at a time
+	int i, nfound = 0;
+	for (i = 0; i < n; i++) {
+		found[i] = table->ops->lookup(table->table, keys[i]);
+		nfound += found[i];
 	}
+	return nfound;
+}
+
+// insert 'key' into hash map 'table' with value 'value', or if 'key' is
+// already in there, replace its value with 'value'
+// returns true if 'key' was inserted, false if it was already in there
+bool hash_table_put(HashTable *table, int64 key, int64 value) {
+	assert(table != NULL && table->ops->put);
+	return table->ops->put(table->table, key, value);
+}
+
+// lookup 'key' in hash map 'table', and if it's there store its value in
+// '*value'
+// returns true if found, false if not
+bool hash_table_get(HashTable *table, int64 key, int64 *value) {
+	assert(table != NULL && table->ops->get);
+	return table->ops->get(table->table, key, value);
+}
+
+// replace the value of 'key' in hash map 'table' with 'value', if 'key' is in
+// there
+// returns true if found (and updated), false if not
+bool hash_table_update(HashTable *table, int64 key, int64 value) {
+	assert(table != NULL && table->ops->update);
+	return table->ops->update(table->table, key, value);
+}
+
+// does 'table' have byte-string keys?
+bool hash_table_has_string_keys(HashTable *table) {
+	assert(table != NULL);
+	return table->ops->insert_string != NULL;
+}
+
+// insert the 'length' bytes at 'key' into string key table 'table', if
+// they're not in there already
+// returns true if insertion succeeds, false if it was already in there
+bool hash_table_insert_string(HashTable *table, const char *key, int length) {
+	assert(table != NULL && table->ops->insert_string);
+	return table->ops->insert_string(table->table, key, length);
+}
+
+// lookup whether the 'length' bytes at 'key' are inside string key table
+// 'table'
+// returns true if found, false if not
+bool hash_table_lookup_string(HashTable *table, const char *key, int length) {
+	assert(table != NULL && table->ops->lookup_string);
+	return table->ops->lookup_string(table->table, key, length);
 }
 
 // print the contents of 'table' to stdout
 void hash_table_print(HashTable *table) {
 	assert(table != NULL);
-
-	// call the relevant print function
-	switch (table->type) {
-		case LINEAR:
-			linear_hash_table_print(table->table);
-			break;
-		case XTNDBL1:
-			xtndbl1_hash_table_print(table->table);
-			break;
-		case CUCKOO:
-			cuckoo_hash_table_print(table->table);
-			break;
-		case XTNDBLN:
-			xtndbln_hash_table_print(table->table);
-			break;
-		case XUCKOO:
-			xuckoo_hash_table_print(table->table);
-			break;
-		default:
-			break;
-	}
+	table->ops->print(table->table);
 }
 
 // print some statistics about 'table' to stdout
 void hash_table_stats(HashTable *table) {
 	assert(table != NULL);
+	table->ops->stats(table->table);
+}
 
-	// call the relevant print stats function
-	switch (table->type) {
-		case LINEAR:
-			linear_hash_table_stats(table->table);
-			break;
-		case XTNDBL1:
-			xtndbl1_hash_table_stats(table->table);
-			break;
-		case CUCKOO:
-			cuckoo_hash_table_stats(table->table);
-			break;
-		case XTNDBLN:
-			xtndbln_hash_table_stats(table->table);
-			break;
-		case XUCKOO:
-			xuckoo_hash_table_stats(table->table);
-			break;
-		default:
-			break;
-	}
-}
\ No newline at end of file
+// fill in 'stats' with the same statistics about any type of table
+void hash_table_get_stats(HashTable *table, TableStats *stats) {
+	assert(table != NULL && stats != NULL);
+	table_stats_init(stats);
+	stats->type = table->ops->name;
+	if (table->ops->get_stats) {
+		table->ops->get_stats(table->table, stats);
+	}
+	stats->load = stats->capacity == 0 ? 0.0
+		: (double)stats->nkeys / stats->capacity;
+	stats->keybytes = stats->nkeys == 0 ? 0.0
+		: (double)stats->nbytes / stats->nkeys;
+}
+
+// the type of 'table'
+TableType hash_table_type(HashTable *table) {
+	assert(table != NULL);
+	return table->type;
+}
+
+// the table of 'table's own type inside the wrapper, for calling its type's
+// functions directly
+void *hash_table_impl(HashTable *table) {
+	assert(table != NULL);
+	return table->table;
+}
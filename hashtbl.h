@@ -11,11 +11,14 @@
 
 #include <stdbool.h>
 #include "inthash.h"
+#include "tblstats.h"
 
 // enumerated type containing constants for the various types of hash table
 // supported
 typedef enum type {
-	NOTYPE = -1, LINEAR, XTNDBL1, CUCKOO, XTNDBLN, XUCKOO
+	NOTYPE = -1, LINEAR, XTNDBL1, CUCKOO, XTNDBLN, XUCKOO,
+	XTNDBLD, XTNDBLC, LINHASH, XTNDBLZ, STRLINEAR, SHARDED,
+	LINEARC
 } TableType;
 
 // converts from a string representation to a TableType constant:
@@ -24,14 +27,95 @@ typedef enum type {
 // "1" or "cuckoo"	->	CUCKOO
 // "2" or "xtndbln"	->	XTNDBLN
 // "3" or "xuckoo"	->	XUCKOO
+// "xtndbld"		->	XTNDBLD
+// "xtndblc"		->	XTNDBLC
+// "linhash"		->	LINHASH
+// "xtndblz"		->	XTNDBLZ
+// "strlinear"		->	STRLINEAR
+// "linearc"		->	LINEARC
+// or the name (or alias) of any other registered type
+// (but not "sharded": a sharded table is made with new_sharded_hash_table())
 TableType strtotype(char *str);
 
+// converts from a TableType constant to its name (the reverse of strtotype()),
+// or NULL if there is no such type
+const char *typetostr(TableType type);
+
 typedef struct table HashTable;
 
+// the functions every type of hash table provides (like the functions of the
+// same names below), taking a table of that type as a void pointer
+typedef struct table_ops {
+	const char *name;	// name of this type, for strtotype()
+	const char *alias;	// another name for it, or NULL
+	void *(*create)(int size);	// NULL for disk-resident tables
+	void *(*open)(char *path);	// for disk-resident tables only, else NULL
+	void (*free)(void *table);
+	bool (*insert)(void *table, int64 key);
+	bool (*lookup)(void *table, int64 key);
+	int (*lookup_batch)(void *table, int64 *keys, int n, bool *found);
+								// NULL to look keys up one at a time
+	void (*print)(void *table);
+	void (*stats)(void *table);
+	void (*get_stats)(void *table, TableStats *stats);
+								// NULL to report only the type's name
+
+	// for types which can also be hash maps (storing a value with each key),
+	// else NULL
+	void *(*create_map)(int size);
+	bool (*put)(void *table, int64 key, int64 value);
+	bool (*get)(void *table, int64 key, int64 *value);
+	bool (*update)(void *table, int64 key, int64 value);
+
+	// for types whose keys are byte strings (which take int64 keys too, as
+	// strings of their decimal digits), else NULL
+	bool (*insert_string)(void *table, const char *key, int length);
+	bool (*lookup_string)(void *table, const char *key, int length);
+
+	// for types which can build a table from an array of keys in one go, with
+	// 'nthreads' threads (if they can use more than one), else NULL to create
+	// a table and insert the keys one at a time
+	void *(*build)(int size, int64 *keys, int n, int nthreads);
+} TableOps;
+
+// register another type of hash table with the functions in 'ops' (which
+// must outlive every table of that type), and return its TableType
+TableType register_hash_table_type(const TableOps *ops);
+
 // initialise a hash table of type 'type' with initial size 'size',
-// and return its pointer
+// and return its pointer (NULL if there is no such type, or if it is a
+// disk-resident type, which must be opened with open_hash_table())
 HashTable *new_hash_table(TableType type, int size);
 
+// initialise a sharded hash table: 'nshards' tables of type 'type' (each
+// created with initial size 'size'), each behind its own lock, and return its
+// pointer. keys are shared between the shards by the high bits of their hash
+// values, and unlike the other types, a sharded table's insert, lookup, print
+// and stats functions are safe to call from many threads at once
+HashTable *new_sharded_hash_table(TableType type, int size, int nshards);
+
+// initialise a hash map (a table storing a value with each key) of type 'type'
+// with initial size 'size', and return its pointer (NULL if 'type' is not a
+// table type which can store values: LINEAR, XTNDBL1, CUCKOO, XTNDBLN and
+// XUCKOO can)
+HashTable *new_hash_map(TableType type, int size);
+
+// build a hash table of type 'type' (with 'size' as for new_hash_table())
+// holding the 'n' keys in 'keys' (ignoring repeats), and return its pointer
+// LINEAR and XTNDBLN tables are sized for all of the keys up front, rather
+// than growing as they go in one at a time; other types just insert them
+HashTable *hash_table_bulk_build(TableType type, int size, int64 *keys, int n);
+
+// the same, but sharing the work between 'nthreads' threads (for XTNDBLN
+// tables; other types are built on this thread alone)
+HashTable *hash_table_bulk_build_parallel(TableType type, int size,
+	int64 *keys, int n, int nthreads);
+
+// open (or create) a disk-resident hash table of type 'type' stored in files
+// starting with 'path', and return its pointer (NULL if 'type' is not a
+// disk-resident table type)
+HashTable *open_hash_table(TableType type, char *path);
+
 // free all memory associated with 'table'
 void free_hash_table(HashTable *table);
 
@@ -43,10 +127,55 @@ bool hash_table_insert(HashTable *table, int64 key);
 // returns true if found, false if not
 bool hash_table_lookup(HashTable *table, int64 key);
 
+// lookup whether each of the 'n' keys in 'keys' is inside 'table', storing
+// the answers in 'found', and return how many were found
+// (overlaps the lookups' memory accesses for the extendible table types)
+int hash_table_lookup_batch(HashTable *table, int64 *keys, int n,
+	bool *found);
+
+// insert 'key' into hash map 'table' with value 'value', or if 'key' is
+// already in there, replace its value with 'value'
+// returns true if 'key' was inserted, false if it was already in there
+bool hash_table_put(HashTable *table, int64 key, int64 value);
+
+// lookup 'key' in hash map 'table', and if it's there store its value in
+// '*value'
+// returns true if found, false if not
+bool hash_table_get(HashTable *table, int64 key, int64 *value);
+
+// replace the value of 'key' in hash map 'table' with 'value', if 'key' is in
+// there
+// returns true if found (and updated), false if not
+bool hash_table_update(HashTable *table, int64 key, int64 value);
+
+// does 'table' have byte-string keys? (only STRLINEAR tables do)
+bool hash_table_has_string_keys(HashTable *table);
+
+// insert the 'length' bytes at 'key' into string key table 'table', if
+// they're not in there already
+// returns true if insertion succeeds, false if it was already in there
+bool hash_table_insert_string(HashTable *table, const char *key, int length);
+
+// lookup whether the 'length' bytes at 'key' are inside string key table
+// 'table'
+// returns true if found, false if not
+bool hash_table_lookup_string(HashTable *table, const char *key, int length);
+
 // print the contents of 'table' to stdout
 void hash_table_print(HashTable *table);
 
 // print some statistics about 'table' to stdout
 void hash_table_stats(HashTable *table);
 
+// fill in 'stats' with the same statistics about any type of table (see
+// tblstats.h), for writing out in a machine-readable form
+void hash_table_get_stats(HashTable *table, TableStats *stats);
+
+// the type of 'table'
+TableType hash_table_type(HashTable *table);
+
+// the table of 'table's own type inside the wrapper, for calling its type's
+// functions directly (see hashtbl_typed.h)
+void *hash_table_impl(HashTable *table);
+
 #endif
@@ -0,0 +1,71 @@
+/* * * * * * * * *
+ * Typed front-ends for the unified hash table interface: for binding a hot
+ * loop directly to one type of table, rather than going through the vtable
+ * in hashtbl.c on every operation
+ *
+ * usage:
+ *   XtndblNHashTable *t = xtndbln_of(table);	// asserts 'table' is XTNDBLN
+ *   for (...) found += xtndbln_hash_table_lookup(t, key);
+ * or, for a one-off call:
+ *   hash_table_insert_as(xtndbln, table, key);
+ *
+ * Either way each operation is a direct call into the table's own module,
+ * which the compiler can inline too when building with link-time
+ * optimisation (adding -flto to CFLAGS in the Makefile).
+ *
+ * created for COMP20007 Design of Algorithms - Assignment 2, 2017
+ * by Luke Hedt
+ */
+
+#ifndef HASHTBL_TYPED_H
+#define HASHTBL_TYPED_H
+
+#include <assert.h>
+#include "hashtbl.h"
+
+#include "tables/linear.h"
+#include "tables/xtndbl1.h"
+#include "tables/cuckoo.h"
+#include "tables/xtndbln.h"
+#include "tables/xuckoo.h"
+#include "tables/xtndbld.h"
+#include "tables/xtndblc.h"
+#include "tables/linhash.h"
+#include "tables/xtndblz.h"
+#include "tables/strlinear.h"
+#include "tables/linearc.h"
+
+// define 'name##_of', which returns the table of type 'Table' inside 'table'
+// (asserting that 'table' really is of type 'TYPE')
+#define DEFINE_TYPED_FRONT_END(name, TYPE, Table) \
+static inline Table *name##_of(HashTable *table) { \
+	assert(hash_table_type(table) == TYPE); \
+	return hash_table_impl(table); \
+}
+
+DEFINE_TYPED_FRONT_END(linear, LINEAR, LinearHashTable)
+DEFINE_TYPED_FRONT_END(xtndbl1, XTNDBL1, Xtndbl1HashTable)
+DEFINE_TYPED_FRONT_END(cuckoo, CUCKOO, CuckooHashTable)
+DEFINE_TYPED_FRONT_END(xtndbln, XTNDBLN, XtndblNHashTable)
+DEFINE_TYPED_FRONT_END(xuckoo, XUCKOO, XuckooHashTable)
+DEFINE_TYPED_FRONT_END(xtndbld, XTNDBLD, XtndblDHashTable)
+DEFINE_TYPED_FRONT_END(xtndblc, XTNDBLC, XtndblCHashTable)
+DEFINE_TYPED_FRONT_END(linhash, LINHASH, LinHashTable)
+DEFINE_TYPED_FRONT_END(xtndblz, XTNDBLZ, XtndblZHashTable)
+DEFINE_TYPED_FRONT_END(strlinear, STRLINEAR, StrLinearHashTable)
+DEFINE_TYPED_FRONT_END(linearc, LINEARC, LinearCHashTable)
+
+// insert 'key' into or lookup 'key' in 'table', known to be of type 'name',
+// calling that type's own functions directly
+#define hash_table_insert_as(name, table, key) \
+	name##_hash_table_insert(name##_of(table), (key))
+#define hash_table_lookup_as(name, table, key) \
+	name##_hash_table_lookup(name##_of(table), (key))
+
+// and the same for hash maps (of the types which can be maps)
+#define hash_table_put_as(name, table, key, value) \
+	name##_hash_table_put(name##_of(table), (key), (value))
+#define hash_table_get_as(name, table, key, value) \
+	name##_hash_table_get(name##_of(table), (key), (value))
+
+#endif
@@ -0,0 +1,297 @@
+/* * * * * * * * *
+ * Module for timing hash table operations cheaply, shared by all of the
+ * table types
+ *
+ * created for COMP20007 Design of Algorithms - Assignment 2, 2017
+ * by Luke Hedt
+ *
+ * Only the clock and the reporting live here: recording is inlined from the
+ * header, so that an operation which isn't sampled costs just an increment
+ * and a test. The monotonic clock is read through the vDSO, without a system
+ * call, and unlike the cycle counter it needs no calibration and works
+ * anywhere.
+ *
+ * The trace is a ring buffer that any thread can add to without a lock: it
+ * claims the next position with an atomic increment, and once the ring has
+ * wrapped around that overwrites the oldest event. Each slot holds the
+ * position of the event in it, zeroed while the event is being written and
+ * published after it, so that trace_dump() can skip any slot it catches
+ * half-written rather than stopping everything else to read the ring.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <time.h>
+
+#include "instrument.h"
+
+// labels for each kind of operation, as printed
+static const char *kind_names[NUM_OP_KINDS] = {
+	[OP_INSERT_NEW] = "insert (new)",
+	[OP_INSERT_HIT] = "insert (hit)",
+	[OP_LOOKUP_HIT] = "lookup (hit)",
+	[OP_LOOKUP_MISS] = "lookup (miss)",
+};
+
+// one traced event, in a slot of the trace's ring buffer
+typedef struct trace_slot {
+	uint64_t seq;		// 1 + the event's position in the trace, once it has
+						// been written (or 0 while it's being written)
+	const char *name;
+	uint64_t start;		// when it started and ended, in ns
+	uint64_t end;
+	int64_t before;		// the size of the table before and after it
+	int64_t after;
+	int tid;			// which thread it happened on
+} TraceSlot;
+
+// the trace: the most recent 'capacity' events, in a ring buffer
+static struct {
+	TraceSlot *slots;
+	uint64_t capacity;
+	uint64_t next;		// the position of the next event to be added
+	uint64_t origin;	// when tracing started, in ns
+	int nthreads;		// how many threads have added events so far
+	const char *path;	// where trace_dump() writes it
+} trace;
+
+bool trace_enabled = false;
+
+// this thread's id in the trace (or 0, until it first adds an event)
+static __thread int trace_tid = 0;
+
+
+/* * * *
+ * helper functions
+ */
+
+// the largest time that falls in bucket 'bucket' of a histogram
+static uint64_t bucket_top(int bucket) {
+	if (bucket < 2 * HISTOGRAM_HALF) {
+		return bucket;
+	}
+	int shift = bucket / HISTOGRAM_HALF - 1;
+	uint64_t sub = bucket - shift * HISTOGRAM_HALF;
+	return ((sub + 1) << shift) - 1;
+}
+
+// print 'nanos' to stdout in whichever unit keeps it short
+static void print_duration(uint64_t nanos) {
+	if (nanos < 1000) {
+		printf("%lluns", (unsigned long long)nanos);
+	} else if (nanos < 1000000) {
+		printf("%.1fus", nanos / 1e3);
+	} else if (nanos < 1000000000) {
+		printf("%.1fms", nanos / 1e6);
+	} else {
+		printf("%.2fs", nanos / 1e9);
+	}
+}
+
+// print the p50/p99/p99.9/max of 'histogram' to stdout
+static void print_percentiles(const Histogram *histogram) {
+	printf("p50 ");
+	print_duration(histogram_percentile(histogram, 0.5));
+	printf(", p99 ");
+	print_duration(histogram_percentile(histogram, 0.99));
+	printf(", p99.9 ");
+	print_duration(histogram_percentile(histogram, 0.999));
+	printf(", max ");
+	print_duration(histogram->max);
+}
+
+
+/* * * *
+ * all functions
+ */
+
+// the current time in nanoseconds, from the monotonic clock
+uint64_t instrument_clock_ns(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+
+// empty 'histogram'
+void histogram_init(Histogram *histogram) {
+	memset(histogram, 0, sizeof *histogram);
+}
+
+
+// the time below which fraction 'p' of the times in 'histogram' fall (to
+// within the resolution of its buckets), or 0 if it's empty
+uint64_t histogram_percentile(const Histogram *histogram, double p) {
+	if (histogram->count == 0) {
+		return 0;
+	}
+
+	// find the bucket holding the time ranked ceil(p * count)
+	uint64_t rank = p * histogram->count;
+	if (rank < p * histogram->count || rank == 0) {
+		rank++;
+	}
+	uint64_t seen = 0;
+	int i;
+	for (i = 0; i < HISTOGRAM_BUCKETS; i++) {
+		seen += histogram->buckets[i];
+		if (seen >= rank) {
+			break;
+		}
+	}
+
+	// report the top of that bucket, but never more than the real maximum
+	uint64_t top = bucket_top(i);
+	return top < histogram->max ? top : histogram->max;
+}
+
+
+// set all of 'timer's totals to zero
+void timer_init(OpTimer *timer) {
+	timer->nops = 0;
+	timer->nsampled = 0;
+	timer->nanos = 0;
+	int kind;
+	for (kind = 0; kind < NUM_OP_KINDS; kind++) {
+		histogram_init(&timer->kinds[kind]);
+	}
+}
+
+
+// print the latency percentiles of each kind of operation 'timer' has timed
+// to stdout, a line per kind
+void timer_print(const OpTimer *timer) {
+	int kind;
+	for (kind = 0; kind < NUM_OP_KINDS; kind++) {
+		const Histogram *histogram = &timer->kinds[kind];
+		if (histogram->count == 0) {
+			continue;
+		}
+		printf("%14s: %llu timed, ", kind_names[kind],
+			(unsigned long long)histogram->count);
+		print_percentiles(histogram);
+		printf("\n");
+	}
+}
+
+
+// set 'events' count to zero
+void event_init(EventTimer *events) {
+	events->count = 0;
+	histogram_init(&events->times);
+}
+
+
+// print how many of 'events' there have been, called 'name', and their
+// total time and latency percentiles, to stdout on one line
+void event_print(const EventTimer *events, const char *name) {
+	printf("%14s: %llu", name, (unsigned long long)events->count);
+	if (events->times.count > 0) {
+		printf(", total ");
+		print_duration(events->times.total);
+		printf(", ");
+		print_percentiles(&events->times);
+	}
+	printf("\n");
+}
+
+
+// start tracing events, keeping the most recent 'capacity' of them, to be
+// written to the file at 'path' by trace_dump()
+// returns false if tracing was compiled out (INSTRUMENT < INSTRUMENT_SAMPLED)
+bool trace_start(const char *path, int capacity) {
+	assert(path && capacity > 0 && !trace_enabled);
+#if INSTRUMENT >= INSTRUMENT_SAMPLED
+	trace.slots = calloc(capacity, sizeof *trace.slots);
+	assert(trace.slots);
+	trace.capacity = capacity;
+	trace.next = 0;
+	trace.origin = instrument_clock_ns();
+	trace.nthreads = 0;
+	trace.path = path;
+	trace_enabled = true;
+	return true;
+#else
+	return false;
+#endif
+}
+
+
+// add an event called 'name', from 'start' to 'end' (in ns), which changed
+// the size of a table from 'before' to 'after', to the trace
+void trace_record(const char *name, uint64_t start, uint64_t end,
+		int64_t before, int64_t after) {
+	if (trace_tid == 0) {
+		trace_tid = __atomic_add_fetch(&trace.nthreads, 1, __ATOMIC_RELAXED);
+	}
+
+	// claim the next slot, and mark it as being written until it has been
+	uint64_t pos = __atomic_fetch_add(&trace.next, 1, __ATOMIC_RELAXED);
+	TraceSlot *slot = &trace.slots[pos % trace.capacity];
+	__atomic_store_n(&slot->seq, 0, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+	slot->name = name;
+	slot->start = start;
+	slot->end = end;
+	slot->before = before;
+	slot->after = after;
+	slot->tid = trace_tid;
+	__atomic_store_n(&slot->seq, pos + 1, __ATOMIC_RELEASE);
+}
+
+
+// write the events traced so far (the most recent of them, if the ring buffer
+// has wrapped around) to the trace's file, replacing what was there
+// returns how many were written, or -1 if not tracing or the file couldn't
+// be written
+int64_t trace_dump(void) {
+	if (!trace_enabled) {
+		return -1;
+	}
+	FILE *file = fopen(trace.path, "w");
+	if (file == NULL) {
+		return -1;
+	}
+
+	// the events overwritten by newer ones are lost, as are any still being
+	// written (or overwritten) while they're read
+	uint64_t next = __atomic_load_n(&trace.next, __ATOMIC_ACQUIRE);
+	uint64_t first = next > trace.capacity ? next - trace.capacity : 0;
+	uint64_t dropped = first;
+	int64_t nwritten = 0;
+
+	fprintf(file, "{\"traceEvents\":[");
+	uint64_t pos;
+	for (pos = first; pos < next; pos++) {
+		TraceSlot *slot = &trace.slots[pos % trace.capacity];
+		uint64_t seq = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE);
+		TraceSlot event = *slot;
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+		if (seq != pos + 1
+				|| __atomic_load_n(&slot->seq, __ATOMIC_RELAXED) != seq) {
+			dropped++;
+			continue;
+		}
+
+		// times are in microseconds since tracing started
+		fprintf(file, "%s\n{\"name\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,"
+			"\"dur\":%.3f,\"pid\":1,\"tid\":%d,"
+			"\"args\":{\"before\":%lld,\"after\":%lld}}",
+			nwritten > 0 ? "," : "", event.name,
+			(event.start - trace.origin) / 1e3,
+			(event.end - event.start) / 1e3, event.tid,
+			(long long)event.before, (long long)event.after);
+		nwritten++;
+	}
+	fprintf(file, "\n],\"otherData\":{\"dropped\":%llu}}\n",
+		(unsigned long long)dropped);
+
+	if (fclose(file) != 0) {
+		return -1;
+	}
+	return nwritten;
+}
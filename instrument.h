@@ -0,0 +1,297 @@
+/* * * * * * * * *
+ * Module for timing hash table operations cheaply, shared by all of the
+ * table types
+ *
+ * how much is measured is chosen when compiling, with -DINSTRUMENT=level
+ * (or make INSTRUMENT=level, then rebuild everything):
+ *   INSTRUMENT_OFF (0): nothing, so timing costs nothing
+ *   INSTRUMENT_COUNTERS (1): count operations and events, but don't time them
+ *   INSTRUMENT_SAMPLED (2, the default): count operations, and time one in
+ *     every INSTRUMENT_SAMPLE_RATE of them (starting with the first), to
+ *     estimate the total time of all of them; time every event
+ *   INSTRUMENT_ALL (3): time every operation, for exact latency tails
+ *
+ * timed operations are sorted by their outcome (an OpKind) into latency
+ * histograms. events are the rare, expensive steps taken inside some
+ * operations (resizing, rehashing, splitting), timed on their own so that
+ * the tail latency they cause can be seen
+ *
+ * usage:
+ *   OpTimer timer;
+ *   timer_init(&timer);
+ *   ...
+ *   TimerStart start = timer_start(&timer);
+ *   // the operation
+ *   timer_stop(&timer, start, found ? OP_LOOKUP_HIT : OP_LOOKUP_MISS);
+ *   ...
+ *   printf("%.6f seconds\n", timer_seconds(&timer));
+ *   timer_print(&timer);	// p50/p99/p99.9/max of each kind of operation
+ *
+ *   EventTimer resizes;
+ *   event_init(&resizes);
+ *   ...
+ *   TimerStart start = event_start();
+ *   // the resize
+ *   event_stop(&resizes, start);	// (or event_stop_atomic(), if other
+ *   ...							// threads may be stopping it too)
+ *   event_print(&resizes, "resizes");
+ *
+ * events can also be traced: once trace_start() has been called, every event
+ * stopped with event_stop_traced() is recorded (with when it started, how
+ * long it took, and the size of the table before and after) in a ring buffer
+ * of the most recent ones, which trace_dump() writes out as a Chrome
+ * trace-event file (for chrome://tracing or ui.perfetto.dev). until then,
+ * tracing costs one predictable branch per event, and nothing at all per
+ * operation; below INSTRUMENT_SAMPLED it is compiled out entirely
+ *
+ * created for COMP20007 Design of Algorithms - Assignment 2, 2017
+ * by Luke Hedt
+ */
+
+#ifndef INSTRUMENT_H
+#define INSTRUMENT_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define INSTRUMENT_OFF 0
+#define INSTRUMENT_COUNTERS 1
+#define INSTRUMENT_SAMPLED 2
+#define INSTRUMENT_ALL 3
+
+#ifndef INSTRUMENT
+#define INSTRUMENT INSTRUMENT_SAMPLED
+#endif
+
+// time one in this many operations (a power of two)
+#define INSTRUMENT_SAMPLE_RATE 1024
+
+// histograms are log-linear, like HdrHistogram's: a bucket per nanosecond up
+// to 2^HISTOGRAM_SUB_BITS ns, then each power of two split into 2^(SUB_BITS-1)
+// equal buckets, so a value is recorded to within 1/16 of itself. times of
+// 2^HISTOGRAM_MAX_BITS ns (about 18 minutes) or more share the last bucket
+#define HISTOGRAM_SUB_BITS 5
+#define HISTOGRAM_MAX_BITS 40
+#define HISTOGRAM_HALF (1 << (HISTOGRAM_SUB_BITS - 1))
+#define HISTOGRAM_BUCKETS \
+	((HISTOGRAM_MAX_BITS - HISTOGRAM_SUB_BITS + 2) * HISTOGRAM_HALF)
+
+// how many times, in ns, fell into each bucket
+typedef struct histogram {
+	uint64_t count;		// how many times were recorded
+	uint64_t total;		// their sum
+	uint64_t max;		// and the largest of them
+	uint64_t buckets[HISTOGRAM_BUCKETS];
+} Histogram;
+
+// the outcomes an operation is sorted by
+typedef enum op_kind {
+	OP_INSERT_NEW,		// inserted a key that wasn't in the table
+	OP_INSERT_HIT,		// tried to insert a key that was already there
+	OP_LOOKUP_HIT,		// looked up a key that was there
+	OP_LOOKUP_MISS,		// looked up a key that wasn't
+	NUM_OP_KINDS
+} OpKind;
+
+// the operations counted and timed by one timer, with 64-bit totals so that
+// long runs can't overflow them
+typedef struct op_timer {
+	uint64_t nops;		// how many operations have started
+	uint64_t nsampled;	// how many of them were timed
+	uint64_t nanos;		// how long the timed ones took altogether, in ns
+	Histogram kinds[NUM_OP_KINDS];	// the timed ones, by outcome
+} OpTimer;
+
+// every occurrence of one kind of event, all of them timed
+typedef struct event_timer {
+	uint64_t count;		// how many times it has happened
+	Histogram times;	// how long each one took
+} EventTimer;
+
+// when a timed operation started, in ns (or 0 if it isn't being timed)
+typedef uint64_t TimerStart;
+
+// the current time in nanoseconds, from the monotonic clock
+uint64_t instrument_clock_ns(void);
+
+// empty 'histogram'
+void histogram_init(Histogram *histogram);
+
+// the bucket of a histogram that 'nanos' falls into
+static inline int histogram_bucket(uint64_t nanos) {
+	if (nanos < 2 * HISTOGRAM_HALF) {
+		return nanos;
+	}
+	if (nanos >> HISTOGRAM_MAX_BITS) {
+		return HISTOGRAM_BUCKETS - 1;
+	}
+	// shift the value down to its top SUB_BITS bits, which give its bucket
+	// within the group of buckets for its power of two
+	int shift = 64 - __builtin_clzll(nanos) - HISTOGRAM_SUB_BITS;
+	return shift * HISTOGRAM_HALF + (nanos >> shift);
+}
+
+// add the time 'nanos' to 'histogram'
+static inline void histogram_record(Histogram *histogram, uint64_t nanos) {
+	histogram->buckets[histogram_bucket(nanos)]++;
+	histogram->count++;
+	histogram->total += nanos;
+	if (nanos > histogram->max) {
+		histogram->max = nanos;
+	}
+}
+
+// add the time 'nanos' to 'histogram', which other threads may be adding to
+static inline void histogram_record_atomic(Histogram *histogram,
+		uint64_t nanos) {
+	__atomic_fetch_add(&histogram->buckets[histogram_bucket(nanos)], 1,
+		__ATOMIC_RELAXED);
+	__atomic_fetch_add(&histogram->count, 1, __ATOMIC_RELAXED);
+	__atomic_fetch_add(&histogram->total, nanos, __ATOMIC_RELAXED);
+	uint64_t max = __atomic_load_n(&histogram->max, __ATOMIC_RELAXED);
+	while (nanos > max && !__atomic_compare_exchange_n(&histogram->max, &max,
+			nanos, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+		// the cas loaded the new maximum into 'max': try again
+	}
+}
+
+// the time below which fraction 'p' of the times in 'histogram' fall (to
+// within the resolution of its buckets), or 0 if it's empty
+uint64_t histogram_percentile(const Histogram *histogram, double p);
+
+// set all of 'timer's totals to zero
+void timer_init(OpTimer *timer);
+
+// count an operation starting, and start timing it if it is sampled
+static inline TimerStart timer_start(OpTimer *timer) {
+#if INSTRUMENT >= INSTRUMENT_COUNTERS
+	uint64_t n = timer->nops++;
+#if INSTRUMENT >= INSTRUMENT_ALL
+	(void)n;
+	return instrument_clock_ns();
+#elif INSTRUMENT >= INSTRUMENT_SAMPLED
+	if ((n & (INSTRUMENT_SAMPLE_RATE - 1)) == 0) {
+		return instrument_clock_ns();
+	}
+#else
+	(void)n;
+#endif
+#endif
+	return 0;
+}
+
+// stop timing an operation started at 'start', if it was being timed, and
+// record its time as an operation of kind 'kind'
+static inline void timer_stop(OpTimer *timer, TimerStart start, OpKind kind) {
+#if INSTRUMENT >= INSTRUMENT_SAMPLED
+	if (start != 0) {
+		uint64_t nanos = instrument_clock_ns() - start;
+		timer->nanos += nanos;
+		timer->nsampled++;
+		histogram_record(&timer->kinds[kind], nanos);
+	}
+#else
+	(void)kind;
+#endif
+}
+
+// an estimate of the total time taken by all of 'timer's operations, in
+// seconds: the average time of the sampled ones, times how many there were
+static inline double timer_seconds(const OpTimer *timer) {
+	if (timer->nsampled == 0) {
+		return 0;
+	}
+	return timer->nanos * 1e-9 / timer->nsampled * timer->nops;
+}
+
+// print the latency percentiles of each kind of operation 'timer' has timed
+// to stdout, a line per kind
+void timer_print(const OpTimer *timer);
+
+// set 'events' count to zero
+void event_init(EventTimer *events);
+
+// start timing an event (it isn't counted until it stops, so one that may
+// be abandoned can be started freely)
+static inline TimerStart event_start(void) {
+#if INSTRUMENT >= INSTRUMENT_SAMPLED
+	return instrument_clock_ns();
+#else
+	return 0;
+#endif
+}
+
+// count an event started at 'start', and stop timing it
+static inline void event_stop(EventTimer *events, TimerStart start) {
+#if INSTRUMENT >= INSTRUMENT_COUNTERS
+	events->count++;
+#endif
+#if INSTRUMENT >= INSTRUMENT_SAMPLED
+	histogram_record(&events->times, instrument_clock_ns() - start);
+#else
+	(void)start;
+#endif
+}
+
+// as event_stop(), for events that other threads may be stopping too
+static inline void event_stop_atomic(EventTimer *events, TimerStart start) {
+#if INSTRUMENT >= INSTRUMENT_COUNTERS
+	__atomic_fetch_add(&events->count, 1, __ATOMIC_RELAXED);
+#endif
+#if INSTRUMENT >= INSTRUMENT_SAMPLED
+	histogram_record_atomic(&events->times, instrument_clock_ns() - start);
+#else
+	(void)start;
+#endif
+}
+
+// has trace_start() been called?
+extern bool trace_enabled;
+
+// add an event called 'name', from 'start' to 'end' (in ns), which changed
+// the size of a table from 'before' to 'after', to the trace
+void trace_record(const char *name, uint64_t start, uint64_t end,
+	int64_t before, int64_t after);
+
+// as event_stop(), also adding the event to the trace (if tracing) as 'name',
+// having changed the size of the table from 'before' to 'after'
+static inline void event_stop_traced(EventTimer *events, TimerStart start,
+		const char *name, int64_t before, int64_t after) {
+#if INSTRUMENT >= INSTRUMENT_COUNTERS
+	events->count++;
+#endif
+#if INSTRUMENT >= INSTRUMENT_SAMPLED
+	uint64_t end = instrument_clock_ns();
+	histogram_record(&events->times, end - start);
+	if (__builtin_expect(trace_enabled, false)) {
+		trace_record(name, start, end, before, after);
+	}
+#else
+	(void)start;
+	(void)name;
+	(void)before;
+	(void)after;
+#endif
+}
+
+// the total time taken by all of 'events', in seconds
+static inline double event_seconds(const EventTimer *events) {
+	return events->times.total * 1e-9;
+}
+
+// print how many of 'events' there have been, called 'name', and their
+// total time and latency percentiles, to stdout on one line
+void event_print(const EventTimer *events, const char *name);
+
+// start tracing events, keeping the most recent 'capacity' of them, to be
+// written to the file at 'path' by trace_dump()
+// returns false if tracing was compiled out (INSTRUMENT < INSTRUMENT_SAMPLED)
+bool trace_start(const char *path, int capacity);
+
+// write the events traced so far (the most recent of them, if the ring buffer
+// has wrapped around) to the trace's file, replacing what was there
+// returns how many were written, or -1 if not tracing or the file couldn't
+// be written
+int64_t trace_dump(void);
+
+#endif
@@ -1,10 +1,13 @@
 /* * * * * * * * *
- * Module containing hash functions for 64-bit unsigned integers
+ * Module containing hash functions for 64-bit unsigned integers (and for
+ * byte strings)
  *
  * created for COMP20007 Design of Algorithms - Assignment 2, 2017
  * by Matt Farrugia <matt.farrugia@unimelb.edu.au>
  */
 
+#include <string.h>
+
 #include "inthash.h"
 
 // constants for first hash function
@@ -17,6 +20,10 @@
 #define B2 306837493
 #define p2 2147483563
 
+// constants for string hash function (odd 64-bit multipliers)
+#define M1 0x9E3779B97F4A7C15ULL
+#define M2 0xBF58476D1CE4E5B9ULL
+
 // first available hash function
 int h1(int64 k) {
 	return (A1 * k + B1) % p1;
@@ -26,3 +33,24 @@ int h1(int64 k) {
 int h2(int64 k) {
 	return (A2 * k + B2) % p2;
 }
+
+// hash function for byte strings: mixes in 8 bytes at a time, multiplying and
+// folding the high bits back down after each word, then finishes the last
+// partial word (and the length, so that trailing zero bytes still count)
+int64 hstr(const char *bytes, int length) {
+	int64 h = M1 ^ ((int64)length * M2);
+	int64 word;
+	int i;
+	for (i = 0; i + 8 <= length; i += 8) {
+		memcpy(&word, bytes + i, 8);
+		h = (h ^ word) * M2;
+		h ^= h >> 31;
+	}
+	word = 0;
+	memcpy(&word, bytes + i, length - i);
+	h = (h ^ word) * M1;
+	h ^= h >> 29;
+	h *= M2;
+	h ^= h >> 32;
+	return h;
+}
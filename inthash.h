@@ -1,6 +1,6 @@
 /* * * * * * * * *
- * Module containing hash functions for 64-bit unsigned integers
- * 
+ * Module containing hash functions for 64-bit unsigned integers (and for
+ * byte strings)
  *
  * created for COMP20007 Design of Algorithms - Assignment 2, 2017
  * by Matt Farrugia <matt.farrugia@unimelb.edu.au>
@@ -36,4 +36,9 @@ int h1(int64 k);
 // second available hash function
 int h2(int64 k);
 
+// hash function for byte strings: takes the 'length' bytes starting at
+// 'bytes' and returns a 64-bit hash of them. unlike h1 and h2 this uses all
+// 64 bits, so string tables can cache it and compare it before comparing keys
+int64 hstr(const char *bytes, int length);
+
 #endif
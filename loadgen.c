@@ -0,0 +1,273 @@
+/* * * * * * * * *
+ * Utility program that puts load on the hash table server (a2 -S or -T),
+ * from many clients at once, and reports its throughput and latency
+ *
+ * usage:
+ *   make loadgen
+ *   ./a2 -t type -S socketpath &	(or -T port)
+ *   ./loadgen (-S socketpath | -T port) [nclients [nrequests [pipeline
+ *       [insertpct]]]]
+ *       nclients: how many clients connect at once (each in its own thread)
+ *       nrequests: how many inserts and lookups they send altogether
+ *       pipeline: how many of them each client sends at a time, before
+ *           waiting for all of their results (at most MAX_PIPELINE)
+ *       insertpct: percentage of requests that are inserts
+ *
+ * created for COMP20007 Design of Algorithms - Assignment 2, 2017
+ * by Luke Hedt
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+#include "inthash.h"
+
+/* Each batch is written whole before its results are read, so a batch must
+ * not be so big that the server stops reading it until its results are. */
+#define MAX_PIPELINE 65536
+
+/*************************************************************************/
+
+/* Wall-clock time in seconds, for measuring throughput. */
+static double now() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/* Small, fast per-thread random number generator (xorshift64*). */
+static int64 next_random(int64 *state) {
+	*state ^= *state >> 12;
+	*state ^= *state << 25;
+	*state ^= *state >> 27;
+	return *state * 2685821657736338717ULL;
+}
+
+/* Connect to the server's Unix domain socket at 'path', or (if 'path' is
+ * NULL) its TCP port 'port' on localhost. Exits if it can't. */
+static int connect_to_server(char *path, int port) {
+	int fd;
+	if (path != NULL) {
+		struct sockaddr_un address;
+		memset(&address, 0, sizeof address);
+		address.sun_family = AF_UNIX;
+		strncpy(address.sun_path, path, sizeof address.sun_path - 1);
+		fd = socket(AF_UNIX, SOCK_STREAM, 0);
+		if (fd < 0 || connect(fd, (struct sockaddr *)&address,
+				sizeof address) < 0) {
+			perror(path);
+			exit(1);
+		}
+	} else {
+		struct sockaddr_in address;
+		memset(&address, 0, sizeof address);
+		address.sin_family = AF_INET;
+		address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+		address.sin_port = htons(port);
+		fd = socket(AF_INET, SOCK_STREAM, 0);
+		if (fd < 0 || connect(fd, (struct sockaddr *)&address,
+				sizeof address) < 0) {
+			perror("connect");
+			exit(1);
+		}
+		int on = 1;
+		setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof on);
+	}
+	return fd;
+}
+
+/*************************************************************************/
+
+/* Each client sends its requests in batches of 'pipeline' commands, in a
+ * single write, then reads until it has a result line for each of them,
+ * timing how long that took. */
+
+typedef struct client_job {
+	char *path;			/* where the server is */
+	int port;
+	int nbatches;		/* how many batches this client sends */
+	int pipeline;		/* how many commands are in each */
+	int insertpct;		/* percentage of those that are inserts */
+	int keyrange;		/* keys are drawn from [0, keyrange) */
+	int64 seed;			/* seed for this client's keys */
+	double *latencies;	/* the round-trip time of each completed batch (s) */
+	int ndone;			/* batches that got all their results back */
+	int nbroken;		/* batches cut short because the server went away */
+} ClientJob;
+
+static void *client_worker(void *arg) {
+	ClientJob *job = arg;
+	int fd = connect_to_server(job->path, job->port);
+	int64 state = job->seed;
+	char *request = malloc(job->pipeline * 24);	/* 'i ' + 20 digits + '\n' */
+	char response[1 << 16];
+
+	int b;
+	for (b = 0; b < job->nbatches; b++) {
+		int length = 0, i;
+		for (i = 0; i < job->pipeline; i++) {
+			int64 r = next_random(&state);
+			length += sprintf(request + length, "%c %llu\n",
+				(int)(r % 100) < job->insertpct ? 'i' : 'l',
+				(r >> 8) % job->keyrange);
+		}
+
+		double start = now();
+		int sent = 0;
+		while (sent < length) {
+			ssize_t n = write(fd, request + sent, length - sent);
+			if (n <= 0) {
+				break;
+			}
+			sent += n;
+		}
+		int nresults = 0;
+		while (nresults < job->pipeline) {
+			ssize_t n = read(fd, response, sizeof response);
+			if (n <= 0) {
+				break;
+			}
+			char *c = response, *end = response + n;
+			while ((c = memchr(c, '\n', end - c)) != NULL) {
+				nresults++;
+				c++;
+			}
+		}
+		if (nresults < job->pipeline) {
+			job->nbroken++;
+			break;
+		}
+		job->latencies[job->ndone++] = now() - start;
+	}
+
+	free(request);
+	close(fd);
+	return NULL;
+}
+
+static int compare_doubles(const void *a, const void *b) {
+	double x = *(const double *)a, y = *(const double *)b;
+	return (x > y) - (x < y);
+}
+
+static void run_load(char *path, int port, int nclients, int nrequests,
+		int pipeline, int insertpct) {
+	int nbatches = nrequests / nclients / pipeline;
+	if (nbatches < 1) {
+		nbatches = 1;
+	}
+	int ntotal = nbatches * pipeline * nclients;
+	printf("%d clients sending %d requests, %d at a time, %d%% inserts\n",
+		nclients, ntotal, pipeline, insertpct);
+
+	pthread_t *threads = malloc(sizeof *threads * nclients);
+	ClientJob *jobs = malloc(sizeof *jobs * nclients);
+	double *latencies = malloc(sizeof *latencies * nbatches * nclients);
+
+	double start = now();
+	int c;
+	for (c = 0; c < nclients; c++) {
+		jobs[c].path = path;
+		jobs[c].port = port;
+		jobs[c].nbatches = nbatches;
+		jobs[c].pipeline = pipeline;
+		jobs[c].insertpct = insertpct;
+		jobs[c].keyrange = ntotal;
+		jobs[c].seed = 88172645463325252ULL + c;
+		jobs[c].latencies = latencies + c * nbatches;
+		jobs[c].ndone = 0;
+		jobs[c].nbroken = 0;
+		pthread_create(&threads[c], NULL, client_worker, &jobs[c]);
+	}
+	/* Gather the latencies of the batches that completed, one client's
+	 * after another: a client that was cut off has fewer than the rest. */
+	int nbroken = 0, n = 0;
+	for (c = 0; c < nclients; c++) {
+		pthread_join(threads[c], NULL);
+		nbroken += jobs[c].nbroken;
+		memmove(latencies + n, jobs[c].latencies,
+			sizeof *latencies * jobs[c].ndone);
+		n += jobs[c].ndone;
+	}
+	double elapsed = now() - start;
+
+	if (nbroken > 0) {
+		printf("%d clients were cut off by the server; %d requests of %d "
+			"completed\n", nbroken, n * pipeline, ntotal);
+	}
+	printf("%.3f seconds, %.0f requests/s\n", elapsed,
+		n * pipeline / elapsed);
+
+	/* Latency percentiles, of each completed batch's round trip. */
+	if (n > 0) {
+		qsort(latencies, n, sizeof *latencies, compare_doubles);
+		double percentiles[] = { 50, 90, 99, 99.9, 100 };
+		printf("batch round-trip latency (us):");
+		int p;
+		for (p = 0; p < sizeof percentiles / sizeof *percentiles; p++) {
+			int i = (int)(percentiles[p] / 100 * (n - 1));
+			printf(" p%g %.1f", percentiles[p], latencies[i] * 1e6);
+		}
+		printf("\n");
+	}
+
+	free(latencies);
+	free(jobs);
+	free(threads);
+}
+
+/*************************************************************************/
+
+void printusageexit(char *exe) {
+	fprintf(stderr, "usage: %s (-S socketpath | -T port) [nclients "
+		"[nrequests [pipeline [insertpct]]]]\n", exe);
+	fprintf(stderr, " -S/-T: where the server (a2 -S or -T) is listening\n");
+	fprintf(stderr, " nclients: how many clients connect at once\n");
+	fprintf(stderr, " nrequests: how many inserts and lookups they send\n");
+	fprintf(stderr, " pipeline: how many each client sends at a time\n");
+	fprintf(stderr, " insertpct: percentage of requests that are inserts\n");
+	exit(1);
+}
+
+/* Integer argument 'i' of argv, or 'fallback' if it was not given. */
+static int intarg(int argc, char **argv, int i, int fallback) {
+	return i < argc ? atoi(argv[i]) : fallback;
+}
+
+int main(int argc, char **argv) {
+	if (argc < 3) {
+		printusageexit(argv[0]);
+	}
+	char *path = NULL;
+	int port = -1;
+	if (strcmp(argv[1], "-S") == 0) {
+		path = argv[2];
+	} else if (strcmp(argv[1], "-T") == 0) {
+		port = atoi(argv[2]);
+	} else {
+		printusageexit(argv[0]);
+	}
+
+	int nclients = intarg(argc, argv, 3, 4);
+	int nrequests = intarg(argc, argv, 4, 1000000);
+	int pipeline = intarg(argc, argv, 5, 32);
+	int insertpct = intarg(argc, argv, 6, 50);
+	if (nclients < 1 || nrequests < 1 || pipeline < 1
+			|| pipeline > MAX_PIPELINE) {
+		printusageexit(argv[0]);
+	}
+	run_load(path, port, nclients, nrequests, pipeline, insertpct);
+
+	return 0;
+}
@@ -6,52 +6,130 @@
  * by Matt Farrugia <matt.farrugia@unimelb.edu.au>
  */
 
+#define _POSIX_C_SOURCE 200809L
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdbool.h>
 #include <string.h>
+#include <assert.h>
 #include <getopt.h>
+#include <pthread.h>
+#include <time.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/epoll.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
 
 #include "inthash.h"
 #include "hashtbl.h"
+#include "commands.h"
+#include "ring.h"
+#include "instrument.h"
 
 // command line options
 #define DEFAULT_SIZE 4
+#define TRACE_CAPACITY (1 << 16)	// how many of the latest events to trace
 typedef struct options {
 	TableType type;
 	int initial_size;
+	char *index_path;	// where a disk-resident table is stored (or NULL)
+	int nshards;		// how many shards to split the table into (or 0)
+	char *input_path;	// file to read commands from (or NULL for stdin)
+	bool quiet;			// print only summary counts, not each result?
+	bool pipelined;		// read, run and write commands in separate threads?
+	char *socket_path;	// Unix domain socket to serve clients on (or NULL)
+	int port;			// localhost TCP port to serve clients on (or -1)
+	char *trace_path;	// where to write a trace of resizes/splits (or NULL)
 } Options;
 Options get_options(int argc, char** argv);
 
 
-// interpreter commands
+// buffered input and output: commands are read in large blocks (or a whole
+// regular file is mapped into memory), and results are written out in large
+// blocks, rather than a line at a time. a mapped file may be a binary command
+// log, whose commands are decoded straight from the mapping
+
+#define INPUT_BLOCK_SIZE (1 << 20)
+typedef struct input {
+	int fd;				// where the commands come from
+	char *data;			// the bytes read so far, or the whole mapped file
+	size_t size;		// how many bytes of 'data' are valid
+	size_t pos;			// where the next unread line starts
+	size_t capacity;	// size of the 'data' buffer (0 if the file is mapped)
+	bool eof;			// has everything been read into 'data'?
+	bool binary;		// is it a command log, rather than text?
+} Input;
+Input *open_input(char *path);
+int next_line(Input *input, char **line);
+int next_command(Input *input, char *operation, int64 *key, char *buffer,
+	const char **string, int *length);
+void close_input(Input *input);
 
-#define INSERT 'i'
-#define LOOKUP 'l'
-#define PRINT  'p'
-#define STATS  's'
-#define HELP   'h'
-#define QUIT   'q'
-#define MAX_LINE_LEN 80
-int get_command(char *operation, int64 *key);
+#define OUTPUT_BUFFER_SIZE (1 << 16)
+typedef struct output {
+	char *data;
+	int size;			// how many bytes are waiting to be written
+	int capacity;		// size of the 'data' buffer
+	FILE *file;			// where they are written, or NULL to keep all of them
+						// (growing the buffer) until they are taken away
+} Output;
+Output *new_output(FILE *file);
+void free_output(Output *output);
+void output_flush(Output *output);
+void output_text(Output *output, const char *text, int length);
+void output_key(Output *output, int64 key);
+#define output_string(output, s) output_text(output, s, strlen(s))
 
 
 // main program
 
-void run_interpreter(HashTable *table);
+void run_interpreter(HashTable *table, Options options);
+void run_server(HashTable *table, Options options);
 
 int main(int argc, char **argv) {
 	
 	// get command line options (to determine table type, size, etc.)
 	Options options = get_options(argc, argv);
 
-	// create hashtable (of given type)
-	HashTable *table = new_hash_table(options.type, options.initial_size);
+	// create hashtable (of given type), or open it from disk if it lives there,
+	// or split it into shards
+	HashTable *table;
+	if (options.index_path != NULL) {
+		table = open_hash_table(options.type, options.index_path);
+	} else if (options.nshards > 0) {
+		table = new_sharded_hash_table(options.type, options.initial_size,
+			options.nshards);
+	} else {
+		table = new_hash_table(options.type, options.initial_size);
+	}
+
+	// trace resizes and splits from the start, if asked to
+	if (options.trace_path != NULL
+			&& !trace_start(options.trace_path, TRACE_CAPACITY)) {
+		fprintf(stderr, "tracing needs INSTRUMENT >= 2 (make INSTRUMENT=2)\n");
+		exit(EXIT_FAILURE);
+	}
 
-	// start the interpreter loop
-	run_interpreter(table);
+	// start the interpreter loop, or serve clients
+	if (options.socket_path != NULL || options.port >= 0) {
+		run_server(table, options);
+	} else {
+		run_interpreter(table, options);
+	}
 
-	// done!
+	// done! (writing out the trace, if there is one)
+	if (options.trace_path != NULL && trace_dump() < 0) {
+		fprintf(stderr, "couldn't write trace to %s\n", options.trace_path);
+	}
 	free_hash_table(table);
 	return 0;
 }
@@ -60,108 +138,962 @@ int main(int argc, char **argv) {
 void print_operations() {
 	printf(" %c number: insert 'number' into table\n",  INSERT);
 	printf(" %c number: lookup is 'number' in table\n", LOOKUP);
+	printf(" %c \"string\": insert 'string' into table (string key tables)\n",
+		INSERT);
+	printf(" %c \"string\": lookup is 'string' in table (string key tables)\n",
+		LOOKUP);
 	printf(" %c: print table\n", PRINT);
 	printf(" %c: print stats\n", STATS);
+	printf(" %c: print stats as JSON\n", STATS_JSON);
+	printf(" %c: print stats as Prometheus metrics\n", METRICS);
+	printf(" %c: write out the trace of resizes/splits (with -e file)\n",
+		TRACE);
 	printf(" %c: quit\n", QUIT);
 }
 
-// run the interpreter, reading and performing commands until 'quit'
-void run_interpreter(HashTable *table) {
-	
-	// print a prompt at the beginning
-	printf("enter a command (h for help):\n");
-	
+// counts of each result, for quiet mode's summary
+typedef struct counts {
+	long long ncommands;
+	long long ninserted, nduplicates;
+	long long nfound, nnotfound;
+} Counts;
+
+// what happened when a command was run
+typedef enum result {
+	NO_RESULT,			// nothing to report (or it's printed directly)
+	DONE,				// the key was inserted, or found
+	NOT_DONE,			// the key was already in the table, or not found
+	NO_KEY,				// the command needed a key, but had none
+	NO_STRING_KEYS		// the key was a string, but the table needs numbers
+} Result;
+
+// a command, as read from the input, and what happened when it was run
+typedef struct command {
 	char op;
+	int argc;			// how many tokens it had (see parse_command), or -1
+						// to mark the end of the input
 	int64 key;
-	
-	// then loop, getting and executing commands, until 'quit'
-	while (true) {
+	const char *string;	// a string key, if there was one
+	int length;			// its length, or -1 if the key was a number
+	bool copied;		// was the string copied (so it must be freed)?
+	Result result;
+} Command;
 
-		// read a command, storing results in op and key variables
-		int argc = get_command(&op, &key);
-		if (argc < 1) {
-			continue; // no valid command entered, get another
+// wall-clock time in seconds
+static double now() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// run 'command' on 'table', storing what happened in command->result
+static void run_command(HashTable *table, Command *command) {
+	command->result = NO_RESULT;
+	if (command->op != INSERT && command->op != LOOKUP) {
+		return;
+	}
+
+	bool done;
+	if (command->argc < 2) {
+		// inserts and lookups must have an argument
+		command->result = NO_KEY;
+		return;
+	} else if (command->length >= 0) {
+		if (!hash_table_has_string_keys(table)) {
+			command->result = NO_STRING_KEYS;
+			return;
 		}
+		done = command->op == INSERT
+			? hash_table_insert_string(table, command->string, command->length)
+			: hash_table_lookup_string(table, command->string, command->length);
+	} else {
+		done = command->op == INSERT
+			? hash_table_insert(table, command->key)
+			: hash_table_lookup(table, command->key);
+	}
+	command->result = done ? DONE : NOT_DONE;
+}
 
-		// execute the command
-		switch (op) {
-			case INSERT:
-				if (argc < 2) {
-					// insert commands must have an argument
-					printf("syntax: %c number\n", INSERT);
-				
+// does 'command' print straight to stdout, once everything before it has
+// been written out? (rather than having its result written out afterwards)
+static bool prints_directly(Command *command) {
+	return command->op != INSERT && command->op != LOOKUP
+		&& command->op != QUIT;
+}
+
+// perform the printing of a command that prints directly
+static void print_command(HashTable *table, Command *command) {
+	switch (command->op) {
+		case PRINT:
+			// perform the print table
+			hash_table_print(table);
+			break;
+
+		case STATS:
+			// perform the print stats
+			hash_table_stats(table);
+			break;
+
+		case STATS_JSON:
+		case METRICS: {
+			// the same stats for every type of table, for machines to read
+			TableStats stats;
+			hash_table_get_stats(table, &stats);
+			if (command->op == STATS_JSON) {
+				table_stats_write_json(&stats, stdout);
+			} else {
+				table_stats_write_prometheus(&stats, stdout);
+			}
+			break;
+		}
+
+		case TRACE: {
+			// write out the events traced so far
+			int64_t n = trace_dump();
+			if (n < 0) {
+				printf("not tracing (start a2 with -e file to trace)\n");
+			} else {
+				printf("traced %lld events\n", (long long)n);
+			}
+			break;
+		}
+
+		default:
+			// list available options (after the error, for unknown ones)
+			print_operations();
+			break;
+	}
+}
+
+// write out the key of an insert or lookup, then 'text'
+static void output_result(Output *output, Command *command, const char *text) {
+	if (command->length >= 0) {
+		output_text(output, "\"", 1);
+		output_text(output, command->string, command->length);
+		output_text(output, "\"", 1);
+	} else {
+		output_key(output, command->key);
+	}
+	output_string(output, text);
+}
+
+// write out the result of 'command', after it has been run. in quiet mode,
+// results are counted instead of written
+static void output_command(Output *output, Command *command, Counts *counts,
+		bool quiet) {
+	counts->ncommands++;
+	switch (command->op) {
+		case INSERT:
+		case LOOKUP:
+			if (command->result == NO_KEY) {
+				output_string(output, command->op == INSERT
+					? "syntax: i number\n" : "syntax: l number\n");
+			} else if (command->result == NO_STRING_KEYS) {
+				output_string(output, "string keys need a string key "
+					"table (-t strlinear)\n");
+			} else if (command->op == INSERT) {
+				if (command->result == DONE) {
+					counts->ninserted++;
+					if (!quiet) {
+						output_result(output, command, " inserted\n");
+					}
 				} else {
-					// perform the insertion
-					if (hash_table_insert(table, key)) {
-						printf("%llu inserted\n", key);
-					} else {
-						printf("%llu already in table\n", key);
+					counts->nduplicates++;
+					if (!quiet) {
+						output_result(output, command, " already in table\n");
 					}
 				}
-				break;
+			} else {
+				if (command->result == DONE) {
+					counts->nfound++;
+					if (!quiet) {
+						output_result(output, command, " found\n");
+					}
+				} else {
+					counts->nnotfound++;
+					if (!quiet) {
+						output_result(output, command, " not found\n");
+					}
+				}
+			}
+			break;
+
+		case PRINT:
+		case STATS:
+		case STATS_JSON:
+		case METRICS:
+		case TRACE:
+			// these print directly
+			break;
+
+		default:
+			// display error
+			output_string(output, "unknown operation '");
+			output_text(output, &command->op, 1);
+			output_string(output, "'\n");
+			// fall through!
+		case HELP:
+			// the list of available options follows directly
+			output_string(output, "available operations:\n");
+			break;
+
+		case QUIT:
+			// leave the interpreter loop
+			if (!quiet) {
+				output_string(output, "exiting\n");
+			}
+			break;
+	}
+}
+
+// read the next command from 'input' into 'command', skipping blank lines,
+// with any string key in 'buffer' (of size MAX_LINE_LEN) if it was copied
+// there. at the end of the input, command->argc is -1
+static void read_command_from(Input *input, Command *command, char *buffer) {
+	do {
+		command->argc = next_command(input, &command->op, &command->key,
+			buffer, &command->string, &command->length);
+	} while (command->argc == 0);
+	command->copied = false;
+}
+
+// run the interpreter one command at a time, until 'quit'
+static void run_serial(HashTable *table, Input *input, Output *output,
+		Counts *counts, bool quiet) {
+	char buffer[MAX_LINE_LEN];	// a quoted string key is copied here
+	Command command;
+
+	while (true) {
+		// read a command. before waiting for more input, show the results
+		// so far
+		if (input->pos == input->size && !input->eof) {
+			output_flush(output);
+		}
+		read_command_from(input, &command, buffer);
+		if (command.argc < 0) {
+			break; // end of input
+		}
+
+		// execute the command
+		run_command(table, &command);
+		output_command(output, &command, counts, quiet);
+		if (prints_directly(&command)) {
+			output_flush(output);
+			print_command(table, &command);
+		}
+		if (command.op == QUIT) {
+			break;
+		}
+	}
+}
+
+// the pipelined interpreter's three threads pass commands along rings: a
+// reader parses them, the table thread (the main one) runs them, and a writer
+// writes out their results. when a command prints directly, the table thread
+// waits for the writer to catch up first, so the output is in the same order
+#define PIPELINE_RING_SIZE 4096
+typedef struct pipeline {
+	Input *input;
+	Output *output;
+	Counts *counts;
+	bool quiet;
+	Ring *commands;		// parsed commands, from the reader to the table thread
+	Ring *results;		// run commands, from the table thread to the writer
+	Ring *caughtup;		// from the writer, once it has written everything
+} Pipeline;
+
+// the reader thread: parse commands onto the commands ring until 'quit' (or
+// the end of the input)
+static void *pipeline_reader(void *arg) {
+	Pipeline *pipeline = arg;
+	char buffer[MAX_LINE_LEN];
+	Command command;
+	do {
+		read_command_from(pipeline->input, &command, buffer);
+		if (command.argc > 0 && command.length >= 0
+				&& command.string == buffer) {
+			// the buffer will be reused, so the key needs its own copy
+			char *copy = malloc(command.length + 1);
+			assert(copy);
+			memcpy(copy, buffer, command.length);
+			command.string = copy;
+			command.copied = true;
+		}
+		ring_push(pipeline->commands, &command);
+	} while (command.argc > 0 && command.op != QUIT);
+	return NULL;
+}
+
+// the writer thread: write out results from the results ring until the end
+static void *pipeline_writer(void *arg) {
+	Pipeline *pipeline = arg;
+	Command command;
+	while (true) {
+		if (ring_is_empty(pipeline->results)) {
+			// nothing more to write yet, so show what has been
+			output_flush(pipeline->output);
+		}
+		ring_pop(pipeline->results, &command);
+		if (command.argc < 0) {
+			break;
+		}
+
+		output_command(pipeline->output, &command, pipeline->counts,
+			pipeline->quiet);
+		if (prints_directly(&command)) {
+			output_flush(pipeline->output);
+			ring_push(pipeline->caughtup, &command.op);
+		}
+		if (command.copied) {
+			free((char *)command.string);
+		}
+	}
+	return NULL;
+}
+
+// run the interpreter as a pipeline of threads, until 'quit'
+static void run_pipelined(HashTable *table, Input *input, Output *output,
+		Counts *counts, bool quiet) {
+	Pipeline pipeline = { input, output, counts, quiet,
+		new_ring(PIPELINE_RING_SIZE, sizeof (Command)),
+		new_ring(PIPELINE_RING_SIZE, sizeof (Command)),
+		new_ring(1, sizeof (char)) };
+	pthread_t reader, writer;
+	int err = pthread_create(&reader, NULL, pipeline_reader, &pipeline);
+	assert(err == 0 && "error: couldn't start the reader thread!");
+	err = pthread_create(&writer, NULL, pipeline_writer, &pipeline);
+	assert(err == 0 && "error: couldn't start the writer thread!");
+
+	Command command;
+	while (true) {
+		ring_pop(pipeline.commands, &command);
+		if (command.argc < 0) {
+			// end of input: pass it on, so the writer stops too
+			ring_push(pipeline.results, &command);
+			break;
+		}
+
+		run_command(table, &command);
+		ring_push(pipeline.results, &command);
+		if (prints_directly(&command)) {
+			char op;
+			ring_pop(pipeline.caughtup, &op);
+			print_command(table, &command);
+		}
+		if (command.op == QUIT) {
+			// tell the writer that's the end
+			command.argc = -1;
+			ring_push(pipeline.results, &command);
+			break;
+		}
+	}
+	pthread_join(reader, NULL);
+	pthread_join(writer, NULL);
+	free_ring(pipeline.caughtup);
+	free_ring(pipeline.results);
+	free_ring(pipeline.commands);
+}
+
+// run the interpreter, reading and performing commands until 'quit' (or the
+// end of the input). in quiet mode, results are counted instead of printed
+void run_interpreter(HashTable *table, Options options) {
+	Input *input = open_input(options.input_path);
+	Output *output = new_output(stdout);
+	Counts counts = { 0, 0, 0, 0, 0 };
+	double start = now();
+
+	// print a prompt at the beginning
+	if (!options.quiet) {
+		output_string(output, "enter a command (h for help):\n");
+	}
+
+	// then loop, getting and executing commands, until 'quit'
+	if (options.pipelined) {
+		run_pipelined(table, input, output, &counts, options.quiet);
+	} else {
+		run_serial(table, input, output, &counts, options.quiet);
+	}
+
+	output_flush(output);
+	if (options.quiet) {
+		double elapsed = now() - start;
+		printf("%lld commands in %.3f seconds (%.0f commands/s)\n",
+			counts.ncommands, elapsed, counts.ncommands / elapsed);
+		printf("%lld inserted, %lld already in table\n", counts.ninserted,
+			counts.nduplicates);
+		printf("%lld found, %lld not found\n", counts.nfound,
+			counts.nnotfound);
+	}
+
+	free_output(output);
+	close_input(input);
+}
+
+// the server: clients connect to a Unix domain socket and/or a localhost TCP
+// port, and send commands in the same language as the interpreter, as many
+// at a time as they like. whenever a client has sent something, the server
+// reads it all, runs every complete command in it, and sends back all of
+// their results together. a single thread serves every client (so the table
+// needs no locks), using epoll to find the ones that are ready
+
+#define SERVER_READ_SIZE (1 << 16)	// how much to read from a client at once
+#define MAX_PENDING (1 << 24)		// stop reading from a client while it has
+									// this much unsent output
+#define MAX_COMMAND_LEN (1 << 20)	// cut off a client sending a command this
+									// long (it can't be a real one)
+#define MAX_EVENTS 64
+
+// a client connection (or a socket listening for them)
+typedef struct client {
+	int fd;
+	bool listening;		// is this a socket listening for new clients?
+	char *input;		// bytes received but not yet run (part of a command)
+	int insize;			// how many bytes are in 'input'
+	int incapacity;		// size of the 'input' buffer
+	Output *output;		// results to send (which will not be written out)
+	int outsent;		// how many bytes of 'output' have been sent already
+	bool closing;		// close it once everything is sent (after 'quit')
+	struct client *prev, *next;	// the other connected clients
+} Client;
+
+// set by a signal, to stop the server at the next opportunity
+static volatile sig_atomic_t server_stopping = 0;
+static void stop_server(int signum) {
+	server_stopping = 1;
+}
+
+// exit, explaining which system call failed
+static void fail(const char *what) {
+	perror(what);
+	exit(EXIT_FAILURE);
+}
+
+// make 'fd' non-blocking, so the server never waits on one client
+static void set_nonblocking(int fd) {
+	int flags = fcntl(fd, F_GETFL);
+	if (flags < 0 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) < 0) {
+		fail("fcntl");
+	}
+}
+
+// start listening on a Unix domain socket at 'path' (replacing any old one)
+static int listen_unix(const char *path) {
+	struct sockaddr_un address;
+	memset(&address, 0, sizeof address);
+	address.sun_family = AF_UNIX;
+	if (strlen(path) >= sizeof address.sun_path) {
+		fprintf(stderr, "socket path is too long: %s\n", path);
+		exit(EXIT_FAILURE);
+	}
+	strcpy(address.sun_path, path);
+
+	int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (fd < 0) {
+		fail("socket");
+	}
+	unlink(path);
+	if (bind(fd, (struct sockaddr *)&address, sizeof address) < 0) {
+		fail(path);
+	}
+	if (listen(fd, SOMAXCONN) < 0) {
+		fail("listen");
+	}
+	printf("listening on %s\n", path);
+	return fd;
+}
+
+// start listening on TCP port 'port' of localhost (any free port, if 0)
+static int listen_tcp(int port) {
+	struct sockaddr_in address;
+	memset(&address, 0, sizeof address);
+	address.sin_family = AF_INET;
+	address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	address.sin_port = htons(port);
+
+	int fd = socket(AF_INET, SOCK_STREAM, 0);
+	if (fd < 0) {
+		fail("socket");
+	}
+	int on = 1;
+	setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof on);
+	if (bind(fd, (struct sockaddr *)&address, sizeof address) < 0) {
+		fail("bind");
+	}
+	if (listen(fd, SOMAXCONN) < 0) {
+		fail("listen");
+	}
+	socklen_t length = sizeof address;
+	getsockname(fd, (struct sockaddr *)&address, &length);
+	printf("listening on 127.0.0.1:%d\n", ntohs(address.sin_port));
+	return fd;
+}
+
+// create a client for 'fd' (a new connection, or a listening socket)
+static Client *new_client(int fd, bool listening) {
+	Client *client = malloc(sizeof *client);
+	assert(client);
+	client->fd = fd;
+	client->listening = listening;
+	client->input = NULL;
+	client->output = NULL;
+	if (!listening) {
+		client->incapacity = 2 * SERVER_READ_SIZE;
+		client->input = malloc(client->incapacity);
+		assert(client->input);
+		client->output = new_output(NULL);
+	}
+	client->insize = 0;
+	client->outsent = 0;
+	client->closing = false;
+	client->prev = client->next = NULL;
+	return client;
+}
+
+// close 'client's connection and free all memory associated with it
+static void free_client(Client *client) {
+	close(client->fd);
+	if (!client->listening) {
+		free(client->input);
+		free_output(client->output);
+	}
+	free(client);
+}
+
+// tell epoll what 'client' is waiting for: more commands, unless it is
+// closing or has too much unsent output, and room to send output, if it has
+// some. 'op' is EPOLL_CTL_ADD for a new client, or EPOLL_CTL_MOD
+static void watch_client(int epfd, Client *client, int op) {
+	struct epoll_event event;
+	int pending = client->listening ? 0
+		: client->output->size - client->outsent;
+	event.events = 0;
+	if (!client->closing && pending < MAX_PENDING) {
+		event.events |= EPOLLIN;
+	}
+	if (pending > 0) {
+		event.events |= EPOLLOUT;
+	}
+	event.data.ptr = client;
+	if (epoll_ctl(epfd, op, client->fd, &event) < 0) {
+		fail("epoll_ctl");
+	}
+}
+
+// perform the printing of a command that prints directly, into 'output'
+// rather than to stdout (by pointing stdout at a temporary file meanwhile)
+static void print_command_into(HashTable *table, Command *command,
+		Output *output) {
+	FILE *capture = tmpfile();
+	if (capture == NULL) {
+		fail("tmpfile");
+	}
+	fflush(stdout);
+	int saved = dup(STDOUT_FILENO);
+	dup2(fileno(capture), STDOUT_FILENO);
+	print_command(table, command);
+	fflush(stdout);
+	dup2(saved, STDOUT_FILENO);
+	close(saved);
+
+	rewind(capture);
+	char block[4096];
+	size_t n;
+	while ((n = fread(block, 1, sizeof block, capture)) > 0) {
+		output_text(output, block, n);
+	}
+	fclose(capture);
+}
+
+// run each complete command in 'client's input (or everything left, once it
+// has stopped sending) on 'table', adding the results to its output
+static void serve_commands(HashTable *table, Client *client, Counts *counts,
+		bool ended) {
+	char buffer[MAX_LINE_LEN];
+	Command command;
+	char *start = client->input;
+	char *end = client->input + client->insize;
+	while (start < end && !client->closing) {
+		char *newline = memchr(start, '\n', end - start);
+		if (newline == NULL && !ended) {
+			break; // the rest of the command hasn't arrived yet
+		}
+		char *next = newline ? newline + 1 : end;
+
+		command.argc = parse_command(start, (newline ? newline : end) - start,
+			&command.op, &command.key, buffer, &command.length);
+		start = next;
+		if (command.argc < 1) {
+			continue;
+		}
+		command.string = buffer;
+		command.copied = false;
 
-			case LOOKUP:
-				if (argc < 2) {
-					// lookup commands must have an argument
-					printf("syntax: %c number\n", LOOKUP);
+		// execute the command
+		run_command(table, &command);
+		output_command(client->output, &command, counts, false);
+		if (prints_directly(&command)) {
+			print_command_into(table, &command, client->output);
+		}
+		if (command.op == QUIT) {
+			client->closing = true;
+		}
+	}
+
+	// keep the incomplete command (if any) for next time
+	client->insize = client->closing ? 0 : end - start;
+	memmove(client->input, start, client->insize);
+}
+
+// send as much of 'client's output as it will take
+// returns false if the connection has broken
+static bool send_output(Client *client) {
+	Output *output = client->output;
+	while (client->outsent < output->size) {
+		ssize_t n = send(client->fd, output->data + client->outsent,
+			output->size - client->outsent, MSG_NOSIGNAL);
+		if (n < 0) {
+			return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+		}
+		client->outsent += n;
+	}
+	output->size = client->outsent = 0;
+	return true;
+}
+
+// read what 'client' has sent, run it, and send the results
+// returns false if the client should be closed now
+static bool serve_client(HashTable *table, Client *client, Counts *counts,
+		uint32_t events) {
+	if ((events & (EPOLLIN | EPOLLHUP | EPOLLERR)) && !client->closing) {
+		// make room to read into
+		if (client->incapacity - client->insize < SERVER_READ_SIZE) {
+			if (client->insize > MAX_COMMAND_LEN) {
+				return false; // that's no command
+			}
+			client->incapacity *= 2;
+			client->input = realloc(client->input, client->incapacity);
+			assert(client->input);
+		}
+
+		ssize_t n = read(client->fd, client->input + client->insize,
+			client->incapacity - client->insize);
+		if (n > 0) {
+			client->insize += n;
+			serve_commands(table, client, counts, false);
+		} else if (n == 0) {
+			// the client has finished sending: run what's left, then close
+			serve_commands(table, client, counts, true);
+			client->closing = true;
+		} else if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+			return false;
+		}
+	}
 
+	if (!send_output(client)) {
+		return false;
+	}
+	return !(client->closing && client->output->size == 0);
+}
+
+// accept every new connection waiting on 'listener', and start watching them,
+// adding them to the list 'clients'
+static void accept_clients(int epfd, Client *listener, bool tcp,
+		Client **clients, int *nclients) {
+	while (true) {
+		int fd = accept(listener->fd, NULL, NULL);
+		if (fd < 0) {
+			return; // none left (or it went away before we got to it)
+		}
+		set_nonblocking(fd);
+		if (tcp) {
+			// results are sent in batches already, so don't hold them back
+			int on = 1;
+			setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof on);
+		}
+		Client *client = new_client(fd, false);
+		watch_client(epfd, client, EPOLL_CTL_ADD);
+		client->next = *clients;
+		if (*clients != NULL) {
+			(*clients)->prev = client;
+		}
+		*clients = client;
+		(*nclients)++;
+	}
+}
+
+// run the interpreter as a server, until it is interrupted (SIGINT or SIGTERM)
+void run_server(HashTable *table, Options options) {
+	int epfd = epoll_create1(0);
+	if (epfd < 0) {
+		fail("epoll_create1");
+	}
+
+	// listen on each socket asked for
+	Client *unixlistener = NULL, *tcplistener = NULL;
+	if (options.socket_path != NULL) {
+		unixlistener = new_client(listen_unix(options.socket_path), true);
+		set_nonblocking(unixlistener->fd);
+		watch_client(epfd, unixlistener, EPOLL_CTL_ADD);
+	}
+	if (options.port >= 0) {
+		tcplistener = new_client(listen_tcp(options.port), true);
+		set_nonblocking(tcplistener->fd);
+		watch_client(epfd, tcplistener, EPOLL_CTL_ADD);
+	}
+	fflush(stdout);
+
+	// stop on ctrl-c (or kill), and don't die when a client goes away
+	struct sigaction action;
+	memset(&action, 0, sizeof action);
+	action.sa_handler = stop_server;
+	sigaction(SIGINT, &action, NULL);
+	sigaction(SIGTERM, &action, NULL);
+
+	Counts counts = { 0, 0, 0, 0, 0 };
+	Client *clients = NULL;	// every connected client
+	int nclients = 0;		// how many there have been
+	struct epoll_event events[MAX_EVENTS];
+	while (!server_stopping) {
+		int n = epoll_wait(epfd, events, MAX_EVENTS, -1);
+		if (n < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			fail("epoll_wait");
+		}
+
+		int i;
+		for (i = 0; i < n; i++) {
+			Client *client = events[i].data.ptr;
+			if (client->listening) {
+				accept_clients(epfd, client, client == tcplistener,
+					&clients, &nclients);
+			} else if (serve_client(table, client, &counts,
+					events[i].events)) {
+				watch_client(epfd, client, EPOLL_CTL_MOD);
+			} else {
+				// (closing it removes it from epoll too)
+				if (client->prev != NULL) {
+					client->prev->next = client->next;
 				} else {
-					// perform the lookup
-					if (hash_table_lookup(table, key)) {
-						printf("%llu found\n", key);
-					} else {
-						printf("%llu not found\n", key);
-					}
+					clients = client->next;
 				}
-				break;
+				if (client->next != NULL) {
+					client->next->prev = client->prev;
+				}
+				free_client(client);
+			}
+		}
+	}
 
-			case PRINT:
-				// perform the print table
-				hash_table_print(table);
-				break;
+	// clients still connected are simply cut off
+	while (clients != NULL) {
+		Client *next = clients->next;
+		free_client(clients);
+		clients = next;
+	}
+	if (unixlistener != NULL) {
+		free_client(unixlistener);
+		unlink(options.socket_path);
+	}
+	if (tcplistener != NULL) {
+		free_client(tcplistener);
+	}
+	close(epfd);
+	printf("served %lld commands from %d clients\n", counts.ncommands,
+		nclients);
+	printf("%lld inserted, %lld already in table\n", counts.ninserted,
+		counts.nduplicates);
+	printf("%lld found, %lld not found\n", counts.nfound, counts.nnotfound);
+}
 
-			case STATS:
-				// perform the print stats
-				hash_table_stats(table);
-				break;
+// open the file at 'path' (or stdin, if 'path' is NULL) for reading commands.
+// regular files are mapped into memory whole; anything else is read in blocks
+Input *open_input(char *path) {
+	Input *input = malloc(sizeof *input);
+	assert(input);
+	input->fd = STDIN_FILENO;
+	if (path != NULL) {
+		input->fd = open(path, O_RDONLY);
+		if (input->fd < 0) {
+			perror(path);
+			exit(EXIT_FAILURE);
+		}
+	}
+	input->pos = 0;
 
-			default:
-				// display error
-				printf("unknown operation '%c'\n", op);
-				// fall through!
-			case HELP:
-				// list available options
-				printf("available operations:\n");
-				print_operations();
-				break;
-				
-			case QUIT:
-				// leave the interpreter loop
-				printf("exiting\n");
+	struct stat st;
+	if (fstat(input->fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+		void *data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE,
+			input->fd, 0);
+		if (data != MAP_FAILED) {
+			posix_madvise(data, st.st_size, POSIX_MADV_SEQUENTIAL);
+			input->data = data;
+			input->size = st.st_size;
+			input->capacity = 0;
+			input->eof = true;
+			input->binary = is_command_log(input->data, input->size);
+			if (input->binary) {
+				input->pos = COMMAND_LOG_MAGIC_LEN;
+			}
+			return input;
+		}
+	}
+
+	input->capacity = INPUT_BLOCK_SIZE;
+	input->data = malloc(input->capacity);
+	assert(input->data);
+	input->size = 0;
+	input->eof = false;
+	input->binary = false;
+	return input;
+}
+
+// find the next line in 'input', reading more if need be, and point *line
+// at it. the line is not null-terminated, and doesn't include its newline
+// returns the line's length, or -1 at the end of the input
+int next_line(Input *input, char **line) {
+	while (true) {
+		char *start = input->data + input->pos;
+		size_t left = input->size - input->pos;
+		char *newline = memchr(start, '\n', left);
+		if (newline != NULL) {
+			input->pos += newline - start + 1;
+			*line = start;
+			return newline - start;
+		}
+		if (input->eof) {
+			// the last line may not have a newline
+			if (left == 0) {
+				return -1;
+			}
+			input->pos = input->size;
+			*line = start;
+			return left;
+		}
+
+		// move the partial line to the front of the buffer (growing it if
+		// the line fills it), then read more after it
+		memmove(input->data, start, left);
+		input->size = left;
+		input->pos = 0;
+		if (input->size == input->capacity) {
+			input->capacity *= 2;
+			input->data = realloc(input->data, input->capacity);
+			assert(input->data);
+		}
+		ssize_t n = read(input->fd, input->data + input->size,
+			input->capacity - input->size);
+		if (n <= 0) {
+			input->eof = true;
+		} else {
+			input->size += n;
+		}
+	}
+}
+
+// read the next command from 'input' into *operation and *key, as for
+// parse_command(), pointing *string at a string key (in 'buffer', of size
+// MAX_LINE_LEN, if it had to be copied out of a line of text)
+// returns the number of tokens read (0 to 2), or -1 (and no operation) at the
+// end of the input
+int next_command(Input *input, char *operation, int64 *key, char *buffer,
+		const char **string, int *length) {
+	*operation = '\0';
+	if (!input->binary) {
+		char *line;
+		int linelen = next_line(input, &line);
+		if (linelen < 0) {
+			return -1;
+		}
+		*string = buffer;
+		return parse_command(line, linelen, operation, key, buffer, length);
+	}
+
+	if (input->pos == input->size) {
+		return -1;
+	}
+	size_t n = read_command(input->data + input->pos, input->size - input->pos,
+		operation, key, string, length);
+	if (n == 0) {
+		fprintf(stderr, "command log is cut short after %zu bytes\n",
+			input->pos);
+		return -1;
+	}
+	input->pos += n;
+	return *operation == INSERT || *operation == LOOKUP ? 2 : 1;
+}
+
+// close 'input' and free all memory associated with it
+void close_input(Input *input) {
+	if (input->capacity == 0) {
+		munmap(input->data, input->size);
+	} else {
+		free(input->data);
+	}
+	if (input->fd != STDIN_FILENO) {
+		close(input->fd);
+	}
+	free(input);
+}
+
+
+// create an output buffer, writing to 'file' (or NULL to keep everything)
+Output *new_output(FILE *file) {
+	Output *output = malloc(sizeof *output);
+	assert(output);
+	output->capacity = OUTPUT_BUFFER_SIZE;
+	output->data = malloc(output->capacity);
+	assert(output->data);
+	output->size = 0;
+	output->file = file;
+	return output;
+}
+
+// free all memory associated with 'output' (without writing anything out)
+void free_output(Output *output) {
+	free(output->data);
+	free(output);
+}
+
+// write out everything waiting in 'output' (if it has a file)
+void output_flush(Output *output) {
+	if (output->file != NULL) {
+		fwrite(output->data, 1, output->size, output->file);
+		output->size = 0;
+	}
+}
+
+// add 'length' characters of 'text' to 'output'
+void output_text(Output *output, const char *text, int length) {
+	if (output->size + length > output->capacity) {
+		if (output->file != NULL) {
+			output_flush(output);
+			if (length > output->capacity) {
+				fwrite(text, 1, length, output->file);
 				return;
+			}
+		} else {
+			while (output->size + length > output->capacity) {
+				output->capacity *= 2;
+			}
+			output->data = realloc(output->data, output->capacity);
+			assert(output->data);
 		}
 	}
+	memcpy(output->data + output->size, text, length);
+	output->size += length;
 }
 
-// reads a line from stdin, parses it into an operation character and possibly
-// a long long uinteger argument. store results in *operation and *key, resp.
-//
-// returns the number of tokens successfully read (e.g. 0 for none,
-// 1 for operation only, 2 for both operation and integer)
-int get_command(char *operation, int64 *key) {
-	
-	// read a line from stdin, up to MAX_LINE_LENGTH, into character buffer
-	char line[MAX_LINE_LEN];
-	fgets(line, MAX_LINE_LEN, stdin);
-	line[strlen(line)-1] = '\0'; // strip trailing newline
-
-	// attempt to parse the line string into *operation and *key
-	int argc = sscanf(line, "%c %llu", operation, key);
-	// note: since llu is unsigned, a command like 'i -1' will overflow,
-	// resulting in *key = 18446744073709551615 (2^64-1). this is a feature.
-	
-	// return the number of variables successfully read, as required
-	return argc;
+// add 'key' to 'output', in decimal
+void output_key(Output *output, int64 key) {
+	char digits[20];	// 2^64-1 has 20 digits
+	int n = sizeof digits;
+	do {
+		digits[--n] = '0' + key % 10;
+		key /= 10;
+	} while (key > 0);
+	output_text(output, digits + n, sizeof digits - n);
 }
 
 
@@ -172,11 +1104,14 @@ int get_command(char *operation, int64 *key) {
 Options get_options(int argc, char** argv) {
 	
 	// create the Options structure with defaults
-	Options options = { .type = NOTYPE, .initial_size = DEFAULT_SIZE };
+	Options options = { .type = NOTYPE, .initial_size = DEFAULT_SIZE,
+		.index_path = NULL, .nshards = 0, .input_path = NULL, .quiet = false,
+		.pipelined = false, .socket_path = NULL, .port = -1,
+		.trace_path = NULL };
 
 	// use C's built-in getopt function to scan inputs by flag
 	char option;
-	while ((option = getopt(argc, argv, "t:s:")) != EOF){
+	while ((option = getopt(argc, argv, "t:s:d:n:f:qPS:T:e:")) != EOF){
 		switch (option){
 			case 't': // set hash table type
 				options.type = strtotype(optarg);
@@ -184,6 +1119,30 @@ Options get_options(int argc, char** argv) {
 			case 's': // set hash table size
 				options.initial_size = atoi(optarg);
 				break;
+			case 'd': // set disk-resident table location
+				options.index_path = optarg;
+				break;
+			case 'n': // set number of shards
+				options.nshards = atoi(optarg);
+				break;
+			case 'f': // set command file
+				options.input_path = optarg;
+				break;
+			case 'q': // print only summary counts
+				options.quiet = true;
+				break;
+			case 'P': // pipeline the interpreter
+				options.pipelined = true;
+				break;
+			case 'S': // serve clients on a Unix domain socket
+				options.socket_path = optarg;
+				break;
+			case 'T': // serve clients on a TCP port
+				options.port = atoi(optarg);
+				break;
+			case 'e': // trace resizes and splits to a file
+				options.trace_path = optarg;
+				break;
 			default:
 				break;
 		}
@@ -202,6 +1161,56 @@ Options get_options(int argc, char** argv) {
 		fprintf(stderr,
 			" -t 2 or xtnbdln: n-key extendible hash table (part 2)\n");
 		fprintf(stderr, " -t 3 or xuckoo:  extendible cuckoo table (part 3)\n");
+		fprintf(stderr,
+			" -t xtndbld: disk-resident extendible hash table (-d path)\n");
+		fprintf(stderr, " -t xtndblc: thread-safe n-key extendible hash table\n");
+		fprintf(stderr, " -t linhash: n-key linear hashing (Litwin) table\n");
+		fprintf(stderr, " -t xtndblz: n-key extendible table, compressed keys\n");
+		fprintf(stderr, " -t strlinear: linear hash table with string keys\n");
+		fprintf(stderr, " -t linearc: lock-free linear hash table\n");
+		fprintf(stderr,
+			"and optionally -n nshards to split it into locked shards\n");
+		fprintf(stderr, "-f file to read commands from 'file' instead of stdin,"
+			"\nand -q to print only counts of the results at the end\n");
+		fprintf(stderr, "(a file may be text, or a command log from "
+			"cmdgen -b or -c)\n");
+		fprintf(stderr, "and -P to read, run and write commands in separate "
+			"threads\n");
+		fprintf(stderr, "or -S path and/or -T port to serve clients on a Unix "
+			"socket or TCP port\n");
+		fprintf(stderr, "and -e file to trace resizes and splits to 'file' "
+			"(Chrome trace JSON)\n");
+		valid = false;
+	}
+
+	// only disk-resident tables can be opened from a path, and they must be
+	if (options.index_path != NULL && options.type != XTNDBLD) {
+		fprintf(stderr, "the -d flag is only valid with -t xtndbld\n");
+		valid = false;
+	} else if (options.index_path == NULL && options.type == XTNDBLD) {
+		fprintf(stderr, "please specify where to store the table using -d\n");
+		valid = false;
+	}
+
+	// validate shard count (disk-resident tables can't be sharded, as every
+	// shard would be created in the same place)
+	if (options.nshards < 0) {
+		fprintf(stderr, "please specify the number of shards (>0) using -n\n");
+		valid = false;
+	} else if (options.nshards > 0 && options.type == XTNDBLD) {
+		fprintf(stderr, "the -n flag is not valid with -t xtndbld\n");
+		valid = false;
+	}
+
+	// validate server options (the server reads commands from its clients)
+	bool serving = options.socket_path != NULL || options.port >= 0;
+	if (options.port > 65535 || (options.port < -1)) {
+		fprintf(stderr, "please specify a TCP port (0-65535) using -T\n");
+		valid = false;
+	} else if (serving && (options.input_path != NULL || options.pipelined
+			|| options.quiet)) {
+		fprintf(stderr,
+			"the -f, -P and -q flags are not valid with -S or -T\n");
 		valid = false;
 	}
 
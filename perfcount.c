@@ -0,0 +1,223 @@
+/* * * * * * * * *
+ * Module for counting hardware events (cache misses, branch misses,
+ * instructions...) around a stretch of code, using the kernel's perf events
+ *
+ * created for COMP20007 Design of Algorithms - Assignment 2, 2017
+ * by Luke Hedt
+ *
+ * Each event gets a counter of its own rather than joining a group, so that
+ * one event the cpu can't count (or the kernel won't allow) doesn't take the
+ * others down with it. When there are more counters than the hardware has
+ * registers the kernel takes turns between them, so each one also reports
+ * how long it was enabled and how long it actually ran, and its count is
+ * scaled up by the difference.
+ */
+
+#define _DEFAULT_SOURCE	// for syscall()
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <assert.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+
+#include "perfcount.h"
+
+struct perf_counters {
+	int fds[NUM_PERF_EVENTS];	// each event's counter, or -1 if unavailable
+	char error[256];			// why the first unavailable one is, or ""
+};
+
+// short names of each event, for column headings
+static const char *event_names[NUM_PERF_EVENTS] = {
+	[PERF_INSTRUCTIONS] = "instrs",
+	[PERF_CYCLES] = "cycles",
+	[PERF_L1D_MISSES] = "L1d-miss",
+	[PERF_LLC_MISSES] = "LLC-miss",
+	[PERF_DTLB_MISSES] = "dTLB-miss",
+	[PERF_BRANCH_MISSES] = "br-miss",
+};
+
+
+/* * * *
+ * helper functions
+ */
+
+#ifdef __linux__
+
+// set the perf type and config of 'attr' to count 'event'
+static void event_config(PerfEvent event, struct perf_event_attr *attr) {
+	// cache events are (cache | operation << 8 | result << 16)
+	uint64_t read_miss = PERF_COUNT_HW_CACHE_OP_READ << 8
+		| PERF_COUNT_HW_CACHE_RESULT_MISS << 16;
+	switch (event) {
+		case PERF_INSTRUCTIONS:
+			attr->type = PERF_TYPE_HARDWARE;
+			attr->config = PERF_COUNT_HW_INSTRUCTIONS;
+			break;
+		case PERF_CYCLES:
+			attr->type = PERF_TYPE_HARDWARE;
+			attr->config = PERF_COUNT_HW_CPU_CYCLES;
+			break;
+		case PERF_L1D_MISSES:
+			attr->type = PERF_TYPE_HW_CACHE;
+			attr->config = PERF_COUNT_HW_CACHE_L1D | read_miss;
+			break;
+		case PERF_LLC_MISSES:
+			attr->type = PERF_TYPE_HW_CACHE;
+			attr->config = PERF_COUNT_HW_CACHE_LL | read_miss;
+			break;
+		case PERF_DTLB_MISSES:
+			attr->type = PERF_TYPE_HW_CACHE;
+			attr->config = PERF_COUNT_HW_CACHE_DTLB | read_miss;
+			break;
+		default:
+			attr->type = PERF_TYPE_HARDWARE;
+			attr->config = PERF_COUNT_HW_BRANCH_MISSES;
+			break;
+	}
+}
+
+// open a disabled counter for 'event' on this thread, in user space only,
+// returning its file descriptor (or -1, leaving errno set)
+static int open_counter(PerfEvent event) {
+	struct perf_event_attr attr;
+	memset(&attr, 0, sizeof attr);
+	attr.size = sizeof attr;
+	event_config(event, &attr);
+	attr.disabled = 1;
+	attr.exclude_kernel = 1;	// (also what unprivileged users are allowed)
+	attr.exclude_hv = 1;
+	attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED
+		| PERF_FORMAT_TOTAL_TIME_RUNNING;
+	return syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+#else
+
+// there are no perf events here
+static int open_counter(PerfEvent event) {
+	(void)event;
+	errno = ENOSYS;
+	return -1;
+}
+
+#endif
+
+
+/* * * *
+ * all functions
+ */
+
+// open a counter for each event, for this thread, in user space only
+PerfCounters *new_perf_counters(void) {
+	PerfCounters *counters = malloc(sizeof *counters);
+	assert(counters);
+	counters->error[0] = '\0';
+
+	int event;
+	for (event = 0; event < NUM_PERF_EVENTS; event++) {
+		counters->fds[event] = open_counter(event);
+		if (counters->fds[event] < 0 && counters->error[0] == '\0') {
+			const char *hint = "";
+			if (errno == EACCES || errno == EPERM) {
+				hint = " (see /proc/sys/kernel/perf_event_paranoid)";
+			} else if (errno == ENOENT || errno == EOPNOTSUPP) {
+				hint = " (not on this cpu, or in this virtual machine)";
+			}
+			snprintf(counters->error, sizeof counters->error,
+				"can't count %s: %s%s", event_names[event], strerror(errno),
+				hint);
+		}
+	}
+
+	return counters;
+}
+
+
+// stop counting and free all memory associated with 'counters'
+void free_perf_counters(PerfCounters *counters) {
+	assert(counters);
+	int event;
+	for (event = 0; event < NUM_PERF_EVENTS; event++) {
+		if (counters->fds[event] >= 0) {
+			close(counters->fds[event]);
+		}
+	}
+	free(counters);
+}
+
+
+// can 'event' be counted?
+bool perf_counters_available(PerfCounters *counters, PerfEvent event) {
+	assert(counters && event >= 0 && event < NUM_PERF_EVENTS);
+	return counters->fds[event] >= 0;
+}
+
+
+// why an event can't be counted (from the first counter that couldn't be
+// opened), or NULL if every event can be
+const char *perf_counters_error(PerfCounters *counters) {
+	assert(counters);
+	return counters->error[0] ? counters->error : NULL;
+}
+
+
+// the short name of 'event', for column headings
+const char *perf_event_name(PerfEvent event) {
+	assert(event >= 0 && event < NUM_PERF_EVENTS);
+	return event_names[event];
+}
+
+
+// zero every counter, and start counting
+void perf_counters_start(PerfCounters *counters) {
+	assert(counters);
+#ifdef __linux__
+	int event;
+	for (event = 0; event < NUM_PERF_EVENTS; event++) {
+		int fd = counters->fds[event];
+		if (fd >= 0) {
+			ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+			ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+		}
+	}
+#endif
+}
+
+
+// stop counting, and store the count of each event since
+// perf_counters_start() in 'values' (scaled up if the kernel had to share
+// the hardware between counters, and 0 for unavailable events)
+void perf_counters_stop(PerfCounters *counters,
+		uint64_t values[NUM_PERF_EVENTS]) {
+	assert(counters && values);
+	int event;
+#ifdef __linux__
+	for (event = 0; event < NUM_PERF_EVENTS; event++) {
+		int fd = counters->fds[event];
+		if (fd >= 0) {
+			ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+		}
+	}
+#endif
+	for (event = 0; event < NUM_PERF_EVENTS; event++) {
+		// the count, how long the counter was enabled, and how long it ran
+		uint64_t reading[3] = {0, 0, 0};
+		int fd = counters->fds[event];
+		if (fd < 0 || read(fd, reading, sizeof reading) != sizeof reading) {
+			values[event] = 0;
+		} else if (reading[2] > 0 && reading[2] < reading[1]) {
+			values[event] = (double)reading[0] * reading[1] / reading[2];
+		} else {
+			values[event] = reading[0];
+		}
+	}
+}
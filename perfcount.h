@@ -0,0 +1,66 @@
+/* * * * * * * * *
+ * Module for counting hardware events (cache misses, branch misses,
+ * instructions...) around a stretch of code, using the kernel's perf events
+ *
+ * where the kernel won't count an event (or perf events aren't allowed at
+ * all, as in many containers), that counter is simply unavailable: it reads
+ * as zero, and perf_counters_error() says why
+ *
+ * usage:
+ *   PerfCounters *counters = new_perf_counters();
+ *   uint64_t values[NUM_PERF_EVENTS];
+ *   perf_counters_start(counters);
+ *   // the code to count
+ *   perf_counters_stop(counters, values);
+ *   ...
+ *   free_perf_counters(counters);
+ *
+ * created for COMP20007 Design of Algorithms - Assignment 2, 2017
+ * by Luke Hedt
+ */
+
+#ifndef PERFCOUNT_H
+#define PERFCOUNT_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// the events that are counted
+typedef enum perf_event {
+	PERF_INSTRUCTIONS,		// instructions retired
+	PERF_CYCLES,			// cpu cycles
+	PERF_L1D_MISSES,		// level 1 data cache read misses
+	PERF_LLC_MISSES,		// last level cache read misses
+	PERF_DTLB_MISSES,		// data TLB read misses
+	PERF_BRANCH_MISSES,		// mispredicted branches
+	NUM_PERF_EVENTS
+} PerfEvent;
+
+typedef struct perf_counters PerfCounters;
+
+// open a counter for each event, for this thread, in user space only
+PerfCounters *new_perf_counters(void);
+
+// stop counting and free all memory associated with 'counters'
+void free_perf_counters(PerfCounters *counters);
+
+// can 'event' be counted?
+bool perf_counters_available(PerfCounters *counters, PerfEvent event);
+
+// why an event can't be counted (from the first counter that couldn't be
+// opened), or NULL if every event can be
+const char *perf_counters_error(PerfCounters *counters);
+
+// the short name of 'event', for column headings
+const char *perf_event_name(PerfEvent event);
+
+// zero every counter, and start counting
+void perf_counters_start(PerfCounters *counters);
+
+// stop counting, and store the count of each event since
+// perf_counters_start() in 'values' (scaled up if the kernel had to share
+// the hardware between counters, and 0 for unavailable events)
+void perf_counters_stop(PerfCounters *counters,
+	uint64_t values[NUM_PERF_EVENTS]);
+
+#endif
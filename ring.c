@@ -0,0 +1,197 @@
+/* * * * * * * * *
+ * Module containing a bounded single-producer, single-consumer queue, for
+ * handing items from one thread to another without locks
+ *
+ * created for COMP20007 Design of Algorithms - Assignment 2, 2017
+ * by Luke Hedt
+ *
+ * The producer only ever writes 'tail' and the consumer only ever writes
+ * 'head', so pushing and popping need no locks: an item is copied in before
+ * 'tail' is advanced past it (a release store), and copied out before
+ * 'head' is. Each side keeps its own copy of the other side's counter, and
+ * only reloads it when the ring looks full (or empty), so the two threads
+ * don't keep stealing one cache line from each other.
+ *
+ * A thread that finds the ring full (or empty) yields a few times, then
+ * goes to sleep on a condition variable, rather than spinning while, for
+ * example, the producer waits for input. Whichever side changes the ring
+ * wakes it if 'sleepers' says anyone might be asleep.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <pthread.h>
+#include <sched.h>
+
+#include "ring.h"
+
+// how many times to yield to the other thread before going to sleep
+#define MAX_YIELDS 16
+
+struct ring {
+	// written by the producer
+	size_t tail __attribute__((aligned(64)));	// items ever pushed
+	size_t headcache;	// the producer's copy of 'head'
+
+	// written by the consumer
+	size_t head __attribute__((aligned(64)));	// items ever popped
+	size_t tailcache;	// the consumer's copy of 'tail'
+
+	// read-only after creation
+	char *items __attribute__((aligned(64)));
+	size_t capacity;	// how many items fit (a power of two)
+	int itemsize;		// size of each item in bytes
+
+	// for sleeping while the ring is full or empty
+	int sleepers;		// how many threads are (or are about to be) asleep
+	pthread_mutex_t lock;
+	pthread_cond_t changed;
+};
+
+
+/* * * *
+ * helper functions
+ */
+
+// wake any thread asleep waiting for 'ring' to change
+static void wake(Ring *ring) {
+	if (__atomic_load_n(&ring->sleepers, __ATOMIC_SEQ_CST) > 0) {
+		pthread_mutex_lock(&ring->lock);
+		pthread_cond_broadcast(&ring->changed);
+		pthread_mutex_unlock(&ring->lock);
+	}
+}
+
+// sleep until 'ring' is no longer full (if 'full') or empty (if not)
+static void wait_for_change(Ring *ring, bool full) {
+	pthread_mutex_lock(&ring->lock);
+	__atomic_add_fetch(&ring->sleepers, 1, __ATOMIC_SEQ_CST);
+	// check again now that the other side will see us, in case it changed
+	// the ring before that
+	size_t head = __atomic_load_n(&ring->head, __ATOMIC_SEQ_CST);
+	size_t tail = __atomic_load_n(&ring->tail, __ATOMIC_SEQ_CST);
+	if (full ? tail - head == ring->capacity : tail == head) {
+		pthread_cond_wait(&ring->changed, &ring->lock);
+	}
+	__atomic_sub_fetch(&ring->sleepers, 1, __ATOMIC_SEQ_CST);
+	pthread_mutex_unlock(&ring->lock);
+}
+
+
+/* * * *
+ * all functions
+ */
+
+// create a ring with room for 'capacity' (rounded up to a power of two)
+// items, each 'itemsize' bytes
+Ring *new_ring(int capacity, int itemsize) {
+	assert(capacity > 0 && itemsize > 0);
+	Ring *ring;
+	int err = posix_memalign((void **)&ring, 64, sizeof *ring);
+	assert(err == 0);
+
+	ring->capacity = 1;
+	while (ring->capacity < capacity) {
+		ring->capacity *= 2;
+	}
+	ring->itemsize = itemsize;
+	ring->items = malloc(ring->capacity * itemsize);
+	assert(ring->items);
+
+	ring->head = ring->headcache = 0;
+	ring->tail = ring->tailcache = 0;
+	ring->sleepers = 0;
+	pthread_mutex_init(&ring->lock, NULL);
+	pthread_cond_init(&ring->changed, NULL);
+	return ring;
+}
+
+
+// free all memory associated with 'ring'
+void free_ring(Ring *ring) {
+	assert(ring != NULL);
+	pthread_cond_destroy(&ring->changed);
+	pthread_mutex_destroy(&ring->lock);
+	free(ring->items);
+	free(ring);
+}
+
+
+// copy 'item' into 'ring', if there's room
+// returns true if it was added, false if the ring was full
+bool ring_try_push(Ring *ring, const void *item) {
+	size_t tail = ring->tail;
+	if (tail - ring->headcache == ring->capacity) {
+		ring->headcache = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+		if (tail - ring->headcache == ring->capacity) {
+			return false;
+		}
+	}
+
+	memcpy(ring->items + (tail & (ring->capacity - 1)) * ring->itemsize, item,
+		ring->itemsize);
+	// (sequentially consistent, so that either we see a sleeping consumer,
+	// or it sees this item before it sleeps)
+	__atomic_store_n(&ring->tail, tail + 1, __ATOMIC_SEQ_CST);
+	wake(ring);
+	return true;
+}
+
+
+// copy the oldest item in 'ring' out into 'item', and remove it
+// returns true if there was one, false if the ring was empty
+bool ring_try_pop(Ring *ring, void *item) {
+	size_t head = ring->head;
+	if (head == ring->tailcache) {
+		ring->tailcache = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+		if (head == ring->tailcache) {
+			return false;
+		}
+	}
+
+	memcpy(item, ring->items + (head & (ring->capacity - 1)) * ring->itemsize,
+		ring->itemsize);
+	__atomic_store_n(&ring->head, head + 1, __ATOMIC_SEQ_CST);
+	wake(ring);
+	return true;
+}
+
+
+// copy 'item' into 'ring', waiting until there's room
+void ring_push(Ring *ring, const void *item) {
+	int yields = 0;
+	while (!ring_try_push(ring, item)) {
+		if (yields++ < MAX_YIELDS) {
+			sched_yield();
+		} else {
+			wait_for_change(ring, true);
+		}
+	}
+}
+
+
+// copy the oldest item in 'ring' out into 'item', and remove it, waiting
+// until there is one
+void ring_pop(Ring *ring, void *item) {
+	int yields = 0;
+	while (!ring_try_pop(ring, item)) {
+		if (yields++ < MAX_YIELDS) {
+			sched_yield();
+		} else {
+			wait_for_change(ring, false);
+		}
+	}
+}
+
+
+// is 'ring' empty? (only meaningful to the consuming thread)
+bool ring_is_empty(Ring *ring) {
+	if (ring->head != ring->tailcache) {
+		return false;
+	}
+	ring->tailcache = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+	return ring->head == ring->tailcache;
+}
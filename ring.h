@@ -0,0 +1,48 @@
+/* * * * * * * * *
+ * Module containing a bounded single-producer, single-consumer queue, for
+ * handing items from one thread to another without locks
+ *
+ * usage:
+ *   Ring *ring = new_ring(capacity, sizeof (Item));
+ *   ring_push(ring, &item);	// in the one producing thread
+ *   ring_pop(ring, &item);		// in the one consuming thread
+ *   free_ring(ring);
+ *
+ * created for COMP20007 Design of Algorithms - Assignment 2, 2017
+ * by Luke Hedt
+ */
+
+#ifndef RING_H
+#define RING_H
+
+#include <stdbool.h>
+
+typedef struct ring Ring;
+
+// create a ring with room for 'capacity' (rounded up to a power of two)
+// items, each 'itemsize' bytes
+Ring *new_ring(int capacity, int itemsize);
+
+// free all memory associated with 'ring'
+void free_ring(Ring *ring);
+
+// copy 'item' into 'ring', if there's room
+// returns true if it was added, false if the ring was full
+bool ring_try_push(Ring *ring, const void *item);
+
+// copy the oldest item in 'ring' out into 'item', and remove it
+// returns true if there was one, false if the ring was empty
+bool ring_try_pop(Ring *ring, void *item);
+
+// copy 'item' into 'ring', waiting until there's room
+void ring_push(Ring *ring, const void *item);
+
+// copy the oldest item in 'ring' out into 'item', and remove it, waiting
+// until there is one
+void ring_pop(Ring *ring, void *item);
+
+// is 'ring' empty? (only meaningful to the consuming thread: the producer
+// may add an item at any moment)
+bool ring_is_empty(Ring *ring);
+
+#endif
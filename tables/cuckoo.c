@@ -14,9 +14,9 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <assert.h>
-#include <time.h>
 
 #include "cuckoo.h"
+#include "../instrument.h"
 
 /* Removing the Magic Numbers */
 #define DOUBSIZE 2
@@ -25,17 +25,20 @@
 
 /* Holds stats and info for stat calculations  */
 typedef struct stats {
-    int time;       // Keeps a track of the time taken to run the commands.
+    OpTimer timer;  // Keeps a track of the time taken to run the commands.
+    EventTimer rehashes; // Times each rehash into bigger tables.
     int collisions; // Keeps a track of how many keys collide on their first
                     // insert.
     int probes;     // Keeps a track of the total number of kicked items
+    MemUsage memory; // Counts the memory allocated for the tables.
 } Stats;
 
 // an inner table represents one of the two internal tables for a cuckoo
 // hash table. it stores two parallel arrays: 'slots' for storing keys and
 // 'inuse' for marking which entries are occupied
+// in a hash map, each slot holds a key followed by its value
 typedef struct inner_table {
-	int64 *slots;	// array of slots holding keys
+	int64 *slots;	// array of slots holding keys (and values, in a map)
 	bool  *inuse;	// is this slot in use or not?
     int filled;     // Keeps a count of the number of filled slots.
 } InnerTable;
@@ -45,9 +48,15 @@ struct cuckoo_table {
 	InnerTable *table1; // first table
 	InnerTable *table2; // second table
 	int size;			// size of each table
+	int width;			// int64s per slot: 1 in a set, 2 (key, value) in a map
     Stats stat;         // holds stats for the stats function.
 };
 
+/* The slot at 'h' in inner table 'inner' of 'table': its key, then its value
+ * (maps only) */
+#define entry_at(table, inner, h) \
+    (&(inner)->slots[(size_t)(h) * (table)->width])
+
 
  /*
   * Helper Functions - Based on supplied code in linear.c
@@ -55,15 +64,17 @@ struct cuckoo_table {
   *	Set up the internals of an inner table struct with new
   * arrays of size 'size'
   */
- static void initialise_inner_table(InnerTable *i_table, int size) {
+ static void initialise_inner_table(InnerTable *i_table, int size,
+        int width, MemUsage *memory) {
 	/* Each single table can't be bigger than the max table size */
 	assert(size < MAX_TABLE_SIZE && "error: table has grown too large!");
 
     /* Create slots table */
-	i_table->slots = malloc((sizeof(*i_table->slots)) * size);
+	i_table->slots = mem_alloc(memory,
+        (sizeof(*i_table->slots)) * width * size);
  	assert(i_table->slots);
     /* Creates an inuse table */
- 	i_table->inuse = malloc((sizeof(*i_table->inuse)) * size);
+ 	i_table->inuse = mem_alloc(memory, (sizeof(*i_table->inuse)) * size);
  	assert(i_table->inuse);
 
     /* Set up the inuse table, marking all elements as false */
@@ -80,33 +91,48 @@ struct cuckoo_table {
   */
  static void initialise_cuck_table(CuckooHashTable *o_table, int size) {
 
-	InnerTable *inner1 = malloc(sizeof(*inner1));
+	InnerTable *inner1 = mem_alloc(&o_table->stat.memory, sizeof(*inner1));
 	assert(inner1);
 
- 	initialise_inner_table(inner1, size);
+ 	initialise_inner_table(inner1, size, o_table->width,
+        &o_table->stat.memory);
 
 	o_table->table1 = inner1;
 
-	InnerTable *inner2 = malloc(sizeof(*inner2));
+	InnerTable *inner2 = mem_alloc(&o_table->stat.memory, sizeof(*inner2));
 	assert(inner2);
 
- 	initialise_inner_table(inner2, size);
+ 	initialise_inner_table(inner2, size, o_table->width,
+        &o_table->stat.memory);
 	o_table->table2 = inner2;
 
  	o_table->size = size;
-    o_table->stat.time = 0;
  }
 
-/* Frees an inner table */
-static void free_inner(InnerTable *i_table) {
+/* Frees an inner table of 'o_table', with 'size' slots */
+static void free_inner(CuckooHashTable *o_table, InnerTable *i_table,
+        int size) {
     assert(i_table != NULL);
+    MemUsage *memory = &o_table->stat.memory;
 
     /*  Free the Innards    */
-    free(i_table->slots);
-    free(i_table->inuse);
+    mem_free(memory, i_table->slots,
+        (sizeof(*i_table->slots)) * o_table->width * size);
+    mem_free(memory, i_table->inuse, (sizeof(*i_table->inuse)) * size);
 
     /* Free the Table */
-    free(i_table);
+    mem_free(memory, i_table, sizeof(*i_table));
+}
+
+static void insert_entry(CuckooHashTable *table, int64 key, int64 value);
+
+/* The bytes allocated for empty slots in either table */
+static int64 wasted_bytes(CuckooHashTable *table) {
+    InnerTable *inner = table->table1;
+    int empty = 2 * table->size - table->table1->filled
+        - table->table2->filled;
+    return (int64)empty
+        * ((sizeof *inner->slots) * table->width + sizeof *inner->inuse);
 }
 
 /* Rehashes the given cuckoo table. Based on code in linear.c */
@@ -121,74 +147,63 @@ static void rehash_table(CuckooHashTable *o_table) {
 	InnerTable *old_in2 = o_table->table2;
 
     int old_size = o_table->size;
+    TimerStart start = event_start();
 
     /* Double the size of the hash table  */
     initialise_cuck_table(o_table, old_size * DOUBSIZE);
 
     /* Insert items from the smaller tables */
+    /* (along with their values, in a map) */
     int i;
     for(i=0; i<old_size; i++) {
         if(old_in1->inuse[i] == true) {
-            cuckoo_hash_table_insert(o_table, old_in1->slots[i]);
+            int64 *entry = entry_at(o_table, old_in1, i);
+            insert_entry(o_table, entry[0], o_table->width == 2 ? entry[1] : 0);
         }
         if(old_in2->inuse[i] == true) {
-            cuckoo_hash_table_insert(o_table, old_in2->slots[i]);
+            int64 *entry = entry_at(o_table, old_in2, i);
+            insert_entry(o_table, entry[0], o_table->width == 2 ? entry[1] : 0);
         }
     }
 
-    free_inner(old_in1);
-    free_inner(old_in2);
+    free_inner(o_table, old_in1, old_size);
+    free_inner(o_table, old_in2, old_size);
+    event_stop_traced(&o_table->stat.rehashes, start, "cuckoo: rehash table",
+        old_size, o_table->size);
 }
 
 
-/* Real Functions */
-
-// initialise a cuckoo hash table with 'size' slots in each table
-CuckooHashTable *new_cuckoo_hash_table(int size) {
-
-	CuckooHashTable *o_table = malloc(sizeof *o_table);
-	assert(o_table);
-
-	// set up the internals of the table struct with arrays of size 'size'
-	initialise_cuck_table(o_table, size);
-    o_table->stat.collisions = 0;
-    o_table->stat.probes = 0;
-
-	return o_table;
-}
-
+/* Finds the slot holding 'key' in 'table', returning NULL if it's not there */
+static int64 *find_entry(CuckooHashTable *table, int64 key) {
+    /* Make for easy referencing */
+    int hash1 = h1(key) % table->size;
+    int hash2 = h2(key) % table->size;
 
-// free all memory associated with 'table'
-void free_cuckoo_hash_table(CuckooHashTable *table) {
-    assert(table != NULL);
+    /* Check the data's not garbage before checking if your key is there. */
+    int64 *entry = entry_at(table, table->table1, hash1);
+    if((table->table1->inuse[hash1] == true) && (entry[0]==key)) {
+        return entry;
+    }
 
-    /* Free the inner tables, then free the main table */
-    free_inner(table->table1);
-    free_inner(table->table2);
+    entry = entry_at(table, table->table2, hash2);
+    if((table->table2->inuse[hash2] == true) && (entry[0]==key)) {
+        return entry;
+    }
 
-    free(table);
+    /* If it hasn't been found it's not in here. */
+    return NULL;
 }
 
-
-// insert 'key' into 'table', if it's not in there already
-// returns true if insertion succeeds, false if it was already in there
-bool cuckoo_hash_table_insert(CuckooHashTable *table, int64 key) {
-    /* Don't operate on a non-existent table */
-    assert(table);
-    int start_time = clock(); // start timing
-
-    /* Don't try to rehash the same item! */
-    if(cuckoo_hash_table_lookup(table, key)) {
-        return false;
-    }
-
+/* Cuckoo inserts 'key' (and 'value', in a map), which must not already be in
+ * 'table', kicking out keys (and their values) until one finds a free slot */
+static void insert_entry(CuckooHashTable *table, int64 key, int64 value) {
     /* Only define the variables you need after you know you need them */
     int chainlen = 0;
     bool flg_insrt = true;
     bool flg_first = true;
     int hashnum = 1;
     int hash;
-    int64 oldkey = -1;
+    int64 oldkey = -1, oldvalue = 0;
     InnerTable *cur_table;
 
     /* Repeat for as long as there are cucks to kick */
@@ -209,6 +224,7 @@ bool cuckoo_hash_table_insert(CuckooHashTable *table, int64 key) {
             hash = h2(key) % table->size;
             cur_table = table->table2;
         }
+        int64 *entry = entry_at(table, cur_table, hash);
 
         /* Check for cucks, breaks the loop if there are none */
         if(cur_table->inuse[hash]) {
@@ -216,7 +232,10 @@ bool cuckoo_hash_table_insert(CuckooHashTable *table, int64 key) {
                 table->stat.collisions += 1;
                 flg_first = false;
             }
-            oldkey = cur_table->slots[hash];
+            oldkey = entry[0];
+            if(table->width == 2) {
+                oldvalue = entry[1];
+            }
             chainlen += 1;
             cur_table->filled -= 1;
             table->stat.probes += 1;
@@ -226,13 +245,81 @@ bool cuckoo_hash_table_insert(CuckooHashTable *table, int64 key) {
 
         /* Insert the key and set up the cucked key if necessary. */
         cur_table->inuse[hash] = true;
-        cur_table->slots[hash] = key;
+        entry[0] = key;
+        if(table->width == 2) {
+            entry[1] = value;
+        }
         cur_table->filled += 1;
         key = oldkey;
+        value = oldvalue;
+    }
+}
+
+
+/* Real Functions */
+
+/* Creates a cuckoo table with 'size' slots of 'width' int64s in each table */
+static CuckooHashTable *new_cuck_table(int size, int width) {
+
+	CuckooHashTable *o_table = malloc(sizeof *o_table);
+	assert(o_table);
+    mem_usage_init(&o_table->stat.memory, sizeof *o_table);
+
+	// set up the internals of the table struct with arrays of size 'size'
+    o_table->width = width;
+	initialise_cuck_table(o_table, size);
+    o_table->stat.collisions = 0;
+    o_table->stat.probes = 0;
+    timer_init(&o_table->stat.timer);
+    event_init(&o_table->stat.rehashes);
+
+	return o_table;
+}
+
+// initialise a cuckoo hash table with 'size' slots in each table
+CuckooHashTable *new_cuckoo_hash_table(int size) {
+	return new_cuck_table(size, 1);
+}
+
+
+// initialise a cuckoo hash map, storing a value with each key, with 'size'
+// slots in each table
+CuckooHashTable *new_cuckoo_hash_map(int size) {
+	return new_cuck_table(size, 2);
+}
+
+
+// free all memory associated with 'table'
+void free_cuckoo_hash_table(CuckooHashTable *table) {
+    assert(table != NULL);
+
+    /* Free the inner tables, then free the main table */
+    free_inner(table, table->table1, table->size);
+    free_inner(table, table->table2, table->size);
+
+    free(table);
+}
+
+
+// insert 'key' into 'table', if it's not in there already
+// returns true if insertion succeeds, false if it was already in there
+bool cuckoo_hash_table_insert(CuckooHashTable *table, int64 key) {
+    /* Don't operate on a non-existent table */
+    assert(table);
+	TimerStart start = timer_start(&table->stat.timer);
+
+    /* Don't try to rehash the same item! */
+    if(find_entry(table, key)) {
+        timer_stop(&table->stat.timer, start, OP_INSERT_HIT);
+        return false;
     }
+
+    /* Cuckoo insert the key, rehashing if necessary */
+    insert_entry(table, key, 0);
+
     /* Success! */
-    // add time elapsed to total CPU time before returning
-	table->stat.time += clock() - start_time;
+    // stop timing before returning
+	timer_stop(&table->stat.timer, start, OP_INSERT_NEW);
     return true;
 }
 
@@ -240,29 +327,69 @@ bool cuckoo_hash_table_insert(CuckooHashTable *table, int64 key) {
 // returns true if found, false if not
 bool cuckoo_hash_table_lookup(CuckooHashTable *table, int64 key) {
     assert(table);
-    int start_time = clock(); // start timing
+	TimerStart start = timer_start(&table->stat.timer);
 
-    /* Make for easy referencing */
-    int hash1 = h1(key) % table->size;
-    int hash2 = h2(key) % table->size;
+    bool found = find_entry(table, key) != NULL;
 
-    /* Check the data's not garbage before checking if your key is there. */
-    if((table->table1->inuse[hash1] == true) && (table->table1->slots[hash1]==key)) {
-        // add time elapsed to total CPU time before returning
-    	table->stat.time += clock() - start_time;
-        return true;
+    // stop timing before returning
+	timer_stop(&table->stat.timer, start,
+        found ? OP_LOOKUP_HIT : OP_LOOKUP_MISS);
+    return found;
+}
+
+
+// insert 'key' into map 'table' with value 'value', or if 'key' is already in
+// there, replace its value with 'value'
+// returns true if 'key' was inserted, false if it was already in there
+bool cuckoo_hash_table_put(CuckooHashTable *table, int64 key, int64 value) {
+    assert(table && table->width == 2);
+	TimerStart start = timer_start(&table->stat.timer);
+
+    /* Overwrite the value of a key that's already here, or insert it */
+    int64 *entry = find_entry(table, key);
+    if(entry) {
+        entry[1] = value;
+    } else {
+        insert_entry(table, key, value);
+    }
+
+	timer_stop(&table->stat.timer, start,
+        entry ? OP_INSERT_HIT : OP_INSERT_NEW);
+    return entry == NULL;
+}
+
+
+// lookup 'key' in map 'table', and if it's there store its value in '*value'
+// returns true if found, false if not
+bool cuckoo_hash_table_get(CuckooHashTable *table, int64 key, int64 *value) {
+    assert(table && table->width == 2);
+	TimerStart start = timer_start(&table->stat.timer);
+
+    int64 *entry = find_entry(table, key);
+    if(entry) {
+        *value = entry[1];
     }
 
-    if((table->table2->inuse[hash2] == true) && (table->table2->slots[hash2]==key)) {
-        // add time elapsed to total CPU time before returning
-    	table->stat.time += clock() - start_time;
-        return true;
+	timer_stop(&table->stat.timer, start,
+        entry ? OP_LOOKUP_HIT : OP_LOOKUP_MISS);
+    return entry != NULL;
+}
+
+
+// replace the value of 'key' in map 'table' with 'value', if 'key' is in there
+// returns true if found (and updated), false if not
+bool cuckoo_hash_table_update(CuckooHashTable *table, int64 key, int64 value) {
+    assert(table && table->width == 2);
+	TimerStart start = timer_start(&table->stat.timer);
+
+    int64 *entry = find_entry(table, key);
+    if(entry) {
+        entry[1] = value;
     }
 
-    /* If it hasn't been found it's not in here. */
-    // add time elapsed to total CPU time before returning
-	table->stat.time += clock() - start_time;
-    return false;
+	timer_stop(&table->stat.timer, start,
+        entry ? OP_LOOKUP_HIT : OP_LOOKUP_MISS);
+    return entry != NULL;
 }
 
 
@@ -281,7 +408,7 @@ void cuckoo_hash_table_print(CuckooHashTable *table) {
 
 		// table 1 key
 		if (table->table1->inuse[i]) {
-			printf(" %20llu ", table->table1->slots[i]);
+			printf(" %20llu ", *entry_at(table, table->table1, i));
 		} else {
 			printf(" %20s ", "-");
 		}
@@ -291,7 +418,7 @@ void cuckoo_hash_table_print(CuckooHashTable *table) {
 
 		// table 2 key
 		if (table->table2->inuse[i]) {
-			printf(" %llu\n", table->table2->slots[i]);
+			printf(" %llu\n", *entry_at(table, table->table2, i));
 		} else {
 			printf(" %s\n",  "-");
 		}
@@ -311,18 +438,37 @@ void cuckoo_hash_table_stats(CuckooHashTable *table) {
 	printf("Current size: %d slots\n", table->size);
 	printf("Filled slots: %d slots\n",
             table->table1->filled + table->table2->filled);
-	printf("Load Percentage in t1: %.2f% \n", table->table1->filled
+	printf("Load Percentage in t1: %.2f%%\n", table->table1->filled
                 / (float)table->size * 100);
-	printf("Load Percentage in t2: %.2f% \n", table->table2->filled
+	printf("Load Percentage in t2: %.2f%%\n", table->table2->filled
                 / (float)table->size * 100);
 
     printf("Number of collisions: %d \n", table->stat.collisions);
-    printf("Averge probe length: %.2f \n",
-                    (float)table->stat.probes/table->stat.collisions);
+    printf("Averge probe length: %.2f \n", table->stat.collisions
+                    ? (float)table->stat.probes/table->stat.collisions : 0);
 
 	// also calculate CPU usage in seconds and print this
-	float seconds = table->stat.time * 1.0 / CLOCKS_PER_SEC;
-	printf("CPU time spent: %.6f sec\n", seconds);
+	float seconds = timer_seconds(&table->stat.timer);
+	printf("Time spent: %.6f sec\n", seconds);
+	timer_print(&table->stat.timer);
+	event_print(&table->stat.rehashes, "rehashes");
+	mem_usage_print(&table->stat.memory,
+		table->table1->filled + table->table2->filled, wasted_bytes(table));
 
 	printf("--- end stats ---\n");
 }
+
+
+// fill in 'stats' with the statistics every type of table reports
+void cuckoo_hash_table_get_stats(CuckooHashTable *table, TableStats *stats) {
+	assert(table != NULL && stats != NULL);
+	stats->size = 2 * table->size;
+	stats->nkeys = table->table1->filled + table->table2->filled;
+	stats->capacity = 2 * table->size;
+	table_stats_add_memory(stats, &table->stat.memory);
+	stats->wastedbytes = wasted_bytes(table);
+	stats->collisions = table->stat.collisions;
+	stats->probes = table->stat.probes;
+	table_stats_add_timer(stats, &table->stat.timer);
+	table_stats_add_growths(stats, &table->stat.rehashes);
+}
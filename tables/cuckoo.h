@@ -11,12 +11,17 @@
 
 #include <stdbool.h>
 #include "../inthash.h"
+#include "../tblstats.h"
 
 typedef struct cuckoo_table CuckooHashTable;
 
 // initialise a cuckoo hash table with 'size' slots in each table
 CuckooHashTable *new_cuckoo_hash_table(int size);
 
+// initialise a cuckoo hash map, storing a value with each key, with
+// 'size' slots in each table
+CuckooHashTable *new_cuckoo_hash_map(int size);
+
 // free all memory associated with 'table'
 void free_cuckoo_hash_table(CuckooHashTable *table);
 
@@ -28,10 +33,27 @@ bool cuckoo_hash_table_insert(CuckooHashTable *table, int64 key);
 // returns true if found, false if not
 bool cuckoo_hash_table_lookup(CuckooHashTable *table, int64 key);
 
+// insert 'key' into map 'table' with value 'value', or if 'key' is already in
+// there, replace its value with 'value'
+// returns true if 'key' was inserted, false if it was already in there
+bool cuckoo_hash_table_put(CuckooHashTable *table, int64 key, int64 value);
+
+// lookup 'key' in map 'table', and if it's there store its value in '*value'
+// returns true if found, false if not
+bool cuckoo_hash_table_get(CuckooHashTable *table, int64 key, int64 *value);
+
+// replace the value of 'key' in map 'table' with 'value', if 'key' is in there
+// returns true if found (and updated), false if not
+bool cuckoo_hash_table_update(CuckooHashTable *table, int64 key, int64 value);
+
 // print the contents of 'table' to stdout
 void cuckoo_hash_table_print(CuckooHashTable *table);
 
 // print some statistics about 'table' to stdout
 void cuckoo_hash_table_stats(CuckooHashTable *table);
 
+// fill in 'stats' with the statistics every type of table reports (see
+// tblstats.h)
+void cuckoo_hash_table_get_stats(CuckooHashTable *table, TableStats *stats);
+
 #endif
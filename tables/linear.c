@@ -8,9 +8,9 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <assert.h>
-#include <time.h>
 
 #include "linear.h"
+#include "../instrument.h"
 
 // how many cells to advance at a time while looking for a free slot
 #define STEP_SIZE 1
@@ -18,35 +18,49 @@
 typedef struct stats {
     int collisions; // Holds the number of first-time collisions
     int probe;      // Holds the number of probes for probelen calcs
-    int ins_time;   // Holds the total time it took to insert all the items
-    int look_time;  // Holds the total time taken to lookup all the called items
+    OpTimer inserts; // Times all of the insertions
+    OpTimer lookups; // Times all of the lookups
+    EventTimer resizes; // Times each doubling of the table
+    EventTimer builds;  // Times building the table from an array of keys
+    MemUsage memory;    // Counts the memory allocated for the table
 } Stats;
 
 // a hash table is an array of slots holding keys, along with a parallel array
 // of boolean markers recording which slots are in use (true) or free (false)
 // important because not-in-use slots might hold garbage data, as they may
 // not have been initialised
+// in a hash map, each slot holds a key followed by its value, so that finding
+// the key also brings its value into the cache
 struct linear_table {
-	int64 *slots;	// array of slots holding keys
+	int64 *slots;	// array of slots holding keys (and values, in a map)
 	bool  *inuse;	// is this slot in use or not?
 	int size;		// the size of both of these arrays right now
 	int load;		// number of keys in the table right now
+	int width;		// int64s per slot: 1 in a set, 2 (key, value) in a map
     Stats stat;
 };
 
+// the key in slot 'h' of 'table', and the value following it (maps only)
+#define key_at(table, h) (table)->slots[(size_t)(h) * (table)->width]
+#define value_at(table, h) (table)->slots[(size_t)(h) * (table)->width + 1]
+
 
 /* * * *
  * helper functions
  */
 
+static int insert_key(LinearHashTable *table, int64 key, bool *inserted);
+
 // set up the internals of a linear hash table struct with new
 // arrays of size 'size'
 static void initialise_table(LinearHashTable *table, int size) {
 	assert(size < MAX_TABLE_SIZE && "error: table has grown too large!");
 
-	table->slots = malloc((sizeof *table->slots) * size);
+	table->slots = mem_alloc(&table->stat.memory,
+		(sizeof *table->slots) * table->width * size);
 	assert(table->slots);
-	table->inuse = malloc((sizeof *table->inuse) * size);
+	table->inuse = mem_alloc(&table->stat.memory,
+		(sizeof *table->inuse) * size);
 	assert(table->inuse);
 	int i;
 	for (i = 0; i < size; i++) {
@@ -57,67 +71,79 @@ static void initialise_table(LinearHashTable *table, int size) {
 	table->load = 0;
     table->stat.collisions = 0;
     table->stat.probe = 0;
-    table->stat.ins_time = 0;
-    table->stat.look_time = 0;
+}
+
+// start timing a new table's operations from scratch (unlike the other
+// stats, these carry on through doublings)
+static void initialise_timers(LinearHashTable *table) {
+    timer_init(&table->stat.inserts);
+    timer_init(&table->stat.lookups);
+    event_init(&table->stat.resizes);
+    event_init(&table->stat.builds);
 }
 
 
 // double the size of the internal table arrays and re-hash all
 // keys in the old tables
 static void double_table(LinearHashTable *table) {
+	TimerStart start = event_start();
 	int64 *oldslots = table->slots;
-	bool  *oldinuse = table->inuse;
+	bool *oldinuse = table->inuse;
 	int oldsize = table->size;
 
 	initialise_table(table, table->size * 2);
 
+	bool inserted;
 	int i;
 	for (i = 0; i < oldsize; i++) {
 		if (oldinuse[i] == true) {
-			linear_hash_table_insert(table, oldslots[i]);
+			int64 *old = &oldslots[(size_t)i * table->width];
+			int h = insert_key(table, old[0], &inserted);
+			if (table->width == 2) {
+				value_at(table, h) = old[1];
+			}
 		}
 	}
 
-	free(oldslots);
-	free(oldinuse);
+	mem_free(&table->stat.memory, oldslots,
+		(sizeof *oldslots) * table->width * oldsize);
+	mem_free(&table->stat.memory, oldinuse, (sizeof *oldinuse) * oldsize);
+	event_stop_traced(&table->stat.resizes, start, "linear: double table",
+		oldsize, table->size);
 }
 
+// find the slot holding 'key' in 'table', or return -1 if it's not in there
+static int find_key(LinearHashTable *table, int64 key) {
+	// need to count our steps to make sure we recognise when the table is full
+	int steps = 0;
 
-/* * * *
- * all functions
- */
-
-// initialise a linear probing hash table with initial size 'size'
-LinearHashTable *new_linear_hash_table(int size) {
-	LinearHashTable *table = malloc(sizeof *table);
-	assert(table);
-
-	// set up the internals of the table struct with arrays of size 'size'
-	initialise_table(table, size);
-
-	return table;
-}
+	// calculate the initial address for this key
+	int h = h1(key) % table->size;
 
+	// step along until we find a free space (inuse[]==false), or until we
+	// visit every cell
+	while (table->inuse[h] && steps < table->size) {
 
-// free all memory associated with 'table'
-void free_linear_hash_table(LinearHashTable *table) {
-	assert(table != NULL);
+		if (key_at(table, h) == key) {
+			// found the key!
+			return h;
+		}
 
-	// free the table's arrays
-	free(table->slots);
-	free(table->inuse);
+		// keep stepping
+		h = (h + STEP_SIZE) % table->size;
+		steps++;
+	}
 
-	// free the table struct itself
-	free(table);
+	// we have either searched the whole table or come back to where we started
+	// either way, the key is not in the hash table
+	return -1;
 }
 
-
-// insert 'key' into 'table', if it's not in there already
-// returns true if insertion succeeds, false if it was already in there
-bool linear_hash_table_insert(LinearHashTable *table, int64 key) {
-	assert(table != NULL);
+// insert 'key' into 'table', if it's not in there already, and return the
+// slot holding it (doubling the table first if it is full)
+// sets '*inserted' to true if it was inserted, false if it was already there
+static int insert_key(LinearHashTable *table, int64 key, bool *inserted) {
     bool flg_first = true;
-    int start_time = clock(); // start timing
 
 	// need to count our steps to make sure we recognise when the table is full
 	int steps = 0;
@@ -128,9 +154,10 @@ bool linear_hash_table_insert(LinearHashTable *table, int64 key) {
 	// step along the array until we find a free space (inuse[]==false),
 	// or until we visit every cell
 	while (table->inuse[h] && steps < table->size) {
-		if (table->slots[h] == key) {
+		if (key_at(table, h) == key) {
 			// this key already exists in the table! no need to insert
-			return false;
+			*inserted = false;
+			return h;
 		}
 
 		// else, keep stepping through the table looking for a free slot
@@ -149,17 +176,115 @@ bool linear_hash_table_insert(LinearHashTable *table, int64 key) {
 	if (steps == table->size) {
 		// let's make some more space and then try to insert this key again!
 		double_table(table);
-	    table->stat.ins_time += clock() - start_time;
-		return linear_hash_table_insert(table, key);
-
-	} else {
-		// otherwise, we have found a free slot! insert this key right here
-		table->slots[h] = key;
-		table->inuse[h] = true;
-		table->load++;
-	    table->stat.ins_time += clock() - start_time;
-		return true;
+		return insert_key(table, key, inserted);
 	}
+
+	// otherwise, we have found a free slot! insert this key right here
+	key_at(table, h) = key;
+	table->inuse[h] = true;
+	table->load++;
+	*inserted = true;
+	return h;
+}
+
+
+// the bytes allocated for empty slots in 'table'
+static int64 wasted_bytes(LinearHashTable *table) {
+	return (int64)(table->size - table->load)
+		* ((sizeof *table->slots) * table->width + sizeof *table->inuse);
+}
+
+
+/* * * *
+ * all functions
+ */
+
+// initialise a linear probing hash table with initial size 'size'
+LinearHashTable *new_linear_hash_table(int size) {
+	LinearHashTable *table = malloc(sizeof *table);
+	assert(table);
+	mem_usage_init(&table->stat.memory, sizeof *table);
+
+	// set up the internals of the table struct with arrays of size 'size'
+	table->width = 1;
+	initialise_table(table, size);
+	initialise_timers(table);
+
+	return table;
+}
+
+
+// initialise a linear probing hash map, storing a value with each key, with
+// initial size 'size'
+LinearHashTable *new_linear_hash_map(int size) {
+	LinearHashTable *table = malloc(sizeof *table);
+	assert(table);
+	mem_usage_init(&table->stat.memory, sizeof *table);
+
+	// as for a table, but with room for a value in every slot
+	table->width = 2;
+	initialise_table(table, size);
+	initialise_timers(table);
+
+	return table;
+}
+
+
+// build a linear probing hash table holding the 'n' keys in 'keys' (ignoring
+// repeats), with initial size 'size' doubled until at most half of its slots
+// will be in use, so that it never has to double while the keys go in
+LinearHashTable *build_linear_hash_table(int size, int64 *keys, int n) {
+	LinearHashTable *table = malloc(sizeof *table);
+	assert(table);
+	mem_usage_init(&table->stat.memory, sizeof *table);
+	assert(size > 0 && n >= 0);
+
+	while (size < 2LL * n) {
+		size *= 2;
+	}
+	table->width = 1;
+	initialise_table(table, size);
+	initialise_timers(table);
+
+	TimerStart start = event_start();
+	bool inserted;
+	int i;
+	for (i = 0; i < n; i++) {
+		insert_key(table, keys[i], &inserted);
+	}
+	event_stop(&table->stat.builds, start);
+
+	return table;
+}
+
+
+// free all memory associated with 'table'
+void free_linear_hash_table(LinearHashTable *table) {
+	assert(table != NULL);
+
+	// free the table's arrays
+	mem_free(&table->stat.memory, table->slots,
+		(sizeof *table->slots) * table->width * table->size);
+	mem_free(&table->stat.memory, table->inuse,
+		(sizeof *table->inuse) * table->size);
+
+	// free the table struct itself
+	free(table);
+}
+
+
+// insert 'key' into 'table', if it's not in there already
+// returns true if insertion succeeds, false if it was already in there
+bool linear_hash_table_insert(LinearHashTable *table, int64 key) {
+	assert(table != NULL);
+	TimerStart start = timer_start(&table->stat.inserts);
+
+	bool inserted;
+	insert_key(table, key, &inserted);
+
+	timer_stop(&table->stat.inserts, start,
+		inserted ? OP_INSERT_NEW : OP_INSERT_HIT);
+	return inserted;
 }
 
 
@@ -167,33 +292,64 @@ bool linear_hash_table_insert(LinearHashTable *table, int64 key) {
 // returns true if found, false if not
 bool linear_hash_table_lookup(LinearHashTable *table, int64 key) {
 	assert(table != NULL);
-    int start_time = clock(); // start timing
+	TimerStart start = timer_start(&table->stat.lookups);
 
-	// need to count our steps to make sure we recognise when the table is full
-	int steps = 0;
+	bool found = find_key(table, key) >= 0;
 
-	// calculate the initial address for this key
-	int h = h1(key) % table->size;
+	timer_stop(&table->stat.lookups, start,
+		found ? OP_LOOKUP_HIT : OP_LOOKUP_MISS);
+	return found;
+}
 
-	// step along until we find a free space (inuse[]==false), or until we
-	// visit every cell
-	while (table->inuse[h] && steps < table->size) {
 
-		if (table->slots[h] == key) {
-			// found the key!
-	        table->stat.look_time += clock() - start_time;
-			return true;
-		}
+// insert 'key' into map 'table' with value 'value', or if 'key' is already in
+// there, replace its value with 'value'
+// returns true if 'key' was inserted, false if it was already in there
+bool linear_hash_table_put(LinearHashTable *table, int64 key, int64 value) {
+	assert(table != NULL && table->width == 2);
+	TimerStart start = timer_start(&table->stat.inserts);
 
-		// keep stepping
-		h = (h + STEP_SIZE) % table->size;
-		steps++;
+	bool inserted;
+	int h = insert_key(table, key, &inserted);
+	value_at(table, h) = value;
+
+	timer_stop(&table->stat.inserts, start,
+		inserted ? OP_INSERT_NEW : OP_INSERT_HIT);
+	return inserted;
+}
+
+
+// lookup 'key' in map 'table', and if it's there store its value in '*value'
+// returns true if found, false if not
+bool linear_hash_table_get(LinearHashTable *table, int64 key, int64 *value) {
+	assert(table != NULL && table->width == 2);
+	TimerStart start = timer_start(&table->stat.lookups);
+
+	int h = find_key(table, key);
+	if (h >= 0) {
+		*value = value_at(table, h);
 	}
 
-	// we have either searched the whole table or come back to where we started
-	// either way, the key is not in the hash table
-	table->stat.look_time += clock() - start_time;
-	return false;
+	timer_stop(&table->stat.lookups, start,
+		h >= 0 ? OP_LOOKUP_HIT : OP_LOOKUP_MISS);
+	return h >= 0;
+}
+
+
+// replace the value of 'key' in map 'table' with 'value', if 'key' is in there
+// returns true if found (and updated), false if not
+bool linear_hash_table_update(LinearHashTable *table, int64 key, int64 value) {
+	assert(table != NULL && table->width == 2);
+	TimerStart start = timer_start(&table->stat.lookups);
+
+	int h = find_key(table, key);
+	if (h >= 0) {
+		value_at(table, h) = value;
+	}
+
+	timer_stop(&table->stat.lookups, start,
+		h >= 0 ? OP_LOOKUP_HIT : OP_LOOKUP_MISS);
+	return h >= 0;
 }
 
 
@@ -215,7 +371,7 @@ void linear_hash_table_print(LinearHashTable *table) {
 
 		// print the contents of the slot
 		if (table->inuse[i]) {
-			printf("%llu\n", table->slots[i]);
+			printf("%llu\n", key_at(table, i));
 		} else {
 			printf("-\n");
 		}
@@ -235,13 +391,36 @@ void linear_hash_table_stats(LinearHashTable *table) {
 	printf("Current load: %d items\n", table->load);
 	printf("Load factor: %.3f%%\n", table->load * 100.0 / table->size);
     printf("Num Collisions: %d\n", table->stat.collisions);
-    printf("Average probe len: %.4f\n", 
-                (float)table->stat.probe / table->stat.collisions);
-	float insertsec = table->stat.ins_time * 1.0 / CLOCKS_PER_SEC;
+    printf("Average probe len: %.4f\n", table->stat.collisions
+                ? (float)table->stat.probe / table->stat.collisions : 0);
+	float insertsec = timer_seconds(&table->stat.inserts);
     printf("Time taken inserting: %.6f seconds\n", insertsec);
-	float looksec = table->stat.look_time * 1.0 / CLOCKS_PER_SEC;
+	float looksec = timer_seconds(&table->stat.lookups);
     printf("Time taken looking up: %.6f seconds\n", looksec);
+	timer_print(&table->stat.inserts);
+	timer_print(&table->stat.lookups);
+	event_print(&table->stat.resizes, "resizes");
+	if (table->stat.builds.count > 0) {
+		event_print(&table->stat.builds, "bulk build");
+	}
+	mem_usage_print(&table->stat.memory, table->load, wasted_bytes(table));
 	printf("   step size: %d slots\n", STEP_SIZE);
 
 	printf("--- end stats ---\n");
 }
+
+
+// fill in 'stats' with the statistics every type of table reports
+void linear_hash_table_get_stats(LinearHashTable *table, TableStats *stats) {
+	assert(table != NULL && stats != NULL);
+	stats->size = table->size;
+	stats->nkeys = table->load;
+	stats->capacity = table->size;
+	table_stats_add_memory(stats, &table->stat.memory);
+	stats->wastedbytes = wasted_bytes(table);
+	stats->collisions = table->stat.collisions;
+	stats->probes = table->stat.probe;
+	table_stats_add_timer(stats, &table->stat.inserts);
+	table_stats_add_timer(stats, &table->stat.lookups);
+	table_stats_add_growths(stats, &table->stat.resizes);
+}
@@ -7,12 +7,22 @@
 
 #include <stdbool.h>
 #include "../inthash.h"
+#include "../tblstats.h"
 
 typedef struct linear_table LinearHashTable;
 
 // initialise a linear probing hash table with initial size 'size'
 LinearHashTable *new_linear_hash_table(int size);
 
+// initialise a linear probing hash map, storing a value with each key, with
+// initial size 'size'
+LinearHashTable *new_linear_hash_map(int size);
+
+// build a linear probing hash table holding the 'n' keys in 'keys' (ignoring
+// repeats), with initial size 'size' doubled until at most half of its slots
+// will be in use, so that it never has to double while the keys go in
+LinearHashTable *build_linear_hash_table(int size, int64 *keys, int n);
+
 // free all memory associated with 'table'
 void free_linear_hash_table(LinearHashTable *table);
 
@@ -24,9 +34,26 @@ bool linear_hash_table_insert(LinearHashTable *table, int64 key);
 // returns true if found, false if not
 bool linear_hash_table_lookup(LinearHashTable *table, int64 key);
 
+// insert 'key' into map 'table' with value 'value', or if 'key' is already in
+// there, replace its value with 'value'
+// returns true if 'key' was inserted, false if it was already in there
+bool linear_hash_table_put(LinearHashTable *table, int64 key, int64 value);
+
+// lookup 'key' in map 'table', and if it's there store its value in '*value'
+// returns true if found, false if not
+bool linear_hash_table_get(LinearHashTable *table, int64 key, int64 *value);
+
+// replace the value of 'key' in map 'table' with 'value', if 'key' is in there
+// returns true if found (and updated), false if not
+bool linear_hash_table_update(LinearHashTable *table, int64 key, int64 value);
+
 // print the contents of 'table' to stdout
 void linear_hash_table_print(LinearHashTable *table);
 
 // print some statistics about 'table' to stdout
 void linear_hash_table_stats(LinearHashTable *table);
 
+// fill in 'stats' with the statistics every type of table reports (see
+// tblstats.h)
+void linear_hash_table_get_stats(LinearHashTable *table, TableStats *stats);
+
@@ -0,0 +1,444 @@
+/* * * * * * * * *
+ * Lock-free dynamic hash table using linear probing to resolve collisions,
+ * resizing cooperatively
+ *
+ * created for COMP20007 Design of Algorithms - Assignment 2, 2017
+ * by Luke Hedt
+ *
+ * Based on linear.c, and on Cliff Click's non-blocking hash map. A slot holds
+ * a key, EMPTY, or MOVED, and only ever changes from EMPTY to one of the
+ * others, with a compare-and-swap. An insert claims the first EMPTY slot on
+ * its key's probe sequence; a lookup reads along the same sequence without
+ * writing anything, so it finishes in a bounded number of steps.
+ *
+ * When an array gets too full (or a probe sequence too long), a twice-as-big
+ * next array is attached to it, and its slots are migrated in chunks by every
+ * thread that inserts until all of them are done: migrating a slot seals it
+ * (EMPTY becomes MOVED) or copies its key to the next array. Inserts that
+ * reach an EMPTY slot while a migration is in progress seal it too, and then
+ * insert into the next array, so that anything reading the old array sees
+ * MOVED on that probe sequence and follows on to the next array. Once every
+ * slot has been migrated, the next array becomes the current one.
+ *
+ * Old arrays may still be being read by other threads, so (where Click's map
+ * leaves them to the garbage collector) they are kept until the table is
+ * freed, costing at most as much memory again as the current array.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <assert.h>
+
+#include "linearc.h"
+#include "../instrument.h"
+
+// the two reserved slot values: a slot no key has claimed, and a slot which
+// has been sealed because its array is being migrated. the keys with these
+// values are kept in flags instead
+#define EMPTY UINT64_MAX
+#define MOVED (UINT64_MAX - 1)
+
+// start migrating an array to a bigger one once this fraction of its slots
+// are in use
+#define MAX_LOAD 0.5
+
+// or once an insert has had to probe this many slots
+#define REPROBE_LIMIT(size) (10 + (size) / 4)
+
+// how many slots a thread migrates at a time
+#define MIGRATE_CHUNK 1024
+
+// shorthands for the atomic operations used here
+#define load(p) __atomic_load_n(p, __ATOMIC_ACQUIRE)
+#define cas(p, expected, desired) __atomic_compare_exchange_n(p, expected, \
+	desired, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)
+#define count(p) __atomic_fetch_add(p, 1, __ATOMIC_RELAXED)
+
+// one array of slots, and its migration to the next array (if any)
+typedef struct array {
+	int64 *slots;			// the slots, each a key, EMPTY or MOVED
+	int size;				// how many slots there are (a power of two)
+	int used;				// how many of them hold keys
+	struct array *next;		// the array it is migrating to, or NULL
+	int copyidx;			// the first slot no thread has started migrating
+	int copydone;			// how many slots have been migrated
+	TimerStart started;		// when migration to this array began
+} Array;
+
+// helper structure to store statistics gathered, updated atomically
+typedef struct stats {
+	int nkeys;		// how many keys are being stored in the table
+	int nresizes;	// how many times the table has started to grow
+	int ncopied;	// how many keys have been copied to a bigger array
+	int nchunks;	// how many chunks of slots have been migrated
+	int ncasfails;	// how many times a slot changed before it could be claimed
+	EventTimer migrations;	// times each resize, from start to promotion
+	EventTimer chunks;		// times each chunk migrated by an insert
+	MemUsage memory;		// counts the memory allocated for the table
+} Stats;
+
+// a lock-free hash table is its current array of slots, all the earlier
+// arrays that were migrated to it, and flags for the two reserved keys
+struct linearc_table {
+	Array *current;		// the array new operations start in
+	Array *oldest;		// the first array, from which all others follow
+	bool hasempty;		// is the key EMPTY in the table?
+	bool hasmoved;		// is the key MOVED in the table?
+	Stats stats;		// collection of statistics about this hash table
+};
+
+
+/* * * *
+ * helper functions
+ */
+
+static bool insert_into(LinearCHashTable *table, Array *array, int64 key);
+
+// create a new array of 'size' slots for 'table', all EMPTY
+static Array *new_array(LinearCHashTable *table, int size) {
+	assert(size < MAX_TABLE_SIZE && "error: table has grown too large!");
+
+	Array *array = mem_alloc(&table->stats.memory, sizeof *array);
+	assert(array);
+	array->slots = mem_alloc(&table->stats.memory,
+		(sizeof *array->slots) * size);
+	assert(array->slots);
+	memset(array->slots, 0xff, (sizeof *array->slots) * size);	// all EMPTY
+
+	array->size = size;
+	array->used = 0;
+	array->next = NULL;
+	array->copyidx = 0;
+	array->copydone = 0;
+	array->started = 0;
+	return array;
+}
+
+static void free_array(LinearCHashTable *table, Array *array) {
+	mem_free(&table->stats.memory, array->slots,
+		(sizeof *array->slots) * array->size);
+	mem_free(&table->stats.memory, array, sizeof *array);
+}
+
+// attach a twice-as-big next array to 'array' (unless another thread already
+// has), and return the next array
+static Array *start_resize(LinearCHashTable *table, Array *array) {
+	Array *next = load(&array->next);
+	if (next) {
+		return next;
+	}
+
+	Array *fresh = new_array(table, array->size * 2);
+	fresh->started = event_start();
+	if (cas(&array->next, &next, fresh)) {
+		count(&table->stats.nresizes);
+		return fresh;
+	}
+
+	// another thread got there first: use its array ('next', from the cas)
+	free_array(table, fresh);
+	return next;
+}
+
+// the bytes allocated for slots in 'table' holding no key: the empty slots,
+// and every slot of the arrays already migrated from (which are only freed
+// along with the table)
+static int64 wasted_bytes(LinearCHashTable *table) {
+	int64 nslots = 0;
+	Array *array;
+	for (array = table->oldest; array != NULL; array = array->next) {
+		nslots += array->size;
+	}
+	return (nslots - table->stats.nkeys) * (int64)sizeof(int64);
+}
+
+// make every fully migrated array's next array current, in order
+static void promote(LinearCHashTable *table) {
+	Array *current = load(&table->current);
+	while (true) {
+		Array *next = load(&current->next);
+		if (next == NULL || load(&current->copydone) < current->size) {
+			return;
+		}
+		// on failure, the cas loads the new current array for us
+		if (cas(&table->current, &current, next)) {
+			current = next;
+		}
+	}
+}
+
+// migrate slot 'i' of 'array': seal it if it's EMPTY, or copy its key to the
+// next array if it holds one
+static void migrate_slot(LinearCHashTable *table, Array *array, int i) {
+	int64 *slot = &array->slots[i];
+	int64 key = load(slot);
+	while (key == EMPTY) {
+		// on failure, the cas loads the slot's new value into 'key'
+		if (cas(slot, &key, MOVED)) {
+			return;
+		}
+	}
+	if (key != MOVED) {
+		insert_into(table, array->next, key);
+		count(&table->stats.ncopied);
+	}
+}
+
+// migrate the next chunk of 'array's slots, if there are any left to start
+static void help_migrate(LinearCHashTable *table, Array *array) {
+	if (load(&array->copyidx) >= array->size) {
+		return;
+	}
+	int start = __atomic_fetch_add(&array->copyidx, MIGRATE_CHUNK,
+		__ATOMIC_RELAXED);
+	if (start >= array->size) {
+		return;
+	}
+
+	TimerStart chunkstart = event_start();
+	int end = start + MIGRATE_CHUNK < array->size
+		? start + MIGRATE_CHUNK : array->size;
+	int i;
+	for (i = start; i < end; i++) {
+		migrate_slot(table, array, i);
+	}
+	count(&table->stats.nchunks);
+	event_stop_atomic(&table->stats.chunks, chunkstart);
+
+	// the thread finishing the last chunk moves the table on to the next array
+	int done = __atomic_add_fetch(&array->copydone, end - start,
+		__ATOMIC_ACQ_REL);
+	if (done == array->size) {
+		promote(table);
+		Array *next = load(&array->next);
+		event_stop_atomic(&table->stats.migrations, next->started);
+	}
+}
+
+// insert 'key' (not EMPTY or MOVED) into 'array', or an array after it, if
+// it's not in there already
+// returns true if insertion succeeds, false if it was already in there
+static bool insert_into(LinearCHashTable *table, Array *array, int64 key) {
+	int mask = array->size - 1;
+	int h = h1(key) & mask;
+	int probes = 0;
+
+	while (true) {
+		int64 *slot = &array->slots[h];
+		int64 found = load(slot);
+
+		if (found == key) {
+			// this key already exists in the table! no need to insert
+			return false;
+		}
+		if (found == MOVED) {
+			// this array is being migrated: the key belongs in the next one
+			break;
+		}
+		if (found == EMPTY) {
+			// claim this slot for the key, or if the array is being migrated,
+			// seal it so that lookups will follow on to the next array
+			Array *next = load(&array->next);
+			if (cas(slot, &found, next ? MOVED : key)) {
+				if (next) {
+					break;
+				}
+				int used = __atomic_add_fetch(&array->used, 1,
+					__ATOMIC_RELAXED);
+				if (used > array->size * MAX_LOAD) {
+					start_resize(table, array);
+				}
+				return true;
+			}
+
+			// the slot changed under us: look at it again
+			count(&table->stats.ncasfails);
+			continue;
+		}
+
+		// this slot holds another key: keep stepping, unless the probe
+		// sequence has got too long, in which case the array needs to grow
+		if (++probes >= REPROBE_LIMIT(array->size)) {
+			break;
+		}
+		h = (h + 1) & mask;
+	}
+
+	return insert_into(table, start_resize(table, array), key);
+}
+
+
+/* * * *
+ * all functions
+ */
+
+// initialise a lock-free linear probing hash table with initial size 'size'
+// (rounded up to a power of two)
+LinearCHashTable *new_linearc_hash_table(int size) {
+	LinearCHashTable *table = malloc(sizeof *table);
+	assert(table);
+	mem_usage_init(&table->stats.memory, sizeof *table);
+
+	int power = 1;
+	while (power < size) {
+		power *= 2;
+	}
+	table->current = table->oldest = new_array(table, power);
+	table->hasempty = false;
+	table->hasmoved = false;
+
+	table->stats.nkeys = 0;
+	table->stats.nresizes = 0;
+	table->stats.ncopied = 0;
+	table->stats.nchunks = 0;
+	table->stats.ncasfails = 0;
+	event_init(&table->stats.migrations);
+	event_init(&table->stats.chunks);
+
+	return table;
+}
+
+
+// free all memory associated with 'table'
+void free_linearc_hash_table(LinearCHashTable *table) {
+	assert(table != NULL);
+
+	// free every array, from the first one on
+	Array *array = table->oldest;
+	while (array) {
+		Array *next = array->next;
+		free_array(table, array);
+		array = next;
+	}
+
+	free(table);
+}
+
+
+// insert 'key' into 'table', if it's not in there already
+// returns true if insertion succeeds, false if it was already in there
+bool linearc_hash_table_insert(LinearCHashTable *table, int64 key) {
+	assert(table != NULL);
+
+	// the reserved keys can't go in slots: use their flags
+	if (key == EMPTY || key == MOVED) {
+		bool *flag = key == EMPTY ? &table->hasempty : &table->hasmoved;
+		bool inserted = !__atomic_exchange_n(flag, true, __ATOMIC_ACQ_REL);
+		if (inserted) {
+			count(&table->stats.nkeys);
+		}
+		return inserted;
+	}
+
+	// help with any migration in progress, then insert
+	Array *array = load(&table->current);
+	if (load(&array->next)) {
+		help_migrate(table, array);
+	}
+	bool inserted = insert_into(table, array, key);
+	if (inserted) {
+		count(&table->stats.nkeys);
+	}
+	return inserted;
+}
+
+
+// lookup whether 'key' is inside 'table'
+// returns true if found, false if not
+bool linearc_hash_table_lookup(LinearCHashTable *table, int64 key) {
+	assert(table != NULL);
+
+	if (key == EMPTY) {
+		return load(&table->hasempty);
+	}
+	if (key == MOVED) {
+		return load(&table->hasmoved);
+	}
+
+	// step along the key's probe sequence in each array in turn, moving on
+	// to the next array wherever an insert would have
+	Array *array = load(&table->current);
+	while (array) {
+		int mask = array->size - 1;
+		int h = h1(key) & mask;
+		int probes;
+		for (probes = 0; probes < REPROBE_LIMIT(array->size); probes++) {
+			int64 found = load(&array->slots[h]);
+			if (found == key) {
+				return true;
+			}
+			if (found == EMPTY) {
+				return false;
+			}
+			if (found == MOVED) {
+				break;
+			}
+			h = (h + 1) & mask;
+		}
+		array = load(&array->next);
+	}
+	return false;
+}
+
+
+// print the contents of 'table' to stdout
+void linearc_hash_table_print(LinearCHashTable *table) {
+	assert(table != NULL);
+	Array *array = table->current;
+
+	printf("--- table size: %d\n", array->size);
+
+	// print header
+	printf("   address | key\n");
+
+	// print the rows of the current array
+	int i;
+	for (i = 0; i < array->size; i++) {
+		printf(" %9d | ", i);
+		if (array->slots[i] == EMPTY) {
+			printf("-\n");
+		} else if (array->slots[i] == MOVED) {
+			printf("(moved)\n");
+		} else {
+			printf("%llu\n", array->slots[i]);
+		}
+	}
+
+	printf("--- end table ---\n");
+}
+
+
+// print some statistics about 'table' to stdout
+void linearc_hash_table_stats(LinearCHashTable *table) {
+	assert(table != NULL);
+	Array *array = table->current;
+
+	printf("--- table stats ---\n");
+	printf("Current size: %d slots\n", array->size);
+	printf("Current load: %d items\n", table->stats.nkeys);
+	printf("Load factor: %.3f%%\n", array->used * 100.0 / array->size);
+	printf("Resizes: %d (%d keys copied in %d chunks)%s\n",
+		table->stats.nresizes, table->stats.ncopied, table->stats.nchunks,
+		array->next ? ", one in progress" : "");
+	printf("Failed compare-and-swaps: %d\n", table->stats.ncasfails);
+	event_print(&table->stats.migrations, "resizes");
+	event_print(&table->stats.chunks, "chunks moved");
+	mem_usage_print(&table->stats.memory, table->stats.nkeys,
+		wasted_bytes(table));
+	printf("--- end stats ---\n");
+}
+
+
+// fill in 'stats' with the statistics every type of table reports
+void linearc_hash_table_get_stats(LinearCHashTable *table,
+		TableStats *stats) {
+	assert(table != NULL && stats != NULL);
+	stats->size = table->current->size;
+	stats->nkeys = table->stats.nkeys;
+	stats->capacity = table->current->size;
+	table_stats_add_memory(stats, &table->stats.memory);
+	stats->wastedbytes = wasted_bytes(table);
+	table_stats_add_growths(stats, &table->stats.migrations);
+}
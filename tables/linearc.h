@@ -0,0 +1,48 @@
+/* * * * * * * * *
+ * Lock-free dynamic hash table using linear probing to resolve collisions,
+ * resizing cooperatively
+ *
+ * insert and lookup may be called from many threads at once: inserts claim
+ * slots with compare-and-swap, lookups are wait-free, and every thread that
+ * inserts while the table is being resized helps to move its keys.
+ * print and stats must not run concurrently with other operations
+ *
+ * created for COMP20007 Design of Algorithms - Assignment 2, 2017
+ * by Luke Hedt
+ */
+
+#ifndef LINEARC_H
+#define LINEARC_H
+
+#include <stdbool.h>
+#include "../inthash.h"
+#include "../tblstats.h"
+
+typedef struct linearc_table LinearCHashTable;
+
+// initialise a lock-free linear probing hash table with initial size 'size'
+// (rounded up to a power of two)
+LinearCHashTable *new_linearc_hash_table(int size);
+
+// free all memory associated with 'table'
+void free_linearc_hash_table(LinearCHashTable *table);
+
+// insert 'key' into 'table', if it's not in there already
+// returns true if insertion succeeds, false if it was already in there
+bool linearc_hash_table_insert(LinearCHashTable *table, int64 key);
+
+// lookup whether 'key' is inside 'table'
+// returns true if found, false if not
+bool linearc_hash_table_lookup(LinearCHashTable *table, int64 key);
+
+// print the contents of 'table' to stdout
+void linearc_hash_table_print(LinearCHashTable *table);
+
+// print some statistics about 'table' to stdout
+void linearc_hash_table_stats(LinearCHashTable *table);
+
+// fill in 'stats' with the statistics every type of table reports (see
+// tblstats.h)
+void linearc_hash_table_get_stats(LinearCHashTable *table, TableStats *stats);
+
+#endif
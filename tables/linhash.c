@@ -0,0 +1,380 @@
+/* * * * * * * * *
+ * Dynamic hash table using Litwin's linear hashing with multiple keys per
+ * bucket, growing smoothly by splitting one bucket at a time in round-robin
+ * order, with overflow chains instead of a table of bucket pointers
+ *
+ * created for COMP20007 Design of Algorithms - Assignment 2, 2017
+ * by Luke Hedt
+ *
+ * Buckets are the same multi-key buckets as in xtndbln.c, but addressed
+ * directly: a key's bucket is the rightmost 'level' bits of its hash, or the
+ * rightmost 'level'+1 bits if that bucket has already been split this round.
+ * Whenever the table gets too full, the bucket at the split pointer is split,
+ * whether or not it is the one that overflowed.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+
+#include "linhash.h"
+#include "../instrument.h"
+
+// macro to calculate the rightmost n bits of a number x
+#define rightmostnbits(n, x) (x) & ((1 << (n)) - 1)
+
+// split the next bucket once the keys fill this fraction of the primary
+// buckets' space
+#define MAX_LOAD 0.8
+
+// a bucket stores an array of keys, and points to the next bucket in its
+// overflow chain (if any)
+typedef struct linhash_bucket {
+	int nkeys;		// number of keys currently contained in this bucket
+	int64 *keys;	// the keys stored in this bucket
+	struct linhash_bucket *overflow;	// next bucket in the chain, or NULL
+} Bucket;
+
+// helper structure to store statistics gathered
+typedef struct stats {
+	int nkeys;		// how many keys are being stored in the table
+	int noverflow;	// how many overflow buckets are currently chained
+	int nsplits;	// how many buckets have been split so far
+	OpTimer timer;	// times the inserts and lookups of keys
+					// in this table
+	EventTimer splits;	// times each bucket split
+	MemUsage memory;	// counts the memory allocated for the table
+} Stats;
+
+// a linear hash table is an array of primary buckets, of which the first
+// 2^level + split are in use. buckets before 'split' (and their new partners
+// at split + 2^level) have already been split using level+1 bits this round
+struct linhash_table {
+	Bucket *buckets;	// array of primary buckets
+	int nbuckets;		// how many primary buckets are in use
+	int capacity;		// how many primary buckets have space allocated
+	int level;			// how many bits of the hash value every bucket uses
+	int split;			// the next bucket to be split
+	int bucketsize;		// maximum number of keys per bucket
+	Stats stats;		// collection of statistics about this hash table
+};
+
+
+/*
+ * Helper Functions
+ */
+
+// set up 'bucket' as an empty bucket of 'table', with space for its
+// bucketsize keys
+static void init_bucket(LinHashTable *table, Bucket *bucket) {
+	assert(bucket);
+	bucket->keys = mem_alloc(&table->stats.memory,
+		(sizeof *bucket->keys) * table->bucketsize);
+	assert(bucket->keys);
+	bucket->nkeys = 0;
+	bucket->overflow = NULL;
+}
+
+// free the overflow chain hanging off 'bucket' in 'table', and return how
+// many buckets were in it
+static int free_overflow(LinHashTable *table, Bucket *bucket) {
+	int n = 0;
+	Bucket *next = bucket->overflow;
+	while (next) {
+		Bucket *after = next->overflow;
+		mem_free(&table->stats.memory, next->keys,
+			sizeof *next->keys * table->bucketsize);
+		mem_free(&table->stats.memory, next, sizeof *next);
+		next = after;
+		n++;
+	}
+	bucket->overflow = NULL;
+	return n;
+}
+
+// which primary bucket does 'hash' belong in right now?
+static int address_of(LinHashTable *table, int hash) {
+	int address = rightmostnbits(table->level, hash);
+	if (address < table->split) {
+		// this bucket has been split already, use one more bit
+		address = rightmostnbits(table->level + 1, hash);
+	}
+	return address;
+}
+
+// put 'key' into the first bucket with space in the chain starting at
+// primary bucket 'address', adding an overflow bucket if they are all full
+// does not check whether 'key' is already there
+static void place_key(LinHashTable *table, int address, int64 key) {
+	Bucket *bucket = &table->buckets[address];
+	while (bucket->nkeys >= table->bucketsize) {
+		if (bucket->overflow == NULL) {
+			bucket->overflow = mem_alloc(&table->stats.memory,
+				sizeof *bucket->overflow);
+			assert(bucket->overflow);
+			init_bucket(table, bucket->overflow);
+			table->stats.noverflow++;
+		}
+		bucket = bucket->overflow;
+	}
+	bucket->keys[bucket->nkeys++] = key;
+}
+
+// split the bucket at the split pointer into itself and a new bucket at the
+// end of the table, then advance the split pointer (starting the next round
+// once every bucket of this round has been split)
+static void split_next(LinHashTable *table) {
+	TimerStart start = event_start();
+
+	// FIRST,
+	// make space for the new primary bucket, if needed
+	if (table->nbuckets == table->capacity) {
+		int capacity = table->capacity * 2;
+		assert(capacity < MAX_TABLE_SIZE && "error: table has grown too large!");
+		table->buckets = mem_realloc(&table->stats.memory, table->buckets,
+			(sizeof *table->buckets) * table->capacity,
+			(sizeof *table->buckets) * capacity);
+		assert(table->buckets);
+		table->capacity = capacity;
+	}
+	init_bucket(table, &table->buckets[table->nbuckets]);
+	table->nbuckets++;
+
+	// SECOND,
+	// take the keys out of the bucket being split (and its chain), remembering
+	// them in a temporary array, and release its overflow buckets
+	Bucket *old = &table->buckets[table->split];
+	int nkeys = 0, maxkeys = table->bucketsize;
+	int64 *keys = mem_alloc(&table->stats.memory, (sizeof *keys) * maxkeys);
+	assert(keys);
+	Bucket *bucket;
+	for (bucket = old; bucket; bucket = bucket->overflow) {
+		int i;
+		for (i = 0; i < bucket->nkeys; i++) {
+			if (nkeys == maxkeys) {
+				keys = mem_realloc(&table->stats.memory, keys,
+					(sizeof *keys) * maxkeys, (sizeof *keys) * maxkeys * 2);
+				maxkeys *= 2;
+				assert(keys);
+			}
+			keys[nkeys++] = bucket->keys[i];
+		}
+	}
+	old->nkeys = 0;
+	table->stats.noverflow -= free_overflow(table, old);
+
+	// THIRD,
+	// advance the split pointer, starting a new round if we've split them all
+	table->split++;
+	if (table->split == 1 << table->level) {
+		table->level++;
+		table->split = 0;
+	}
+	table->stats.nsplits++;
+
+	// FINALLY,
+	// redistribute the keys between the old bucket and its new partner
+	int i;
+	for (i = 0; i < nkeys; i++) {
+		place_key(table, address_of(table, h1(keys[i])), keys[i]);
+	}
+	mem_free(&table->stats.memory, keys, (sizeof *keys) * maxkeys);
+	event_stop(&table->stats.splits, start);
+}
+
+// is 'key' in 'table'? (searches the key's bucket and its overflow chain)
+static bool find_key(LinHashTable *table, int64 key) {
+	bool found = false;
+	Bucket *bucket = &table->buckets[address_of(table, h1(key))];
+	for (; bucket && !found; bucket = bucket->overflow) {
+		int i;
+		for (i = 0; i < bucket->nkeys && !found; i++) {
+			found = bucket->keys[i] == key;
+		}
+	}
+	return found;
+}
+
+// the bytes allocated for keys in 'table' holding none, plus the space at the
+// end of the array of primary buckets for buckets not yet in use
+static int64 wasted_bytes(LinHashTable *table) {
+	int64 nslots = (int64)(table->nbuckets + table->stats.noverflow)
+		* table->bucketsize;
+	return (nslots - table->stats.nkeys) * (int64)sizeof(int64)
+		+ (int64)(table->capacity - table->nbuckets) * sizeof(Bucket);
+}
+
+
+/*
+ * Real Functions
+ */
+
+// initialise a linear hash table with 'bucketsize' keys per bucket
+LinHashTable *new_linhash_hash_table(int bucketsize) {
+	LinHashTable *table = malloc(sizeof *table);
+	assert(table);
+	mem_usage_init(&table->stats.memory, sizeof *table);
+
+	// start with a single primary bucket, using no bits of the hash value
+	table->bucketsize = bucketsize;
+	table->capacity = 1;
+	table->buckets = mem_alloc(&table->stats.memory, sizeof *table->buckets);
+	assert(table->buckets);
+	init_bucket(table, &table->buckets[0]);
+	table->nbuckets = 1;
+	table->level = 0;
+	table->split = 0;
+
+	table->stats.nkeys = 0;
+	table->stats.noverflow = 0;
+	table->stats.nsplits = 0;
+	timer_init(&table->stats.timer);
+	event_init(&table->stats.splits);
+
+	return table;
+}
+
+
+// free all memory associated with 'table'
+void free_linhash_hash_table(LinHashTable *table) {
+	assert(table);
+
+	// free each primary bucket's keys and overflow chain
+	int i;
+	for (i = 0; i < table->nbuckets; i++) {
+		free_overflow(table, &table->buckets[i]);
+		mem_free(&table->stats.memory, table->buckets[i].keys,
+			sizeof *table->buckets[i].keys * table->bucketsize);
+	}
+
+	// free the array of primary buckets, then the table struct itself
+	mem_free(&table->stats.memory, table->buckets,
+		sizeof *table->buckets * table->capacity);
+	free(table);
+}
+
+
+// insert 'key' into 'table', if it's not in there already
+// returns true if insertion succeeds, false if it was already in there
+bool linhash_hash_table_insert(LinHashTable *table, int64 key) {
+	assert(table);
+	TimerStart start = timer_start(&table->stats.timer);
+
+	// is this key already there?
+	if (find_key(table, key)) {
+		timer_stop(&table->stats.timer, start, OP_INSERT_HIT);
+		return false;
+	}
+
+	// if not, add it to the end of its bucket's chain
+	place_key(table, address_of(table, h1(key)), key);
+	table->stats.nkeys++;
+
+	// and split the next bucket in line if the table is getting full
+	if (table->stats.nkeys >
+			MAX_LOAD * table->nbuckets * table->bucketsize) {
+		split_next(table);
+	}
+
+	// stop timing before returning
+	timer_stop(&table->stats.timer, start, OP_INSERT_NEW);
+	return true;
+}
+
+
+// lookup whether 'key' is inside 'table'
+// returns true if found, false if not
+bool linhash_hash_table_lookup(LinHashTable *table, int64 key) {
+	assert(table);
+	TimerStart start = timer_start(&table->stats.timer);
+
+	bool found = find_key(table, key);
+
+	// stop timing before returning result
+	timer_stop(&table->stats.timer, start,
+		found ? OP_LOOKUP_HIT : OP_LOOKUP_MISS);
+	return found;
+}
+
+
+// print the contents of 'table' to stdout
+void linhash_hash_table_print(LinHashTable *table) {
+	assert(table);
+	printf("--- table size: %d\n", table->nbuckets);
+
+	// print header
+	printf("  address | [key] -> [overflow key]\n");
+
+	// print each primary bucket followed by its overflow chain
+	int i;
+	for (i = 0; i < table->nbuckets; i++) {
+		printf("%9d | ", i);
+
+		Bucket *bucket;
+		for (bucket = &table->buckets[i]; bucket; bucket = bucket->overflow) {
+			if (bucket != &table->buckets[i]) {
+				printf(" -> ");
+			}
+			printf("[");
+			int j;
+			for (j = 0; j < table->bucketsize; j++) {
+				if (j < bucket->nkeys) {
+					printf(" %llu", bucket->keys[j]);
+				} else {
+					printf(" -");
+				}
+			}
+			printf(" ]");
+		}
+		printf("\n");
+	}
+
+	printf("--- end table ---\n");
+}
+
+
+// print some statistics about 'table' to stdout
+void linhash_hash_table_stats(LinHashTable *table) {
+	assert(table);
+
+	printf("--- table stats ---\n");
+
+	// print some stats about state of the table
+	printf("current table size: %d\n", table->nbuckets);
+	printf("    number of keys: %d\n", table->stats.nkeys);
+	printf(" number of buckets: %d\n",
+		table->nbuckets + table->stats.noverflow);
+	printf("             level: %d\n", table->level);
+	printf("     split pointer: %d\n", table->split);
+	printf("  overflow buckets: %d\n", table->stats.noverflow);
+	printf("     buckets split: %d\n", table->stats.nsplits);
+	printf("       load factor: %.3f%%\n", table->stats.nkeys * 100.0
+		/ ((double)table->nbuckets * table->bucketsize));
+
+	// also calculate CPU usage in seconds and print this
+	float seconds = timer_seconds(&table->stats.timer);
+	printf("        time spent: %.6f sec\n", seconds);
+	timer_print(&table->stats.timer);
+	event_print(&table->stats.splits, "splits");
+	mem_usage_print(&table->stats.memory, table->stats.nkeys,
+		wasted_bytes(table));
+
+	printf("--- end stats ---\n");
+}
+
+
+// fill in 'stats' with the statistics every type of table reports
+void linhash_hash_table_get_stats(LinHashTable *table, TableStats *stats) {
+	assert(table && stats);
+	int nbuckets = table->nbuckets + table->stats.noverflow;
+	stats->size = table->nbuckets;
+	stats->nkeys = table->stats.nkeys;
+	stats->capacity = (int64)nbuckets * table->bucketsize;
+	table_stats_add_memory(stats, &table->stats.memory);
+	stats->wastedbytes = wasted_bytes(table);
+	stats->nbuckets = nbuckets;
+	stats->bucketsize = table->bucketsize;
+	stats->depth = table->level;
+	table_stats_add_timer(stats, &table->stats.timer);
+	table_stats_add_growths(stats, &table->stats.splits);
+}
@@ -0,0 +1,43 @@
+/* * * * * * * * *
+ * Dynamic hash table using Litwin's linear hashing with multiple keys per
+ * bucket, growing smoothly by splitting one bucket at a time in round-robin
+ * order, with overflow chains instead of a table of bucket pointers
+ *
+ * created for COMP20007 Design of Algorithms - Assignment 2, 2017
+ * by Luke Hedt
+ */
+
+#ifndef LINHASH_H
+#define LINHASH_H
+
+#include <stdbool.h>
+#include "../inthash.h"
+#include "../tblstats.h"
+
+typedef struct linhash_table LinHashTable;
+
+// initialise a linear hash table with 'bucketsize' keys per bucket
+LinHashTable *new_linhash_hash_table(int bucketsize);
+
+// free all memory associated with 'table'
+void free_linhash_hash_table(LinHashTable *table);
+
+// insert 'key' into 'table', if it's not in there already
+// returns true if insertion succeeds, false if it was already in there
+bool linhash_hash_table_insert(LinHashTable *table, int64 key);
+
+// lookup whether 'key' is inside 'table'
+// returns true if found, false if not
+bool linhash_hash_table_lookup(LinHashTable *table, int64 key);
+
+// print the contents of 'table' to stdout
+void linhash_hash_table_print(LinHashTable *table);
+
+// print some statistics about 'table' to stdout
+void linhash_hash_table_stats(LinHashTable *table);
+
+// fill in 'stats' with the statistics every type of table reports (see
+// tblstats.h)
+void linhash_hash_table_get_stats(LinHashTable *table, TableStats *stats);
+
+#endif
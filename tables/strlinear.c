@@ -0,0 +1,362 @@
+/* * * * * * * * *
+ * Dynamic hash table with variable-length byte-string keys, using linear
+ * probing to resolve collisions
+ *
+ * created for COMP20007 Design of Algorithms - Assignment 2, 2017
+ * by Luke Hedt
+ *
+ * The keys' bytes are stored one after another in a single arena, and each
+ * slot holds just a key's full 64-bit hash along with where its bytes are in
+ * the arena. A probe compares the cached hashes first, so it only touches a
+ * key's bytes (a second cache miss) when the hashes match, which is almost
+ * always because it is the key being looked for. Doubling the table moves the
+ * slots using their cached hashes, without rehashing or moving any bytes.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <assert.h>
+
+#include "strlinear.h"
+#include "../instrument.h"
+
+// how many cells to advance at a time while looking for a free slot
+#define STEP_SIZE 1
+
+// double the table once this fraction of its slots are in use
+#define MAX_LOAD 0.75
+
+// the length marking a slot which is not in use
+#define EMPTY UINT32_MAX
+
+// how many bytes of space the arena starts with
+#define INITIAL_ARENA_SIZE 256
+
+// enough space for the decimal digits of any int64
+#define MAX_DIGITS 21
+
+// a slot holds a key's cached hash, and where its bytes are in the arena
+typedef struct slot {
+	int64 hash;			// the key's full hash, from hstr()
+	uint32_t offset;	// where the key's bytes start in the arena
+	uint32_t length;	// how many bytes long the key is, or EMPTY
+} Slot;
+
+// helper structure to store statistics gathered
+typedef struct stats {
+	int collisions;		// number of first-time collisions
+	int probe;			// number of probes past the key's home slot
+	int compares;		// how many times key bytes were compared
+	int falsematches;	// how many of those compares found different bytes
+	OpTimer inserts;	// times the inserts of keys
+	OpTimer lookups;	// times the lookups of keys
+	EventTimer resizes;	// times each doubling of the slot array
+	MemUsage memory;	// counts the memory allocated for the table
+} Stats;
+
+// a string hash table is an array of slots, and an arena holding the bytes of
+// all of the keys in those slots
+struct strlinear_table {
+	Slot *slots;		// array of slots
+	int size;			// the size of the slot array right now
+	int load;			// number of keys in the table right now
+	char *arena;		// the keys' bytes, one after another
+	size_t arenasize;	// how many bytes of space the arena has
+	size_t arenaused;	// how many of those bytes are in use
+	Stats stats;		// collection of statistics about this hash table
+};
+
+
+/* * * *
+ * helper functions
+ */
+
+// set up a new slot array of size 'size' in 'table', with every slot free
+static void initialise_slots(StrLinearHashTable *table, int size) {
+	assert(size < MAX_TABLE_SIZE && "error: table has grown too large!");
+
+	table->slots = mem_alloc(&table->stats.memory,
+		(sizeof *table->slots) * size);
+	assert(table->slots);
+	int i;
+	for (i = 0; i < size; i++) {
+		table->slots[i].length = EMPTY;
+	}
+	table->size = size;
+}
+
+// double the size of the slot array, moving every slot to its new home using
+// its cached hash (the keys' bytes stay where they are in the arena)
+static void double_table(StrLinearHashTable *table) {
+	TimerStart start = event_start();
+	Slot *oldslots = table->slots;
+	int oldsize = table->size;
+
+	initialise_slots(table, oldsize * 2);
+
+	int i;
+	for (i = 0; i < oldsize; i++) {
+		if (oldslots[i].length != EMPTY) {
+			int h = oldslots[i].hash % table->size;
+			while (table->slots[h].length != EMPTY) {
+				h = (h + STEP_SIZE) % table->size;
+			}
+			table->slots[h] = oldslots[i];
+		}
+	}
+
+	mem_free(&table->stats.memory, oldslots, (sizeof *oldslots) * oldsize);
+	event_stop(&table->stats.resizes, start);
+}
+
+// copy the 'length' bytes at 'key' onto the end of the arena (growing it if
+// necessary), and return the offset they were copied to
+static uint32_t arena_append(StrLinearHashTable *table, const char *key,
+		int length) {
+	assert(table->arenaused + length < EMPTY && "error: arena is too large!");
+
+	if (table->arenaused + length > table->arenasize) {
+		size_t oldsize = table->arenasize;
+		while (table->arenaused + length > table->arenasize) {
+			table->arenasize *= 2;
+		}
+		table->arena = mem_realloc(&table->stats.memory, table->arena,
+			oldsize, table->arenasize);
+		assert(table->arena);
+	}
+
+	uint32_t offset = table->arenaused;
+	memcpy(table->arena + offset, key, length);
+	table->arenaused += length;
+	return offset;
+}
+
+// find the slot holding the 'length' bytes at 'key' (whose hash is 'hash') in
+// 'table', or if they're not in there, the free slot where they would go
+// (there always is one, as the table is never allowed to fill up)
+static int find_slot(StrLinearHashTable *table, int64 hash, const char *key,
+		int length) {
+	int h = hash % table->size;
+
+	while (table->slots[h].length != EMPTY) {
+		Slot *slot = &table->slots[h];
+
+		// only look at the key's bytes if everything else matches
+		if (slot->hash == hash && slot->length == (uint32_t)length) {
+			table->stats.compares++;
+			if (memcmp(table->arena + slot->offset, key, length) == 0) {
+				// found the key!
+				return h;
+			}
+			table->stats.falsematches++;
+		}
+
+		h = (h + STEP_SIZE) % table->size;
+	}
+
+	return h;
+}
+
+// the decimal digits of 'key', written into 'digits', and how many there are
+static int key_digits(int64 key, char digits[MAX_DIGITS]) {
+	return snprintf(digits, MAX_DIGITS, "%llu", key);
+}
+
+// the bytes allocated in 'table' holding no key: its empty slots, and the
+// unused end of the arena
+static int64 wasted_bytes(StrLinearHashTable *table) {
+	return (int64)(table->size - table->load) * sizeof *table->slots
+		+ (table->arenasize - table->arenaused);
+}
+
+
+/* * * *
+ * all functions
+ */
+
+// initialise a string-key linear probing hash table with initial size 'size'
+StrLinearHashTable *new_strlinear_hash_table(int size) {
+	StrLinearHashTable *table = malloc(sizeof *table);
+	assert(table);
+	mem_usage_init(&table->stats.memory, sizeof *table);
+
+	initialise_slots(table, size);
+	table->load = 0;
+
+	table->arena = mem_alloc(&table->stats.memory, INITIAL_ARENA_SIZE);
+	assert(table->arena);
+	table->arenasize = INITIAL_ARENA_SIZE;
+	table->arenaused = 0;
+
+	table->stats.collisions = 0;
+	table->stats.probe = 0;
+	table->stats.compares = 0;
+	table->stats.falsematches = 0;
+	timer_init(&table->stats.inserts);
+	timer_init(&table->stats.lookups);
+	event_init(&table->stats.resizes);
+
+	return table;
+}
+
+
+// free all memory associated with 'table'
+void free_strlinear_hash_table(StrLinearHashTable *table) {
+	assert(table != NULL);
+
+	mem_free(&table->stats.memory, table->slots,
+		sizeof *table->slots * table->size);
+	mem_free(&table->stats.memory, table->arena, table->arenasize);
+	free(table);
+}
+
+
+// insert the 'length' bytes at 'key' into 'table', if they're not in there
+// already
+// returns true if insertion succeeds, false if it was already in there
+bool strlinear_hash_table_insert_string(StrLinearHashTable *table,
+		const char *key, int length) {
+	assert(table != NULL && length >= 0);
+	TimerStart start = timer_start(&table->stats.inserts);
+
+	int64 hash = hstr(key, length);
+	int h = find_slot(table, hash, key, length);
+	bool inserted = table->slots[h].length == EMPTY;
+
+	if (inserted) {
+		// make sure there will still be a free slot after this one is used
+		if (table->load + 1 > table->size * MAX_LOAD) {
+			double_table(table);
+			h = find_slot(table, hash, key, length);
+		}
+
+		// count how far the key ended up from its home slot
+		int home = hash % table->size;
+		if (h != home) {
+			table->stats.collisions++;
+			table->stats.probe += (h - home + table->size) % table->size;
+		}
+
+		table->slots[h].hash = hash;
+		table->slots[h].offset = arena_append(table, key, length);
+		table->slots[h].length = length;
+		table->load++;
+	}
+
+	timer_stop(&table->stats.inserts, start,
+		inserted ? OP_INSERT_NEW : OP_INSERT_HIT);
+	return inserted;
+}
+
+
+// lookup whether the 'length' bytes at 'key' are inside 'table'
+// returns true if found, false if not
+bool strlinear_hash_table_lookup_string(StrLinearHashTable *table,
+		const char *key, int length) {
+	assert(table != NULL && length >= 0);
+	TimerStart start = timer_start(&table->stats.lookups);
+
+	int h = find_slot(table, hstr(key, length), key, length);
+	bool found = table->slots[h].length != EMPTY;
+
+	timer_stop(&table->stats.lookups, start,
+		found ? OP_LOOKUP_HIT : OP_LOOKUP_MISS);
+	return found;
+}
+
+
+// insert 'key' into 'table' as a string (its decimal digits), if it's not in
+// there already
+// returns true if insertion succeeds, false if it was already in there
+bool strlinear_hash_table_insert(StrLinearHashTable *table, int64 key) {
+	char digits[MAX_DIGITS];
+	int length = key_digits(key, digits);
+	return strlinear_hash_table_insert_string(table, digits, length);
+}
+
+
+// lookup whether 'key' (as a string of its decimal digits) is inside 'table'
+// returns true if found, false if not
+bool strlinear_hash_table_lookup(StrLinearHashTable *table, int64 key) {
+	char digits[MAX_DIGITS];
+	int length = key_digits(key, digits);
+	return strlinear_hash_table_lookup_string(table, digits, length);
+}
+
+
+// print the contents of 'table' to stdout
+void strlinear_hash_table_print(StrLinearHashTable *table) {
+	assert(table != NULL);
+
+	printf("--- table size: %d\n", table->size);
+
+	// print header
+	printf("   address | key\n");
+
+	// print the rows of the hash table
+	int i;
+	for (i = 0; i < table->size; i++) {
+		Slot *slot = &table->slots[i];
+
+		// print the address, then the contents of the slot
+		printf(" %9d | ", i);
+		if (slot->length != EMPTY) {
+			printf("\"%.*s\"\n", (int)slot->length,
+				table->arena + slot->offset);
+		} else {
+			printf("-\n");
+		}
+	}
+
+	printf("--- end table ---\n");
+}
+
+
+// print some statistics about 'table' to stdout
+void strlinear_hash_table_stats(StrLinearHashTable *table) {
+	assert(table != NULL);
+	printf("--- table stats ---\n");
+
+	// print some information about the table
+	printf("Current size: %d slots\n", table->size);
+	printf("Current load: %d items\n", table->load);
+	printf("Load factor: %.3f%%\n", table->load * 100.0 / table->size);
+	printf("Num Collisions: %d\n", table->stats.collisions);
+	printf("Average probe len: %.4f\n",
+		table->stats.collisions
+			? (float)table->stats.probe / table->stats.collisions : 0);
+	printf("Key bytes: %zu (arena space %zu)\n", table->arenaused,
+		table->arenasize);
+	printf("Key compares: %d (%d with matching hashes but different keys)\n",
+		table->stats.compares, table->stats.falsematches);
+	float insertsec = timer_seconds(&table->stats.inserts);
+	printf("Time taken inserting: %.6f seconds\n", insertsec);
+	float looksec = timer_seconds(&table->stats.lookups);
+	printf("Time taken looking up: %.6f seconds\n", looksec);
+	timer_print(&table->stats.inserts);
+	timer_print(&table->stats.lookups);
+	event_print(&table->stats.resizes, "resizes");
+	mem_usage_print(&table->stats.memory, table->load, wasted_bytes(table));
+	printf("   step size: %d slots\n", STEP_SIZE);
+
+	printf("--- end stats ---\n");
+}
+
+
+// fill in 'stats' with the statistics every type of table reports
+void strlinear_hash_table_get_stats(StrLinearHashTable *table,
+		TableStats *stats) {
+	assert(table != NULL && stats != NULL);
+	stats->size = table->size;
+	stats->nkeys = table->load;
+	stats->capacity = table->size;
+	table_stats_add_memory(stats, &table->stats.memory);
+	stats->wastedbytes = wasted_bytes(table);
+	stats->collisions = table->stats.collisions;
+	stats->probes = table->stats.probe;
+	table_stats_add_timer(stats, &table->stats.inserts);
+	table_stats_add_timer(stats, &table->stats.lookups);
+	table_stats_add_growths(stats, &table->stats.resizes);
+}
@@ -0,0 +1,55 @@
+/* * * * * * * * *
+ * Dynamic hash table with variable-length byte-string keys, using linear
+ * probing to resolve collisions
+ *
+ * created for COMP20007 Design of Algorithms - Assignment 2, 2017
+ * by Luke Hedt
+ */
+
+#ifndef STRLINEAR_H
+#define STRLINEAR_H
+
+#include <stdbool.h>
+#include "../inthash.h"
+#include "../tblstats.h"
+
+typedef struct strlinear_table StrLinearHashTable;
+
+// initialise a string-key linear probing hash table with initial size 'size'
+StrLinearHashTable *new_strlinear_hash_table(int size);
+
+// free all memory associated with 'table'
+void free_strlinear_hash_table(StrLinearHashTable *table);
+
+// insert the 'length' bytes at 'key' into 'table', if they're not in there
+// already
+// returns true if insertion succeeds, false if it was already in there
+bool strlinear_hash_table_insert_string(StrLinearHashTable *table,
+	const char *key, int length);
+
+// lookup whether the 'length' bytes at 'key' are inside 'table'
+// returns true if found, false if not
+bool strlinear_hash_table_lookup_string(StrLinearHashTable *table,
+	const char *key, int length);
+
+// insert 'key' into 'table' as a string (its decimal digits), if it's not in
+// there already
+// returns true if insertion succeeds, false if it was already in there
+bool strlinear_hash_table_insert(StrLinearHashTable *table, int64 key);
+
+// lookup whether 'key' (as a string of its decimal digits) is inside 'table'
+// returns true if found, false if not
+bool strlinear_hash_table_lookup(StrLinearHashTable *table, int64 key);
+
+// print the contents of 'table' to stdout
+void strlinear_hash_table_print(StrLinearHashTable *table);
+
+// print some statistics about 'table' to stdout
+void strlinear_hash_table_stats(StrLinearHashTable *table);
+
+// fill in 'stats' with the statistics every type of table reports (see
+// tblstats.h)
+void strlinear_hash_table_get_stats(StrLinearHashTable *table,
+	TableStats *stats);
+
+#endif
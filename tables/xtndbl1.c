@@ -8,95 +8,147 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <assert.h>
-#include <time.h>
+#include <stdint.h>
 
 #include "xtndbl1.h"
+#include "../instrument.h"
 
 // macro to calculate the rightmost n bits of a number x
 #define rightmostnbits(n, x) (x) & ((1 << (n)) - 1)
 
 // a bucket stores a single key (full=true) or is empty (full=false)
-// it also knows how many bits are shared between possible keys, and the first
-// table address that references it
+// it also knows how many bits are shared between possible keys. its id (the
+// first table address that references it) is not stored, but is the rightmost
+// 'depth' bits of any address that references it
+// in a hash map, the key's value follows it directly in the pool
 typedef struct bucket {
-	int id;		// a unique id for this bucket, equal to the first address
-				// in the table which points to it
-	int depth;	// how many hash value bits are being used by this bucket
-	bool full;	// does this bucket contain a key
-	int64 key;	// the key stored in this bucket
+	int depth;		// how many hash value bits are being used by this bucket
+	bool full;		// does this bucket contain a key
+	int64 key;		// the key stored in this bucket
+	int64 value[];	// the value stored with it (maps only)
 } Bucket;
 
 // helper structure to store statistics gathered
 typedef struct stats {
 	int nbuckets;	// how many distinct buckets does the table point to
 	int nkeys;		// how many keys are being stored in the table
-	int time;		// how much CPU time has been used to insert/lookup keys
+	OpTimer timer;	// times the inserts and lookups of keys
 					// in this table
+	EventTimer splits;		// times each bucket split
+	EventTimer doublings;	// times each doubling of the table
+	EventTimer batches;		// times each batch of lookups
+	MemUsage memory;		// counts the memory allocated for the table
 } Stats;
 
-// a hash table is an array of slots pointing to buckets holding up to 1 key,
-// along with some usage statistics and information about the number of hash
-// value bits to use for addressing
+// a hash table is an array of slots holding the 32-bit indices of buckets
+// (holding up to 1 key) in a contiguous pool, along with some usage statistics
+// and information about the number of hash value bits to use for addressing
 struct xtndbl1_table {
-	Bucket **buckets;	// array of pointers to buckets
-	int size;			// how many entries in the table of pointers (2^depth)
+	uint32_t *buckets;	// array of bucket indices into 'pool'
+	char *pool;			// every bucket in the table, in order of creation
+	int poolsize;		// how many buckets 'pool' has space for
+	int bucketbytes;	// size of each bucket in 'pool' (with its value, if any)
+	int size;			// how many entries in the table of indices (2^depth)
 	int depth;			// how many bits of the hash value to use (log2(size))
 	Stats stats;		// collection of statistics about this hash table
 };
 
+// how many batched lookups to keep in flight at once
+#define LOOKUP_GROUP 16
+
+// one in-flight batched lookup: which key it is for, and how far along it is
+typedef struct lookup_state {
+	enum { IDLE, DIRECTORY, BUCKET } stage;	// what to look at next
+	int i;				// index of the key being looked up
+	int address;		// table address for the key
+	Bucket *bucket;		// bucket for the key (from stage BUCKET)
+} LookupState;
+
 /* * * *
  * helper functions
  */
 
-// create a new bucket first referenced from 'first_address', based on 'depth'
-// bits of its keys' hash values
-static Bucket *new_bucket(int first_address, int depth) {
-	Bucket *bucket = malloc(sizeof *bucket);
-	assert(bucket);
+// bucket number 'index' in the pool
+#define pool_bucket(table, index) \
+	((Bucket *)((table)->pool + (size_t)(index) * (table)->bucketbytes))
 
-	bucket->id = first_address;
-	bucket->depth = depth;
-	bucket->full = false;
+// the bucket referenced from table address 'address'
+#define bucket_at(table, address) pool_bucket(table, (table)->buckets[address])
 
-	return bucket;
+// does 'table' store a value with each key?
+#define is_map(table) ((table)->bucketbytes > (int)sizeof(Bucket))
+
+// the id of the bucket referenced from table address 'address': the first
+// address in the table which points to it
+static int bucket_id(Xtndbl1HashTable *table, int address) {
+	return rightmostnbits(bucket_at(table, address)->depth, address);
+}
+
+// create a new bucket at the end of the pool based on 'depth' bits of its
+// keys' hash values, and return its index
+// (this may move the pool, so any Bucket pointers must be looked up again)
+static uint32_t new_bucket(Xtndbl1HashTable *table, int depth) {
+	if (table->stats.nbuckets == table->poolsize) {
+		table->poolsize *= 2;
+		table->pool = mem_realloc(&table->stats.memory, table->pool,
+			(size_t)table->bucketbytes * (table->poolsize / 2),
+			(size_t)table->bucketbytes * table->poolsize);
+		assert(table->pool);
+	}
+
+	uint32_t index = table->stats.nbuckets++;
+	pool_bucket(table, index)->depth = depth;
+	pool_bucket(table, index)->full = false;
+
+	return index;
 }
 
-// double the table of bucket pointers, duplicating the bucket pointers in the
-// first half into the new second half of the table
+// double the table of bucket indices, duplicating the indices in the first
+// half into the new second half of the table
 static void double_table(Xtndbl1HashTable *table) {
+	TimerStart start = event_start();
 	int size = table->size * 2;
 	assert(size < MAX_TABLE_SIZE && "error: table has grown too large!");
 
-	// get a new array of twice as many bucket pointers, and copy pointers down
-	table->buckets = realloc(table->buckets, (sizeof *table->buckets) * size);
+	// get a new array of twice as many bucket indices, and copy indices down
+	table->buckets = mem_realloc(&table->stats.memory, table->buckets,
+		(sizeof *table->buckets) * table->size,
+		(sizeof *table->buckets) * size);
 	assert(table->buckets);
-	int i;
-	for (i = 0; i < table->size; i++) {
-		table->buckets[table->size + i] = table->buckets[i];
-	}
+	memcpy(table->buckets + table->size, table->buckets,
+		(sizeof *table->buckets) * table->size);
 
 	// finally, increase the table size and the depth we are using to hash keys
 	table->size = size;
 	table->depth++;
+	event_stop_traced(&table->stats.doublings, start, "xtndbl1: double table",
+		size / 2, size);
 }
 
 // reinsert a key into the hash table after splitting a bucket --- we can assume
 // that there will definitely be space for this key because it was already
 // inside the hash table previously
 // use 'xtndbl1_hash_table_insert()' instead for inserting new keys
-static void reinsert_key(Xtndbl1HashTable *table, int64 key) {
+// (in a map, 'value' goes with it)
+static void reinsert_key(Xtndbl1HashTable *table, int64 key, int64 value) {
 	int address = rightmostnbits(table->depth, h1(key));
-	table->buckets[address]->key = key;
-	table->buckets[address]->full = true;
+	Bucket *bucket = bucket_at(table, address);
+	bucket->key = key;
+	bucket->full = true;
+	if (is_map(table)) {
+		bucket->value[0] = value;
+	}
 }
 
 // split the bucket in 'table' at address 'address', growing table if necessary
 static void split_bucket(Xtndbl1HashTable *table, int address) {
+	TimerStart start = event_start();
 
 	// FIRST,
 	// do we need to grow the table?
-	if (table->buckets[address]->depth == table->depth) {
+	if (bucket_at(table, address)->depth == table->depth) {
 		// yep, this bucket is down to its last pointer
 		double_table(table);
 	}
@@ -105,18 +157,14 @@ static void split_bucket(Xtndbl1HashTable *table, int address) {
 
 	// SECOND,
 	// create a new bucket and update both buckets' depth
-	Bucket *bucket = table->buckets[address];
-	int depth = bucket->depth;
-	int first_address = bucket->id;
+	int depth = bucket_at(table, address)->depth;
+	int first_address = bucket_id(table, address);
 
 	int new_depth = depth + 1;
+	uint32_t newbucket = new_bucket(table, new_depth);
+	Bucket *bucket = bucket_at(table, address);
 	bucket->depth = new_depth;
 
-	// new bucket's first address will be a 1 bit plus the old first address
-	int new_first_address = 1 << depth | first_address;
-	Bucket *newbucket = new_bucket(new_first_address, new_depth);
-	table->stats.nbuckets++;
-
 	// THIRD,
 	// redirect every second address pointing to this bucket to the new bucket
 	// construct addresses by joining a bit 'prefix' and a bit 'suffix'
@@ -145,52 +193,121 @@ static void split_bucket(Xtndbl1HashTable *table, int address) {
 	// filter the key from the old bucket into its rightful place in the new
 	// table (which may be the old bucket, or may be the new bucket)
 
-	// remove and reinsert the key
+	// remove and reinsert the key (and its value)
 	int64 key = bucket->key;
+	int64 value = is_map(table) ? bucket->value[0] : 0;
 	bucket->full = false;
-	reinsert_key(table, key);
+	reinsert_key(table, key, value);
+	// (sized by its number of buckets, one more than before)
+	event_stop_traced(&table->stats.splits, start, "xtndbl1: split bucket",
+		table->stats.nbuckets - 1, table->stats.nbuckets);
 }
 
+// find the bucket holding 'key' in 'table', or return NULL if it's not there
+static Bucket *find_key(Xtndbl1HashTable *table, int64 key) {
+	// calculate table address for this key
+	int address = rightmostnbits(table->depth, h1(key));
 
-/* * * *
- * all functions
- */
+	// look for the key in that bucket (unless it's empty)
+	Bucket *bucket = bucket_at(table, address);
+	if (bucket->full && bucket->key == key) {
+		return bucket;
+	}
+	return NULL;
+}
 
-// initialise a single-key extendible hash table
-Xtndbl1HashTable *new_xtndbl1_hash_table() {
+// insert 'key' into 'table', if it's not in there already, and return the
+// bucket holding it (splitting buckets as necessary to make space)
+// sets '*inserted' to true if it was inserted, false if it was already there
+static Bucket *insert_key(Xtndbl1HashTable *table, int64 key, bool *inserted) {
+	// calculate table address
+	int hash = h1(key);
+	int address = rightmostnbits(table->depth, hash);
+
+	// is this key already there?
+	Bucket *bucket = bucket_at(table, address);
+	if (bucket->full && bucket->key == key) {
+		*inserted = false;
+		return bucket;
+	}
+
+	// if not, make space in the table until our target bucket has space
+	while (bucket_at(table, address)->full) {
+		split_bucket(table, address);
+
+		// and recalculate address because we might now need more bits
+		address = rightmostnbits(table->depth, hash);
+	}
+
+	// there's now space! we can insert this key
+	bucket = bucket_at(table, address);
+	bucket->key = key;
+	bucket->full = true;
+	table->stats.nkeys++;
+	*inserted = true;
+	return bucket;
+}
+
+// set up a new single-key extendible hash table whose buckets are
+// 'bucketbytes' bytes each
+static Xtndbl1HashTable *new_table(int bucketbytes) {
 	Xtndbl1HashTable *table = malloc(sizeof *table);
 	assert(table);
+	mem_usage_init(&table->stats.memory, sizeof *table);
+
+	table->bucketbytes = bucketbytes;
+	table->poolsize = 1;
+	table->pool = mem_alloc(&table->stats.memory, bucketbytes);
+	assert(table->pool);
+	table->stats.nbuckets = 0;
 
 	table->size = 1;
-	table->buckets = malloc(sizeof *table->buckets);
+	table->buckets = mem_alloc(&table->stats.memory, sizeof *table->buckets);
 	assert(table->buckets);
-	table->buckets[0] = new_bucket(0, 0);
+	table->buckets[0] = new_bucket(table, 0);
 	table->depth = 0;
 
-	table->stats.nbuckets = 1;
 	table->stats.nkeys = 0;
-	table->stats.time = 0;
+	timer_init(&table->stats.timer);
+	event_init(&table->stats.splits);
+	event_init(&table->stats.doublings);
+	event_init(&table->stats.batches);
 
 	return table;
 }
 
+// the bytes allocated for buckets in 'table' holding no key (including space
+// in the pool for buckets not yet made)
+static int64 wasted_bytes(Xtndbl1HashTable *table) {
+	return (int64)(table->poolsize - table->stats.nkeys) * table->bucketbytes;
+}
+
+
+/* * * *
+ * all functions
+ */
+
+// initialise a single-key extendible hash table
+Xtndbl1HashTable *new_xtndbl1_hash_table() {
+	return new_table(sizeof(Bucket));
+}
+
+
+// initialise a single-key extendible hash map, storing a value with each key
+Xtndbl1HashTable *new_xtndbl1_hash_map() {
+	return new_table(sizeof(Bucket) + sizeof(int64));
+}
+
 
 // free all memory associated with 'table'
 void free_xtndbl1_hash_table(Xtndbl1HashTable *table) {
 	assert(table);
 
-	// loop backwards through the array of pointers, freeing buckets only as we
-	// reach their first reference
-	// (if we loop through forwards, we wouldn't know which reference was last)
-	int i;
-	for (i = table->size-1; i >= 0; i--) {
-		if (table->buckets[i]->id == i) {
-			free(table->buckets[i]);
-		}
-	}
-
-	// free the array of bucket pointers
-	free(table->buckets);
+	// free the pool of buckets and the array of bucket indices
+	mem_free(&table->stats.memory, table->pool,
+		(size_t)table->bucketbytes * table->poolsize);
+	mem_free(&table->stats.memory, table->buckets,
+		(sizeof *table->buckets) * table->size);
 
 	// free the table struct itself
 	free(table);
@@ -201,56 +318,140 @@ void free_xtndbl1_hash_table(Xtndbl1HashTable *table) {
 // returns true if insertion succeeds, false if it was already in there
 bool xtndbl1_hash_table_insert(Xtndbl1HashTable *table, int64 key) {
 	assert(table);
-	int start_time = clock(); // start timing
+	TimerStart start = timer_start(&table->stats.timer);
 
-	// calculate table address
-	int hash = h1(key);
-	int address = rightmostnbits(table->depth, hash);
+	bool inserted;
+	insert_key(table, key, &inserted);
 
-	// is this key already there?
-	if (table->buckets[address]->full && table->buckets[address]->key == key) {
-		table->stats.time += clock() - start_time; // add time elapsed
-		return false;
-	}
+	// stop timing before returning
+	timer_stop(&table->stats.timer, start,
+		inserted ? OP_INSERT_NEW : OP_INSERT_HIT);
+	return inserted;
+}
 
-	// if not, make space in the table until our target bucket has space
-	while (table->buckets[address]->full) {
-		split_bucket(table, address);
 
-		// and recalculate address because we might now need more bits
-		address = rightmostnbits(table->depth, hash);
-	}
+// lookup whether 'key' is inside 'table'
+// returns true if found, false if not
+bool xtndbl1_hash_table_lookup(Xtndbl1HashTable *table, int64 key) {
+	assert(table);
+	TimerStart start = timer_start(&table->stats.timer);
 
-	// there's now space! we can insert this key
-	table->buckets[address]->key = key;
-	table->buckets[address]->full = true;
-	table->stats.nkeys++;
+	bool found = find_key(table, key) != NULL;
 
-	// add time elapsed to total CPU time before returning
-	table->stats.time += clock() - start_time;
-	return true;
+	// stop timing before returning result
+	timer_stop(&table->stats.timer, start,
+		found ? OP_LOOKUP_HIT : OP_LOOKUP_MISS);
+	return found;
 }
 
 
-// lookup whether 'key' is inside 'table'
+// insert 'key' into map 'table' with value 'value', or if 'key' is already in
+// there, replace its value with 'value'
+// returns true if 'key' was inserted, false if it was already in there
+bool xtndbl1_hash_table_put(Xtndbl1HashTable *table, int64 key, int64 value) {
+	assert(table && is_map(table));
+	TimerStart start = timer_start(&table->stats.timer);
+
+	bool inserted;
+	insert_key(table, key, &inserted)->value[0] = value;
+
+	// stop timing before returning
+	timer_stop(&table->stats.timer, start,
+		inserted ? OP_INSERT_NEW : OP_INSERT_HIT);
+	return inserted;
+}
+
+
+// lookup 'key' in map 'table', and if it's there store its value in '*value'
 // returns true if found, false if not
-bool xtndbl1_hash_table_lookup(Xtndbl1HashTable *table, int64 key) {
+bool xtndbl1_hash_table_get(Xtndbl1HashTable *table, int64 key, int64 *value) {
+	assert(table && is_map(table));
+	TimerStart start = timer_start(&table->stats.timer);
+
+	Bucket *bucket = find_key(table, key);
+	if (bucket) {
+		*value = bucket->value[0];
+	}
+
+	// stop timing before returning result
+	timer_stop(&table->stats.timer, start,
+		bucket ? OP_LOOKUP_HIT : OP_LOOKUP_MISS);
+	return bucket != NULL;
+}
+
+
+// replace the value of 'key' in map 'table' with 'value', if 'key' is in there
+// returns true if found (and updated), false if not
+bool xtndbl1_hash_table_update(Xtndbl1HashTable *table, int64 key,
+		int64 value) {
+	assert(table && is_map(table));
+	TimerStart start = timer_start(&table->stats.timer);
+
+	Bucket *bucket = find_key(table, key);
+	if (bucket) {
+		bucket->value[0] = value;
+	}
+
+	// stop timing before returning result
+	timer_stop(&table->stats.timer, start,
+		bucket ? OP_LOOKUP_HIT : OP_LOOKUP_MISS);
+	return bucket != NULL;
+}
+
+
+// lookup whether each of the 'n' keys in 'keys' is inside 'table', storing
+// the answers in 'found', and return how many were found
+// a group of lookups is kept in flight, each one prefetching the next level
+// of the table (directory slot, then bucket) before giving way to the next
+int xtndbl1_hash_table_lookup_batch(Xtndbl1HashTable *table, int64 *keys,
+		int n, bool *found) {
 	assert(table);
-	int start_time = clock(); // start timing
+	TimerStart start = event_start();
 
-	// calculate table address for this key
-	int address = rightmostnbits(table->depth, h1(key));
+	LookupState group[LOOKUP_GROUP];
+	int g;
+	for (g = 0; g < LOOKUP_GROUP; g++) {
+		group[g].stage = IDLE;
+	}
 
-	// look for the key in that bucket (unless it's empty)
-	bool found = false;
-	if (table->buckets[address]->full) {
-		// found it?
-		found = table->buckets[address]->key == key;
+	// step each lookup in the group along until every key has been answered
+	int next = 0, remaining = n, nfound = 0;
+	while (remaining > 0) {
+		for (g = 0; g < LOOKUP_GROUP; g++) {
+			LookupState *state = &group[g];
+			switch (state->stage) {
+				case IDLE:
+					// start on the next key, if there are any left
+					if (next == n) {
+						break;
+					}
+					state->i = next++;
+					state->address = rightmostnbits(table->depth,
+						h1(keys[state->i]));
+					__builtin_prefetch(&table->buckets[state->address]);
+					state->stage = DIRECTORY;
+					break;
+				case DIRECTORY:
+					// the directory slot should be cached by now
+					state->bucket = bucket_at(table, state->address);
+					__builtin_prefetch(state->bucket);
+					state->stage = BUCKET;
+					break;
+				case BUCKET:
+					// and now the bucket: is the key there?
+					found[state->i] = state->bucket->full
+						&& state->bucket->key == keys[state->i];
+					nfound += found[state->i];
+					remaining--;
+					state->stage = IDLE;
+					break;
+			}
+		}
 	}
 
-	// add time elapsed to total CPU time before returning result
-	table->stats.time += clock() - start_time;
-	return found;
+	// stop timing before returning result
+	event_stop(&table->stats.batches, start);
+	return nfound;
 }
 
 
@@ -267,13 +468,14 @@ void xtndbl1_hash_table_print(Xtndbl1HashTable *table) {
 	int i;
 	for (i = 0; i < table->size; i++) {
 		// table entry
-		printf("%9d | %-9d ", i, table->buckets[i]->id);
+		int id = bucket_id(table, i);
+		printf("%9d | %-9d ", i, id);
 
 		// if this is the first address at which a bucket occurs, print it
-		if (table->buckets[i]->id == i) {
-			printf("%9d ", table->buckets[i]->id);
-			if (table->buckets[i]->full) {
-				printf("[%llu]", table->buckets[i]->key);
+		if (id == i) {
+			printf("%9d ", id);
+			if (bucket_at(table, i)->full) {
+				printf("[%llu]", bucket_at(table, i)->key);
 			} else {
 				printf("[ ]");
 			}
@@ -299,8 +501,36 @@ void xtndbl1_hash_table_stats(Xtndbl1HashTable *table) {
 	printf(" number of buckets: %d\n", table->stats.nbuckets);
 
 	// also calculate CPU usage in seconds and print this
-	float seconds = table->stats.time * 1.0 / CLOCKS_PER_SEC;
-	printf("    CPU time spent: %.6f sec\n", seconds);
+	float seconds = timer_seconds(&table->stats.timer)
+		+ event_seconds(&table->stats.batches);
+	printf("        time spent: %.6f sec\n", seconds);
+	timer_print(&table->stats.timer);
+	event_print(&table->stats.splits, "splits");
+	event_print(&table->stats.doublings, "doublings");
+	if (table->stats.batches.count > 0) {
+		event_print(&table->stats.batches, "lookup batches");
+	}
+	mem_usage_print(&table->stats.memory, table->stats.nkeys,
+		wasted_bytes(table));
 
 	printf("--- end stats ---\n");
 }
+
+
+// fill in 'stats' with the statistics every type of table reports
+void xtndbl1_hash_table_get_stats(Xtndbl1HashTable *table,
+		TableStats *stats) {
+	assert(table && stats);
+	stats->size = table->size;
+	stats->nkeys = table->stats.nkeys;
+	stats->capacity = table->stats.nbuckets;
+	table_stats_add_memory(stats, &table->stats.memory);
+	stats->wastedbytes = wasted_bytes(table);
+	stats->nbuckets = table->stats.nbuckets;
+	stats->bucketsize = 1;
+	stats->depth = table->depth;
+	table_stats_add_timer(stats, &table->stats.timer);
+	stats->opseconds += event_seconds(&table->stats.batches);
+	// (doublings happen during the splits that need them)
+	table_stats_add_growths(stats, &table->stats.splits);
+}
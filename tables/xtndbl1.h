@@ -11,12 +11,16 @@
 
 #include <stdbool.h>
 #include "../inthash.h"
+#include "../tblstats.h"
 
 typedef struct xtndbl1_table Xtndbl1HashTable;
 
 // initialise a single-key extendible hash table
 Xtndbl1HashTable *new_xtndbl1_hash_table();
 
+// initialise a single-key extendible hash map, storing a value with each key
+Xtndbl1HashTable *new_xtndbl1_hash_map();
+
 // free all memory associated with 'table'
 void free_xtndbl1_hash_table(Xtndbl1HashTable *table);
 
@@ -28,10 +32,33 @@ bool xtndbl1_hash_table_insert(Xtndbl1HashTable *table, int64 key);
 // returns true if found, false if not
 bool xtndbl1_hash_table_lookup(Xtndbl1HashTable *table, int64 key);
 
+// lookup whether each of the 'n' keys in 'keys' is inside 'table', storing
+// the answers in 'found', and return how many were found
+// faster than 'n' separate lookups once the table no longer fits in cache
+int xtndbl1_hash_table_lookup_batch(Xtndbl1HashTable *table, int64 *keys,
+	int n, bool *found);
+
+// insert 'key' into map 'table' with value 'value', or if 'key' is already in
+// there, replace its value with 'value'
+// returns true if 'key' was inserted, false if it was already in there
+bool xtndbl1_hash_table_put(Xtndbl1HashTable *table, int64 key, int64 value);
+
+// lookup 'key' in map 'table', and if it's there store its value in '*value'
+// returns true if found, false if not
+bool xtndbl1_hash_table_get(Xtndbl1HashTable *table, int64 key, int64 *value);
+
+// replace the value of 'key' in map 'table' with 'value', if 'key' is in there
+// returns true if found (and updated), false if not
+bool xtndbl1_hash_table_update(Xtndbl1HashTable *table, int64 key, int64 value);
+
 // print the contents of 'table' to stdout
 void xtndbl1_hash_table_print(Xtndbl1HashTable *table);
 
 // print some statistics about 'table' to stdout
 void xtndbl1_hash_table_stats(Xtndbl1HashTable *table);
 
+// fill in 'stats' with the statistics every type of table reports (see
+// tblstats.h)
+void xtndbl1_hash_table_get_stats(Xtndbl1HashTable *table, TableStats *stats);
+
 #endif
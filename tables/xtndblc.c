@@ -0,0 +1,461 @@
+/* * * * * * * * *
+ * Thread-safe dynamic hash table using extendible hashing with multiple keys
+ * per bucket, resolving collisions by incrementally growing the hash table
+ *
+ * created for COMP20007 Design of Algorithms - Assignment 2, 2017
+ * by Luke Hedt
+ *
+ * Based on xtndbln.c. Inserts and lookups take no directory lock: the table
+ * of bucket pointers and its depth are one Directory, reached through a single
+ * atomic pointer. Each bucket has its own reader/writer lock, and a thread
+ * that locked a bucket through a stale table entry (or a stale directory)
+ * sees that it no longer covers its hash value, and tries again. Doubling
+ * makes a new directory and publishes it; the old ones are kept until the
+ * table is freed, since other threads may still be reading them. Only
+ * doublings take the table's lock, to keep from doubling twice. A split
+ * redirects table entries with atomic stores under its bucket's lock, and
+ * checks the directory's version afterwards, redoing the redirection in the
+ * new directory if the table was doubled meanwhile.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <pthread.h>
+#include <sched.h>
+
+#include "xtndblc.h"
+#include "../instrument.h"
+
+// macro to calculate the rightmost n bits of a number x
+#define rightmostnbits(n, x) (x) & ((1 << (n)) - 1)
+
+
+// a bucket stores an array of keys behind its own lock
+// it also knows how many bits are shared between possible keys, and the first
+// table address that references it
+typedef struct xtndblc_bucket {
+	pthread_rwlock_t lock;	// shared by lookups, exclusive for inserts
+	int id;			// a unique id for this bucket, equal to the first address
+					// in the table which points to it
+	int depth;		// how many hash value bits are being used by this bucket
+	int nkeys;		// number of keys currently contained in this bucket
+	int64 *keys;	// the keys stored in this bucket
+} Bucket;
+
+// helper structure to store statistics gathered, updated atomically
+typedef struct stats {
+	int nbuckets;	// how many distinct buckets does the table point to
+	int nkeys;		// how many keys are being stored in the table
+	int nsplits;	// how many times a bucket has been split
+	int ndoubles;	// how many times the table of pointers has been doubled
+	EventTimer splits;		// times each bucket split
+	EventTimer doublings;	// times each doubling of the table
+	MemUsage memory;		// counts the memory allocated for the table
+} Stats;
+
+// a directory is an array of slots pointing to buckets, along with the number
+// of hash value bits to use for addressing. it is never changed in size, but
+// replaced by a new directory twice as big
+typedef struct directory {
+	struct directory *older;	// the directory this one replaced, if any
+	int size;			// how many entries in the table of pointers (2^depth)
+	int depth;			// how many bits of the hash value to use (log2(size))
+	Bucket *buckets[];	// array of pointers to buckets
+} Directory;
+
+// a hash table is a directory of buckets holding up to bucketsize keys, and
+// the lock and version number that keep doublings apart from each other and
+// from splits
+struct xtndblc_table {
+	Directory *dir;		// the current directory
+	int bucketsize;		// maximum number of keys per bucket
+	unsigned version;	// odd while the directory is being doubled
+	pthread_mutex_t growlock;	// held while doubling the directory
+	Stats stats;		// collection of statistics about this hash table
+};
+
+
+/*
+ * Helper Functions
+ */
+
+// create a new, empty bucket for 'table' first referenced from 'id', based on
+// 'depth' bits of its keys' hash values
+static Bucket *new_bucket(XtndblCHashTable *table, int id, int depth) {
+	Bucket *bucket = mem_alloc(&table->stats.memory, sizeof *bucket);
+	assert(bucket);
+	bucket->keys = mem_alloc(&table->stats.memory,
+		(sizeof *bucket->keys) * table->bucketsize);
+	assert(bucket->keys);
+
+	int err = pthread_rwlock_init(&bucket->lock, NULL);
+	assert(err == 0);
+	(void)err;
+
+	bucket->id = id;
+	bucket->depth = depth;
+	bucket->nkeys = 0;
+	return bucket;
+}
+
+// the bytes allocated for a directory of 'size' entries
+static size_t directory_bytes(int size) {
+	return sizeof (Directory) + sizeof (Bucket *) * size;
+}
+
+// read the current directory; it may be replaced by a doubling in another
+// thread at any time, but the old one stays readable
+static Directory *load_directory(XtndblCHashTable *table) {
+	return __atomic_load_n(&table->dir, __ATOMIC_ACQUIRE);
+}
+
+// read the entry for 'hash' in the current directory; entries may be
+// redirected by a split in another thread at any time
+static Bucket *load_bucket(XtndblCHashTable *table, int hash) {
+	Directory *dir = load_directory(table);
+	int address = rightmostnbits(dir->depth, hash);
+	return __atomic_load_n(&dir->buckets[address], __ATOMIC_ACQUIRE);
+}
+
+// is 'bucket' (which must be locked) still the right bucket for 'hash'?
+// it may have been split between reading its table entry and locking it
+static bool covers(Bucket *bucket, int hash) {
+	return (rightmostnbits(bucket->depth, hash)) == bucket->id;
+}
+
+// double the table of bucket pointers, making a new directory with the bucket
+// pointers of the old one in both its halves
+// must be called with the table's growlock held
+static void double_table(XtndblCHashTable *table) {
+	TimerStart start = event_start();
+	Directory *old = table->dir;
+	int size = old->size * 2;
+	assert(size < MAX_TABLE_SIZE && "error: table has grown too large!");
+
+	Directory *dir = mem_alloc(&table->stats.memory, directory_bytes(size));
+	assert(dir);
+	dir->older = old;
+	dir->size = size;
+	dir->depth = old->depth + 1;
+
+	// tell splits that a copy is under way before making it (any split still
+	// writing the old entries will see this, and write the new ones again)
+	__atomic_store_n(&table->version, table->version + 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	int i;
+	for (i = 0; i < old->size; i++) {
+		Bucket *bucket = __atomic_load_n(&old->buckets[i], __ATOMIC_ACQUIRE);
+		dir->buckets[i] = bucket;
+		dir->buckets[old->size + i] = bucket;
+	}
+
+	// finally, publish the new directory, and its depth with it
+	__atomic_store_n(&table->dir, dir, __ATOMIC_RELEASE);
+	__atomic_store_n(&table->version, table->version + 1, __ATOMIC_RELEASE);
+	table->stats.ndoubles++;
+	event_stop_atomic(&table->stats.doublings, start);
+}
+
+// point every second entry of 'dir' referring to the split bucket 'bucket'
+// (whose depth has just grown) at 'newbucket'
+static void redirect(Directory *dir, Bucket *bucket, Bucket *newbucket) {
+	int depth = bucket->depth - 1;
+	int suffix = (1 << depth) | (rightmostnbits(depth, bucket->id));
+	int maxprefix = 1 << (dir->depth - bucket->depth);
+	int prefix;
+	for (prefix = 0; prefix < maxprefix; prefix++) {
+		int a = (prefix << bucket->depth) | suffix;
+		__atomic_store_n(&dir->buckets[a], newbucket, __ATOMIC_RELEASE);
+	}
+}
+
+// split 'bucket', which has a smaller depth than the table
+// must be called with the bucket's lock held exclusively
+static void split_bucket(XtndblCHashTable *table, Bucket *bucket) {
+	TimerStart start = event_start();
+	int depth = bucket->depth;
+	int new_depth = depth + 1;
+
+	// FIRST,
+	// create the new bucket and fill it before anyone else can see it, with
+	// the keys whose new hash bit is set
+	int new_first_address = 1 << depth | bucket->id;
+	Bucket *newbucket = new_bucket(table, new_first_address, new_depth);
+
+	int i, nkeys = bucket->nkeys;
+	bucket->nkeys = 0;
+	for (i = 0; i < nkeys; i++) {
+		int64 key = bucket->keys[i];
+		if ((h1(key) >> depth) & 1) {
+			newbucket->keys[newbucket->nkeys++] = key;
+		} else {
+			bucket->keys[bucket->nkeys++] = key;
+		}
+	}
+	bucket->depth = new_depth;
+
+	// SECOND,
+	// publish it: redirect every second address pointing to the old bucket
+	// (only the holder of the old bucket's lock ever writes these entries),
+	// and if a doubling started before we were done, the entries might not
+	// have been copied to the new directory, so redirect them there too
+	// the new bucket stays locked until then: a thread that finds it through
+	// an entry already redirected must not split it (and redirect some of
+	// the same entries) while we're still writing them
+	pthread_rwlock_wrlock(&newbucket->lock);
+	unsigned version;
+	do {
+		while ((version = __atomic_load_n(&table->version, __ATOMIC_ACQUIRE))
+				& 1) {
+			// wait for the doubling to be published
+			sched_yield();
+		}
+		redirect(load_directory(table), bucket, newbucket);
+		__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	} while (__atomic_load_n(&table->version, __ATOMIC_RELAXED) != version);
+	pthread_rwlock_unlock(&newbucket->lock);
+
+	__atomic_fetch_add(&table->stats.nbuckets, 1, __ATOMIC_RELAXED);
+	__atomic_fetch_add(&table->stats.nsplits, 1, __ATOMIC_RELAXED);
+	event_stop_atomic(&table->stats.splits, start);
+}
+
+// double the table so that a bucket of depth 'depth' can be split, unless
+// another thread has already done so. called without holding any locks
+static void grow_for(XtndblCHashTable *table, int depth) {
+	pthread_mutex_lock(&table->growlock);
+	// (only doublings change the directory, and we're the only one)
+	if (table->dir->depth <= depth) {
+		double_table(table);
+	}
+	pthread_mutex_unlock(&table->growlock);
+}
+
+// the bytes allocated for keys in 'table' holding none
+static int64 wasted_bytes(XtndblCHashTable *table) {
+	int64 nslots = (int64)table->stats.nbuckets * table->bucketsize;
+	return (nslots - table->stats.nkeys) * (int64)sizeof(int64);
+}
+
+
+/*
+ * Real Functions
+ */
+
+// initialise a thread-safe extendible hash table with 'bucketsize' keys per
+// bucket
+XtndblCHashTable *new_xtndblc_hash_table(int bucketsize) {
+	XtndblCHashTable *table = malloc(sizeof *table);
+	assert(table);
+	mem_usage_init(&table->stats.memory, sizeof *table);
+
+	table->bucketsize = bucketsize;
+	table->dir = mem_alloc(&table->stats.memory, directory_bytes(1));
+	assert(table->dir);
+	table->dir->older = NULL;
+	table->dir->size = 1;
+	table->dir->depth = 0;
+	table->dir->buckets[0] = new_bucket(table, 0, 0);
+	table->version = 0;
+
+	int err = pthread_mutex_init(&table->growlock, NULL);
+	assert(err == 0);
+	(void)err;
+
+	table->stats.nbuckets = 1;
+	table->stats.nkeys = 0;
+	table->stats.nsplits = 0;
+	table->stats.ndoubles = 0;
+	event_init(&table->stats.splits);
+	event_init(&table->stats.doublings);
+
+	return table;
+}
+
+
+// free all memory associated with 'table'
+void free_xtndblc_hash_table(XtndblCHashTable *table) {
+	assert(table);
+
+	// loop backwards through the array of pointers, freeing buckets only as we
+	// reach their first reference
+	Bucket **buckets = table->dir->buckets;
+	int i;
+	for (i = table->dir->size-1; i >= 0; i--) {
+		if (buckets[i]->id == i) {
+			pthread_rwlock_destroy(&buckets[i]->lock);
+			mem_free(&table->stats.memory, buckets[i]->keys,
+				sizeof *buckets[i]->keys * table->bucketsize);
+			mem_free(&table->stats.memory, buckets[i], sizeof *buckets[i]);
+		}
+	}
+
+	// then every directory, the current one and those it replaced
+	Directory *dir = table->dir;
+	while (dir) {
+		Directory *older = dir->older;
+		mem_free(&table->stats.memory, dir, directory_bytes(dir->size));
+		dir = older;
+	}
+
+	pthread_mutex_destroy(&table->growlock);
+	free(table);
+}
+
+
+// insert 'key' into 'table', if it's not in there already
+// returns true if insertion succeeds, false if it was already in there
+bool xtndblc_hash_table_insert(XtndblCHashTable *table, int64 key) {
+	assert(table);
+	int hash = h1(key);
+
+	while (true) {
+		// find and lock the target bucket, retrying if it was split under us
+		Bucket *bucket = load_bucket(table, hash);
+		pthread_rwlock_wrlock(&bucket->lock);
+		if (!covers(bucket, hash)) {
+			pthread_rwlock_unlock(&bucket->lock);
+			continue;
+		}
+
+		// is this key already there?
+		int i;
+		for (i = 0; i < bucket->nkeys; i++) {
+			if (bucket->keys[i] == key) {
+				pthread_rwlock_unlock(&bucket->lock);
+				return false;
+			}
+		}
+
+		// is there space? we can insert this key
+		if (bucket->nkeys < table->bucketsize) {
+			bucket->keys[bucket->nkeys++] = key;
+			pthread_rwlock_unlock(&bucket->lock);
+			__atomic_fetch_add(&table->stats.nkeys, 1, __ATOMIC_RELAXED);
+			return true;
+		}
+
+		// if not, split the bucket in place if the table is deep enough...
+		int depth = bucket->depth;
+		if (depth < load_directory(table)->depth) {
+			split_bucket(table, bucket);
+			pthread_rwlock_unlock(&bucket->lock);
+			continue;
+		}
+
+		// ...or let go of it and double the table first
+		pthread_rwlock_unlock(&bucket->lock);
+		grow_for(table, depth);
+	}
+}
+
+
+// lookup whether 'key' is inside 'table'
+// returns true if found, false if not
+bool xtndblc_hash_table_lookup(XtndblCHashTable *table, int64 key) {
+	assert(table);
+	int hash = h1(key);
+
+	// find and share-lock the target bucket, retrying if it was split under us
+	Bucket *bucket;
+	while (true) {
+		bucket = load_bucket(table, hash);
+		pthread_rwlock_rdlock(&bucket->lock);
+		if (covers(bucket, hash)) {
+			break;
+		}
+		pthread_rwlock_unlock(&bucket->lock);
+	}
+
+	// look for the key in that bucket
+	bool found = false;
+	int i;
+	for (i = 0; i < bucket->nkeys && !found; i++) {
+		found = bucket->keys[i] == key;
+	}
+
+	pthread_rwlock_unlock(&bucket->lock);
+	return found;
+}
+
+
+// print the contents of 'table' to stdout
+void xtndblc_hash_table_print(XtndblCHashTable *table) {
+	assert(table);
+	Bucket **buckets = table->dir->buckets;
+	printf("--- table size: %d\n", table->dir->size);
+
+	// print header
+	printf("  table:               buckets:\n");
+	printf("  address | bucketid   bucketid [key]\n");
+
+	// print table and buckets
+	int i;
+	for (i = 0; i < table->dir->size; i++) {
+		// table entry
+		printf("%9d | %-9d ", i, buckets[i]->id);
+
+		// if this is the first address at which a bucket occurs, print it now
+		if (buckets[i]->id == i) {
+			printf("%9d ", buckets[i]->id);
+
+			// print the bucket's contents
+			printf("[");
+			for(int j = 0; j < table->bucketsize; j++) {
+				if (j < buckets[i]->nkeys) {
+					printf(" %llu", buckets[i]->keys[j]);
+				} else {
+					printf(" -");
+				}
+			}
+			printf(" ]");
+		}
+		// end the line
+		printf("\n");
+	}
+
+	printf("--- end table ---\n");
+}
+
+
+// print some statistics about 'table' to stdout
+void xtndblc_hash_table_stats(XtndblCHashTable *table) {
+	assert(table);
+
+	printf("--- table stats ---\n");
+
+	// print some stats about state of the table
+	printf("current table size: %d\n", table->dir->size);
+	printf("    number of keys: %d\n", table->stats.nkeys);
+	printf(" number of buckets: %d\n", table->stats.nbuckets);
+	printf("     buckets split: %d\n", table->stats.nsplits);
+	printf("     table doubled: %d times\n", table->stats.ndoubles);
+	event_print(&table->stats.splits, "splits");
+	event_print(&table->stats.doublings, "doublings");
+	mem_usage_print(&table->stats.memory, table->stats.nkeys,
+		wasted_bytes(table));
+
+	printf("--- end stats ---\n");
+}
+
+
+// fill in 'stats' with the statistics every type of table reports
+void xtndblc_hash_table_get_stats(XtndblCHashTable *table,
+		TableStats *stats) {
+	assert(table && stats);
+	stats->size = table->dir->size;
+	stats->nkeys = table->stats.nkeys;
+	stats->capacity = (int64)table->stats.nbuckets * table->bucketsize;
+	table_stats_add_memory(stats, &table->stats.memory);
+	stats->wastedbytes = wasted_bytes(table);
+	stats->nbuckets = table->stats.nbuckets;
+	stats->bucketsize = table->bucketsize;
+	stats->depth = table->dir->depth;
+	// (inserts double the table before splitting, rather than during)
+	table_stats_add_growths(stats, &table->stats.splits);
+	table_stats_add_growths(stats, &table->stats.doublings);
+}
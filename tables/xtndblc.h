@@ -0,0 +1,48 @@
+/* * * * * * * * *
+ * Thread-safe dynamic hash table using extendible hashing with multiple keys
+ * per bucket, resolving collisions by incrementally growing the hash table
+ *
+ * insert and lookup may be called from many threads at once: lookups share
+ * the target bucket, inserts lock only the target bucket, and neither locks
+ * the table of bucket pointers, which is only locked while it is being doubled.
+ * print and stats must not run concurrently with other operations
+ *
+ * created for COMP20007 Design of Algorithms - Assignment 2, 2017
+ * by Luke Hedt
+ */
+
+#ifndef XTNDBLC_H
+#define XTNDBLC_H
+
+#include <stdbool.h>
+#include "../inthash.h"
+#include "../tblstats.h"
+
+typedef struct xtndblc_table XtndblCHashTable;
+
+// initialise a thread-safe extendible hash table with 'bucketsize' keys per
+// bucket
+XtndblCHashTable *new_xtndblc_hash_table(int bucketsize);
+
+// free all memory associated with 'table'
+void free_xtndblc_hash_table(XtndblCHashTable *table);
+
+// insert 'key' into 'table', if it's not in there already
+// returns true if insertion succeeds, false if it was already in there
+bool xtndblc_hash_table_insert(XtndblCHashTable *table, int64 key);
+
+// lookup whether 'key' is inside 'table'
+// returns true if found, false if not
+bool xtndblc_hash_table_lookup(XtndblCHashTable *table, int64 key);
+
+// print the contents of 'table' to stdout
+void xtndblc_hash_table_print(XtndblCHashTable *table);
+
+// print some statistics about 'table' to stdout
+void xtndblc_hash_table_stats(XtndblCHashTable *table);
+
+// fill in 'stats' with the statistics every type of table reports (see
+// tblstats.h)
+void xtndblc_hash_table_get_stats(XtndblCHashTable *table, TableStats *stats);
+
+#endif
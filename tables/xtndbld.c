@@ -0,0 +1,637 @@
+/* * * * * * * * *
+ * Disk-resident hash table using extendible hashing with page-sized buckets,
+ * resolving collisions by incrementally growing the hash table
+ *
+ * created for COMP20007 Design of Algorithms - Assignment 2, 2017
+ * by Luke Hedt
+ *
+ * Based on xtndbln.c, with each bucket stored as one page of a data file.
+ * A lookup costs at most one page read, an insert one read and one write, and
+ * a split writes only the two pages involved.
+ *
+ * The header file is only rewritten by sync() and free, so each split is also
+ * appended to a log of splits ('path'.log), and opening a table replays the
+ * log, so a process that dies without freeing its table loses no keys. A split
+ * syncs its new page and then its log record to disk before writing back the
+ * smaller split page (see split_page()). Other page writes are not synced, so
+ * a power failure may lose the latest inserts, but never the keys a split
+ * moved. sync() and free sync the data file, write a new header file and
+ * rename it over the old one, and only then empty the log.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <assert.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "xtndbld.h"
+#include "../instrument.h"
+
+// macro to calculate the rightmost n bits of a number x
+#define rightmostnbits(n, x) (x) & ((1 << (n)) - 1)
+
+// how many keys fit into a page after its header
+#define PAGE_NKEYS ((XTNDBLD_PAGE_SIZE - 4 * sizeof(int32_t)) / sizeof(int64))
+
+// identifies a header file written by this module
+#define DIR_MAGIC "XTNDBLD2"
+
+// a page is a bucket as it is laid out on disk: it stores an array of keys,
+// and also knows how many bits are shared between its keys and the first
+// table address that references it
+typedef struct page {
+	int32_t id;		// a unique id for this bucket, equal to the first address
+					// in the table which points to it
+	int32_t depth;	// how many hash value bits are being used by this bucket
+	int32_t nkeys;	// number of keys currently contained in this bucket
+	int32_t unused;	// padding, keeps the keys 8-byte aligned
+	int64 keys[PAGE_NKEYS];	// the keys stored in this bucket
+} Page;
+
+// the fixed-size part of the header file, followed on disk by 'size' page
+// numbers (the table) and then 'npages' page depths
+typedef struct dir_header {
+	char magic[8];		// always DIR_MAGIC
+	int32_t pagesize;	// XTNDBLD_PAGE_SIZE when the file was written
+	int32_t depth;		// how many bits of the hash value to use
+	int32_t npages;		// how many pages are in the data file
+	int32_t nkeys;		// how many keys are stored in the data file
+	int32_t open;		// 1 if the table was still open when this was
+						// written (so more keys may have been stored since)
+} DirHeader;
+
+// a log record describes one page split, so that a header file written
+// before the split can be brought up to date by repeating it
+typedef struct split_record {
+	int32_t id;			// the first table address of the page that was split
+	int32_t depth;		// the depth of both pages after the split
+	uint32_t pageno;	// the page that was split
+	uint32_t newpageno;	// the page that took the keys with the new bit set
+} SplitRecord;
+
+// helper structure to store statistics gathered
+typedef struct stats {
+	int nkeys;		// how many keys are being stored in the table
+	long reads;		// how many pages have been read since opening
+	long writes;	// how many pages have been written since opening
+	long syncs;		// how many times a file has been synced to disk
+	OpTimer timer;	// times the inserts and lookups of keys
+					// in this table
+	EventTimer splits;		// times each page split (with its writes)
+	EventTimer doublings;	// times each doubling of the table
+	MemUsage memory;		// counts the memory allocated for the table
+} Stats;
+
+// a disk-resident hash table is an in-memory array of page numbers, along with
+// the open data file holding the pages and two page-sized buffers
+struct xtndbld_table {
+	uint32_t *pages;	// array of page numbers (the table)
+	uint8_t *depths;	// the depth of each page, indexed by page number
+	int size;			// how many entries in the table of pages (2^depth)
+	int depth;			// how many bits of the hash value to use (log2(size))
+	int npages;			// how many pages are in the data file
+	int maxpages;		// how many pages 'depths' has space for
+	int fd;				// the open data file
+	int logfd;			// the open log of splits since the header was written
+	char *dirpath;		// where to write the header file back to
+	Page *page;			// buffer holding the page currently being worked on
+	Page *spare;		// second buffer, used while splitting a page
+	Stats stats;		// collection of statistics about this hash table
+};
+
+
+/*
+ * Helper Functions
+ */
+
+// join 'path' and 'ext' into a string newly allocated for 'table'
+static char *path_with_ext(XtndblDHashTable *table, char *path, char *ext) {
+	char *joined = mem_alloc(&table->stats.memory,
+		strlen(path) + strlen(ext) + 1);
+	assert(joined);
+	strcpy(joined, path);
+	strcat(joined, ext);
+	return joined;
+}
+
+// read page number 'pageno' from the data file into 'page'
+static void read_page(XtndblDHashTable *table, uint32_t pageno, Page *page) {
+	ssize_t n = pread(table->fd, page, sizeof *page,
+		(off_t)pageno * XTNDBLD_PAGE_SIZE);
+	assert(n == sizeof *page && "error: could not read page");
+	table->stats.reads++;
+}
+
+// write 'page' to the data file as page number 'pageno'
+static void write_page(XtndblDHashTable *table, uint32_t pageno, Page *page) {
+	ssize_t n = pwrite(table->fd, page, sizeof *page,
+		(off_t)pageno * XTNDBLD_PAGE_SIZE);
+	assert(n == sizeof *page && "error: could not write page");
+	table->stats.writes++;
+}
+
+// make sure everything written to 'fd' so far is on disk
+static void sync_file(XtndblDHashTable *table, int fd) {
+	int err = fdatasync(fd);
+	assert(err == 0 && "error: could not sync index file");
+	table->stats.syncs++;
+}
+
+// reset 'page' to an empty bucket with the given id and depth
+static void init_page(Page *page, int id, int depth) {
+	memset(page, 0, sizeof *page);
+	page->id = id;
+	page->depth = depth;
+}
+
+// append a page number to the data file, and return its number
+static uint32_t new_page(XtndblDHashTable *table, int depth) {
+	if (table->npages == table->maxpages) {
+		int maxpages = table->maxpages > 0 ? table->maxpages * 2 : 1;
+		table->depths = mem_realloc(&table->stats.memory, table->depths,
+			table->maxpages, maxpages);
+		assert(table->depths);
+		table->maxpages = maxpages;
+	}
+	uint32_t pageno = table->npages++;
+	table->depths[pageno] = depth;
+	return pageno;
+}
+
+// double the table of page numbers, duplicating the page numbers in the
+// first half into the new second half of the table
+static void double_table(XtndblDHashTable *table) {
+	TimerStart start = event_start();
+	int size = table->size * 2;
+	assert(size < MAX_TABLE_SIZE && "error: table has grown too large!");
+
+	// get a new array of twice as many page numbers, and copy them down
+	table->pages = mem_realloc(&table->stats.memory, table->pages,
+		(sizeof *table->pages) * table->size, (sizeof *table->pages) * size);
+	assert(table->pages);
+	memcpy(table->pages + table->size, table->pages,
+		(sizeof *table->pages) * table->size);
+
+	// finally, increase the table size and the depth we are using to hash keys
+	table->size = size;
+	table->depth++;
+	event_stop(&table->stats.doublings, start);
+}
+
+// redirect every second address referencing the page with first address 'id'
+// (whose depth is now 'new_depth') to page 'newpageno'
+static void redirect(XtndblDHashTable *table, int id, int new_depth,
+		uint32_t newpageno) {
+	int depth = new_depth - 1;
+	int suffix = (1 << depth) | (rightmostnbits(depth, id));
+	int maxprefix = 1 << (table->depth - new_depth);
+	int prefix;
+	for (prefix = 0; prefix < maxprefix; prefix++) {
+		table->pages[(prefix << new_depth) | suffix] = newpageno;
+	}
+}
+
+// move the keys of 'page' whose hash value bit 'bit' is set to 'newpage' (if
+// it is not NULL), compacting 'page' as we go
+static void move_keys(Page *page, Page *newpage, int bit) {
+	int i, nkeys = page->nkeys;
+	page->nkeys = 0;
+	for (i = 0; i < nkeys; i++) {
+		int64 key = page->keys[i];
+		if (!((h1(key) >> bit) & 1)) {
+			page->keys[page->nkeys++] = key;
+		} else if (newpage) {
+			newpage->keys[newpage->nkeys++] = key;
+		}
+	}
+}
+
+// split the page held in table->page (found at address 'address'), growing the
+// table if necessary. both halves are written back to disk, and the buffer
+// that 'hash' now addresses is left in table->page
+static void split_page(XtndblDHashTable *table, int address, int hash) {
+	TimerStart start = event_start();
+
+	// FIRST,
+	// do we need to grow the table?
+	Page *page = table->page;
+	uint32_t pageno = table->pages[address];
+	if (page->depth >= table->depth) {
+		// yep, this page is down to its last reference
+		double_table(table);
+	}
+
+	// SECOND,
+	// create a new page and update both pages' depth
+	int depth = page->depth;
+	int new_depth = depth + 1;
+	page->depth = new_depth;
+	table->depths[pageno] = new_depth;
+
+	// new page's first address will be a 1 bit plus the old first address
+	int new_first_address = 1 << depth | page->id;
+	Page *newpage = table->spare;
+	init_page(newpage, new_first_address, new_depth);
+	uint32_t newpageno = new_page(table, new_depth);
+
+	// THIRD,
+	// redirect every second address referencing the old page to the new page,
+	// and move the keys with the new bit set over to the new page
+	redirect(table, page->id, new_depth, newpageno);
+	move_keys(page, newpage, depth);
+
+	// FINALLY,
+	// write both pages out: the new page and the log record describing the
+	// split must be on disk before the old page loses its keys, so that until
+	// then the old page still holds all of them
+	write_page(table, newpageno, newpage);
+	sync_file(table, table->fd);
+	SplitRecord record = { page->id, new_depth, pageno, newpageno };
+	ssize_t n = write(table->logfd, &record, sizeof record);
+	assert(n == sizeof record && "error: could not write index log");
+	sync_file(table, table->logfd);
+	write_page(table, pageno, page);
+
+	// keep whichever page the pending key belongs in as the working page
+	if ((hash >> depth) & 1) {
+		table->page = newpage;
+		table->spare = page;
+	}
+	event_stop(&table->stats.splits, start);
+}
+
+// write the header file describing 'table' (noting whether it is still
+// 'open'), replacing the old one only once the new one is on disk, then empty
+// the log of splits, which the new header file already includes
+static void write_header(XtndblDHashTable *table, bool open) {
+	// the pages the header refers to must reach the disk first
+	sync_file(table, table->fd);
+
+	DirHeader header;
+	memset(&header, 0, sizeof header);
+	memcpy(header.magic, DIR_MAGIC, sizeof header.magic);
+	header.pagesize = XTNDBLD_PAGE_SIZE;
+	header.depth = table->depth;
+	header.npages = table->npages;
+	header.nkeys = table->stats.nkeys;
+	header.open = open;
+
+	char *tmppath = path_with_ext(table, table->dirpath, ".tmp");
+	FILE *dir = fopen(tmppath, "wb");
+	assert(dir && "error: could not write index header file");
+	fwrite(&header, sizeof header, 1, dir);
+	fwrite(table->pages, sizeof *table->pages, table->size, dir);
+	fwrite(table->depths, 1, table->npages, dir);
+	int err = fflush(dir) != 0 || fsync(fileno(dir)) != 0;
+	err |= fclose(dir) != 0;
+	assert(!err && "error: could not write index header file");
+	table->stats.syncs++;
+	err = rename(tmppath, table->dirpath);
+	assert(err == 0 && "error: could not replace index header file");
+	mem_free(&table->stats.memory, tmppath, strlen(tmppath) + 1);
+
+	err = ftruncate(table->logfd, 0) != 0 || lseek(table->logfd, 0, SEEK_SET);
+	assert(!err && "error: could not empty index log");
+	sync_file(table, table->logfd);
+}
+
+// repeat each split in the log that the header file doesn't include yet,
+// finishing any whose split page was not written back, and return how many
+// there were
+static int replay_log(XtndblDHashTable *table) {
+	int nreplayed = 0;
+	SplitRecord record;
+	// (a record cut short by a crash was written before its split page was,
+	// so it can be ignored)
+	while (read(table->logfd, &record, sizeof record) == sizeof record) {
+		if (record.newpageno < (uint32_t)table->npages) {
+			continue;	// the header file was written after this split
+		}
+		assert(record.newpageno == (uint32_t)table->npages
+			&& "error: index log does not match its header file");
+		while (table->depth < record.depth) {
+			double_table(table);
+		}
+		table->depths[record.pageno] = record.depth;
+		new_page(table, record.depth);
+		redirect(table, record.id, record.depth, record.newpageno);
+
+		// the new page is already on disk, but the split page might still
+		// hold the keys that moved to it
+		Page *page = table->page;
+		read_page(table, record.pageno, page);
+		if (page->depth < record.depth) {
+			page->depth = record.depth;
+			move_keys(page, NULL, record.depth - 1);
+			write_page(table, record.pageno, page);
+		}
+		nreplayed++;
+	}
+	return nreplayed;
+}
+
+// count the keys in every page of 'table', when the header file's count may be
+// out of date
+static int count_keys(XtndblDHashTable *table) {
+	int nkeys = 0;
+	uint32_t pageno;
+	for (pageno = 0; pageno < (uint32_t)table->npages; pageno++) {
+		read_page(table, pageno, table->page);
+		nkeys += table->page->nkeys;
+	}
+	return nkeys;
+}
+
+// create a fresh, empty table with its data file at 'datpath' and its log of
+// splits at 'logpath'
+static void create_files(XtndblDHashTable *table, char *datpath,
+		char *logpath) {
+	table->fd = open(datpath, O_RDWR | O_CREAT | O_TRUNC, 0644);
+	assert(table->fd >= 0 && "error: could not create index data file");
+	table->logfd = open(logpath, O_RDWR | O_CREAT | O_TRUNC, 0644);
+	assert(table->logfd >= 0 && "error: could not create index log");
+
+	table->size = 1;
+	table->depth = 0;
+	table->npages = 0;
+	table->maxpages = 0;
+	table->depths = NULL;
+	table->pages = mem_alloc(&table->stats.memory, sizeof *table->pages);
+	assert(table->pages);
+	table->pages[0] = new_page(table, 0);
+	table->stats.nkeys = 0;
+
+	init_page(table->page, 0, 0);
+	write_page(table, table->pages[0], table->page);
+	write_header(table, true);
+}
+
+// load an existing table's header file, then open its data file 'datpath' and
+// bring the table up to date from its log of splits at 'logpath'
+// returns false if there is no header file
+static bool load_files(XtndblDHashTable *table, char *datpath,
+		char *logpath) {
+	FILE *dir = fopen(table->dirpath, "rb");
+	if (dir == NULL) {
+		return false;
+	}
+
+	DirHeader header;
+	bool valid = fread(&header, sizeof header, 1, dir) == 1
+		&& memcmp(header.magic, DIR_MAGIC, sizeof header.magic) == 0;
+	assert(valid && "error: not an index header file (or an old version)");
+	assert(header.pagesize == XTNDBLD_PAGE_SIZE
+		&& "error: index was written with a different page size");
+
+	table->depth = header.depth;
+	table->size = 1 << header.depth;
+	table->npages = header.npages;
+	table->maxpages = header.npages;
+	table->stats.nkeys = header.nkeys;
+
+	table->pages = mem_alloc(&table->stats.memory,
+		(sizeof *table->pages) * table->size);
+	assert(table->pages);
+	table->depths = mem_alloc(&table->stats.memory, table->maxpages);
+	assert(table->depths);
+	size_t n = fread(table->pages, sizeof *table->pages, table->size, dir);
+	assert(n == (size_t)table->size && "error: truncated index header file");
+	n = fread(table->depths, 1, table->npages, dir);
+	assert(n == (size_t)table->npages && "error: truncated index header file");
+	fclose(dir);
+
+	table->fd = open(datpath, O_RDWR);
+	assert(table->fd >= 0 && "error: could not open index data file");
+	table->logfd = open(logpath, O_RDWR | O_CREAT, 0644);
+	assert(table->logfd >= 0 && "error: could not open index log");
+
+	// if the table wasn't closed, its splits since the header file was
+	// written are in the log, and its key count is out of date
+	if (replay_log(table) > 0 || header.open) {
+		table->stats.nkeys = count_keys(table);
+	}
+	write_header(table, true);
+	return true;
+}
+
+
+/*
+ * Real Functions
+ */
+
+// open the disk-resident extendible hash table stored at 'path', creating an
+// empty one if it does not exist yet
+XtndblDHashTable *open_xtndbld_hash_table(char *path) {
+	assert(path);
+
+	XtndblDHashTable *table = malloc(sizeof *table);
+	assert(table);
+	mem_usage_init(&table->stats.memory, sizeof *table);
+
+	table->page = mem_alloc(&table->stats.memory, sizeof *table->page);
+	assert(table->page);
+	table->spare = mem_alloc(&table->stats.memory, sizeof *table->spare);
+	assert(table->spare);
+
+	table->stats.reads = 0;
+	table->stats.writes = 0;
+	table->stats.syncs = 0;
+	timer_init(&table->stats.timer);
+	event_init(&table->stats.splits);
+	event_init(&table->stats.doublings);
+
+	// only the header file (and the log) is read up front, pages are read on
+	// demand
+	table->dirpath = path_with_ext(table, path, ".dir");
+	char *datpath = path_with_ext(table, path, ".dat");
+	char *logpath = path_with_ext(table, path, ".log");
+	if (!load_files(table, datpath, logpath)) {
+		create_files(table, datpath, logpath);
+	}
+	mem_free(&table->stats.memory, datpath, strlen(datpath) + 1);
+	mem_free(&table->stats.memory, logpath, strlen(logpath) + 1);
+
+	return table;
+}
+
+
+// write the table of page numbers back to disk, so that the files at 'path'
+// describe the current contents of 'table' (and are all on disk)
+void xtndbld_hash_table_sync(XtndblDHashTable *table) {
+	assert(table);
+	write_header(table, true);
+}
+
+
+// sync and close 'table', and free all memory associated with it
+void free_xtndbld_hash_table(XtndblDHashTable *table) {
+	assert(table);
+
+	write_header(table, false);
+	close(table->fd);
+	close(table->logfd);
+
+	MemUsage *memory = &table->stats.memory;
+	mem_free(memory, table->pages, sizeof *table->pages * table->size);
+	mem_free(memory, table->depths, table->maxpages);
+	mem_free(memory, table->dirpath, strlen(table->dirpath) + 1);
+	mem_free(memory, table->page, sizeof *table->page);
+	mem_free(memory, table->spare, sizeof *table->spare);
+	free(table);
+}
+
+
+// insert 'key' into 'table', if it's not in there already
+// returns true if insertion succeeds, false if it was already in there
+bool xtndbld_hash_table_insert(XtndblDHashTable *table, int64 key) {
+	assert(table);
+	TimerStart start = timer_start(&table->stats.timer);
+
+	// calculate table address, and bring in that page
+	int hash = h1(key);
+	int address = rightmostnbits(table->depth, hash);
+	read_page(table, table->pages[address], table->page);
+
+	// is this key already there?
+	int i;
+	for (i = 0; i < table->page->nkeys; i++) {
+		if (table->page->keys[i] == key) {
+			timer_stop(&table->stats.timer, start, OP_INSERT_HIT);
+			return false;
+		}
+	}
+
+	// if not, split pages until our target page has space
+	while (table->page->nkeys >= (int)PAGE_NKEYS) {
+		split_page(table, address, hash);
+
+		// and recalculate address because we might now need more bits
+		address = rightmostnbits(table->depth, hash);
+	}
+
+	// there's now space! we can insert this key and write the page back
+	table->page->keys[table->page->nkeys++] = key;
+	write_page(table, table->pages[address], table->page);
+	table->stats.nkeys++;
+
+	// stop timing before returning
+	timer_stop(&table->stats.timer, start, OP_INSERT_NEW);
+	return true;
+}
+
+
+// lookup whether 'key' is inside 'table'
+// returns true if found, false if not
+bool xtndbld_hash_table_lookup(XtndblDHashTable *table, int64 key) {
+	assert(table);
+	TimerStart start = timer_start(&table->stats.timer);
+
+	// calculate table address for this key, and read just that page
+	int address = rightmostnbits(table->depth, h1(key));
+	read_page(table, table->pages[address], table->page);
+
+	bool found = false;
+	int i;
+	for (i = 0; i < table->page->nkeys && !found; i++) {
+		found = table->page->keys[i] == key;
+	}
+
+	// stop timing before returning result
+	timer_stop(&table->stats.timer, start,
+		found ? OP_LOOKUP_HIT : OP_LOOKUP_MISS);
+	return found;
+}
+
+
+// print the contents of 'table' to stdout
+void xtndbld_hash_table_print(XtndblDHashTable *table) {
+	assert(table);
+	printf("--- table size: %d\n", table->size);
+
+	// print header
+	printf("  table:               buckets:\n");
+	printf("  address | bucketid   bucketid [key]\n");
+
+	// print table and buckets
+	int i;
+	for (i = 0; i < table->size; i++) {
+		// table entry, using the in-memory depth to find the bucket id
+		int depth = table->depths[table->pages[i]];
+		int id = rightmostnbits(depth, i);
+		printf("%9d | %-9d ", i, id);
+
+		// if this is the first address at which a bucket occurs, print it now
+		if (id == i) {
+			read_page(table, table->pages[i], table->page);
+			printf("%9d ", id);
+
+			// print the bucket's contents (pages are too big to print the
+			// empty slots as well)
+			printf("[");
+			int j;
+			for (j = 0; j < table->page->nkeys; j++) {
+				printf(" %llu", table->page->keys[j]);
+			}
+			printf(" ]");
+		}
+		// end the line
+		printf("\n");
+	}
+
+	printf("--- end table ---\n");
+}
+
+
+// print some statistics about 'table' to stdout
+void xtndbld_hash_table_stats(XtndblDHashTable *table) {
+	assert(table);
+
+	printf("--- table stats ---\n");
+
+	// print some stats about state of the table
+	printf("current table size: %d\n", table->size);
+	printf("    number of keys: %d\n", table->stats.nkeys);
+	printf(" number of buckets: %d\n", table->npages);
+	printf("  keys per bucket: %d (%d byte pages)\n",
+		(int)PAGE_NKEYS, XTNDBLD_PAGE_SIZE);
+	printf("       load factor: %.3f%%\n",
+		table->stats.nkeys * 100.0 / ((double)table->npages * PAGE_NKEYS));
+	printf("        page reads: %ld\n", table->stats.reads);
+	printf("       page writes: %ld\n", table->stats.writes);
+	printf("        file syncs: %ld\n", table->stats.syncs);
+
+	// also calculate CPU usage in seconds and print this
+	float seconds = timer_seconds(&table->stats.timer);
+	printf("        time spent: %.6f sec\n", seconds);
+	timer_print(&table->stats.timer);
+	event_print(&table->stats.splits, "page splits");
+	event_print(&table->stats.doublings, "doublings");
+	// (the empty space in pages is on disk, so none of the memory is wasted)
+	mem_usage_print(&table->stats.memory, table->stats.nkeys, 0);
+
+	printf("--- end stats ---\n");
+}
+
+
+// fill in 'stats' with the statistics every type of table reports
+void xtndbld_hash_table_get_stats(XtndblDHashTable *table,
+		TableStats *stats) {
+	assert(table && stats);
+	stats->size = table->size;
+	stats->nkeys = table->stats.nkeys;
+	stats->capacity = (int64)table->npages * PAGE_NKEYS;
+	// (only the directory and page buffers are in memory; the pages, and
+	// their empty space, are in the data file)
+	table_stats_add_memory(stats, &table->stats.memory);
+	stats->nbuckets = table->npages;
+	stats->bucketsize = PAGE_NKEYS;
+	stats->depth = table->depth;
+	table_stats_add_timer(stats, &table->stats.timer);
+	// (doublings happen during the splits that need them)
+	table_stats_add_growths(stats, &table->stats.splits);
+}
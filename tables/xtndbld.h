@@ -0,0 +1,56 @@
+/* * * * * * * * *
+ * Disk-resident hash table using extendible hashing with page-sized buckets,
+ * resolving collisions by incrementally growing the hash table
+ *
+ * buckets are fixed-size pages in a data file ('path'.dat), and the table of
+ * page numbers lives in a small header file ('path'.dir) which is loaded when
+ * the table is opened and written back when it is synced or freed. the splits
+ * made in between are logged ('path'.log) as they happen, so that a table
+ * which was never freed (after a crash) loses none of its keys when reopened
+ *
+ * created for COMP20007 Design of Algorithms - Assignment 2, 2017
+ * by Luke Hedt
+ */
+
+#ifndef XTNDBLD_H
+#define XTNDBLD_H
+
+#include <stdbool.h>
+#include "../inthash.h"
+#include "../tblstats.h"
+
+// the size of a single bucket page on disk, in bytes
+#define XTNDBLD_PAGE_SIZE 4096
+
+typedef struct xtndbld_table XtndblDHashTable;
+
+// open the disk-resident extendible hash table stored at 'path', creating an
+// empty one if it does not exist yet
+XtndblDHashTable *open_xtndbld_hash_table(char *path);
+
+// write the table of page numbers back to disk, so that the files at 'path'
+// describe the current contents of 'table'
+void xtndbld_hash_table_sync(XtndblDHashTable *table);
+
+// sync and close 'table', and free all memory associated with it
+void free_xtndbld_hash_table(XtndblDHashTable *table);
+
+// insert 'key' into 'table', if it's not in there already
+// returns true if insertion succeeds, false if it was already in there
+bool xtndbld_hash_table_insert(XtndblDHashTable *table, int64 key);
+
+// lookup whether 'key' is inside 'table'
+// returns true if found, false if not
+bool xtndbld_hash_table_lookup(XtndblDHashTable *table, int64 key);
+
+// print the contents of 'table' to stdout
+void xtndbld_hash_table_print(XtndblDHashTable *table);
+
+// print some statistics about 'table' to stdout
+void xtndbld_hash_table_stats(XtndblDHashTable *table);
+
+// fill in 'stats' with the statistics every type of table reports (see
+// tblstats.h)
+void xtndbld_hash_table_get_stats(XtndblDHashTable *table, TableStats *stats);
+
+#endif
@@ -15,99 +15,330 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <assert.h>
-#include <time.h>
+#include <stdint.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 #include "xtndbln.h"
+#include "../instrument.h"
+#include "../threadpool.h"
 
 // macro to calculate the rightmost n bits of a number x
 #define rightmostnbits(n, x) (x) & ((1 << (n)) - 1)
 
 
-// a bucket stores an array of keys
-// it also knows how many bits are shared between possible keys, and the first
-// table address that references it
+// a bucket is described by how many bits are shared between possible keys,
+// and how many keys it has. the bucket's id (the first table address that
+// references it) is not stored, but is the rightmost 'depth' bits of any
+// address that references it
 typedef struct xtndbln_bucket {
-	int id;			// a unique id for this bucket, equal to the first address
-					// in the table which points to it
-	int depth;		// how many hash value bits are being used by this bucket
-	int nkeys;		// number of keys currently contained in this bucket
-	int64 *keys;	// the keys stored in this bucket
+	uint16_t nkeys;		// number of keys currently contained in this bucket
+	uint8_t depth;		// how many hash value bits are being used by this bucket
 } Bucket;
 
+// each directory entry is the index of its bucket followed by a small Bloom
+// filter of the bucket's keys, so that most lookups for keys that aren't there
+// are answered from the directory alone. an entry is a power of two uint32s,
+// at most this many, so entries never straddle a cache line
+#define MAX_ENTRY_WORDS 16
+
+// a bucket referenced by more than 2^MAX_FILTER_ALIASES addresses has no
+// filter (its entries' filter bits are all set), so that no insert or split
+// rewrites more than that many entries
+#define MAX_FILTER_ALIASES 6
+
 // helper structure to store statistics gathered
 typedef struct stats {
 	int nbuckets;	// how many distinct buckets does the table point to
 	int nkeys;		// how many keys are being stored in the table
-	int time;		// how much CPU time has been used to insert/lookup keys
+	int nlookups;	// how many lookups have been made (including for inserts)
+	int nfiltered;	// how many of them were answered by the directory alone
+	OpTimer timer;	// times the inserts and lookups of keys
 					// in this table
+	EventTimer splits;		// times each bucket split
+	EventTimer doublings;	// times each doubling of the directory
+	EventTimer batches;		// times each batch of lookups
+	EventTimer builds;		// times building the table from an array of keys
+	MemUsage memory;		// counts the memory allocated for the table
 } Stats;
 
-// a hash table is an array of slots pointing to buckets holding up to
-// bucketsize keys, along with some information about the number of hash value
-// bits to use for addressing
+// a function to search the first 'nkeys' of a bucket's 'keys' for 'key',
+// returning its index (or -1 if it's not there)
+typedef int (*ScanFunction)(const int64 *keys, int nkeys, int64 key);
+
+// a hash table is a directory of entries pointing to buckets holding up to
+// bucketsize keys, whose descriptions and keys are stored one bucket after
+// another in two arrays, along with some information about the number of hash
+// value bits to use for addressing
+// in a hash map, each bucket's keys are followed by their values, so the value
+// of the key in slot i of a bucket is 'bucketsize' slots after it
 struct xtndbln_table {
-	Bucket **buckets;	// array of pointers to buckets
-	int size;			// how many entries in the table of pointers (2^depth)
+	uint32_t *directory;	// array of entries (one per address): a bucket
+						// index, then that bucket's filter
+	int entryshift;		// log2 of the uint32s per directory entry
+	int filterbits;		// how many bits each entry's filter has
+	Bucket *pool;		// every bucket's description, bucket by bucket
+	int64 *keys;		// every bucket's keys (and values), bucket by bucket
+	int poolsize;		// how many buckets 'pool' and 'keys' have space for
+	int size;			// how many entries in the directory (2^depth)
 	int depth;			// how many bits of the hash value to use (log2(size))
 	int bucketsize;		// maximum number of keys per bucket
+	int stride;			// int64s per bucket in 'keys': bucketsize in a set,
+						// twice that (keys, then values) in a map
+	ScanFunction scan;	// bucket search specialised for 'bucketsize', if any
 	Stats stats;		// collection of statistics about this hash table
 };
 
+/* How many batched lookups to keep in flight at once. */
+#define LOOKUP_GROUP 16
+
+/* One in-flight batched lookup: which key it's for and how far along it is. */
+typedef struct lookup_state {
+	enum { IDLE, DIRECTORY, KEYS } stage;	// what to look at next
+	int i;				// index of the key being looked up
+	int address;		// table address for the key
+	uint32_t bucket;	// index of the key's bucket (from stage KEYS)
+} LookupState;
+
+/* Which bit of which filter word each of a key's two filter bits is. */
+typedef struct filter_bits {
+	int word1, word2;
+	uint32_t bit1, bit2;
+} FilterBits;
+
 
 /*
  * Helper Functions
  */
-/* Initialises a Bucket with size 'bucketsize.' */
-static void init_bucket(Bucket *bucket, int id, int depth, int bucksize) {
-    /* Don't play with memory that isn't yours! */
-    assert(bucket);
+// the directory entry for address 'address'
+#define entry_at(table, address) \
+	((table)->directory + ((size_t)(address) << (table)->entryshift))
+
+// the keys of bucket number 'index'
+#define bucket_keys(table, index) \
+	((table)->keys + (size_t)(index) * (table)->stride)
+
+// does 'table' store a value with each key?
+#define is_map(table) ((table)->stride > (table)->bucketsize)
+
+/* The two filter bits for 'key' in 'table's filters. These come from h2,
+ * because every key in a bucket shares the low bits of h1 and they would tell
+ * the keys apart badly; each 15 bits of it are scaled to a bit position by a
+ * multiply, as the number of bits needn't be a power of two. */
+static FilterBits filter_bits(XtndblNHashTable *table, int64 key) {
+	unsigned hash = h2(key);
+	int bit1 = ((hash & 0x7fff) * table->filterbits) >> 15;
+	int bit2 = (((hash >> 15) & 0x7fff) * table->filterbits) >> 15;
+	FilterBits bits = { bit1 / 32, bit2 / 32, 1u << (bit1 % 32),
+		1u << (bit2 % 32) };
+	return bits;
+}
+
+/* Could the bucket of directory entry 'entry' contain the key with 'bits'? */
+static bool might_contain(const uint32_t *entry, FilterBits bits) {
+	const uint32_t *filter = entry + 1;
+	return (filter[bits.word1] & bits.bit1) && (filter[bits.word2] & bits.bit2);
+}
+
+/* Adds the key with 'bits' to 'filter'. */
+static void filter_add(uint32_t *filter, FilterBits bits) {
+	filter[bits.word1] |= bits.bit1;
+	filter[bits.word2] |= bits.bit2;
+}
+
+/* Does a bucket of depth 'depth' have few enough addresses to keep a filter? */
+static bool has_filter(XtndblNHashTable *table, int depth) {
+	return table->depth - depth <= MAX_FILTER_ALIASES;
+}
+
+/* Fills in 'filter' for bucket number 'index': the union of its keys' bits,
+ * or every bit if it has too many addresses to keep one. */
+static void make_filter(XtndblNHashTable *table, uint32_t index,
+		uint32_t *filter) {
+	int nwords = table->filterbits / 32;
+	Bucket *bucket = &table->pool[index];
+	if (!has_filter(table, bucket->depth)) {
+		memset(filter, 0xff, sizeof *filter * nwords);
+		return;
+	}
+	memset(filter, 0, sizeof *filter * nwords);
+	int64 *keys = bucket_keys(table, index);
+	int i;
+	for (i = 0; i < bucket->nkeys; i++) {
+		filter_add(filter, filter_bits(table, keys[i]));
+	}
+}
+
+/* Points every address of the bucket with id 'id' and depth 'depth' at bucket
+ * number 'index', with filter 'filter'. */
+static void set_entries(XtndblNHashTable *table, int id, int depth,
+		uint32_t index, const uint32_t *filter) {
+	size_t filterbytes = sizeof *filter * (table->filterbits / 32);
+	int address;
+	for (address = id; address < table->size; address += 1 << depth) {
+		uint32_t *entry = entry_at(table, address);
+		entry[0] = index;
+		memcpy(entry + 1, filter, filterbytes);
+	}
+}
+
+/* Searches the first 'nkeys' of 'keys' for 'key', for any bucket size. */
+static int scan_keys(const int64 *keys, int nkeys, int64 key) {
+	int i;
+	for (i = 0; i < nkeys; i++) {
+		if (keys[i] == key) {
+			return i;
+		}
+	}
+	return -1;
+}
 
-    /* Create a safe space for the keys in the bucket. */
-    bucket->keys = malloc(sizeof(bucket->keys) * bucksize);
-    assert(bucket->keys);
+/* How many keys the specialised searches compare at once: one 64-byte cache
+ * line's worth, so they stop reading a bucket as soon as a line matches. */
+#define SCAN_CHUNK 8
+
+/* Sets the bit i of 'matches' for each of the first 'width' of 'keys' that
+ * equals 'key'. With SSE2 (always there on x86-64) the keys are compared two
+ * at a time: 64-bit lanes are equal when both of their 32-bit halves are. */
+#ifdef __SSE2__
+#define MATCH_KEYS(keys, width, key, matches) do { \
+	__m128i wanted_ = _mm_set1_epi64x(key); \
+	int i_; \
+	_Pragma("GCC unroll 8") \
+	for (i_ = 0; i_ < (width); i_ += 2) { \
+		__m128i eq_ = _mm_cmpeq_epi32(wanted_, \
+			_mm_loadu_si128((const __m128i *)((keys) + i_))); \
+		eq_ = _mm_and_si128(eq_, _mm_shuffle_epi32(eq_, \
+			_MM_SHUFFLE(2, 3, 0, 1))); \
+		(matches) |= (unsigned)_mm_movemask_pd(_mm_castsi128_pd(eq_)) << i_; \
+	} \
+} while (0)
+#else
+#define MATCH_KEYS(keys, width, key, matches) do { \
+	int i_; \
+	_Pragma("GCC unroll 8") \
+	for (i_ = 0; i_ < (width); i_++) { \
+		(matches) |= (unsigned)((keys)[i_] == (key)) << i_; \
+	} \
+} while (0)
+#endif
+
+/* Defines scan_keys_N(), the same search specialised for buckets of exactly N
+ * keys (a multiple of 2). With a fixed width the compares within each chunk
+ * unroll into straight-line code with no branches; slots past 'nkeys' in the
+ * last chunk are compared too, but their matches are masked out (those slots
+ * are always zero, so never uninitialised). */
+#define DEFINE_SCAN_KEYS(N) \
+static int scan_keys_##N(const int64 *keys, int nkeys, int64 key) { \
+	int chunk; \
+	for (chunk = 0; chunk < N && chunk < nkeys; chunk += SCAN_CHUNK) { \
+		unsigned matches = 0; \
+		MATCH_KEYS(keys + chunk, N < SCAN_CHUNK ? N : SCAN_CHUNK, key, \
+			matches); \
+		if (nkeys - chunk < SCAN_CHUNK) { \
+			matches &= (1u << (nkeys - chunk)) - 1; \
+		} \
+		if (matches) { \
+			return chunk + __builtin_ctz(matches); \
+		} \
+	} \
+	return -1; \
+}
+
+DEFINE_SCAN_KEYS(4)
+DEFINE_SCAN_KEYS(8)
+DEFINE_SCAN_KEYS(16)
+DEFINE_SCAN_KEYS(32)
+
+/* The fastest search for buckets of 'bucketsize' keys. */
+static ScanFunction choose_scan(int bucketsize) {
+	switch (bucketsize) {
+		case 4:
+			return scan_keys_4;
+		case 8:
+			return scan_keys_8;
+		case 16:
+			return scan_keys_16;
+		case 32:
+			return scan_keys_32;
+		default:
+			return scan_keys;
+	}
+}
 
-    /* Set all the relevant stuff up. */
-    bucket->id = id;
-    bucket->depth = depth;
-    bucket->nkeys = 0;
+/* How many of bucket number 'index's slots a search for 'key' must look at.
+ * Every slot past a bucket's last key is zero, so unless the search is for 0
+ * it can look at all of them, and need not read the bucket's description. */
+static int slots_to_scan(XtndblNHashTable *table, uint32_t index, int64 key) {
+	return key == 0 ? table->pool[index].nkeys : table->bucketsize;
 }
 
-// double the table of bucket pointers, duplicating the bucket pointers in the
-// first half into the new second half of the table
+/* Adds another empty bucket of depth 'depth' to the end of the bucket and
+ * key arrays and returns its index. This may move both arrays. */
+static uint32_t new_bucket(XtndblNHashTable *table, int depth) {
+    /* Make room in the arrays if they're full. */
+    if (table->stats.nbuckets == table->poolsize) {
+        table->poolsize *= 2;
+        table->pool = mem_realloc(&table->stats.memory, table->pool,
+            sizeof(*table->pool) * (table->poolsize / 2),
+            sizeof(*table->pool) * table->poolsize);
+        size_t bucketbytes = sizeof(*table->keys) * table->stride;
+        table->keys = mem_realloc(&table->stats.memory, table->keys,
+            bucketbytes * (size_t)(table->poolsize / 2),
+            bucketbytes * (size_t)table->poolsize);
+        assert(table->pool && table->keys);
+    }
+    uint32_t index = table->stats.nbuckets++;
+    Bucket empty = { 0, depth };
+    table->pool[index] = empty;
+    memset(bucket_keys(table, index), 0,
+        sizeof(*table->keys) * table->stride);
+    return index;
+}
+
+// double the directory, duplicating the entries in the first half into the
+// new second half of the table
 static void double_table(XtndblNHashTable *table) {
+	TimerStart start = event_start();
 	int size = table->size * 2;
 	assert(size < MAX_TABLE_SIZE && "error: table has grown too large!");
 
-	// get a new array of twice as many bucket pointers, and copy pointers down
-	table->buckets = realloc(table->buckets, (sizeof *table->buckets) * size);
-	assert(table->buckets);
-	int i;
-	for (i = 0; i < table->size; i++) {
-		table->buckets[table->size + i] = table->buckets[i];
-	}
+	// get a new array of twice as many entries, and copy entries down
+	size_t halfbytes = (sizeof *table->directory << table->entryshift)
+		* table->size;
+	table->directory = mem_realloc(&table->stats.memory, table->directory,
+		halfbytes, 2 * halfbytes);
+	assert(table->directory);
+	memcpy(entry_at(table, table->size), table->directory, halfbytes);
 
-	// finally, increase the table size and the depth we are using to hash keys
+	// increase the table size and the depth we are using to hash keys
 	table->size = size;
 	table->depth++;
-}
 
-// reinsert a key into the hash table after splitting a bucket --- we can assume
-// that there will definitely be space for this key because it was already
-// inside the hash table previously
-// use 'xtndbl1_hash_table_insert()' instead for inserting new keys
-static void reinsert_key(XtndblNHashTable *table, int64 key) {
-	int address = rightmostnbits(table->depth, h1(key));
-	table->buckets[address]->keys[table->buckets[address]->nkeys] = key;
-	table->buckets[address]->nkeys += 1;
+	// finally, the buckets that now have too many addresses to keep a filter
+	// lose it
+	int nwords = table->filterbits / 32;
+	int address;
+	for (address = 0; address < size; address++) {
+		uint32_t *entry = entry_at(table, address);
+		if (!has_filter(table, table->pool[entry[0]].depth)) {
+			memset(entry + 1, 0xff, sizeof *entry * nwords);
+		}
+	}
+	event_stop_traced(&table->stats.doublings, start, "xtndbln: double table",
+		size / 2, size);
 }
 
 // split the bucket in 'table' at address 'address', growing table if necessary
 static void split_bucket(XtndblNHashTable *table, int address) {
+	TimerStart start = event_start();
 	int i;
 	// FIRST,
 	// do we need to grow the table?
-	if (table->buckets[address]->depth >= table->depth) {
+	if (table->pool[entry_at(table, address)[0]].depth >= table->depth) {
 		// yep, this bucket is down to its last pointer
 		double_table(table);
 	}
@@ -115,54 +346,397 @@ static void split_bucket(XtndblNHashTable *table, int address) {
 
 
 	// SECOND,
-	// create a new bucket and update both buckets' depth
-	Bucket *bucket = table->buckets[address];
-	int depth = bucket->depth;
-	int first_address = bucket->id;
+	// create a new bucket, and give both buckets one more bit of depth: the
+	// new bucket's id is a 1 bit followed by the old bucket's id
+	uint32_t index0 = entry_at(table, address)[0];
+	int depth = table->pool[index0].depth;
+	int first_address = rightmostnbits(depth, address);
+	int new_first_address = (1 << depth) | first_address;
+	uint32_t index1 = new_bucket(table, depth + 1);
+
+	Bucket old = table->pool[index0];
+	Bucket *bucket0 = &table->pool[index0];
+	Bucket *bucket1 = &table->pool[index1];
+	bucket0->depth = depth + 1;
+	bucket0->nkeys = 0;
 
-	int new_depth = depth + 1;
-	bucket->depth = new_depth;
+	// THIRD,
+	// filter the keys from the old bucket into their rightful places: those
+	// whose new hash bit is set move to the new bucket (with their values)
+	int64 *keys0 = bucket_keys(table, index0);
+	int64 *keys1 = bucket_keys(table, index1);
+	for (i = 0; i < old.nkeys; i++) {
+		int64 key = keys0[i];
+		Bucket *bucket = ((h1(key) >> depth) & 1) ? bucket1 : bucket0;
+		int64 *keys = (bucket == bucket1) ? keys1 : keys0;
+		if (is_map(table)) {
+			int64 *values = keys + table->bucketsize;
+			values[bucket->nkeys] = keys0[table->bucketsize + i];
+		}
+		keys[bucket->nkeys++] = key;
+	}
+	// (the old bucket's slots past its last key must be zero again)
+	memset(keys0 + bucket0->nkeys, 0,
+		sizeof *keys0 * (old.nkeys - bucket0->nkeys));
 
-	// new bucket's first address will be a 1 bit plus the old first address
-	int new_first_address = 1 << depth | first_address;
-	Bucket *newbucket = malloc(sizeof(*newbucket));
-	init_bucket(newbucket, new_first_address, new_depth, table->bucketsize);
-	table->stats.nbuckets++;
+	// FINALLY,
+	// redirect every second address pointing to the old bucket to the new
+	// bucket, and give each bucket's addresses its new filter (if it keeps
+	// one: if not, the old bucket's addresses already have every bit set)
+	uint32_t filter[MAX_ENTRY_WORDS - 1];
+	make_filter(table, index1, filter);
+	set_entries(table, new_first_address, depth + 1, index1, filter);
+	if (has_filter(table, depth + 1)) {
+		make_filter(table, index0, filter);
+		set_entries(table, first_address, depth + 1, index0, filter);
+	}
+	// (sized by its number of buckets, one more than before)
+	event_stop_traced(&table->stats.splits, start, "xtndbln: split bucket",
+		table->stats.nbuckets - 1, table->stats.nbuckets);
+}
 
-	// THIRD,
-	// redirect every second address pointing to this bucket to the new bucket
-	// construct addresses by joining a bit 'prefix' and a bit 'suffix'
-	// (defined below)
 
-	// suffix: a 1 bit followed by the previous bucket bit address
-	int bit_address = rightmostnbits(depth, first_address);
-	int suffix = (1 << depth) | bit_address;
+/* Finds the slot holding 'key' in 'table', returning NULL if it's not there.
+ * (In a map, its value is 'bucketsize' slots after it.) */
+static int64 *find_key(XtndblNHashTable *table, int64 key) {
+	// calculate table address for this key
+	int address = rightmostnbits(table->depth, h1(key));
 
-	// prefix: all bitstrings of length equal to the difference between the new
-	// bucket depth and the table depth
-	// use a for loop to enumerate all possible prefixes less than maxprefix:
-	int maxprefix = 1 << (table->depth - new_depth);
+	// look for the key in that bucket (unless its filter rules it out)
+	uint32_t *entry = entry_at(table, address);
+	table->stats.nlookups++;
+	if (!might_contain(entry, filter_bits(table, key))) {
+		table->stats.nfiltered++;
+		return NULL;
+	}
+	int64 *keys = bucket_keys(table, entry[0]);
+	int i = table->scan(keys, slots_to_scan(table, entry[0], key), key);
+	return i < 0 ? NULL : &keys[i];
+}
 
-	int prefix;
-	for (prefix = 0; prefix < maxprefix; prefix++) {
+/* Inserts 'key' into 'table' if it's not in there already, and returns the
+ * slot holding it. Sets '*inserted' to whether it was inserted. */
+static int64 *insert_key(XtndblNHashTable *table, int64 key, bool *inserted) {
+	// is this key already there?
+	int64 *slot = find_key(table, key);
+	*inserted = slot == NULL;
+	if (slot) {
+		return slot;
+	}
 
-		// construct address by joining this prefix and the suffix
-		int a = (prefix << new_depth) | suffix;
+	// calculate table address
+	int hash = h1(key);
+	int address = rightmostnbits(table->depth, hash);
 
-		// redirect this table entry to point at the new bucket
-		table->buckets[a] = newbucket;
+	// if not, make space in the table until our target bucket has space
+	while (table->pool[entry_at(table, address)[0]].nkeys
+			>= table->bucketsize) {
+		split_bucket(table, address);
+
+		// and recalculate address because we might now need more bits
+		address = rightmostnbits(table->depth, hash);
 	}
 
-	// FINALLY,
-	// filter the key from the old bucket into its rightful place in the new
-	// table (which may be the old bucket, or may be the new bucket)
+	// there's now space! we can insert this key
+	uint32_t index = entry_at(table, address)[0];
+	Bucket *bucket = &table->pool[index];
+	slot = &bucket_keys(table, index)[bucket->nkeys];
+	*slot = key;
+	bucket->nkeys += 1;
+	table->stats.nkeys++;
+
+	// and add it to the filter in each of the bucket's entries, if it has one
+	if (has_filter(table, bucket->depth)) {
+		FilterBits bits = filter_bits(table, key);
+		for (address = rightmostnbits(bucket->depth, address);
+				address < table->size; address += 1 << bucket->depth) {
+			filter_add(entry_at(table, address) + 1, bits);
+		}
+	}
+	return slot;
+}
+
+/* Returns the bytes allocated for buckets in 'table' holding no key
+ * (including space in the pool for buckets not yet made). */
+static int64 wasted_bytes(XtndblNHashTable *table) {
+	int64 nslots = (int64)table->poolsize * table->bucketsize;
+	return (nslots - table->stats.nkeys) * (int64)sizeof *table->keys
+		* table->stride / table->bucketsize;
+}
+
+/* Sets up a new table with 'bucketsize' keys per bucket and 'stride' int64s
+ * of space for each bucket. */
+static XtndblNHashTable *new_table(int bucketsize, int stride) {
+
+	XtndblNHashTable *table = malloc(sizeof *table);
+	assert(table);
+	mem_usage_init(&table->stats.memory, sizeof *table);
+
+	// buckets only have room for key counts up to UINT16_MAX
+	assert(bucketsize > 0 && bucketsize <= UINT16_MAX);
+	table->bucketsize = bucketsize;
+	table->stride = stride;
+	table->scan = choose_scan(bucketsize);
+
+	// give filters at least 6 bits for each key a full bucket holds, in the
+	// smallest entries that fit them: the bigger the directory, the more of
+	// it misses the cache and the TLB
+	table->entryshift = 1;
+	while ((1 << table->entryshift) < MAX_ENTRY_WORDS
+			&& ((1 << table->entryshift) - 1) * 32 < 6 * bucketsize) {
+		table->entryshift++;
+	}
+	table->filterbits = ((1 << table->entryshift) - 1) * 32;
+
+	table->poolsize = 1;
+	table->pool = mem_alloc(&table->stats.memory, sizeof *table->pool);
+	table->keys = mem_alloc(&table->stats.memory, sizeof *table->keys * stride);
+	assert(table->pool && table->keys);
+	table->stats.nbuckets = 0;
+
+	table->size = 1;
+	table->directory = mem_alloc(&table->stats.memory,
+		sizeof *table->directory << table->entryshift);
+	assert(table->directory);
+	memset(table->directory, 0, sizeof *table->directory << table->entryshift);
+	table->directory[0] = new_bucket(table, 0);
+	table->depth = 0;
+
+	table->stats.nkeys = 0;
+	table->stats.nlookups = 0;
+	table->stats.nfiltered = 0;
+	timer_init(&table->stats.timer);
+	event_init(&table->stats.splits);
+	event_init(&table->stats.doublings);
+	event_init(&table->stats.batches);
+	event_init(&table->stats.builds);
+
+	return table;
+}
+
+
+/*
+ * Bulk Building
+ *
+ * A bulk build skips the incremental growth altogether: the keys are grouped
+ * by the rightmost bits of their hash values (a counting sort, first by up to
+ * MAX_TOP_BITS bits and then by the rest), and each group becomes a bucket of
+ * its own, or if it has too many keys for one bucket, is divided by the next
+ * bit until its parts fit. Only then is the directory made, at the depth of
+ * the deepest bucket. Each worker builds the buckets of every nworkers'th
+ * group into its own pool of keys, and the pools are joined at the end.
+ */
+
+/* The first counting sort of a bulk build uses at most this many bits, so
+ * each worker's array of counts stays small. */
+#define MAX_TOP_BITS 16
+
+/* The groups of a bulk build start out with about this many bucketfuls of keys
+ * each, so that nearly all of them have to be divided: a group is only
+ * divided when its keys don't fit, so the buckets end up just as splitting
+ * them one insertion at a time would have left them. */
+#define GROUP_BUCKETS 4
+
+/* A bucket made by a worker: its description and its id. The worker's i'th
+ * built bucket has the i'th bucketful of keys in its pool. */
+typedef struct built_bucket {
+	Bucket bucket;
+	int id;
+} BuiltBucket;
+
+/* What each worker of a bulk build has made so far. */
+typedef struct build_worker {
+	int64 *pool;		// its buckets' keys, bucket by bucket
+	int poolsize;		// how many buckets 'pool' has space for
+	BuiltBucket *built;	// its buckets
+	int nbuilt;			// how many buckets it has made
+	int maxbuilt;		// how many 'built' has space for
+	int64 *scratch;		// space for sorting one group's keys
+	int scratchsize;	// how many keys 'scratch' has space for
+	int *counts;		// space for counting one group's keys
+	int maxdepth;		// the depth of its deepest bucket
+	int nkeys;			// how many (distinct) keys its buckets hold
+	int offset;			// where its buckets begin in the table's pool
+} BuildWorker;
+
+/* What the workers of a bulk build share. */
+typedef struct bulk_build {
+	XtndblNHashTable *table;	// the table being built
+	int64 *keys;		// the keys to build it from
+	int n;				// how many of them there are
+	int depth;			// the depth of the shallowest buckets
+	int topdepth;		// how many bits the first counting sort uses
+	int ntop;			// how many groups that makes (2^topdepth)
+	int *counts;		// each worker's count of its keys in each group,
+						// then where it puts them in 'sorted'
+	int *topstart;		// where each group starts in 'sorted'
+	int64 *sorted;		// the keys, grouped by their rightmost bits
+	BuildWorker *workers;
+} BulkBuild;
+
+/* Where worker 'w' of 'nworkers' starts its share of 'n' keys. */
+static int share_start(int n, int w, int nworkers) {
+	return (long long)n * w / nworkers;
+}
+
+/* Counts worker 'w's share of the keys in each top group. */
+static void count_task(void *arg, int w, int nworkers) {
+	BulkBuild *build = arg;
+	int *counts = build->counts + (size_t)w * build->ntop;
+	int i, end = share_start(build->n, w + 1, nworkers);
+	for (i = share_start(build->n, w, nworkers); i < end; i++) {
+		counts[rightmostnbits(build->topdepth, h1(build->keys[i]))]++;
+	}
+}
+
+/* Moves worker 'w's share of the keys to where their groups are in 'sorted'
+ * (after the counts have become positions). */
+static void scatter_task(void *arg, int w, int nworkers) {
+	BulkBuild *build = arg;
+	int *next = build->counts + (size_t)w * build->ntop;
+	int i, end = share_start(build->n, w + 1, nworkers);
+	for (i = share_start(build->n, w, nworkers); i < end; i++) {
+		int64 key = build->keys[i];
+		build->sorted[next[rightmostnbits(build->topdepth, h1(key))]++] = key;
+	}
+}
+
+/* Adds a new, empty bucket to 'worker's pool (for 'table') and returns its
+ * index. */
+static uint32_t worker_new_bucket(XtndblNHashTable *table,
+		BuildWorker *worker) {
+	int bucketsize = table->bucketsize;
+	if (worker->nbuilt == worker->poolsize) {
+		worker->poolsize *= 2;
+		worker->pool = mem_realloc(&table->stats.memory, worker->pool,
+			sizeof *worker->pool * bucketsize * (size_t)(worker->poolsize / 2),
+			sizeof *worker->pool * bucketsize * (size_t)worker->poolsize);
+		assert(worker->pool);
+	}
+	memset(worker->pool + (size_t)worker->nbuilt * bucketsize, 0,
+		sizeof *worker->pool * bucketsize);
+	return worker->nbuilt;
+}
+
+/* Makes a bucket of depth 'depth' and id 'id' holding the 'count' keys at
+ * 'keys' (ignoring repeats), or if they don't fit, divides them by their next
+ * hash value bit and makes a deeper bucket from each part. */
+static void build_buckets(BulkBuild *build, BuildWorker *worker, int64 *keys,
+		int count, int depth, int id) {
+	XtndblNHashTable *table = build->table;
+	Bucket bucket = { 0, depth };
+	int64 *bucketkeys = worker->pool
+		+ (size_t)worker_new_bucket(table, worker) * table->bucketsize;
+
+	int i;
+	for (i = 0; i < count; i++) {
+		if (table->scan(bucketkeys, bucket.nkeys, keys[i]) >= 0) {
+			continue;	// a repeat of a key already in the bucket
+		}
+		if (bucket.nkeys == table->bucketsize) {
+			break;		// the keys don't fit
+		}
+		bucketkeys[bucket.nkeys++] = keys[i];
+	}
+
+	if (i == count) {
+		// they fit: keep the bucket
+		if (worker->nbuilt == worker->maxbuilt) {
+			worker->maxbuilt *= 2;
+			worker->built = mem_realloc(&table->stats.memory, worker->built,
+				sizeof *worker->built * (worker->maxbuilt / 2),
+				sizeof *worker->built * worker->maxbuilt);
+			assert(worker->built);
+		}
+		BuiltBucket built = { bucket, id };
+		worker->built[worker->nbuilt++] = built;
+		worker->nkeys += bucket.nkeys;
+		if (depth > worker->maxdepth) {
+			worker->maxdepth = depth;
+		}
+		return;
+	}
+
+	// they don't: the bucket is not kept, and the keys whose next bit is 0
+	// are moved in front of those whose next bit is 1
+	assert((1 << (depth + 1)) < MAX_TABLE_SIZE
+		&& "error: table has grown too large!");
+	int nzero = 0;
+	for (i = 0; i < count; i++) {
+		if (((h1(keys[i]) >> depth) & 1) == 0) {
+			int64 key = keys[i];
+			keys[i] = keys[nzero];
+			keys[nzero++] = key;
+		}
+	}
+	build_buckets(build, worker, keys, nzero, depth + 1, id);
+	build_buckets(build, worker, keys + nzero, count - nzero, depth + 1,
+		(1 << depth) | id);
+}
+
+/* Builds the buckets of every nworkers'th top group, starting from 'w',
+ * first sorting each group's keys by the rest of the bits to 'depth'. */
+static void build_task(void *arg, int w, int nworkers) {
+	BulkBuild *build = arg;
+	BuildWorker *worker = &build->workers[w];
+	int nlocal = 1 << (build->depth - build->topdepth);
+
+	int top;
+	for (top = w; top < build->ntop; top += nworkers) {
+		int64 *keys = build->sorted + build->topstart[top];
+		int count = build->topstart[top + 1] - build->topstart[top];
+
+		if (count > worker->scratchsize) {
+			worker->scratch = mem_realloc(&build->table->stats.memory,
+				worker->scratch, sizeof *worker->scratch * worker->scratchsize,
+				sizeof *worker->scratch * count);
+			worker->scratchsize = count;
+			assert(worker->scratch);
+		}
 
-	// remove and reinsert the key
-	int nkeys = bucket->nkeys;
-	bucket->nkeys = 0;
-	for(i=0; i<nkeys; i++) {
-		int64 key = bucket->keys[i];
-		reinsert_key(table, key);
+		// counting sort this group's keys into scratch by their next bits
+		int *counts = worker->counts;
+		int i, local;
+		memset(counts, 0, sizeof *counts * (nlocal + 1));
+		for (i = 0; i < count; i++) {
+			counts[(h1(keys[i]) >> build->topdepth) % nlocal + 1]++;
+		}
+		for (local = 0; local < nlocal; local++) {
+			counts[local + 1] += counts[local];
+		}
+		for (i = 0; i < count; i++) {
+			local = (h1(keys[i]) >> build->topdepth) % nlocal;
+			worker->scratch[counts[local]++] = keys[i];
+		}
+
+		// counts[local] is now where group 'local' ends, and so the next
+		// one begins
+		int start = 0;
+		for (local = 0; local < nlocal; local++) {
+			build_buckets(build, worker, worker->scratch + start,
+				counts[local] - start, build->depth,
+				(local << build->topdepth) | top);
+			start = counts[local];
+		}
+	}
+}
+
+/* Copies the descriptions of worker 'w's buckets to the table's, and points
+ * every directory address of each bucket at it, with its filter. */
+static void directory_task(void *arg, int w, int nworkers) {
+	(void)nworkers;
+	BulkBuild *build = arg;
+	BuildWorker *worker = &build->workers[w];
+	XtndblNHashTable *table = build->table;
+
+	uint32_t filter[MAX_ENTRY_WORDS - 1];
+	int i;
+	for (i = 0; i < worker->nbuilt; i++) {
+		uint32_t index = worker->offset + i;
+		Bucket bucket = worker->built[i].bucket;
+		table->pool[index] = bucket;
+		make_filter(table, index, filter);
+		set_entries(table, worker->built[i].id, bucket.depth, index, filter);
 	}
 }
 
@@ -173,22 +747,146 @@ static void split_bucket(XtndblNHashTable *table, int address) {
 
 // initialise an extendible hash table with 'bucketsize' keys per bucket
 XtndblNHashTable *new_xtndbln_hash_table(int bucketsize) {
+	return new_table(bucketsize, bucketsize);
+}
 
-	XtndblNHashTable *table = malloc(sizeof *table);
-	assert(table);
 
-	table->size = 1;
-	table->buckets = malloc(sizeof *table->buckets);
-	assert(table->buckets);
-	table->buckets[0] = malloc(sizeof(table->buckets[0]));
-	init_bucket(table->buckets[0], 0, 0, bucketsize);
-	table->depth = 0;
-	table->bucketsize = bucketsize;
+// initialise an extendible hash map, storing a value with each key, with
+// 'bucketsize' keys per bucket
+XtndblNHashTable *new_xtndbln_hash_map(int bucketsize) {
+	return new_table(bucketsize, 2 * bucketsize);
+}
+
+
+// build an extendible hash table with 'bucketsize' keys per bucket holding
+// the 'n' keys in 'keys' (ignoring repeats), making its buckets and directory
+// directly rather than splitting buckets as it grows, and using 'nthreads'
+// threads to do so
+XtndblNHashTable *build_xtndbln_hash_table(int bucketsize, int64 *keys, int n,
+		int nthreads) {
+	assert(n >= 0 && nthreads > 0);
+
+	// the table struct, without its first bucket and directory
+	XtndblNHashTable *table = new_table(bucketsize, bucketsize);
+	MemUsage *memory = &table->stats.memory;
+	TimerStart start = event_start();
+	mem_free(memory, table->pool, sizeof *table->pool);
+	mem_free(memory, table->keys, sizeof *table->keys * bucketsize);
+	mem_free(memory, table->directory,
+		sizeof *table->directory << table->entryshift);
+
+	BulkBuild build = { .table = table, .keys = keys, .n = n };
+
+	// use just enough bits to divide the keys into groups of a few bucketfuls
+	build.depth = 0;
+	while ((double)(1 << build.depth) * bucketsize * GROUP_BUCKETS < n) {
+		build.depth++;
+	}
+	assert((1 << build.depth) < MAX_TABLE_SIZE
+		&& "error: table has grown too large!");
+	build.topdepth = build.depth < MAX_TOP_BITS ? build.depth : MAX_TOP_BITS;
+	build.ntop = 1 << build.topdepth;
+
+	ThreadPool *pool = new_thread_pool(nthreads);
+
+	// FIRST,
+	// group the keys by the rightmost 'topdepth' bits of their hash values
+	size_t ncounts = (size_t)nthreads * build.ntop;
+	build.counts = mem_alloc(memory, sizeof *build.counts * ncounts);
+	build.topstart = mem_alloc(memory,
+		sizeof *build.topstart * (build.ntop + 1));
+	build.sorted = mem_alloc(memory, sizeof *build.sorted * (n > 0 ? n : 1));
+	assert(build.counts && build.topstart && build.sorted);
+	memset(build.counts, 0, sizeof *build.counts * ncounts);
+	thread_pool_run(pool, count_task, &build);
+
+	// each worker's keys in each group go after the previous worker's
+	int top, w, position = 0;
+	for (top = 0; top < build.ntop; top++) {
+		build.topstart[top] = position;
+		for (w = 0; w < nthreads; w++) {
+			int count = build.counts[(size_t)w * build.ntop + top];
+			build.counts[(size_t)w * build.ntop + top] = position;
+			position += count;
+		}
+	}
+	build.topstart[build.ntop] = position;
+	thread_pool_run(pool, scatter_task, &build);
+	mem_free(memory, build.counts, sizeof *build.counts * ncounts);
 
-	table->stats.nbuckets = 1;
+	// SECOND,
+	// make every group's buckets
+	int nlocal = 1 << (build.depth - build.topdepth);
+	build.workers = mem_alloc(memory, sizeof *build.workers * nthreads);
+	assert(build.workers);
+	memset(build.workers, 0, sizeof *build.workers * nthreads);
+	for (w = 0; w < nthreads; w++) {
+		BuildWorker *worker = &build.workers[w];
+		worker->poolsize = (n / nthreads) / bucketsize * 2 + 1;
+		worker->pool = mem_alloc(memory, sizeof *worker->pool * bucketsize
+			* (size_t)worker->poolsize);
+		worker->maxbuilt = worker->poolsize;
+		worker->built = mem_alloc(memory,
+			sizeof *worker->built * worker->maxbuilt);
+		worker->counts = mem_alloc(memory,
+			sizeof *worker->counts * (nlocal + 1));
+		assert(worker->pool && worker->built && worker->counts);
+	}
+	thread_pool_run(pool, build_task, &build);
+	mem_free(memory, build.sorted, sizeof *build.sorted * (n > 0 ? n : 1));
+
+	// THIRD,
+	// join the workers' pools into the table's, one after another
+	int nbuckets = 0;
+	table->depth = 0;
 	table->stats.nkeys = 0;
-	table->stats.time = 0;
+	for (w = 0; w < nthreads; w++) {
+		BuildWorker *worker = &build.workers[w];
+		worker->offset = nbuckets;
+		nbuckets += worker->nbuilt;
+		table->stats.nkeys += worker->nkeys;
+		if (worker->maxdepth > table->depth) {
+			table->depth = worker->maxdepth;
+		}
+		mem_free(memory, worker->scratch,
+			sizeof *worker->scratch * worker->scratchsize);
+		mem_free(memory, worker->counts, sizeof *worker->counts * (nlocal + 1));
+	}
+	table->keys = mem_realloc(memory, build.workers[0].pool,
+		sizeof *table->keys * bucketsize * (size_t)build.workers[0].poolsize,
+		sizeof *table->keys * bucketsize * (size_t)nbuckets);
+	assert(table->keys);
+	for (w = 1; w < nthreads; w++) {
+		BuildWorker *worker = &build.workers[w];
+		memcpy(bucket_keys(table, worker->offset), worker->pool,
+			sizeof *table->keys * bucketsize * (size_t)worker->nbuilt);
+		mem_free(memory, worker->pool,
+			sizeof *worker->pool * bucketsize * (size_t)worker->poolsize);
+	}
+	table->poolsize = nbuckets;
+	table->stats.nbuckets = nbuckets;
+
+	// FINALLY,
+	// make the directory, as deep as the deepest bucket, along with the
+	// buckets' descriptions
+	table->size = 1 << table->depth;
+	table->directory = mem_alloc(memory,
+		(sizeof *table->directory << table->entryshift) * table->size);
+	table->pool = mem_alloc(memory, sizeof *table->pool * nbuckets);
+	assert(table->directory && table->pool);
+	thread_pool_run(pool, directory_task, &build);
+
+	for (w = 0; w < nthreads; w++) {
+		mem_free(memory, build.workers[w].built,
+			sizeof *build.workers[w].built * build.workers[w].maxbuilt);
+	}
+	mem_free(memory, build.workers, sizeof *build.workers * nthreads);
+	mem_free(memory, build.topstart,
+		sizeof *build.topstart * (build.ntop + 1));
+	free_thread_pool(pool);
 
+	// stop timing before returning
+	event_stop(&table->stats.builds, start);
 	return table;
 }
 
@@ -196,19 +894,13 @@ XtndblNHashTable *new_xtndbln_hash_table(int bucketsize) {
 void free_xtndbln_hash_table(XtndblNHashTable *table) {
 	assert(table);
 
-	// loop backwards through the array of pointers, freeing buckets only as we
-	// reach their first reference
-	// (if we loop through forwards, we wouldn't know which reference was last)
-	int i;
-	for (i = table->size-1; i >= 0; i--) {
-		if (table->buckets[i]->id == i) {
-			free(table->buckets[i]->keys);
-			free(table->buckets[i]);
-		}
-	}
-
-	// free the array of bucket pointers
-	free(table->buckets);
+	// free every bucket's description and keys, then the directory
+	mem_free(&table->stats.memory, table->pool,
+		sizeof *table->pool * table->poolsize);
+	mem_free(&table->stats.memory, table->keys,
+		sizeof *table->keys * table->stride * (size_t)table->poolsize);
+	mem_free(&table->stats.memory, table->directory,
+		(sizeof *table->directory << table->entryshift) * table->size);
 
 	// free the table struct itself
 	free(table);
@@ -219,61 +911,156 @@ void free_xtndbln_hash_table(XtndblNHashTable *table) {
 // returns true if insertion succeeds, false if it was already in there
 bool xtndbln_hash_table_insert(XtndblNHashTable *table, int64 key) {
 	assert(table);
-	int start_time = clock(); // start timing
+	TimerStart start = timer_start(&table->stats.timer);
 
-	// calculate table address
-	int hash = h1(key);
-	int address = rightmostnbits(table->depth, hash);
+	bool inserted;
+	insert_key(table, key, &inserted);
 
-	// is this key already there?
-	if (xtndbln_hash_table_lookup(table, key)) {
-		table->stats.time += clock() - start_time; // add time elapsed
-		return false;
-	}
+	// stop timing before returning
+	timer_stop(&table->stats.timer, start,
+		inserted ? OP_INSERT_NEW : OP_INSERT_HIT);
+	return inserted;
+}
 
-	// if not, make space in the table until our target bucket has space
-	while (table->buckets[address]->nkeys >= table->bucketsize) {
-		split_bucket(table, address);
 
-		// and recalculate address because we might now need more bits
-		address = rightmostnbits(table->depth, hash);
-	}
+// lookup whether 'key' is inside 'table'
+// returns true if found, false if not
+bool xtndbln_hash_table_lookup(XtndblNHashTable *table, int64 key) {
+	assert(table);
+	TimerStart start = timer_start(&table->stats.timer);
 
-	// there's now space! we can insert this key
-	table->buckets[address]->keys[table->buckets[address]->nkeys] = key;
-	table->buckets[address]->nkeys += 1;
-	table->stats.nkeys++;
+	bool found = find_key(table, key) != NULL;
 
-	// add time elapsed to total CPU time before returning
-	table->stats.time += clock() - start_time;
-	return true;
+	// stop timing before returning result
+	timer_stop(&table->stats.timer, start,
+		found ? OP_LOOKUP_HIT : OP_LOOKUP_MISS);
+	return found;
 }
 
 
-// lookup whether 'key' is inside 'table'
+// insert 'key' into map 'table' with value 'value', or if 'key' is already in
+// there, replace its value with 'value'
+// returns true if 'key' was inserted, false if it was already in there
+bool xtndbln_hash_table_put(XtndblNHashTable *table, int64 key, int64 value) {
+	assert(table && is_map(table));
+	TimerStart start = timer_start(&table->stats.timer);
+
+	bool inserted;
+	insert_key(table, key, &inserted)[table->bucketsize] = value;
+
+	// stop timing before returning
+	timer_stop(&table->stats.timer, start,
+		inserted ? OP_INSERT_NEW : OP_INSERT_HIT);
+	return inserted;
+}
+
+
+// lookup 'key' in map 'table', and if it's there store its value in '*value'
 // returns true if found, false if not
-bool xtndbln_hash_table_lookup(XtndblNHashTable *table, int64 key) {
+bool xtndbln_hash_table_get(XtndblNHashTable *table, int64 key, int64 *value) {
+	assert(table && is_map(table));
+	TimerStart start = timer_start(&table->stats.timer);
+
+	int64 *slot = find_key(table, key);
+	if (slot) {
+		*value = slot[table->bucketsize];
+	}
+
+	// stop timing before returning result
+	timer_stop(&table->stats.timer, start,
+		slot ? OP_LOOKUP_HIT : OP_LOOKUP_MISS);
+	return slot != NULL;
+}
+
+
+// replace the value of 'key' in map 'table' with 'value', if 'key' is in there
+// returns true if found (and updated), false if not
+bool xtndbln_hash_table_update(XtndblNHashTable *table, int64 key,
+		int64 value) {
+	assert(table && is_map(table));
+	TimerStart start = timer_start(&table->stats.timer);
+
+	int64 *slot = find_key(table, key);
+	if (slot) {
+		slot[table->bucketsize] = value;
+	}
+
+	// stop timing before returning result
+	timer_stop(&table->stats.timer, start,
+		slot ? OP_LOOKUP_HIT : OP_LOOKUP_MISS);
+	return slot != NULL;
+}
+
+
+/* Looks up each of the 'n' keys in 'keys', storing the answers in 'found',
+ * and returns how many were found. A group of lookups is kept in flight, each
+ * one prefetching the next thing it needs (directory entry, then the bucket's
+ * keys unless the entry's filter rules them out) and then giving way to the
+ * next, so the cache misses overlap. */
+int xtndbln_hash_table_lookup_batch(XtndblNHashTable *table, int64 *keys,
+		int n, bool *found) {
 	assert(table);
-	int start_time = clock(); // start timing
-	int i;
+	TimerStart start = event_start();
 
-	// calculate table address for this key
-	int address = rightmostnbits(table->depth, h1(key));
+	LookupState group[LOOKUP_GROUP];
+	int g;
+	for (g = 0; g < LOOKUP_GROUP; g++) {
+		group[g].stage = IDLE;
+	}
 
-	// look for the key in that bucket (unless it's empty)
-	bool found = false;
-	if (table->buckets[address]->nkeys > 0) {
-		for(i=0; i<table->buckets[address]->nkeys; i++) {
-			if(table->buckets[address]->keys[i] == key) {
-				// found it?
-				found = true;
+	// step each lookup in the group along until every key has been answered
+	int next = 0, remaining = n, nfound = 0;
+	while (remaining > 0) {
+		for (g = 0; g < LOOKUP_GROUP; g++) {
+			LookupState *state = &group[g];
+			switch (state->stage) {
+				case IDLE:
+					// start on the next key, if there are any left
+					if (next == n) {
+						break;
+					}
+					state->i = next++;
+					state->address = rightmostnbits(table->depth,
+						h1(keys[state->i]));
+					__builtin_prefetch(entry_at(table, state->address));
+					state->stage = DIRECTORY;
+					break;
+				case DIRECTORY: {
+					// the directory entry should be cached by now: can it
+					// answer the lookup on its own?
+					uint32_t *entry = entry_at(table, state->address);
+					table->stats.nlookups++;
+					if (!might_contain(entry,
+							filter_bits(table, keys[state->i]))) {
+						table->stats.nfiltered++;
+						found[state->i] = false;
+						remaining--;
+						state->stage = IDLE;
+						break;
+					}
+					state->bucket = entry[0];
+					__builtin_prefetch(bucket_keys(table, state->bucket));
+					state->stage = KEYS;
+					break;
+				}
+				case KEYS: {
+					// if not, the keys: is ours there?
+					bool hit = table->scan(bucket_keys(table, state->bucket),
+						slots_to_scan(table, state->bucket, keys[state->i]),
+						keys[state->i]) >= 0;
+					found[state->i] = hit;
+					nfound += hit;
+					remaining--;
+					state->stage = IDLE;
+					break;
+				}
 			}
 		}
 	}
 
-	// add time elapsed to total CPU time before returning result
-	table->stats.time += clock() - start_time;
-	return found;
+	// stop timing before returning result
+	event_stop(&table->stats.batches, start);
+	return nfound;
 }
 
 
@@ -290,17 +1077,21 @@ void xtndbln_hash_table_print(XtndblNHashTable *table) {
 	int i;
 	for (i = 0; i < table->size; i++) {
 		// table entry
-		printf("%9d | %-9d ", i, table->buckets[i]->id);
+		uint32_t index = entry_at(table, i)[0];
+		Bucket *bucket = &table->pool[index];
+		int id = rightmostnbits(bucket->depth, i);
+		printf("%9d | %-9d ", i, id);
 
 		// if this is the first address at which a bucket occurs, print it now
-		if (table->buckets[i]->id == i) {
-			printf("%9d ", table->buckets[i]->id);
+		if (id == i) {
+			printf("%9d ", id);
 
 			// print the bucket's contents
+			int64 *keys = bucket_keys(table, index);
 			printf("[");
 			for(int j = 0; j < table->bucketsize; j++) {
-				if (j < table->buckets[i]->nkeys) {
-					printf(" %llu", table->buckets[i]->keys[j]);
+				if (j < bucket->nkeys) {
+					printf(" %llu", keys[j]);
 				} else {
 					printf(" -");
 				}
@@ -324,11 +1115,48 @@ void xtndbln_hash_table_stats(XtndblNHashTable *table) {
 	// print some stats about state of the table
 	printf("current table size: %d\n", table->size);
 	printf("    number of keys: %d\n", table->stats.nkeys);
-	printf("number of buckets: %d\n", table->stats.nbuckets);
+	printf(" number of buckets: %d\n", table->stats.nbuckets);
+	printf("      lookups made: %d\n", table->stats.nlookups);
+	printf("      filtered out: %d (%.3f%%) by the directory alone\n",
+		table->stats.nfiltered, table->stats.nlookups == 0 ? 0.0
+		: table->stats.nfiltered * 100.0 / table->stats.nlookups);
 
 	// also calculate CPU usage in seconds and print this
-	float seconds = table->stats.time * 1.0 / CLOCKS_PER_SEC;
-	printf("    CPU time spent: %.6f sec\n", seconds);
+	float seconds = timer_seconds(&table->stats.timer)
+		+ event_seconds(&table->stats.batches)
+		+ event_seconds(&table->stats.builds);
+	printf("        time spent: %.6f sec\n", seconds);
+	timer_print(&table->stats.timer);
+	event_print(&table->stats.splits, "splits");
+	event_print(&table->stats.doublings, "doublings");
+	if (table->stats.batches.count > 0) {
+		event_print(&table->stats.batches, "lookup batches");
+	}
+	if (table->stats.builds.count > 0) {
+		event_print(&table->stats.builds, "bulk build");
+	}
+	mem_usage_print(&table->stats.memory, table->stats.nkeys,
+		wasted_bytes(table));
 
 	printf("--- end stats ---\n");
 }
+
+
+// fill in 'stats' with the statistics every type of table reports
+void xtndbln_hash_table_get_stats(XtndblNHashTable *table,
+		TableStats *stats) {
+	assert(table && stats);
+	stats->size = table->size;
+	stats->nkeys = table->stats.nkeys;
+	stats->capacity = (int64)table->stats.nbuckets * table->bucketsize;
+	table_stats_add_memory(stats, &table->stats.memory);
+	stats->wastedbytes = wasted_bytes(table);
+	stats->nbuckets = table->stats.nbuckets;
+	stats->bucketsize = table->bucketsize;
+	stats->depth = table->depth;
+	table_stats_add_timer(stats, &table->stats.timer);
+	stats->opseconds += event_seconds(&table->stats.batches)
+		+ event_seconds(&table->stats.builds);
+	// (doublings happen during the splits that need them)
+	table_stats_add_growths(stats, &table->stats.splits);
+}
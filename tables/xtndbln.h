@@ -11,12 +11,24 @@
 
 #include <stdbool.h>
 #include "../inthash.h"
+#include "../tblstats.h"
 
 typedef struct xtndbln_table XtndblNHashTable;
 
 // initialise an extendible hash table with 'bucketsize' keys per bucket
 XtndblNHashTable *new_xtndbln_hash_table(int bucketsize);
 
+// initialise an extendible hash map, storing a value with each key, with
+// 'bucketsize' keys per bucket
+XtndblNHashTable *new_xtndbln_hash_map(int bucketsize);
+
+// build an extendible hash table with 'bucketsize' keys per bucket holding
+// the 'n' keys in 'keys' (ignoring repeats), making its buckets and directory
+// directly rather than splitting buckets as it grows, and using 'nthreads'
+// threads to do so
+XtndblNHashTable *build_xtndbln_hash_table(int bucketsize, int64 *keys, int n,
+	int nthreads);
+
 // free all memory associated with 'table'
 void free_xtndbln_hash_table(XtndblNHashTable *table);
 
@@ -28,10 +40,33 @@ bool xtndbln_hash_table_insert(XtndblNHashTable *table, int64 key);
 // returns true if found, false if not
 bool xtndbln_hash_table_lookup(XtndblNHashTable *table, int64 key);
 
+// lookup whether each of the 'n' keys in 'keys' is inside 'table', storing
+// the answers in 'found', and return how many were found
+// faster than 'n' separate lookups once the table no longer fits in cache
+int xtndbln_hash_table_lookup_batch(XtndblNHashTable *table, int64 *keys,
+	int n, bool *found);
+
+// insert 'key' into map 'table' with value 'value', or if 'key' is already in
+// there, replace its value with 'value'
+// returns true if 'key' was inserted, false if it was already in there
+bool xtndbln_hash_table_put(XtndblNHashTable *table, int64 key, int64 value);
+
+// lookup 'key' in map 'table', and if it's there store its value in '*value'
+// returns true if found, false if not
+bool xtndbln_hash_table_get(XtndblNHashTable *table, int64 key, int64 *value);
+
+// replace the value of 'key' in map 'table' with 'value', if 'key' is in there
+// returns true if found (and updated), false if not
+bool xtndbln_hash_table_update(XtndblNHashTable *table, int64 key, int64 value);
+
 // print the contents of 'table' to stdout
 void xtndbln_hash_table_print(XtndblNHashTable *table);
 
 // print some statistics about 'table' to stdout
 void xtndbln_hash_table_stats(XtndblNHashTable *table);
 
+// fill in 'stats' with the statistics every type of table reports (see
+// tblstats.h)
+void xtndbln_hash_table_get_stats(XtndblNHashTable *table, TableStats *stats);
+
 #endif
\ No newline at end of file
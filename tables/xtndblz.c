@@ -0,0 +1,544 @@
+/* * * * * * * * *
+ * Dynamic hash table using extendible hashing with multiple keys per bucket,
+ * resolving collisions by incrementally growing the hash table, and storing
+ * each bucket's keys compressed
+ *
+ * created for COMP20007 Design of Algorithms - Assignment 2, 2017
+ * by Luke Hedt
+ *
+ * Based on xtndbln.c. h1 is not invertible (it maps 64-bit keys to 31 bits),
+ * so the shared low hash bits of a bucket's keys can't be dropped. Instead,
+ * each bucket keeps its keys sorted and stores them as varint-encoded gaps
+ * between neighbouring keys, in groups of SKIP_EVERY keys: each group starts
+ * with a full key, and a small skip index records where each group starts.
+ * Lookups binary search the skip index, then decode at most one group.
+ * Inserts and splits decode the whole bucket and encode it again.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <stdint.h>
+
+#include "xtndblz.h"
+#include "../instrument.h"
+
+// macro to calculate the rightmost n bits of a number x
+#define rightmostnbits(n, x) (x) & ((1 << (n)) - 1)
+
+// how many keys are encoded after each entry in a bucket's skip index
+#define SKIP_EVERY 16
+
+// the most bytes one key can take up once encoded
+#define MAX_VARINT_BYTES 10
+
+// the largest bucketsize whose encoded keys can still be addressed by the
+// 16-bit offsets in the skip index
+#define MAX_BUCKETSIZE (UINT16_MAX / MAX_VARINT_BYTES)
+
+// a bucket stores its keys, sorted and compressed, in a single allocation:
+// one 16-bit skip index entry per group of SKIP_EVERY keys, giving the offset
+// of that group in the encoded keys which follow
+// it also knows how many bits are shared between possible keys. its id (the
+// first table address that references it) is not stored, but is the rightmost
+// 'depth' bits of any address that references it
+typedef struct xtndblz_bucket {
+	int depth;		// how many hash value bits are being used by this bucket
+	int nkeys;		// number of keys currently contained in this bucket
+	int nbytes;		// size of 'data' (skip index and encoded keys) in bytes
+	uint8_t *data;	// the skip index, followed by the encoded keys
+} Bucket;
+
+// helper structure to store statistics gathered
+typedef struct stats {
+	int nbuckets;	// how many distinct buckets does the table point to
+	int nkeys;		// how many keys are being stored in the table
+	long nbytes;	// how many bytes the buckets' data takes up altogether
+	OpTimer timer;	// times the inserts and lookups of keys
+					// in this table
+	EventTimer splits;		// times each bucket split
+	EventTimer doublings;	// times each doubling of the table
+	MemUsage memory;		// counts the memory allocated for the table
+} Stats;
+
+// a hash table is an array of slots holding the 32-bit indices of buckets
+// (holding up to bucketsize keys) in a contiguous pool, along with some
+// information about the number of hash value bits to use for addressing
+struct xtndblz_table {
+	uint32_t *buckets;	// array of bucket indices into 'pool'
+	Bucket *pool;		// every bucket in the table, in order of creation
+	int poolsize;		// how many buckets 'pool' has space for
+	int size;			// how many entries in the table of indices (2^depth)
+	int depth;			// how many bits of the hash value to use (log2(size))
+	int bucketsize;		// maximum number of keys per bucket
+	int64 *scratch;		// space to decode a bucket's keys (plus one more)
+	uint8_t *encoded;	// space to encode a full bucket's keys
+	Stats stats;		// collection of statistics about this hash table
+};
+
+
+/*
+ * Helper Functions
+ */
+// the bucket referenced from table address 'address'
+#define bucket_at(table, address) (&(table)->pool[(table)->buckets[address]])
+
+// the skip index of 'bucket', and the encoded keys after it
+#define skips_of(bucket) ((uint16_t *)(bucket)->data)
+#define keys_of(bucket) \
+	((bucket)->data + sizeof(uint16_t) * ngroups((bucket)->nkeys))
+
+// how many groups (and skip index entries) it takes to hold 'nkeys' keys
+static int ngroups(int nkeys) {
+	return (nkeys + SKIP_EVERY - 1) / SKIP_EVERY;
+}
+
+// write 'value' to 'out' as a varint (7 bits per byte, low bits first, with
+// the top bit set on all but the last byte), and return how many bytes it took
+static int put_varint(uint8_t *out, int64 value) {
+	int n = 0;
+	while (value >= 0x80) {
+		out[n++] = (value & 0x7f) | 0x80;
+		value >>= 7;
+	}
+	out[n++] = value;
+	return n;
+}
+
+// read a varint from '*in' into '*value', and move '*in' past it
+static void get_varint(uint8_t **in, int64 *value) {
+	uint8_t *p = *in;
+	int64 result = 0;
+	int shift = 0;
+	while (*p & 0x80) {
+		result |= (int64)(*p++ & 0x7f) << shift;
+		shift += 7;
+	}
+	result |= (int64)*p++ << shift;
+	*value = result;
+	*in = p;
+}
+
+// the id of the bucket referenced from table address 'address': the first
+// address in the table which points to it
+static int bucket_id(XtndblZHashTable *table, int address) {
+	return rightmostnbits(bucket_at(table, address)->depth, address);
+}
+
+// add a new, empty bucket based on 'depth' bits of its keys' hash values to
+// the end of the pool and return its index
+// (this may move the pool, so any Bucket pointers must be looked up again)
+static uint32_t new_bucket(XtndblZHashTable *table, int depth) {
+	if (table->stats.nbuckets == table->poolsize) {
+		table->poolsize *= 2;
+		table->pool = mem_realloc(&table->stats.memory, table->pool,
+			(sizeof *table->pool) * (table->poolsize / 2),
+			(sizeof *table->pool) * table->poolsize);
+		assert(table->pool);
+	}
+
+	uint32_t index = table->stats.nbuckets++;
+	Bucket *bucket = &table->pool[index];
+	bucket->depth = depth;
+	bucket->nkeys = 0;
+	bucket->nbytes = 0;
+	bucket->data = NULL;
+
+	return index;
+}
+
+// the bytes allocated for buckets in 'table' holding no keys: only the space
+// at the end of the pool for buckets not yet made, since each bucket's data is
+// exactly as big as its keys need
+static int64 wasted_bytes(XtndblZHashTable *table) {
+	return (int64)(table->poolsize - table->stats.nbuckets)
+		* sizeof *table->pool;
+}
+
+// decode all of the keys in 'bucket' into 'keys', in sorted order
+static void decode_bucket(Bucket *bucket, int64 *keys) {
+	uint8_t *in = keys_of(bucket);
+	int i;
+	for (i = 0; i < bucket->nkeys; i++) {
+		int64 value;
+		get_varint(&in, &value);
+		// the first key of each group is stored whole, the rest as gaps
+		keys[i] = (i % SKIP_EVERY == 0) ? value : keys[i-1] + value;
+	}
+}
+
+// replace the contents of 'bucket' with the 'nkeys' sorted keys in 'keys'
+static void encode_bucket(XtndblZHashTable *table, Bucket *bucket,
+		int64 *keys, int nkeys) {
+	// encode the keys into the table's scratch space, noting where each group
+	// starts as we go
+	uint16_t skips[ngroups(nkeys) + 1];
+	uint8_t *out = table->encoded;
+	int i;
+	for (i = 0; i < nkeys; i++) {
+		if (i % SKIP_EVERY == 0) {
+			skips[i / SKIP_EVERY] = out - table->encoded;
+			out += put_varint(out, keys[i]);
+		} else {
+			out += put_varint(out, keys[i] - keys[i-1]);
+		}
+	}
+
+	// then copy the skip index and the encoded keys into a bucket exactly big
+	// enough for them
+	int skipbytes = sizeof(uint16_t) * ngroups(nkeys);
+	int nbytes = skipbytes + (out - table->encoded);
+	table->stats.nbytes += nbytes - bucket->nbytes;
+	bucket->data = mem_realloc(&table->stats.memory, bucket->data,
+		bucket->nbytes, nbytes);
+	assert(bucket->data || nbytes == 0);
+	memcpy(bucket->data, skips, skipbytes);
+	memcpy(bucket->data + skipbytes, table->encoded, out - table->encoded);
+	bucket->nbytes = nbytes;
+	bucket->nkeys = nkeys;
+}
+
+// does 'bucket' contain 'key'? finds the last group starting at or before
+// 'key' using the skip index, then decodes only that group
+static bool bucket_contains(Bucket *bucket, int64 key) {
+	if (bucket->nkeys == 0) {
+		return false;
+	}
+	uint16_t *skips = skips_of(bucket);
+	uint8_t *keys = keys_of(bucket);
+
+	// binary search for the group: groups lo..hi-1 might hold 'key'
+	int lo = 0, hi = ngroups(bucket->nkeys);
+	while (hi - lo > 1) {
+		int mid = (lo + hi) / 2;
+		uint8_t *in = keys + skips[mid];
+		int64 first;
+		get_varint(&in, &first);
+		if (first <= key) {
+			lo = mid;
+		} else {
+			hi = mid;
+		}
+	}
+
+	// then decode that group until we reach or pass 'key'
+	uint8_t *in = keys + skips[lo];
+	int n = bucket->nkeys - lo * SKIP_EVERY;
+	if (n > SKIP_EVERY) {
+		n = SKIP_EVERY;
+	}
+	int64 value;
+	get_varint(&in, &value);
+	int i;
+	for (i = 1; i < n && value < key; i++) {
+		int64 gap;
+		get_varint(&in, &gap);
+		value += gap;
+	}
+	return value == key;
+}
+
+// double the table of bucket indices, duplicating the indices in the first
+// half into the new second half of the table
+static void double_table(XtndblZHashTable *table) {
+	TimerStart start = event_start();
+	int size = table->size * 2;
+	assert(size < MAX_TABLE_SIZE && "error: table has grown too large!");
+
+	// get a new array of twice as many bucket indices, and copy indices down
+	table->buckets = mem_realloc(&table->stats.memory, table->buckets,
+		(sizeof *table->buckets) * table->size,
+		(sizeof *table->buckets) * size);
+	assert(table->buckets);
+	memcpy(table->buckets + table->size, table->buckets,
+		(sizeof *table->buckets) * table->size);
+
+	// finally, increase the table size and the depth we are using to hash keys
+	table->size = size;
+	table->depth++;
+	event_stop(&table->stats.doublings, start);
+}
+
+// split the bucket in 'table' at address 'address', growing table if necessary
+static void split_bucket(XtndblZHashTable *table, int address) {
+	TimerStart start = event_start();
+
+	// FIRST,
+	// do we need to grow the table?
+	if (bucket_at(table, address)->depth >= table->depth) {
+		// yep, this bucket is down to its last pointer
+		double_table(table);
+	}
+	// either way, now it's time to split this bucket
+
+
+	// SECOND,
+	// create a new bucket and update both buckets' depth
+	int depth = bucket_at(table, address)->depth;
+	int first_address = bucket_id(table, address);
+
+	int new_depth = depth + 1;
+	uint32_t newbucket = new_bucket(table, new_depth);
+	Bucket *bucket = bucket_at(table, address);
+	bucket->depth = new_depth;
+
+	// THIRD,
+	// redirect every second address pointing to this bucket to the new bucket
+	// construct addresses by joining a bit 'prefix' and a bit 'suffix'
+
+	// suffix: a 1 bit followed by the previous bucket bit address
+	int bit_address = rightmostnbits(depth, first_address);
+	int suffix = (1 << depth) | bit_address;
+
+	// prefix: all bitstrings of length equal to the difference between the new
+	// bucket depth and the table depth
+	int maxprefix = 1 << (table->depth - new_depth);
+
+	int prefix;
+	for (prefix = 0; prefix < maxprefix; prefix++) {
+		int a = (prefix << new_depth) | suffix;
+		table->buckets[a] = newbucket;
+	}
+
+	// FINALLY,
+	// decode the old bucket's keys and encode them again into whichever of
+	// the two buckets they now belong in (both halves stay sorted)
+	int64 *keys = table->scratch;
+	int nkeys = bucket->nkeys;
+	decode_bucket(bucket, keys);
+
+	int i, nkeys0 = 0, nkeys1 = 0;
+	int64 *keys1 = keys + table->bucketsize + 1;
+	for (i = 0; i < nkeys; i++) {
+		if ((h1(keys[i]) >> depth) & 1) {
+			keys1[nkeys1++] = keys[i];
+		} else {
+			keys[nkeys0++] = keys[i];
+		}
+	}
+	encode_bucket(table, bucket, keys, nkeys0);
+	encode_bucket(table, &table->pool[newbucket], keys1, nkeys1);
+	event_stop(&table->stats.splits, start);
+}
+
+
+/*
+ * Real Functions
+ */
+
+// initialise a compressed extendible hash table with 'bucketsize' keys per
+// bucket
+XtndblZHashTable *new_xtndblz_hash_table(int bucketsize) {
+	assert(bucketsize > 0 && bucketsize <= MAX_BUCKETSIZE);
+
+	XtndblZHashTable *table = malloc(sizeof *table);
+	assert(table);
+	mem_usage_init(&table->stats.memory, sizeof *table);
+	MemUsage *memory = &table->stats.memory;
+	table->bucketsize = bucketsize;
+
+	// scratch space for decoding a bucket, with room for one new key, and for
+	// the keys that move out of it in a split
+	table->scratch = mem_alloc(memory,
+		(sizeof *table->scratch) * 2 * (bucketsize + 1));
+	assert(table->scratch);
+	table->encoded = mem_alloc(memory, MAX_VARINT_BYTES * (bucketsize + 1));
+	assert(table->encoded);
+
+	table->poolsize = 1;
+	table->pool = mem_alloc(memory, sizeof *table->pool);
+	assert(table->pool);
+	table->stats.nbuckets = 0;
+	table->stats.nbytes = 0;
+
+	table->size = 1;
+	table->buckets = mem_alloc(memory, sizeof *table->buckets);
+	assert(table->buckets);
+	table->buckets[0] = new_bucket(table, 0);
+	table->depth = 0;
+
+	table->stats.nkeys = 0;
+	timer_init(&table->stats.timer);
+	event_init(&table->stats.splits);
+	event_init(&table->stats.doublings);
+
+	return table;
+}
+
+
+// free all memory associated with 'table'
+void free_xtndblz_hash_table(XtndblZHashTable *table) {
+	assert(table);
+
+	// free each bucket's data, then the pool of buckets itself
+	MemUsage *memory = &table->stats.memory;
+	int i;
+	for (i = 0; i < table->stats.nbuckets; i++) {
+		mem_free(memory, table->pool[i].data, table->pool[i].nbytes);
+	}
+	mem_free(memory, table->pool, sizeof *table->pool * table->poolsize);
+
+	// free the array of bucket indices and the scratch space
+	mem_free(memory, table->buckets, sizeof *table->buckets * table->size);
+	mem_free(memory, table->scratch,
+		sizeof *table->scratch * 2 * (table->bucketsize + 1));
+	mem_free(memory, table->encoded,
+		MAX_VARINT_BYTES * (table->bucketsize + 1));
+
+	// free the table struct itself
+	free(table);
+}
+
+
+// insert 'key' into 'table', if it's not in there already
+// returns true if insertion succeeds, false if it was already in there
+bool xtndblz_hash_table_insert(XtndblZHashTable *table, int64 key) {
+	assert(table);
+	TimerStart start = timer_start(&table->stats.timer);
+
+	// calculate table address
+	int hash = h1(key);
+	int address = rightmostnbits(table->depth, hash);
+
+	// is this key already there?
+	if (bucket_contains(bucket_at(table, address), key)) {
+		timer_stop(&table->stats.timer, start, OP_INSERT_HIT);
+		return false;
+	}
+
+	// if not, make space in the table until our target bucket has space
+	while (bucket_at(table, address)->nkeys >= table->bucketsize) {
+		split_bucket(table, address);
+
+		// and recalculate address because we might now need more bits
+		address = rightmostnbits(table->depth, hash);
+	}
+
+	// there's now space! decode the bucket, slot the key into its sorted
+	// place, and encode the bucket again
+	Bucket *bucket = bucket_at(table, address);
+	int64 *keys = table->scratch;
+	decode_bucket(bucket, keys);
+	int i = bucket->nkeys;
+	while (i > 0 && keys[i-1] > key) {
+		keys[i] = keys[i-1];
+		i--;
+	}
+	keys[i] = key;
+	encode_bucket(table, bucket, keys, bucket->nkeys + 1);
+	table->stats.nkeys++;
+
+	// stop timing before returning
+	timer_stop(&table->stats.timer, start, OP_INSERT_NEW);
+	return true;
+}
+
+
+// lookup whether 'key' is inside 'table'
+// returns true if found, false if not
+bool xtndblz_hash_table_lookup(XtndblZHashTable *table, int64 key) {
+	assert(table);
+	TimerStart start = timer_start(&table->stats.timer);
+
+	// calculate table address for this key, and look in that bucket
+	int address = rightmostnbits(table->depth, h1(key));
+	bool found = bucket_contains(bucket_at(table, address), key);
+
+	// stop timing before returning result
+	timer_stop(&table->stats.timer, start,
+		found ? OP_LOOKUP_HIT : OP_LOOKUP_MISS);
+	return found;
+}
+
+
+// print the contents of 'table' to stdout
+void xtndblz_hash_table_print(XtndblZHashTable *table) {
+	assert(table);
+	printf("--- table size: %d\n", table->size);
+
+	// print header
+	printf("  table:               buckets:\n");
+	printf("  address | bucketid   bucketid [key]\n");
+
+	// print table and buckets
+	int i;
+	for (i = 0; i < table->size; i++) {
+		// table entry
+		int id = bucket_id(table, i);
+		printf("%9d | %-9d ", i, id);
+
+		// if this is the first address at which a bucket occurs, print it now
+		if (id == i) {
+			printf("%9d ", id);
+
+			// print the bucket's contents (in sorted order)
+			Bucket *bucket = bucket_at(table, i);
+			decode_bucket(bucket, table->scratch);
+			printf("[");
+			int j;
+			for (j = 0; j < table->bucketsize; j++) {
+				if (j < bucket->nkeys) {
+					printf(" %llu", table->scratch[j]);
+				} else {
+					printf(" -");
+				}
+			}
+			printf(" ]");
+		}
+		// end the line
+		printf("\n");
+	}
+
+	printf("--- end table ---\n");
+}
+
+
+// print some statistics about 'table' to stdout
+void xtndblz_hash_table_stats(XtndblZHashTable *table) {
+	assert(table);
+
+	printf("--- table stats ---\n");
+
+	// print some stats about state of the table
+	printf("current table size: %d\n", table->size);
+	printf("    number of keys: %d\n", table->stats.nkeys);
+	printf(" number of buckets: %d\n", table->stats.nbuckets);
+	printf("   keys per bucket: %d\n", table->bucketsize);
+
+	// compare the space the keys take up in the buckets with plain int64s
+	printf("    key data bytes: %ld (%.2f bytes/key)\n", table->stats.nbytes,
+		table->stats.nkeys == 0 ? 0.0
+		: (double)table->stats.nbytes / table->stats.nkeys);
+	printf(" compression ratio: %.3f\n", table->stats.nbytes == 0 ? 0.0
+		: (double)table->stats.nkeys * sizeof(int64) / table->stats.nbytes);
+
+	// also calculate CPU usage in seconds and print this
+	float seconds = timer_seconds(&table->stats.timer);
+	printf("        time spent: %.6f sec\n", seconds);
+	timer_print(&table->stats.timer);
+	event_print(&table->stats.splits, "splits");
+	event_print(&table->stats.doublings, "doublings");
+	mem_usage_print(&table->stats.memory, table->stats.nkeys,
+		wasted_bytes(table));
+
+	printf("--- end stats ---\n");
+}
+
+
+// fill in 'stats' with the statistics every type of table reports
+void xtndblz_hash_table_get_stats(XtndblZHashTable *table,
+		TableStats *stats) {
+	assert(table && stats);
+	stats->size = table->size;
+	stats->nkeys = table->stats.nkeys;
+	stats->capacity = (int64)table->stats.nbuckets * table->bucketsize;
+	table_stats_add_memory(stats, &table->stats.memory);
+	stats->wastedbytes = wasted_bytes(table);
+	stats->nbuckets = table->stats.nbuckets;
+	stats->bucketsize = table->bucketsize;
+	stats->depth = table->depth;
+	table_stats_add_timer(stats, &table->stats.timer);
+	// (doublings happen during the splits that need them)
+	table_stats_add_growths(stats, &table->stats.splits);
+}
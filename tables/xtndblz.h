@@ -0,0 +1,44 @@
+/* * * * * * * * *
+ * Dynamic hash table using extendible hashing with multiple keys per bucket,
+ * resolving collisions by incrementally growing the hash table, and storing
+ * each bucket's keys compressed
+ *
+ * created for COMP20007 Design of Algorithms - Assignment 2, 2017
+ * by Luke Hedt
+ */
+
+#ifndef XTNDBLZ_H
+#define XTNDBLZ_H
+
+#include <stdbool.h>
+#include "../inthash.h"
+#include "../tblstats.h"
+
+typedef struct xtndblz_table XtndblZHashTable;
+
+// initialise a compressed extendible hash table with 'bucketsize' keys per
+// bucket
+XtndblZHashTable *new_xtndblz_hash_table(int bucketsize);
+
+// free all memory associated with 'table'
+void free_xtndblz_hash_table(XtndblZHashTable *table);
+
+// insert 'key' into 'table', if it's not in there already
+// returns true if insertion succeeds, false if it was already in there
+bool xtndblz_hash_table_insert(XtndblZHashTable *table, int64 key);
+
+// lookup whether 'key' is inside 'table'
+// returns true if found, false if not
+bool xtndblz_hash_table_lookup(XtndblZHashTable *table, int64 key);
+
+// print the contents of 'table' to stdout
+void xtndblz_hash_table_print(XtndblZHashTable *table);
+
+// print some statistics about 'table' to stdout
+void xtndblz_hash_table_stats(XtndblZHashTable *table);
+
+// fill in 'stats' with the statistics every type of table reports (see
+// tblstats.h)
+void xtndblz_hash_table_get_stats(XtndblZHashTable *table, TableStats *stats);
+
+#endif
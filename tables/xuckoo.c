@@ -1,7 +1,7 @@
 /* * * * * * * * *
 * Dynamic hash table using a combination of extendible hashing and cuckoo
-* hashing with a single keys per bucket, resolving collisions by switching keys 
-* between two tables with two separate hash functions and growing the tables 
+* hashing with multiple keys per bucket, resolving collisions by switching keys
+* between two tables with two separate hash functions and growing the tables
 * incrementally in response to cycles
 *
 * created for COMP20007 Design of Algorithms - Assignment 2, 2017
@@ -12,49 +12,62 @@
 * StuID:    832153
 * Date:     14/05/2017
 *
-* Code based on cuckoo.c and xtndbl1.c unless stated otherwise.
+* Code based on cuckoo.c, xtndbl1.c and xtndbln.c unless stated otherwise.
 */
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <assert.h>
-#include <time.h>
+#include <stdint.h>
 
 #include "xuckoo.h"
+#include "../instrument.h"
 
-/* Maximum length of a chain before rehashing the table. */
+/* Maximum length of a chain before splitting a bucket. */
 #define MAXDEP 34
 
 // macro to calculate the rightmost n bits of a number x
 #define rightmostnbits(n, x) (x) & ((1 << (n)) - 1)
 
-// a bucket stores a single key (full=true) or is empty (full=false)
-// it also knows how many bits are shared between possible keys, and the first 
-// table address that references it
+// a bucket stores up to bucketsize keys
+// it also knows how many bits are shared between possible keys. its id (the
+// first table address that references it) is not stored, but is the rightmost
+// 'depth' bits of any address that references it
+// in a hash map, the keys are followed by their values in the same array, so
+// the value of keys[i] is keys[bucketsize + i]
 typedef struct bucket {
-	int id;		// a unique id for this bucket, equal to the first address
-				// in the table which points to it
-	int depth;	// how many hash value bits are being used by this bucket
-	bool full;	// does this bucket contain a key
-	int64 key;	// the key stored in this bucket
+	int depth;		// how many hash value bits are being used by this bucket
+	int nkeys;		// number of keys currently contained in this bucket
+	int64 *keys;	// the keys stored in this bucket (then their values)
 } Bucket;
 
 // helper structure to store statistics gathered
 typedef struct stats {
 	int nbuckets;	// how many distinct buckets does the table point to
 	int nkeys;		// how many keys are being stored in the table
-	int time;		// how much CPU time has been used to insert/lookup keys
+	int nsplits;	// how many buckets have been split
+	OpTimer timer;	// times the inserts and lookups of keys
 					// in this table
+	EventTimer splits;		// times each bucket split
+	EventTimer doublings;	// times each doubling of the table
+	EventTimer batches;		// times each batch of lookups
 } Stats;
 
-// an inner table is an extendible hash table with an array of slots pointing 
-// to buckets holding up to 1 key, along with some information about the number 
-// of hash value bits to use for addressing
+// an inner table is an extendible hash table with an array of slots holding
+// the 32-bit indices of buckets (holding up to bucketsize keys) in a
+// contiguous pool, along with some information about the number of hash value
+// bits to use for addressing
 typedef struct inner_table {
-	Bucket **buckets;	// array of pointers to buckets
-	int size;			// how many entries in the table of pointers (2^depth)
+	uint32_t *buckets;	// array of bucket indices into 'pool'
+	Bucket *pool;		// every bucket in the table, in order of creation
+	int poolsize;		// how many buckets 'pool' has space for
+	int size;			// how many entries in the table of indices (2^depth)
 	int depth;			// how many bits of the hash value to use (log2(size))
-	int nkeys;			// how many keys are being stored in the table
+	int hashnum;		// which hash function this table uses (1 or 2)
+	int stride;			// int64s in each bucket's 'keys': bucketsize in a set,
+						// twice that (keys, then values) in a map
+	MemUsage *memory;	// counts the memory allocated for the whole table
     Stats stats;		// collection of statistics about this hash table
 } InnerTable;
 
@@ -62,85 +75,180 @@ typedef struct inner_table {
 struct xuckoo_table {
 	InnerTable *table1;
 	InnerTable *table2;
+	int bucketsize;		// maximum number of keys per bucket
+	int ncucks;			// how many keys have been displaced so far
+	bool map;			// is there a value with each key?
+	MemUsage memory;	// counts the memory allocated for both inner tables
 };
 
+/* How many batched lookups to keep in flight at once */
+#define LOOKUP_GROUP 16
 
-/* 
+/* One in-flight batched lookup: which key it's for and how far along it is,
+ * in each of the two inner tables */
+typedef struct lookup_state {
+	enum { IDLE, DIRECTORY, BUCKET, KEYS } stage;	// what to look at next
+	int i;				// index of the key being looked up
+	int address[2];		// address for the key in table1 and table2
+	Bucket *bucket[2];	// bucket for the key in each (from stage BUCKET)
+} LookupState;
+
+
+/*
  * Helper Functions
  * */
 
-/* Initialises values for the new bucket */
-static void init_bucket(Bucket *bucket, int first_address, int depth) {
-    /* Make sure this is your memory */
-	assert(bucket);
+// the bucket referenced from table address 'address'
+#define bucket_at(table, address) (&(table)->pool[(table)->buckets[address]])
+
+/* The id of the bucket referenced from table address 'address': the first
+ * address in the table which points to it */
+static int bucket_id(InnerTable *table, int address) {
+	return rightmostnbits(bucket_at(table, address)->depth, address);
+}
 
-	bucket->id = first_address;
+/* Adds a new empty bucket (with space for 'stride' int64s) to the end of the
+ * pool and returns its index. This may move the pool, so look up any Bucket
+ * pointers again afterwards */
+static uint32_t new_bucket(InnerTable *table, int depth) {
+	if (table->stats.nbuckets == table->poolsize) {
+		table->poolsize *= 2;
+		table->pool = mem_realloc(table->memory, table->pool,
+			sizeof(*table->pool) * (table->poolsize / 2),
+			sizeof(*table->pool) * table->poolsize);
+		assert(table->pool);
+	}
+	uint32_t index = table->stats.nbuckets++;
+	Bucket *bucket = &table->pool[index];
+
+	bucket->keys = mem_alloc(table->memory,
+		sizeof(*bucket->keys) * table->stride);
+	assert(bucket->keys);
 	bucket->depth = depth;
-	bucket->full = false;
+	bucket->nkeys = 0;
 
+	return index;
 }
 
-/* Initialises an InnerTable */
-static void init_xuck_table(InnerTable *table) {
+/* Initialises an InnerTable using hash function 'hashnum', with buckets of
+ * 'stride' int64s, counting its memory in 'memory' */
+static void init_xuck_table(InnerTable *table, int hashnum, int stride,
+        MemUsage *memory) {
     /* Don't touch memory you didn't ask for! */
     assert(table);
 
     /* Initialise values and create bucket space */
+    table->memory = memory;
+    table->poolsize = 1;
+    table->pool = mem_alloc(memory, sizeof(*(table->pool)));
+    assert(table->pool);
+    table->stats.nbuckets = 0;
+
+    table->stride = stride;
     table->size = 1;
-    table->buckets = malloc(sizeof(*(table->buckets)));
+    table->buckets = mem_alloc(memory, sizeof(*(table->buckets)));
     assert(table->buckets);
-    table->buckets[0] = malloc(sizeof(table->buckets[0]));
-    init_bucket(table->buckets[0], 0, 0);
+    table->buckets[0] = new_bucket(table, 0);
     table->depth = 0;
-    table->nkeys = 0;
+    table->hashnum = hashnum;
 
     /* Initialise Stats Info */
-	table->stats.nbuckets = 1;
 	table->stats.nkeys = 0;
-	table->stats.time = 0;
+	table->stats.nsplits = 0;
+	timer_init(&table->stats.timer);
+	event_init(&table->stats.splits);
+	event_init(&table->stats.doublings);
+	event_init(&table->stats.batches);
 }
 
+/* Frees an InnerTable and all of its buckets */
+static void free_xuck_table(InnerTable *table) {
+	// free each bucket's keys, then the pool of buckets itself
+	int i;
+	for (i = 0; i < table->stats.nbuckets; i++) {
+		mem_free(table->memory, table->pool[i].keys,
+			sizeof(*table->pool[i].keys) * table->stride);
+	}
+	mem_free(table->memory, table->pool,
+		sizeof(*table->pool) * table->poolsize);
+
+	// free the array of bucket indices
+	mem_free(table->memory, table->buckets,
+		sizeof(*table->buckets) * table->size);
+	mem_free(table->memory, table, sizeof(*table));
+}
 
-// double the table of bucket pointers, duplicating the bucket pointers in the
-// first half into the new second half of the table
+/* Hashes 'key' with this inner table's hash function */
+static int xuck_hash(InnerTable *table, int64 key) {
+	return table->hashnum == 1 ? h1(key) : h2(key);
+}
+
+/* Finds 'key' in its bucket in 'table', returning the slot holding it (or
+ * NULL if it's not there) */
+static int64 *find_in_table(InnerTable *table, int64 key) {
+	int address = rightmostnbits(table->depth, xuck_hash(table, key));
+	Bucket *bucket = bucket_at(table, address);
+	int i;
+	for (i = 0; i < bucket->nkeys; i++) {
+		if (bucket->keys[i] == key) {
+			return &bucket->keys[i];
+		}
+	}
+	return NULL;
+}
+
+/* Finds the slot holding 'key' in either inner table, or returns NULL. (In a
+ * map, the key's value is 'bucketsize' slots after it.) */
+static int64 *find_key(XuckooHashTable *table, int64 key) {
+	int64 *slot = find_in_table(table->table1, key);
+	return slot ? slot : find_in_table(table->table2, key);
+}
+
+
+// double the table of bucket indices, duplicating the indices in the first
+// half into the new second half of the table
 static void double_table(InnerTable *table) {
+	TimerStart start = event_start();
 	int size = table->size * 2;
 	assert(size < MAX_TABLE_SIZE && "error: table has grown too large!");
 
-	// get a new array of twice as many bucket pointers, and copy pointers down
-	table->buckets = realloc(table->buckets, (sizeof *table->buckets) * size);
+	// get a new array of twice as many bucket indices, and copy indices down
+	table->buckets = mem_realloc(table->memory, table->buckets,
+		(sizeof *table->buckets) * table->size,
+		(sizeof *table->buckets) * size);
 	assert(table->buckets);
-	int i;
-	for (i = 0; i < table->size; i++) {
-		table->buckets[table->size + i] = table->buckets[i];
-	}
+	memcpy(table->buckets + table->size, table->buckets,
+		(sizeof *table->buckets) * table->size);
 
 	// finally, increase the table size and the depth we are using to hash keys
 	table->size = size;
 	table->depth++;
+	event_stop_traced(&table->stats.doublings, start, "xuckoo: double table",
+		size / 2, size);
 }
 
 // reinsert a key into the hash table after splitting a bucket --- we can assume
 // that there will definitely be space for this key because it was already
 // inside the hash table previously
-// use 'xtndbl1_hash_table_insert()' instead for inserting new keys
-static void reinsert_key(InnerTable *table, int hashnum, int64 key) {
-	int address;
-    if(hashnum == 1) {
-        address = rightmostnbits(table->depth, h1(key));
-    } else {
-        address = rightmostnbits(table->depth, h2(key));
-    }
-	table->buckets[address]->key = key;
-	table->buckets[address]->full = true;
+// use 'xuckoo_hash_table_insert()' instead for inserting new keys
+// (in a map, 'value' goes 'bucketsize' slots after it)
+static void reinsert_key(InnerTable *table, int64 key, int64 value,
+		int bucketsize) {
+	int address = rightmostnbits(table->depth, xuck_hash(table, key));
+	Bucket *bucket = bucket_at(table, address);
+	if (table->stride > bucketsize) {
+		bucket->keys[bucketsize + bucket->nkeys] = value;
+	}
+	bucket->keys[bucket->nkeys++] = key;
 }
 
 // split the bucket in 'table' at address 'address', growing table if necessary
-static void split_bucket(InnerTable *table, int hashnum, int address) {
+static void split_bucket(InnerTable *table, int address, int bucketsize) {
+	TimerStart start = event_start();
 
 	// FIRST,
 	// do we need to grow the table?
-	if (table->buckets[address]->depth == table->depth) {
+	if (bucket_at(table, address)->depth == table->depth) {
 		// yep, this bucket is down to its last pointer
 		double_table(table);
 	}
@@ -149,18 +257,14 @@ static void split_bucket(InnerTable *table, int hashnum, int address) {
 
 	// SECOND,
 	// create a new bucket and update both buckets' depth
-	Bucket *bucket = table->buckets[address];
-	int depth = bucket->depth;
-	int first_address = bucket->id;
+	int depth = bucket_at(table, address)->depth;
+	int first_address = bucket_id(table, address);
 
 	int new_depth = depth + 1;
+	uint32_t newbucket = new_bucket(table, new_depth);
+	Bucket *bucket = bucket_at(table, address);
 	bucket->depth = new_depth;
-
-	// new bucket's first address will be a 1 bit plus the old first address
-	int new_first_address = 1 << depth | first_address;
-	Bucket *newbucket = malloc(sizeof(*newbucket));
-    init_bucket(newbucket, new_first_address, new_depth);
-	table->stats.nbuckets++;
+	table->stats.nsplits++;
 
 	// THIRD,
 	// redirect every second address pointing to this bucket to the new bucket
@@ -187,120 +291,157 @@ static void split_bucket(InnerTable *table, int hashnum, int address) {
 	}
 
 	// FINALLY,
-	// filter the key from the old bucket into its rightful place in the new
+	// filter the keys from the old bucket into their rightful places in the new
 	// table (which may be the old bucket, or may be the new bucket)
 
-	// remove and reinsert the key
-	int64 key = bucket->key;
-	bucket->full = false;
-	reinsert_key(table, hashnum, key);
+	// remove and reinsert the keys (and their values: a key never moves to a
+	// slot after its own, so none is overwritten before it is reinserted)
+	int i, nkeys = bucket->nkeys;
+	bucket->nkeys = 0;
+	for (i = 0; i < nkeys; i++) {
+		int64 value = table->stride > bucketsize ? bucket->keys[bucketsize + i]
+			: 0;
+		reinsert_key(table, bucket->keys[i], value, bucketsize);
+	}
+	// (sized by its number of buckets, one more than before)
+	event_stop_traced(&table->stats.splits, start, "xuckoo: split bucket",
+		table->stats.nbuckets - 1, table->stats.nbuckets);
 }
 
-/* Chain-inserts values until it finds a blank spot. Will
- * rehash and resize table if necessary. */
-static void xuck_insert(XuckooHashTable *table, int hashnum, int64 key) {
+/* Chain-inserts values until it finds a bucket with space, starting with
+ * inner table 'ftable'. A key is only displaced from a bucket once that bucket
+ * is full. Splits the current full bucket after MAXDEP displacements. In a
+ * map, 'value' goes with 'key', and displaced keys take their values along. */
+static void xuck_insert(XuckooHashTable *table, InnerTable *ftable, int64 key,
+        int64 value) {
+    int bucketsize = table->bucketsize;
     assert(table);
     int chainlen = 0;
-    int hash, nexthash;
-    bool flg_insrt = true;
-    int64 oldkey;
-    InnerTable *ftable;
-
-    /* Loop until flagged, flagged if key inserted */
-    while(flg_insrt) {
-        /* Decide on Hash function and Inner Table */
-        if(hashnum == 1) {
-            ftable = table->table1;
-            hash = h1(key);
-            nexthash = 2;
-        } else {
-            ftable = table->table2;
-            hash = h2(key);
-            nexthash = 1;
-        }
 
+    /* Loop until the key being carried finds a home */
+    while(true) {
         // calculate table address
+        int hash = xuck_hash(ftable, key);
         int address = rightmostnbits(ftable->depth, hash);
 
-        /* Rehashes table after MAXDEP cucks */
-        if(chainlen > MAXDEP) {
-            split_bucket(ftable, hashnum, address);
+        /* After MAXDEP cucks, split this bucket and keep going (but only in
+         * the table with fewer buckets, so that both tables keep growing) */
+        InnerTable *other = (ftable == table->table1) ? table->table2
+            : table->table1;
+        if(chainlen > MAXDEP
+                && ftable->stats.nbuckets <= other->stats.nbuckets) {
+            split_bucket(ftable, address, bucketsize);
+            address = rightmostnbits(ftable->depth, hash);
             chainlen = 0;
         }
 
-        /* Check for cucks, breaks the loop if there are none */
-        if(ftable->buckets[address]->full) {
-            /* if(flg_first) { */
-            /*     table->stat.collisions += 1; */
-            /*     flg_first = false; */
-            /* } */
-            oldkey = ftable->buckets[address]->key;
-            chainlen += 1;
-            ftable->nkeys -= 1;
-            /* table->stat.probes += 1; */
-        } else {
-            flg_insrt = false;
+        /* If there's space, we're done */
+        Bucket *bucket = bucket_at(ftable, address);
+        if(bucket->nkeys < bucketsize) {
+            if(table->map) {
+                bucket->keys[bucketsize + bucket->nkeys] = value;
+            }
+            bucket->keys[bucket->nkeys++] = key;
+            ftable->stats.nkeys++;
+            return;
         }
 
-        /* Insert the key and set up the cucked key if necessary. */
-        ftable->buckets[address]->key = key;
-        ftable->buckets[address]->full = true;
-        ftable->stats.nkeys++;
+        /* Otherwise, swap the key with one of the bucket's keys (taking turns,
+         * so we don't keep kicking out the same key) and carry the old key
+         * over to the other table */
+        int victim = table->ncucks % bucket->nkeys;
+        int64 oldkey = bucket->keys[victim];
+        bucket->keys[victim] = key;
         key = oldkey;
-        hashnum = nexthash;
+        if(table->map) {
+            int64 oldvalue = bucket->keys[bucketsize + victim];
+            bucket->keys[bucketsize + victim] = value;
+            value = oldvalue;
+        }
+        table->ncucks++;
+        chainlen++;
+
+        ftable = other;
     }
+}
 
+/* Returns the bytes allocated for keys (and values) in 'table' holding none,
+ * plus the space at the end of each pool for buckets not yet made */
+static int64 wasted_bytes(XuckooHashTable *table) {
+    InnerTable *inner[2] = { table->table1, table->table2 };
+    int64 wasted = 0;
+    int i;
+    for (i = 0; i < 2; i++) {
+        int64 nslots = (int64)inner[i]->stats.nbuckets * table->bucketsize;
+        wasted += (nslots - inner[i]->stats.nkeys) * sizeof(int64)
+            * inner[i]->stride / table->bucketsize;
+        wasted += (int64)(inner[i]->poolsize - inner[i]->stats.nbuckets)
+            * sizeof(*inner[i]->pool);
+    }
+    return wasted;
 }
 
-/* 
- * Real Functions
- */
-// initialise an extendible cuckoo hash table
-XuckooHashTable *new_xuckoo_hash_table() {
+/* Inserts 'key', which isn't in 'table' yet, with 'value' (in a map) */
+static void insert_new_key(XuckooHashTable *table, int64 key, int64 value) {
+    // Start with the table holding fewer keys (table1 if they're equal)
+    InnerTable *ftable = table->table1;
+    if(table->table2->stats.nkeys < table->table1->stats.nkeys) {
+        ftable = table->table2;
+    }
+
+    /* Cuckoo insert the key until a space is found, splitting buckets if
+     * necessary */
+    xuck_insert(table, ftable, key, value);
+}
+
+/* Creates an extendible cuckoo table with 'bucketsize' keys per bucket, and
+ * a value with each key if 'map' is true */
+static XuckooHashTable *new_xuck(int bucketsize, bool map) {
     /* Ask for mem for table and make sure you have it */
     XuckooHashTable *table = malloc(sizeof(*table));
     assert(table);
+    table->bucketsize = bucketsize;
+    table->ncucks = 0;
+    table->map = map;
+    mem_usage_init(&table->memory, sizeof(*table));
 
     /* Create and initialise both inner tables */
-    InnerTable *table1 = malloc(sizeof(*table1));
-    init_xuck_table(table1);
+    int stride = map ? 2 * bucketsize : bucketsize;
+    InnerTable *table1 = mem_alloc(&table->memory, sizeof(*table1));
+    assert(table1);
+    init_xuck_table(table1, 1, stride, &table->memory);
     table->table1 = table1;
-    InnerTable *table2 = malloc(sizeof(*table2));
-    init_xuck_table(table2);
+    InnerTable *table2 = mem_alloc(&table->memory, sizeof(*table2));
+    assert(table2);
+    init_xuck_table(table2, 2, stride, &table->memory);
     table->table2 = table2;
 
     return table;
 }
 
+/*
+ * Real Functions
+ */
+// initialise an extendible cuckoo hash table with 'bucketsize' keys per bucket
+XuckooHashTable *new_xuckoo_hash_table(int bucketsize) {
+    return new_xuck(bucketsize, false);
+}
+
+
+// initialise an extendible cuckoo hash map, storing a value with each key,
+// with 'bucketsize' keys per bucket
+XuckooHashTable *new_xuckoo_hash_map(int bucketsize) {
+    return new_xuck(bucketsize, true);
+}
+
 
 // free all memory associated with 'table'
 void free_xuckoo_hash_table(XuckooHashTable *table) {
 	assert(table);
-    
-    /* Free Inner1 */
-	// loop backwards through the array of pointers, freeing buckets only as we
-	// reach their first reference
-	// (if we loop through forwards, we wouldn't know which reference was last)
-	int i;
-    for (i = table->table1->size-1; i >= 0; i--) {
-        if (table->table1->buckets[i]->id == i) {
-            free(table->table1->buckets[i]);
-        }
-	}
-	// free the array of bucket pointers
-	free(table->table1->buckets);
-    free(table->table1);
-
-    /* Free Inner2 */
-    for (i = table->table2->size-1; i >= 0; i--) {
-        if (table->table2->buckets[i]->id == i) {
-            free(table->table2->buckets[i]);
-        }
-	}
 
-	// free the array of bucket pointers
-	free(table->table2->buckets);
-    free(table->table2);
+    /* Free both inner tables */
+    free_xuck_table(table->table1);
+    free_xuck_table(table->table2);
 
 	// free the table struct itself
 	free(table);
@@ -311,46 +452,19 @@ void free_xuckoo_hash_table(XuckooHashTable *table) {
 // returns true if insertion succeeds, false if it was already in there
 bool xuckoo_hash_table_insert(XuckooHashTable *table, int64 key) {
 	assert(table);
-	int start_time = clock(); // start timing
-    InnerTable *ftable = table->table1;
-	int hash = h1(key);
-    int newhash = 2;
-
-    // Decide on table and hash algorithm
-    if(table->table2->nkeys < table->table1->nkeys) {
-        ftable = table->table2;
-        hash = h2(key);
-        newhash = 1;
-    }
-
-	// calculate table address
-	int address = rightmostnbits(ftable->depth, hash);
+	TimerStart start = timer_start(&table->table1->stats.timer);
 
 	// is this key already there?
-	if (xuckoo_hash_table_lookup(table, key)) {
-		table->table1->stats.time += clock() - start_time; // add time elapsed
+	if (find_key(table, key)) {
+		// stop timing
+		timer_stop(&table->table1->stats.timer, start, OP_INSERT_HIT);
 		return false;
 	}
 
-    /* If not, cuckoo insert the key until a space is found, resize the tables
-    * if necessary */
-	// if not, make space in the table until our target bucket has space
-	if(ftable->buckets[address]->full) {
-        int64 oldkey = ftable->buckets[address]->key;
-        ftable->buckets[address]->key = key;
-
-        xuck_insert(table, newhash, oldkey);
-
-	} else {
-        // there's now space! we can insert this key
-        ftable->buckets[address]->key = key;
-        ftable->buckets[address]->full = true;
-        ftable->stats.nkeys++;
-    }
-
+	insert_new_key(table, key, 0);
 
-	// add time elapsed to total CPU time before returning
-	table->table1->stats.time += clock() - start_time;
+	// stop timing before returning
+	timer_stop(&table->table1->stats.timer, start, OP_INSERT_NEW);
 	return true;
 }
 
@@ -359,32 +473,155 @@ bool xuckoo_hash_table_insert(XuckooHashTable *table, int64 key) {
 // returns true if found, false if not
 bool xuckoo_hash_table_lookup(XuckooHashTable *table, int64 key) {
 	assert(table);
-	int start_time = clock(); // start timing
-
-	// calculate table address for this key
-	int address = rightmostnbits(table->table1->depth, h1(key));
-
-	// look for the key in table1 in that bucket (unless it's empty)
-	bool found = false;
-	if (table->table1->buckets[address]->full) {
-		// found it? Only search table2 if the  h1 key has somehting in it.
-		if(table->table1->buckets[address]->key == key) {
-            found = true;
-        } else {
-	        address = rightmostnbits(table->table2->depth, h2(key));
-		    if(table->table2->buckets[address] && 
-                            table->table2->buckets[address]->key == key) {
-                found = true;
-            }
-        }
-	}
+	TimerStart start = timer_start(&table->table1->stats.timer);
+
+	// look for the key in its bucket in table1, then in table2
+	bool found = find_key(table, key) != NULL;
 
-	// add time elapsed to total CPU time before returning result
-	table->table1->stats.time += clock() - start_time;
+	// stop timing before returning result
+	timer_stop(&table->table1->stats.timer, start,
+		found ? OP_LOOKUP_HIT : OP_LOOKUP_MISS);
 	return found;
 }
 
 
+// insert 'key' into map 'table' with value 'value', or if 'key' is already in
+// there, replace its value with 'value'
+// returns true if 'key' was inserted, false if it was already in there
+bool xuckoo_hash_table_put(XuckooHashTable *table, int64 key, int64 value) {
+	assert(table && table->map);
+	TimerStart start = timer_start(&table->table1->stats.timer);
+
+	// overwrite the value of a key that's already here, or insert it
+	int64 *slot = find_key(table, key);
+	if (slot) {
+		slot[table->bucketsize] = value;
+	} else {
+		insert_new_key(table, key, value);
+	}
+
+	// stop timing before returning
+	timer_stop(&table->table1->stats.timer, start,
+		slot ? OP_INSERT_HIT : OP_INSERT_NEW);
+	return slot == NULL;
+}
+
+
+// lookup 'key' in map 'table', and if it's there store its value in '*value'
+// returns true if found, false if not
+bool xuckoo_hash_table_get(XuckooHashTable *table, int64 key, int64 *value) {
+	assert(table && table->map);
+	TimerStart start = timer_start(&table->table1->stats.timer);
+
+	int64 *slot = find_key(table, key);
+	if (slot) {
+		*value = slot[table->bucketsize];
+	}
+
+	// stop timing before returning result
+	timer_stop(&table->table1->stats.timer, start,
+		slot ? OP_LOOKUP_HIT : OP_LOOKUP_MISS);
+	return slot != NULL;
+}
+
+
+// replace the value of 'key' in map 'table' with 'value', if 'key' is in there
+// returns true if found (and updated), false if not
+bool xuckoo_hash_table_update(XuckooHashTable *table, int64 key,
+		int64 value) {
+	assert(table && table->map);
+	TimerStart start = timer_start(&table->table1->stats.timer);
+
+	int64 *slot = find_key(table, key);
+	if (slot) {
+		slot[table->bucketsize] = value;
+	}
+
+	// stop timing before returning result
+	timer_stop(&table->table1->stats.timer, start,
+		slot ? OP_LOOKUP_HIT : OP_LOOKUP_MISS);
+	return slot != NULL;
+}
+
+
+/* Looks up each of the 'n' keys in 'keys', storing the answers in 'found',
+ * and returns how many were found. Like xtndbln's batch lookup, but each
+ * in-flight lookup walks both inner tables side by side. */
+int xuckoo_hash_table_lookup_batch(XuckooHashTable *table, int64 *keys,
+		int n, bool *found) {
+	assert(table);
+	TimerStart start = event_start();
+
+	InnerTable *innertables[2] = {table->table1, table->table2};
+	LookupState group[LOOKUP_GROUP];
+	int g, t;
+	for (g = 0; g < LOOKUP_GROUP; g++) {
+		group[g].stage = IDLE;
+	}
+
+	/* Step each lookup in the group along until every key is answered */
+	int next = 0, remaining = n, nfound = 0;
+	while (remaining > 0) {
+		for (g = 0; g < LOOKUP_GROUP; g++) {
+			LookupState *state = &group[g];
+			switch (state->stage) {
+				case IDLE:
+					/* Start on the next key, if there are any left */
+					if (next == n) {
+						break;
+					}
+					state->i = next++;
+					for (t = 0; t < 2; t++) {
+						InnerTable *inner = innertables[t];
+						state->address[t] = rightmostnbits(inner->depth,
+							xuck_hash(inner, keys[state->i]));
+						__builtin_prefetch(&inner->buckets[state->address[t]]);
+					}
+					state->stage = DIRECTORY;
+					break;
+				case DIRECTORY:
+					/* Both directory slots should be cached by now */
+					for (t = 0; t < 2; t++) {
+						state->bucket[t] = bucket_at(innertables[t],
+							state->address[t]);
+						__builtin_prefetch(state->bucket[t]);
+					}
+					state->stage = BUCKET;
+					break;
+				case BUCKET:
+					/* Then the Buckets, which say where their keys are */
+					for (t = 0; t < 2; t++) {
+						__builtin_prefetch(state->bucket[t]->keys);
+					}
+					state->stage = KEYS;
+					break;
+				case KEYS: {
+					/* And finally the keys: is ours in either bucket? */
+					int64 key = keys[state->i];
+					bool hit = false;
+					for (t = 0; t < 2 && !hit; t++) {
+						Bucket *bucket = state->bucket[t];
+						int i;
+						for (i = 0; i < bucket->nkeys && !hit; i++) {
+							hit = bucket->keys[i] == key;
+						}
+					}
+					found[state->i] = hit;
+					nfound += hit;
+					remaining--;
+					state->stage = IDLE;
+					break;
+				}
+			}
+		}
+	}
+
+	// stop timing before returning result
+	event_stop(&table->table1->stats.batches, start);
+	return nfound;
+}
+
+
 // print the contents of 'table' to stdout
 void xuckoo_hash_table_print(XuckooHashTable *table) {
 	assert(table != NULL);
@@ -400,20 +637,36 @@ void xuckoo_hash_table_print(XuckooHashTable *table) {
 
 		printf("  table:               buckets:\n");
 		printf("  address | bucketid   bucketid [key]\n");
-		
+
 		// print table and buckets
 		int i;
 		for (i = 0; i < innertables[t]->size; i++) {
 			// table entry
-			printf("%9d | %-9d ", i, innertables[t]->buckets[i]->id);
+			Bucket *bucket = bucket_at(innertables[t], i);
+			int id = bucket_id(innertables[t], i);
+			printf("%9d | %-9d ", i, id);
 
 			// if this is the first address at which a bucket occurs, print it
-			if (innertables[t]->buckets[i]->id == i) {
-				printf("%9d ", innertables[t]->buckets[i]->id);
-				if (innertables[t]->buckets[i]->full) {
-					printf("[%llu]", innertables[t]->buckets[i]->key);
+			if (id == i) {
+				printf("%9d ", id);
+				if (table->bucketsize == 1) {
+					// single-key buckets keep the original format
+					if (bucket->nkeys) {
+						printf("[%llu]", bucket->keys[0]);
+					} else {
+						printf("[ ]");
+					}
 				} else {
-					printf("[ ]");
+					printf("[");
+					int j;
+					for (j = 0; j < table->bucketsize; j++) {
+						if (j < bucket->nkeys) {
+							printf(" %llu", bucket->keys[j]);
+						} else {
+							printf(" -");
+						}
+					}
+					printf(" ]");
 				}
 			}
 
@@ -435,13 +688,57 @@ void xuckoo_hash_table_stats(XuckooHashTable *table) {
 	printf("current table1 size: %d\n", table->table1->size);
 	printf("    number of keys: %d\n", table->table1->stats.nkeys);
 	printf(" number of buckets: %d\n", table->table1->stats.nbuckets);
+	printf("     buckets split: %d\n", table->table1->stats.nsplits);
 	printf("current table2 size: %d\n", table->table2->size);
 	printf("    number of keys: %d\n", table->table2->stats.nkeys);
 	printf(" number of buckets: %d\n", table->table2->stats.nbuckets);
+	printf("     buckets split: %d\n", table->table2->stats.nsplits);
+	printf("   keys per bucket: %d\n", table->bucketsize);
+	int nkeys = table->table1->stats.nkeys + table->table2->stats.nkeys;
+	int nbuckets = table->table1->stats.nbuckets
+		+ table->table2->stats.nbuckets;
+	printf("       load factor: %.3f%%\n",
+		nkeys * 100.0 / ((double)nbuckets * table->bucketsize));
+	printf("     keys cuckoo'd: %d\n", table->ncucks);
 
 	// also calculate CPU usage in seconds and print this
-	float seconds = table->table1->stats.time * 1.0 / CLOCKS_PER_SEC;
-	printf("    CPU time spent: %.6f sec\n", seconds);
+	float seconds = timer_seconds(&table->table1->stats.timer)
+		+ event_seconds(&table->table1->stats.batches);
+	printf("        time spent: %.6f sec\n", seconds);
+	timer_print(&table->table1->stats.timer);
+	event_print(&table->table1->stats.splits, "table1 splits");
+	event_print(&table->table1->stats.doublings, "table1 doublings");
+	event_print(&table->table2->stats.splits, "table2 splits");
+	event_print(&table->table2->stats.doublings, "table2 doublings");
+	if (table->table1->stats.batches.count > 0) {
+		event_print(&table->table1->stats.batches, "lookup batches");
+	}
+	mem_usage_print(&table->memory, nkeys, wasted_bytes(table));
 
 	printf("--- end stats ---\n");
 }
+
+
+// fill in 'stats' with the statistics every type of table reports
+void xuckoo_hash_table_get_stats(XuckooHashTable *table, TableStats *stats) {
+	assert(table && stats);
+	table_stats_add_memory(stats, &table->memory);
+	stats->wastedbytes = wasted_bytes(table);
+	InnerTable *inner[2] = { table->table1, table->table2 };
+	int i;
+	for (i = 0; i < 2; i++) {
+		stats->size += inner[i]->size;
+		stats->nkeys += inner[i]->stats.nkeys;
+		stats->nbuckets += inner[i]->stats.nbuckets;
+		if (inner[i]->depth > (int)stats->depth) {
+			stats->depth = inner[i]->depth;
+		}
+		// (doublings happen during the splits that need them)
+		table_stats_add_growths(stats, &inner[i]->stats.splits);
+	}
+	stats->capacity = stats->nbuckets * table->bucketsize;
+	stats->bucketsize = table->bucketsize;
+	stats->probes = table->ncucks;
+	table_stats_add_timer(stats, &table->table1->stats.timer);
+	stats->opseconds += event_seconds(&table->table1->stats.batches);
+}
@@ -1,6 +1,6 @@
 /* * * * * * * * *
 * Dynamic hash table using a combination of extendible hashing and cuckoo
-* hashing with a single keys per bucket, resolving collisions by switching keys 
+* hashing with multiple keys per bucket, resolving collisions by switching keys 
 * between two tables with two separate hash functions and growing the tables 
 * incrementally in response to cycles
 *
@@ -13,11 +13,16 @@
 
 #include <stdbool.h>
 #include "../inthash.h"
+#include "../tblstats.h"
 
 typedef struct xuckoo_table XuckooHashTable;
 
-// initialise an extendible cuckoo hash table
-XuckooHashTable *new_xuckoo_hash_table();
+// initialise an extendible cuckoo hash table with 'bucketsize' keys per bucket
+XuckooHashTable *new_xuckoo_hash_table(int bucketsize);
+
+// initialise an extendible cuckoo hash map, storing a value with each key,
+// with 'bucketsize' keys per bucket
+XuckooHashTable *new_xuckoo_hash_map(int bucketsize);
 
 // free all memory associated with 'table'
 void free_xuckoo_hash_table(XuckooHashTable *table);
@@ -30,10 +35,33 @@ bool xuckoo_hash_table_insert(XuckooHashTable *table, int64 key);
 // returns true if found, false if not
 bool xuckoo_hash_table_lookup(XuckooHashTable *table, int64 key);
 
+// lookup whether each of the 'n' keys in 'keys' is inside 'table', storing
+// the answers in 'found', and return how many were found
+// faster than 'n' separate lookups once the table no longer fits in cache
+int xuckoo_hash_table_lookup_batch(XuckooHashTable *table, int64 *keys,
+	int n, bool *found);
+
+// insert 'key' into map 'table' with value 'value', or if 'key' is already in
+// there, replace its value with 'value'
+// returns true if 'key' was inserted, false if it was already in there
+bool xuckoo_hash_table_put(XuckooHashTable *table, int64 key, int64 value);
+
+// lookup 'key' in map 'table', and if it's there store its value in '*value'
+// returns true if found, false if not
+bool xuckoo_hash_table_get(XuckooHashTable *table, int64 key, int64 *value);
+
+// replace the value of 'key' in map 'table' with 'value', if 'key' is in there
+// returns true if found (and updated), false if not
+bool xuckoo_hash_table_update(XuckooHashTable *table, int64 key, int64 value);
+
 // print the contents of 'table' to stdout
 void xuckoo_hash_table_print(XuckooHashTable *table);
 
 // print some statistics about 'table' to stdout
 void xuckoo_hash_table_stats(XuckooHashTable *table);
 
+// fill in 'stats' with the statistics every type of table reports (see
+// tblstats.h)
+void xuckoo_hash_table_get_stats(XuckooHashTable *table, TableStats *stats);
+
 #endif
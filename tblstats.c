@@ -0,0 +1,235 @@
+/* * * * * * * * *
+ * Module for the statistics every type of hash table can report in the same
+ * form, and for writing them out for machines to read
+ *
+ * created for COMP20007 Design of Algorithms - Assignment 2, 2017
+ * by Luke Hedt
+ *
+ * Both formats are written from one list of the fields, so that a field added
+ * to TableStats (and to that list) appears in each of them under the same
+ * name. Prometheus counters follow its convention of ending in _total, and
+ * times are in seconds as it expects.
+ *
+ * The memory hooks count with atomic adds, since the thread-safe tables
+ * allocate from many threads at once. That costs next to nothing beside the
+ * allocation itself.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <assert.h>
+
+#include "tblstats.h"
+
+// how to write out one field of TableStats
+typedef struct field {
+	const char *name;	// its JSON key, and its metric name after a2_table_
+	const char *help;	// what it is, for the metric's HELP line
+	size_t offset;		// where it is in TableStats
+	bool real;			// is it a double? (otherwise an int64)
+	bool counter;		// does it only ever go up? (otherwise a gauge)
+} Field;
+
+#define INT_FIELD(field, name, help, counter) \
+	{ name, help, offsetof(TableStats, field), false, counter }
+#define REAL_FIELD(field, name, help, counter) \
+	{ name, help, offsetof(TableStats, field), true, counter }
+
+static const Field fields[] = {
+	INT_FIELD(size, "size", "Slots, or directory entries.", false),
+	INT_FIELD(nkeys, "keys", "Keys stored.", false),
+	INT_FIELD(capacity, "capacity", "Keys the allocated space can hold.",
+		false),
+	REAL_FIELD(load, "load", "Keys stored per key of capacity.", false),
+	INT_FIELD(nbytes, "bytes", "Bytes allocated in memory.", false),
+	INT_FIELD(peakbytes, "peak_bytes", "Most bytes allocated at once.", false),
+	REAL_FIELD(keybytes, "bytes_per_key", "Bytes allocated per key stored.",
+		false),
+	INT_FIELD(wastedbytes, "wasted_bytes",
+		"Bytes of empty slots and unused bucket space.", false),
+	INT_FIELD(nbuckets, "buckets", "Buckets, for bucketed tables.", false),
+	INT_FIELD(bucketsize, "bucket_size", "Most keys per bucket.", false),
+	INT_FIELD(depth, "depth", "Hash bits addressing the directory.", false),
+	INT_FIELD(collisions, "collisions_total",
+		"Inserts whose first choice of slot was taken.", true),
+	INT_FIELD(probes, "probes_total",
+		"Slots probed past the first, or keys kicked out.", true),
+	INT_FIELD(nops, "operations_total", "Inserts and lookups made.", true),
+	REAL_FIELD(opseconds, "operation_seconds_total",
+		"Estimated time spent on inserts and lookups.", true),
+	INT_FIELD(ngrowths, "growths_total",
+		"Resizes, rehashes and bucket splits.", true),
+	REAL_FIELD(growseconds, "growth_seconds_total",
+		"Time spent on resizes, rehashes and bucket splits.", true),
+};
+
+#define NFIELDS (int)(sizeof fields / sizeof *fields)
+
+
+/* * * *
+ * helper functions
+ */
+
+// write the value of 'field' in 'stats' to 'file'
+static void write_value(const TableStats *stats, const Field *field,
+		FILE *file) {
+	const char *at = (const char *)stats + field->offset;
+	if (field->real) {
+		fprintf(file, "%.9g", *(const double *)at);
+	} else {
+		fprintf(file, "%llu", (unsigned long long)*(const int64 *)at);
+	}
+}
+
+
+// count 'delta' more bytes (or fewer, if it's negative) in 'usage'
+static void count_bytes(MemUsage *usage, int64_t delta) {
+	int64 current = __atomic_add_fetch(&usage->current, delta,
+		__ATOMIC_RELAXED);
+	int64 peak = __atomic_load_n(&usage->peak, __ATOMIC_RELAXED);
+	while (current > peak && !__atomic_compare_exchange_n(&usage->peak, &peak,
+			current, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+		// the cas loaded the new peak into 'peak': try again
+	}
+}
+
+
+/* * * *
+ * all functions
+ */
+
+// start counting, with 'size' bytes already allocated (the table's own
+// struct, which holds 'usage')
+void mem_usage_init(MemUsage *usage, size_t size) {
+	usage->current = size;
+	usage->peak = size;
+}
+
+
+// allocate 'size' bytes, as malloc(), counting them in 'usage'
+void *mem_alloc(MemUsage *usage, size_t size) {
+	void *ptr = malloc(size);
+	if (ptr != NULL) {
+		count_bytes(usage, size);
+	}
+	return ptr;
+}
+
+
+// resize the 'oldsize' bytes at 'ptr' to 'newsize' bytes, as realloc(),
+// counting the difference in 'usage'
+void *mem_realloc(MemUsage *usage, void *ptr, size_t oldsize,
+		size_t newsize) {
+	void *newptr = realloc(ptr, newsize);
+	if (newptr != NULL || newsize == 0) {	// (realloc to 0 bytes may free)
+		count_bytes(usage, (int64_t)newsize - (int64_t)oldsize);
+	}
+	return newptr;
+}
+
+
+// free the 'size' bytes at 'ptr', as free(), no longer counting them in 'usage'
+void mem_free(MemUsage *usage, void *ptr, size_t size) {
+	if (ptr != NULL) {
+		count_bytes(usage, -(int64_t)size);
+	}
+	free(ptr);
+}
+
+
+// print the memory counted in 'usage' by a table holding 'nkeys' keys, of
+// which 'wasted' bytes hold no key, to stdout on one line
+void mem_usage_print(const MemUsage *usage, int64 nkeys, int64 wasted) {
+	printf("%14s: %llu bytes (peak %llu), %.2f bytes/key, %llu wasted\n",
+		"memory", (unsigned long long)usage->current,
+		(unsigned long long)usage->peak,
+		nkeys == 0 ? 0.0 : (double)usage->current / nkeys,
+		(unsigned long long)wasted);
+}
+
+
+// set every field of 'stats' to 0 (and its type to NULL)
+void table_stats_init(TableStats *stats) {
+	memset(stats, 0, sizeof *stats);
+	stats->type = NULL;
+}
+
+
+// add the memory counted in 'usage' to 'stats'
+void table_stats_add_memory(TableStats *stats, const MemUsage *usage) {
+	stats->nbytes += usage->current;
+	stats->peakbytes += usage->peak;
+}
+
+
+// add the operations counted and timed by 'timer' to 'stats'
+void table_stats_add_timer(TableStats *stats, const OpTimer *timer) {
+	stats->nops += timer->nops;
+	stats->opseconds += timer_seconds(timer);
+}
+
+
+// add the growth events counted and timed by 'events' to 'stats'
+void table_stats_add_growths(TableStats *stats, const EventTimer *events) {
+	stats->ngrowths += events->count;
+	stats->growseconds += event_seconds(events);
+}
+
+
+// add the sizes and counts in 'more' to those in 'stats' (taking the deeper
+// of their depths), as for a table made of several smaller ones
+void table_stats_add(TableStats *stats, const TableStats *more) {
+	stats->size += more->size;
+	stats->nkeys += more->nkeys;
+	stats->capacity += more->capacity;
+	stats->nbytes += more->nbytes;
+	stats->peakbytes += more->peakbytes;	// (their peaks may not coincide)
+	stats->wastedbytes += more->wastedbytes;
+	stats->nbuckets += more->nbuckets;
+	if (more->bucketsize > stats->bucketsize) {
+		stats->bucketsize = more->bucketsize;
+	}
+	if (more->depth > stats->depth) {
+		stats->depth = more->depth;
+	}
+	stats->collisions += more->collisions;
+	stats->probes += more->probes;
+	stats->nops += more->nops;
+	stats->opseconds += more->opseconds;
+	stats->ngrowths += more->ngrowths;
+	stats->growseconds += more->growseconds;
+}
+
+
+// write 'stats' to 'file' as a single line JSON object
+void table_stats_write_json(const TableStats *stats, FILE *file) {
+	assert(stats && file);
+	fprintf(file, "{\"type\":\"%s\"", stats->type ? stats->type : "");
+	int i;
+	for (i = 0; i < NFIELDS; i++) {
+		fprintf(file, ",\"%s\":", fields[i].name);
+		write_value(stats, &fields[i], file);
+	}
+	fprintf(file, "}\n");
+}
+
+
+// write 'stats' to 'file' in the Prometheus text exposition format, as
+// metrics named a2_table_*, labelled with the table's type
+void table_stats_write_prometheus(const TableStats *stats, FILE *file) {
+	assert(stats && file);
+	int i;
+	for (i = 0; i < NFIELDS; i++) {
+		const Field *field = &fields[i];
+		fprintf(file, "# HELP a2_table_%s %s\n", field->name, field->help);
+		fprintf(file, "# TYPE a2_table_%s %s\n", field->name,
+			field->counter ? "counter" : "gauge");
+		fprintf(file, "a2_table_%s{type=\"%s\"} ", field->name,
+			stats->type ? stats->type : "");
+		write_value(stats, field, file);
+		fprintf(file, "\n");
+	}
+}
@@ -0,0 +1,107 @@
+/* * * * * * * * *
+ * Module for the statistics every type of hash table can report in the same
+ * form, and for writing them out for machines to read: as JSON, or in the
+ * Prometheus text exposition format
+ *
+ * each type fills in the fields that mean something for it, and leaves the
+ * rest as 0 (a linear probing table has no buckets, an extendible table has
+ * no probes...). capacity is what the table can hold in the space it has
+ * now, so nkeys / capacity is its load whatever its layout
+ *
+ * every type also counts the memory it allocates, by calling the hooks below
+ * in place of malloc, realloc and free (passing the size of what it frees,
+ * which it always knows), so that the bytes it uses now and at its peak are
+ * exact rather than worked out from its layout
+ *
+ * usage:
+ *   TableStats stats;
+ *   hash_table_get_stats(table, &stats);	// (see hashtbl.h)
+ *   table_stats_write_json(&stats, stdout);
+ *
+ * created for COMP20007 Design of Algorithms - Assignment 2, 2017
+ * by Luke Hedt
+ */
+
+#ifndef TBLSTATS_H
+#define TBLSTATS_H
+
+#include <stdio.h>
+#include <stddef.h>
+#include "inthash.h"
+#include "instrument.h"
+
+typedef struct table_stats {
+	const char *type;	// the name of the table's type ("sharded:" and the
+						// name of its shards' type for a sharded table)
+	int64 size;			// slots, or directory entries for extendible types
+						// (or primary buckets for linhash)
+	int64 nkeys;		// how many keys are stored
+	int64 capacity;		// how many keys fit in the space allocated so far
+	double load;		// nkeys / capacity
+	int64 nbytes;		// bytes allocated for the table in memory now
+	int64 peakbytes;	// the most it has had allocated at once
+	double keybytes;	// nbytes / nkeys
+	int64 wastedbytes;	// bytes allocated for keys (and values) but holding
+						// none: empty slots, and unused space in buckets
+	int64 nbuckets;		// how many buckets there are, for bucketed types
+	int64 bucketsize;	// the most keys each bucket can hold
+	int64 depth;		// how many hash value bits address the directory
+						// (or linhash's level)
+	int64 collisions;	// inserts whose first choice of slot was taken
+	int64 probes;		// slots probed past the first, or keys kicked out
+	int64 nops;			// how many inserts and lookups have been made
+	double opseconds;	// an estimate of the time they took altogether
+	int64 ngrowths;		// how many resizes, rehashes and bucket splits (each
+						// with any directory doubling it needed)
+	double growseconds;	// the time they took altogether
+} TableStats;
+
+// the memory a table has allocated, counted by the hooks below (which may
+// be called from many threads at once)
+typedef struct mem_usage {
+	int64 current;		// how many bytes are allocated now
+	int64 peak;			// the most that have been allocated at once
+} MemUsage;
+
+// start counting, with 'size' bytes already allocated (the table's own
+// struct, which holds 'usage')
+void mem_usage_init(MemUsage *usage, size_t size);
+
+// allocate 'size' bytes, as malloc(), counting them in 'usage'
+void *mem_alloc(MemUsage *usage, size_t size);
+
+// resize the 'oldsize' bytes at 'ptr' to 'newsize' bytes, as realloc(),
+// counting the difference in 'usage'
+void *mem_realloc(MemUsage *usage, void *ptr, size_t oldsize, size_t newsize);
+
+// free the 'size' bytes at 'ptr', as free(), no longer counting them in 'usage'
+void mem_free(MemUsage *usage, void *ptr, size_t size);
+
+// print the memory counted in 'usage' by a table holding 'nkeys' keys, of
+// which 'wasted' bytes hold no key, to stdout on one line
+void mem_usage_print(const MemUsage *usage, int64 nkeys, int64 wasted);
+
+// set every field of 'stats' to 0 (and its type to NULL)
+void table_stats_init(TableStats *stats);
+
+// add the memory counted in 'usage' to 'stats'
+void table_stats_add_memory(TableStats *stats, const MemUsage *usage);
+
+// add the operations counted and timed by 'timer' to 'stats'
+void table_stats_add_timer(TableStats *stats, const OpTimer *timer);
+
+// add the growth events counted and timed by 'events' to 'stats'
+void table_stats_add_growths(TableStats *stats, const EventTimer *events);
+
+// add the sizes and counts in 'more' to those in 'stats' (taking the deeper
+// of their depths), as for a table made of several smaller ones
+void table_stats_add(TableStats *stats, const TableStats *more);
+
+// write 'stats' to 'file' as a single line JSON object
+void table_stats_write_json(const TableStats *stats, FILE *file);
+
+// write 'stats' to 'file' in the Prometheus text exposition format, as
+// metrics named a2_table_*, labelled with the table's type
+void table_stats_write_prometheus(const TableStats *stats, FILE *file);
+
+#endif
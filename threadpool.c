@@ -0,0 +1,163 @@
+/* * * * * * * * *
+ * Module containing a fixed pool of worker threads, which all run the same
+ * task together, for splitting a job up between threads
+ *
+ * created for COMP20007 Design of Algorithms - Assignment 2, 2017
+ * by Luke Hedt
+ *
+ * The workers sleep until thread_pool_run() hands out a new task by bumping
+ * the pool's generation number, and it waits until they have all finished
+ * that generation before returning, so tasks never overlap.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <assert.h>
+#include <pthread.h>
+
+#include "threadpool.h"
+
+struct thread_pool {
+	int nthreads;			// number of workers, including the caller
+	pthread_t *threads;		// the other nthreads-1 workers
+	pthread_mutex_t lock;	// protects everything below
+	pthread_cond_t start;	// signalled when there is a new task (or stop)
+	pthread_cond_t done;	// signalled when the last worker finishes a task
+	PoolTask task;			// the current task
+	void *arg;				// and its argument
+	int generation;			// how many tasks have been handed out
+	int running;			// how many workers are still on the current task
+	bool stop;				// should the workers exit?
+};
+
+// what each new thread is given: its pool and its worker number
+typedef struct worker {
+	ThreadPool *pool;
+	int worker;
+} Worker;
+
+
+/* * * *
+ * helper functions
+ */
+
+// each worker thread runs each task handed out, until the pool stops
+static void *worker_main(void *arg) {
+	Worker self = *(Worker *)arg;
+	free(arg);
+	ThreadPool *pool = self.pool;
+
+	int seen = 0;	// the last generation this worker ran
+	pthread_mutex_lock(&pool->lock);
+	while (true) {
+		while (pool->generation == seen && !pool->stop) {
+			pthread_cond_wait(&pool->start, &pool->lock);
+		}
+		if (pool->stop) {
+			break;
+		}
+		seen = pool->generation;
+		PoolTask task = pool->task;
+		void *taskarg = pool->arg;
+		pthread_mutex_unlock(&pool->lock);
+
+		task(taskarg, self.worker, pool->nthreads);
+
+		pthread_mutex_lock(&pool->lock);
+		if (--pool->running == 0) {
+			pthread_cond_signal(&pool->done);
+		}
+	}
+	pthread_mutex_unlock(&pool->lock);
+	return NULL;
+}
+
+
+/* * * *
+ * all functions
+ */
+
+// start a pool of 'nthreads' workers (the thread calling thread_pool_run()
+// acts as worker 0, so only nthreads-1 new threads are started)
+ThreadPool *new_thread_pool(int nthreads) {
+	assert(nthreads > 0);
+	ThreadPool *pool = malloc(sizeof *pool);
+	assert(pool);
+
+	pool->nthreads = nthreads;
+	pool->generation = 0;
+	pool->running = 0;
+	pool->stop = false;
+	pthread_mutex_init(&pool->lock, NULL);
+	pthread_cond_init(&pool->start, NULL);
+	pthread_cond_init(&pool->done, NULL);
+
+	pool->threads = malloc(sizeof *pool->threads * nthreads);
+	assert(pool->threads);
+	int i;
+	for (i = 1; i < nthreads; i++) {
+		Worker *worker = malloc(sizeof *worker);
+		assert(worker);
+		worker->pool = pool;
+		worker->worker = i;
+		int err = pthread_create(&pool->threads[i], NULL, worker_main, worker);
+		assert(err == 0 && "error: couldn't start a worker thread!");
+	}
+
+	return pool;
+}
+
+
+// run 'task' on every worker in 'pool', returning once all of them finish
+void thread_pool_run(ThreadPool *pool, PoolTask task, void *arg) {
+	assert(pool != NULL);
+
+	// hand the task out to the other workers
+	pthread_mutex_lock(&pool->lock);
+	pool->task = task;
+	pool->arg = arg;
+	pool->running = pool->nthreads - 1;
+	pool->generation++;
+	pthread_cond_broadcast(&pool->start);
+	pthread_mutex_unlock(&pool->lock);
+
+	// do this thread's share, then wait for theirs
+	task(arg, 0, pool->nthreads);
+
+	pthread_mutex_lock(&pool->lock);
+	while (pool->running > 0) {
+		pthread_cond_wait(&pool->done, &pool->lock);
+	}
+	pthread_mutex_unlock(&pool->lock);
+}
+
+
+// the number of workers in 'pool'
+int thread_pool_size(ThreadPool *pool) {
+	assert(pool != NULL);
+	return pool->nthreads;
+}
+
+
+// stop the workers in 'pool' and free all memory associated with it
+void free_thread_pool(ThreadPool *pool) {
+	assert(pool != NULL);
+
+	pthread_mutex_lock(&pool->lock);
+	pool->stop = true;
+	pthread_cond_broadcast(&pool->start);
+	pthread_mutex_unlock(&pool->lock);
+
+	int i;
+	for (i = 1; i < pool->nthreads; i++) {
+		pthread_join(pool->threads[i], NULL);
+	}
+
+	pthread_cond_destroy(&pool->done);
+	pthread_cond_destroy(&pool->start);
+	pthread_mutex_destroy(&pool->lock);
+	free(pool->threads);
+	free(pool);
+}
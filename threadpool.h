@@ -0,0 +1,37 @@
+/* * * * * * * * *
+ * Module containing a fixed pool of worker threads, which all run the same
+ * task together, for splitting a job up between threads
+ *
+ * usage:
+ *   ThreadPool *pool = new_thread_pool(nthreads);
+ *   thread_pool_run(pool, task, arg);	// calls task(arg, w, nthreads) on
+ *   ...								// every worker w, then returns
+ *   free_thread_pool(pool);
+ *
+ * created for COMP20007 Design of Algorithms - Assignment 2, 2017
+ * by Luke Hedt
+ */
+
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+// a task for the pool: 'worker' is which of the 'nworkers' workers this is
+// (0 to nworkers-1), to choose its share of the work
+typedef void (*PoolTask)(void *arg, int worker, int nworkers);
+
+typedef struct thread_pool ThreadPool;
+
+// start a pool of 'nthreads' workers (the thread calling thread_pool_run()
+// acts as worker 0, so only nthreads-1 new threads are started)
+ThreadPool *new_thread_pool(int nthreads);
+
+// run 'task' on every worker in 'pool', returning once all of them finish
+void thread_pool_run(ThreadPool *pool, PoolTask task, void *arg);
+
+// the number of workers in 'pool'
+int thread_pool_size(ThreadPool *pool);
+
+// stop the workers in 'pool' and free all memory associated with it
+void free_thread_pool(ThreadPool *pool);
+
+#endif